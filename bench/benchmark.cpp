@@ -0,0 +1,79 @@
+#include <precomp.h>
+#include <benchmark.h>
+#include <numeric>
+#include <spdlog/spdlog.h>
+
+namespace veng::bench {
+
+    BenchmarkSummary BenchmarkResult::Summarize() const {
+        BenchmarkSummary summary;
+        if (samples.empty()) {
+            return summary;
+        }
+
+        std::vector<double> sorted = samples;
+        std::sort(sorted.begin(), sorted.end());
+
+        // Nearest rank percentiles
+        auto percentile = [&sorted](double fraction) {
+            std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * sorted.size()));
+            return sorted[std::clamp<std::size_t>(rank, 1, sorted.size()) - 1];
+        };
+
+        summary.min = sorted.front();
+        summary.median = percentile(0.5);
+        summary.p99 = percentile(0.99);
+        summary.mean = std::accumulate(sorted.begin(), sorted.end(), 0.0) / sorted.size();
+        return summary;
+    }
+
+    BenchmarkRunner::BenchmarkRunner(std::string_view filter, std::uint32_t iterations)
+        : filter_(filter), iterations_(std::max(iterations, 1u)) {}
+
+    bool BenchmarkRunner::ShouldRun(std::string_view suite) const {
+        return filter_.empty() || suite.find(filter_) != std::string_view::npos;
+    }
+
+    void BenchmarkRunner::AddResult(BenchmarkResult result) {
+        results_.push_back(std::move(result));
+    }
+
+    void BenchmarkRunner::PrintSummary() const {
+        for (const BenchmarkResult& result : results_) {
+            BenchmarkSummary summary = result.Summarize();
+            spdlog::info("{:<16} {:<36} min {:>10.3f}  median {:>10.3f}  p99 {:>10.3f} {}",
+                result.suite, result.name, summary.min, summary.median, summary.p99, result.unit);
+        }
+    }
+
+    static std::string EscapeJson(std::string_view text) {
+        std::string escaped;
+        for (char character : text) {
+            if (character == '"' || character == '\\') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(character);
+        }
+        return escaped;
+    }
+
+    void BenchmarkRunner::WriteJson(std::ostream& out, std::string_view device_name) const {
+        out << "{\n";
+        out << "  \"device\": \"" << EscapeJson(device_name) << "\",\n";
+        out << "  \"results\": [\n";
+
+        for (std::size_t i = 0; i < results_.size(); i++) {
+            const BenchmarkResult& result = results_[i];
+            BenchmarkSummary summary = result.Summarize();
+
+            out << "    {\"suite\": \"" << EscapeJson(result.suite) << "\", \"name\": \"" << EscapeJson(result.name)
+                << "\", \"unit\": \"" << EscapeJson(result.unit) << "\", \"samples\": " << result.samples.size()
+                << ", \"min\": " << summary.min << ", \"median\": " << summary.median << ", \"p99\": " << summary.p99
+                << ", \"mean\": " << summary.mean << "}";
+            out << (i + 1 < results_.size() ? ",\n" : "\n");
+        }
+
+        out << "  ]\n";
+        out << "}\n";
+    }
+}
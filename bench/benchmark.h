@@ -0,0 +1,52 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <ostream>
+
+namespace veng::bench {
+
+    struct BenchmarkSummary {
+        double min = 0.0;
+        double median = 0.0;
+        double p99 = 0.0;
+        double mean = 0.0;
+    };
+
+    struct BenchmarkResult {
+        std::string suite;
+        std::string name;
+        std::string unit;
+        std::vector<double> samples;
+
+        BenchmarkSummary Summarize() const;
+    };
+
+    class BenchmarkRunner {
+        public:
+        BenchmarkRunner(std::string_view filter, std::uint32_t iterations);
+
+        // A suite runs when the filter is empty or a substring of its name
+        bool ShouldRun(std::string_view suite) const;
+        std::uint32_t GetIterations() const { return iterations_; }
+        // For suites where every iteration loads or bakes something, a tenth of the iterations but at least 3
+        std::uint32_t GetSlowIterations() const { return std::max(iterations_ / 10, 3u); }
+
+        void AddResult(BenchmarkResult result);
+        void PrintSummary() const;
+        void WriteJson(std::ostream& out, std::string_view device_name) const;
+
+        private:
+        std::string filter_;
+        std::uint32_t iterations_;
+        std::vector<BenchmarkResult> results_;
+    };
+
+    template <typename Function>
+    double MeasureMilliseconds(Function&& function) {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const auto end = std::chrono::steady_clock::now();
+        return std::chrono::duration<double, std::milli>(end - start).count();
+    }
+}
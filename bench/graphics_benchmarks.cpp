@@ -0,0 +1,974 @@
+#include <precomp.h>
+#include <suites.h>
+#include <asset_archive.h>
+#include <async_file_reader.h>
+#include <atomic>
+#include <bit>
+#include <filesystem>
+#include <fstream>
+#include <glm/gtc/matrix_transform.hpp>
+#include <particle_system.h>
+#include <resource_cache.h>
+#include <spdlog/spdlog.h>
+#include <thread>
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace veng::bench {
+
+    namespace {
+
+        constexpr std::uint32_t kWarmupFrames = 8;
+
+        struct QuadMesh {
+            BufferHandle vertices;
+            BufferHandle indices;
+            std::uint32_t index_count = 0;
+        };
+
+        QuadMesh CreateQuad(Graphics& graphics) {
+            std::array<Vertex, 4> vertices = {
+                Vertex{{-0.5f, -0.5f, 0.0f}, {0.0f, 1.0f}},
+                Vertex{{0.5f, -0.5f, 0.0f}, {1.0f, 1.0f}},
+                Vertex{{-0.5f, 0.5f, 0.0f}, {0.0f, 0.0f}},
+                Vertex{{0.5f, 0.5f, 0.0f}, {1.0f, 0.0f}},
+            };
+            std::array<std::uint32_t, 6> indices = {0, 3, 2, 0, 1, 3};
+
+            QuadMesh quad;
+            quad.vertices = graphics.CreateVertexBuffer(vertices);
+            quad.indices = graphics.CreateIndexBuffer(indices);
+            quad.index_count = indices.size();
+            return quad;
+        }
+
+        void DestroyQuad(Graphics& graphics, QuadMesh quad) {
+            graphics.DestroyBuffer(quad.vertices);
+            graphics.DestroyBuffer(quad.indices);
+        }
+
+        // Unit cube around the origin, same layout as the quad
+        QuadMesh CreateBox(Graphics& graphics) {
+            std::vector<Vertex> vertices;
+            std::vector<std::uint32_t> indices;
+            for (std::uint32_t axis = 0; axis < 3; axis++) {
+                for (float side : {-0.5f, 0.5f}) {
+                    std::uint32_t first = vertices.size();
+                    for (std::uint32_t corner = 0; corner < 4; corner++) {
+                        glm::vec2 uv(corner & 1, corner >> 1);
+                        glm::vec3 position;
+                        position[axis] = side;
+                        position[(axis + 1) % 3] = uv.x - 0.5f;
+                        position[(axis + 2) % 3] = uv.y - 0.5f;
+                        vertices.emplace_back(position, uv);
+                    }
+                    for (std::uint32_t index : {0u, 3u, 2u, 0u, 1u, 3u}) {
+                        indices.push_back(first + index);
+                    }
+                }
+            }
+
+            QuadMesh box;
+            box.vertices = graphics.CreateVertexBuffer(vertices);
+            box.indices = graphics.CreateIndexBuffer(indices);
+            box.index_count = indices.size();
+            return box;
+        }
+
+        // stb_image reads binary PPM, which is trivial to write without an encoder
+        std::filesystem::path WriteTestImage(std::uint32_t size) {
+            std::filesystem::path path =
+                std::filesystem::temp_directory_path() / fmt::format("veng_bench_{}.ppm", size);
+            std::ofstream file(path, std::ios::binary);
+            file << "P6\n" << size << " " << size << "\n255\n";
+
+            std::vector<std::uint8_t> row(size * 3);
+            for (std::uint32_t y = 0; y < size; y++) {
+                for (std::uint32_t x = 0; x < size; x++) {
+                    row[x * 3 + 0] = static_cast<std::uint8_t>(x ^ y);
+                    row[x * 3 + 1] = static_cast<std::uint8_t>(x * 7 + y);
+                    row[x * 3 + 2] = static_cast<std::uint8_t>(y * 3);
+                }
+                file.write(reinterpret_cast<const char*>(row.data()), row.size());
+            }
+            return path;
+        }
+
+        // A DDS with the DX10 header and a full mip chain. Block compressed levels get arbitrary blocks, every bit
+        // pattern decodes to something.
+        std::filesystem::path WriteTestDds(std::uint32_t size, VkFormat format, std::uint32_t dxgi_format) {
+            std::filesystem::path path =
+                std::filesystem::temp_directory_path() / fmt::format("veng_bench_{}_{}.dds", size, dxgi_format);
+            std::ofstream file(path, std::ios::binary);
+
+            std::uint32_t mip_count = std::bit_width(size);
+            std::array<std::uint32_t, 32> header = {};
+            header[0] = 124;
+            header[1] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000;
+            header[2] = size;
+            header[3] = size;
+            header[6] = mip_count;
+            header[18] = 32;
+            header[19] = 0x4;
+            header[20] = 0x30315844;   // DX10
+            header[26] = 0x1000 | 0x400000 | 0x8;
+            std::array<std::uint32_t, 5> dx10_header = {dxgi_format, 3, 0, 1, 0};
+            file.write("DDS ", 4);
+            file.write(reinterpret_cast<const char*>(header.data()), 124);
+            file.write(reinterpret_cast<const char*>(dx10_header.data()), sizeof(dx10_header));
+
+            std::uint32_t state = 1;
+            for (std::uint32_t mip = 0; mip < mip_count; mip++) {
+                std::vector<std::uint8_t> level(GetTextureLevelSize(format, size >> mip, size >> mip));
+                for (std::uint8_t& byte : level) {
+                    state = state * 1664525u + 1013904223u;
+                    byte = static_cast<std::uint8_t>(state >> 24);
+                }
+                file.write(reinterpret_cast<const char*>(level.data()), level.size());
+            }
+            return path;
+        }
+
+        // Runs load and returns the MiB of images it left allocated, images are the only kImage allocations
+        // while a suite runs
+        template <typename Function>
+        double MeasureImageMebibytes(Graphics& graphics, Function&& load) {
+            auto image_bytes = [&graphics]() {
+                return graphics.GetMemoryStats().allocated_by_usage[static_cast<std::size_t>(MemoryUsage::kImage)];
+            };
+            graphics.WaitIdle();
+            VkDeviceSize before = image_bytes();
+            load();
+            return (image_bytes() - before) / (1024.0 * 1024.0);
+        }
+
+        // Makes the next read of path come from the disk. Only Linux lets an unprivileged process do
+        // this, elsewhere the reads are warm and the comparison only shows the parsing overhead.
+        void DropFromPageCache(const std::filesystem::path& path) {
+#if defined(__linux__)
+            std::int32_t file = open(path.c_str(), O_RDONLY);
+            if (file >= 0) {
+                fdatasync(file);
+                posix_fadvise(file, 0, 0, POSIX_FADV_DONTNEED);
+                close(file);
+            }
+#endif
+        }
+
+        // MiB of the process's resident set, field is "VmRSS:" or the peak "VmHWM:". Reads 0 outside Linux.
+        double GetResidentMemory(std::string_view field) {
+#if defined(__linux__)
+            std::ifstream status("/proc/self/status");
+            std::string line;
+            while (std::getline(status, line)) {
+                if (line.starts_with(field)) {
+                    // In kB
+                    return std::stod(line.substr(field.size())) / 1024.0;
+                }
+            }
+#endif
+            return 0.0;
+        }
+
+        // Drops the peak back to the current size and returns it
+        double ResetPeakResidentMemory() {
+#if defined(__linux__)
+            std::ofstream("/proc/self/clear_refs") << "5";
+#endif
+            return GetResidentMemory("VmHWM:");
+        }
+
+        void SetupCamera(Graphics& graphics) {
+            glm::mat4 view = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 0.0f, -2.0f));
+            glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+            graphics.SetViewProjection(view, projection);
+        }
+
+        void RecordDraws(Graphics& graphics, const QuadMesh& quad, gsl::span<TextureHandle> textures,
+                         std::uint32_t draw_count) {
+            for (std::uint32_t i = 0; i < draw_count; i++) {
+                graphics.SetTexture(textures[i % textures.size()]);
+                float offset = (static_cast<float>(i % 64) - 32.0f) / 32.0f;
+                graphics.SetModelMatrix(glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, 0.0f)));
+                graphics.RenderIndexedBuffer(quad.vertices, quad.indices, quad.index_count);
+            }
+        }
+    }
+
+    void RunDrawCallBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        QuadMesh quad = CreateQuad(graphics);
+        std::filesystem::path image = WriteTestImage(64);
+        TextureHandle texture = graphics.CreateTexture(image.string().c_str());
+        SetupCamera(graphics);
+
+        for (std::uint32_t draw_count : {100u, 1000u, 10000u}) {
+            BenchmarkResult cpu_result{"draw_calls", fmt::format("{}_draws_cpu_record_submit", draw_count), "ms"};
+            BenchmarkResult gpu_result{"draw_calls", fmt::format("{}_draws_gpu_frame", draw_count), "ms"};
+
+            for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+                double milliseconds = MeasureMilliseconds([&]() {
+                    graphics.BeginFrame();
+                    RecordDraws(graphics, quad, gsl::span<TextureHandle>(&texture, 1), draw_count);
+                    graphics.EndFrame();
+                });
+
+                // GPU timings lag a couple of frames behind, skip the warmup ones
+                if (i >= kWarmupFrames + 2) {
+                    cpu_result.samples.push_back(milliseconds);
+                    if (graphics.GetLastGpuFrameTime().has_value()) {
+                        gpu_result.samples.push_back(graphics.GetLastGpuFrameTime().value());
+                    }
+                }
+            }
+
+            runner.AddResult(std::move(cpu_result));
+            runner.AddResult(std::move(gpu_result));
+        }
+
+        graphics.WaitIdle();
+        graphics.DestroyTexture(texture);
+        DestroyQuad(graphics, quad);
+        std::filesystem::remove(image);
+    }
+
+    void RunUploadBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr VkDeviceSize kMebibyte = 1024 * 1024;
+        std::uint32_t iterations = runner.GetSlowIterations();
+
+        for (VkDeviceSize size_mb : {1ull, 16ull, 64ull}) {
+            std::vector<Vertex> vertices(size_mb * kMebibyte / sizeof(Vertex));
+            BenchmarkResult result{"upload", fmt::format("vertex_buffer_{}mb", size_mb), "MiB/s"};
+
+            for (std::uint32_t i = 0; i < iterations; i++) {
+                BufferHandle buffer;
+                double milliseconds = MeasureMilliseconds([&]() {
+                    buffer = graphics.CreateVertexBuffer(vertices);
+                    graphics.WaitForUploads();
+                });
+                result.samples.push_back(static_cast<double>(size_mb) / (milliseconds / 1000.0));
+                graphics.DestroyBuffer(buffer);
+            }
+
+            runner.AddResult(std::move(result));
+        }
+
+        for (std::uint32_t size : {512u, 2048u}) {
+            std::filesystem::path image = WriteTestImage(size);
+            BenchmarkResult result{"upload", fmt::format("texture_{}x{}_decode_upload", size, size), "ms"};
+
+            for (std::uint32_t i = 0; i < iterations; i++) {
+                TextureHandle texture;
+                result.samples.push_back(MeasureMilliseconds([&]() {
+                    texture = graphics.CreateTexture(image.string().c_str());
+                    graphics.WaitForUploads();
+                }));
+                graphics.DestroyTexture(texture);
+            }
+
+            runner.AddResult(std::move(result));
+            std::filesystem::remove(image);
+        }
+    }
+
+    void RunDescriptorBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kDrawCount = 2000;
+        constexpr std::uint32_t kTextureCount = 8;
+
+        QuadMesh quad = CreateQuad(graphics);
+        std::filesystem::path image = WriteTestImage(64);
+        std::vector<TextureHandle> textures;
+        for (std::uint32_t i = 0; i < kTextureCount; i++) {
+            textures.push_back(graphics.CreateTexture(image.string().c_str()));
+        }
+        SetupCamera(graphics);
+
+        // Same draws, once rebinding a different set every draw and once with a single set
+        for (std::uint32_t bound_textures : {kTextureCount, 1u}) {
+            BenchmarkResult result{
+                "descriptors",
+                fmt::format("{}_draws_{}", kDrawCount, bound_textures > 1 ? "set_churn" : "single_set"), "ms"};
+
+            for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+                double milliseconds = MeasureMilliseconds([&]() {
+                    graphics.BeginFrame();
+                    RecordDraws(graphics, quad, gsl::span<TextureHandle>(textures.data(), bound_textures), kDrawCount);
+                    graphics.EndFrame();
+                });
+                if (i >= kWarmupFrames) {
+                    result.samples.push_back(milliseconds);
+                }
+            }
+
+            runner.AddResult(std::move(result));
+        }
+
+        BenchmarkResult allocation_result{"descriptors", "texture_create_destroy_64x64", "ms"};
+        for (std::uint32_t i = 0; i < runner.GetIterations(); i++) {
+            allocation_result.samples.push_back(MeasureMilliseconds([&]() {
+                TextureHandle texture = graphics.CreateTexture(image.string().c_str());
+                graphics.DestroyTexture(texture);
+            }));
+        }
+        runner.AddResult(std::move(allocation_result));
+
+        graphics.WaitIdle();
+        for (TextureHandle texture : textures) {
+            graphics.DestroyTexture(texture);
+        }
+        DestroyQuad(graphics, quad);
+        std::filesystem::remove(image);
+    }
+
+    void RunPipelineBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        BenchmarkResult result{"pipelines", "recreate_all_pipelines", "ms"};
+        std::uint32_t iterations = std::max(runner.GetIterations() / 4, 3u);
+
+        for (std::uint32_t i = 0; i < iterations; i++) {
+            result.samples.push_back(MeasureMilliseconds([&]() { graphics.RecreatePipelines(); }));
+        }
+
+        runner.AddResult(std::move(result));
+    }
+
+    void RunFrameLatencyBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        QuadMesh quad = CreateQuad(graphics);
+        std::filesystem::path image = WriteTestImage(64);
+        TextureHandle texture = graphics.CreateTexture(image.string().c_str());
+        SetupCamera(graphics);
+
+        // From the start of recording until the GPU has finished the frame
+        BenchmarkResult result{"frame_latency", "100_draws_record_to_gpu_complete", "ms"};
+        for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+            double milliseconds = MeasureMilliseconds([&]() {
+                graphics.BeginFrame();
+                RecordDraws(graphics, quad, gsl::span<TextureHandle>(&texture, 1), 100);
+                graphics.EndFrame();
+                graphics.WaitIdle();
+            });
+            if (i >= kWarmupFrames) {
+                result.samples.push_back(milliseconds);
+            }
+        }
+        runner.AddResult(std::move(result));
+
+        graphics.DestroyTexture(texture);
+        DestroyQuad(graphics, quad);
+        std::filesystem::remove(image);
+    }
+
+    void RunComputeBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kGroupSize = 256;
+
+        struct FillConstants {
+            std::uint32_t count;
+            std::uint32_t seed;
+        };
+
+        std::array<ComputeBindingType, 1> bindings = {ComputeBindingType::kStorageBuffer};
+        ComputePipelineHandle pipeline =
+            graphics.CreateComputePipeline("./fill_buffer.comp.spv", bindings, sizeof(FillConstants));
+
+        // Standalone submissions, from recording until the GPU is done
+        for (std::uint32_t size_mb : {1u, 16u, 64u}) {
+            std::uint32_t count = size_mb * 1024 * 1024 / sizeof(std::uint32_t);
+            BufferHandle buffer = graphics.CreateStorageBuffer(count * sizeof(std::uint32_t), "compute benchmark");
+            std::array<ComputeResource, 1> resources = {buffer};
+            VkDescriptorSet set = graphics.CreateComputeSet(pipeline, resources);
+
+            BenchmarkResult result{"compute", fmt::format("fill_{}mb_submit_wait", size_mb), "MiB/s"};
+            for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+                FillConstants constants = {count, i};
+                double milliseconds = MeasureMilliseconds([&]() {
+                    std::uint64_t value = graphics.SubmitCompute([&](ComputeRecorder& recorder) {
+                        recorder.Dispatch(pipeline, set, {(count + kGroupSize - 1) / kGroupSize, 1, 1}, &constants);
+                    });
+                    graphics.WaitForCompute(value);
+                });
+                if (i >= kWarmupFrames) {
+                    result.samples.push_back(static_cast<double>(size_mb) / (milliseconds / 1000.0));
+                }
+            }
+            runner.AddResult(std::move(result));
+
+            graphics.DestroyComputeSet(set);
+            graphics.DestroyBuffer(buffer);
+        }
+
+        // Many small dispatches inside a frame, each waiting on the previous one
+        constexpr std::uint32_t kDispatchCount = 64;
+        constexpr std::uint32_t kSmallCount = 64 * 1024;
+        BufferHandle buffer = graphics.CreateStorageBuffer(kSmallCount * sizeof(std::uint32_t), "compute benchmark");
+        std::array<ComputeResource, 1> resources = {buffer};
+        VkDescriptorSet set = graphics.CreateComputeSet(pipeline, resources);
+
+        BenchmarkResult frame_result{"compute", fmt::format("{}_dispatches_in_frame_gpu", kDispatchCount), "ms"};
+        for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+            graphics.BeginFrame();
+            graphics.RecordCompute([&](ComputeRecorder& recorder) {
+                for (std::uint32_t d = 0; d < kDispatchCount; d++) {
+                    FillConstants constants = {kSmallCount, d};
+                    recorder.Dispatch(pipeline, set, {kSmallCount / kGroupSize, 1, 1}, &constants);
+                    recorder.BufferBarrier(
+                        buffer, ResourceUsage::kComputeStorageWrite, ResourceUsage::kComputeStorageWrite);
+                }
+            });
+            graphics.EndFrame();
+
+            if (i >= kWarmupFrames + 2 && graphics.GetLastGpuFrameTime().has_value()) {
+                frame_result.samples.push_back(graphics.GetLastGpuFrameTime().value());
+            }
+        }
+        runner.AddResult(std::move(frame_result));
+
+        // The same frames with a large fill running next to them on the compute queue
+        if (graphics.HasAsyncComputeQueue()) {
+            constexpr std::uint32_t kAsyncCount = 16 * 1024 * 1024 / sizeof(std::uint32_t);
+            BufferHandle async_buffer =
+                graphics.CreateStorageBuffer(kAsyncCount * sizeof(std::uint32_t), "compute benchmark");
+            std::array<ComputeResource, 1> async_resources = {async_buffer};
+            VkDescriptorSet async_set = graphics.CreateComputeSet(pipeline, async_resources);
+            std::array<AsyncComputeBuffer, 1> transfers = {{{async_buffer}}};
+
+            BenchmarkResult overlap_result{"compute", "async_fill_16mb_overlap", "%"};
+            for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+                AsyncComputeStats before = graphics.GetAsyncComputeStats();
+                FillConstants async_constants = {kAsyncCount, i};
+                std::uint64_t submission = graphics.SubmitAsyncCompute(
+                    [&](ComputeRecorder& recorder) {
+                        recorder.Dispatch(pipeline, async_set, {kAsyncCount / kGroupSize, 1, 1}, &async_constants);
+                    },
+                    transfers);
+
+                graphics.BeginFrame();
+                graphics.RecordCompute([&](ComputeRecorder& recorder) {
+                    for (std::uint32_t d = 0; d < kDispatchCount; d++) {
+                        FillConstants constants = {kSmallCount, d};
+                        recorder.Dispatch(pipeline, set, {kSmallCount / kGroupSize, 1, 1}, &constants);
+                        recorder.BufferBarrier(
+                            buffer, ResourceUsage::kComputeStorageWrite, ResourceUsage::kComputeStorageWrite);
+                    }
+                });
+                graphics.AcquireAsyncCompute(submission);
+                graphics.EndFrame();
+
+                // Timings arrive a few frames late, which evens out over the run
+                AsyncComputeStats after = graphics.GetAsyncComputeStats();
+                double busy_ms = after.busy_ms - before.busy_ms;
+                if (i >= kWarmupFrames && busy_ms > 0.0) {
+                    overlap_result.samples.push_back((after.overlapped_ms - before.overlapped_ms) / busy_ms * 100.0);
+                }
+            }
+            runner.AddResult(std::move(overlap_result));
+
+            graphics.WaitIdle();
+            graphics.DestroyComputeSet(async_set);
+            graphics.DestroyBuffer(async_buffer);
+        }
+
+        graphics.WaitIdle();
+        graphics.DestroyComputeSet(set);
+        graphics.DestroyBuffer(buffer);
+        graphics.DestroyComputePipeline(pipeline);
+    }
+
+    void RunStreamingBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::int32_t kTextureSize = 2048;
+        constexpr std::uint32_t kTextureCount = 64;   // 16 MiB each, 1 GiB in total
+        constexpr std::uint32_t kMaxInFlight = 8;
+        constexpr double kTextureMebibytes = kTextureSize * kTextureSize * 4 / (1024.0 * 1024.0);
+
+        QuadMesh quad = CreateQuad(graphics);
+        std::filesystem::path image = WriteTestImage(64);
+        TextureHandle texture = graphics.CreateTexture(image.string().c_str());
+        SetupCamera(graphics);
+
+        auto render_frame = [&]() {
+            graphics.BeginFrame();
+            RecordDraws(graphics, quad, gsl::span<TextureHandle>(&texture, 1), 1000);
+            graphics.EndFrame();
+        };
+
+        BenchmarkResult idle_result{"streaming", "1000_draws_gpu_frame_idle", "ms"};
+        for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+            render_frame();
+            if (i >= kWarmupFrames + 2 && graphics.GetLastGpuFrameTime().has_value()) {
+                idle_result.samples.push_back(graphics.GetLastGpuFrameTime().value());
+            }
+        }
+        runner.AddResult(std::move(idle_result));
+
+        // A loader thread keeps a few textures in flight, frames hand them over and drop them again
+        std::vector<std::uint8_t> pixels(kTextureSize * kTextureSize * 4);
+        for (std::size_t i = 0; i < pixels.size(); i++) {
+            pixels[i] = static_cast<std::uint8_t>(i * 31);
+        }
+
+        std::atomic<std::uint32_t> in_flight = 0;
+        std::uint32_t ready_count = 0;
+        std::thread loader([&]() {
+            for (std::uint32_t i = 0; i < kTextureCount; i++) {
+                while (in_flight.load() >= kMaxInFlight) {
+                    std::this_thread::yield();
+                }
+                in_flight++;
+                graphics.StreamTexture(pixels, {kTextureSize, kTextureSize}, "streaming benchmark",
+                                       [&](TextureHandle streamed) {
+                                           graphics.DestroyTexture(streamed);
+                                           ready_count++;
+                                           in_flight--;
+                                       });
+            }
+        });
+
+        BenchmarkResult cpu_result{"streaming", "1000_draws_cpu_frame_streaming_1gb", "ms"};
+        BenchmarkResult gpu_result{"streaming", "1000_draws_gpu_frame_streaming_1gb", "ms"};
+        double total_milliseconds = MeasureMilliseconds([&]() {
+            while (ready_count < kTextureCount) {
+                cpu_result.samples.push_back(MeasureMilliseconds(render_frame));
+                if (graphics.GetLastGpuFrameTime().has_value()) {
+                    gpu_result.samples.push_back(graphics.GetLastGpuFrameTime().value());
+                }
+            }
+        });
+        loader.join();
+
+        runner.AddResult(std::move(cpu_result));
+        runner.AddResult(std::move(gpu_result));
+        runner.AddResult(
+            {"streaming", "stream_1gb_throughput", "MiB/s",
+             {kTextureCount * kTextureMebibytes / (total_milliseconds / 1000.0)}});
+
+        graphics.WaitIdle();
+        graphics.DestroyTexture(texture);
+        DestroyQuad(graphics, quad);
+        std::filesystem::remove(image);
+    }
+
+    void RunParticleBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        std::filesystem::path image = WriteTestImage(64);
+        TextureHandle texture = graphics.CreateTexture(image.string().c_str());
+        SetupCamera(graphics);
+
+        // Full buffers that never die, every frame simulates, compacts and draws all of them
+        for (std::uint32_t thousands : {64u, 256u, 1024u}) {
+            std::uint32_t capacity = thousands * 1024;
+            ParticleSystem particles(graphics, capacity, "particle benchmark");
+            ParticleEmitter emitter;
+            emitter.radius = 1.0f;
+            emitter.spread = 0.1f;
+            emitter.lifetime = 1000.0f;
+            emitter.size = 0.01f;
+            emitter.rate = 0.0f;
+            particles.SetEmitter(emitter);
+            particles.SetGravity(glm::vec3(0.0f));
+            particles.Burst(capacity);
+
+            BenchmarkResult gpu_result{"particles", fmt::format("{}k_particles_gpu_frame", thousands), "ms"};
+            BenchmarkResult throughput_result{
+                "particles", fmt::format("{}k_particles_throughput", thousands), "particles/ms"};
+            for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+                graphics.BeginFrame();
+                particles.Update(1.0f / 60.0f);
+                graphics.SetTexture(texture);
+                particles.Render();
+                graphics.EndFrame();
+
+                if (i >= kWarmupFrames + 2 && graphics.GetLastGpuFrameTime().has_value()) {
+                    double milliseconds = graphics.GetLastGpuFrameTime().value();
+                    gpu_result.samples.push_back(milliseconds);
+                    throughput_result.samples.push_back(static_cast<double>(capacity) / milliseconds);
+                }
+            }
+            runner.AddResult(std::move(gpu_result));
+            runner.AddResult(std::move(throughput_result));
+
+            graphics.WaitIdle();
+        }
+
+        graphics.DestroyTexture(texture);
+        std::filesystem::remove(image);
+    }
+
+    void RunOcclusionBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        QuadMesh box = CreateBox(graphics);
+        std::filesystem::path image = WriteTestImage(64);
+        TextureHandle texture = graphics.CreateTexture(image.string().c_str());
+
+        // Street level in a dense city block, the first rows of buildings hide almost everything behind them
+        glm::mat4 view =
+            glm::lookAt(glm::vec3(2.0f, 1.5f, 2.0f), glm::vec3(3.0f, 1.5f, -40.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 500.0f);
+
+        for (std::uint32_t side : {32u, 64u, 96u}) {
+            std::uint32_t building_count = side * side;
+            std::vector<glm::mat4> buildings;
+            buildings.reserve(building_count);
+            for (std::uint32_t z = 0; z < side; z++) {
+                for (std::uint32_t x = 0; x < side; x++) {
+                    // Blocks on a 4m grid with 1m streets between them
+                    float height = 4.0f + static_cast<float>((x * 7 + z * 13) % 17);
+                    glm::vec3 center((static_cast<float>(x) - side / 2.0f) * 4.0f, height / 2.0f,
+                                     (static_cast<float>(z) - side / 2.0f) * 4.0f);
+                    glm::mat4 model = glm::translate(glm::mat4(1.0f), center);
+                    buildings.push_back(glm::scale(model, glm::vec3(3.0f, height, 3.0f)));
+                }
+            }
+
+            for (bool culling : {false, true}) {
+                graphics.SetOcclusionCulling(culling);
+                std::string_view mode = culling ? "culling_on" : "culling_off";
+                BenchmarkResult gpu_result{
+                    "occlusion", fmt::format("{}_buildings_gpu_frame_{}", building_count, mode), "ms"};
+                BenchmarkResult drawn_result{"occlusion", fmt::format("{}_buildings_drawn", building_count), "%"};
+                BenchmarkResult culled_result{"occlusion", fmt::format("{}_buildings_culled", building_count), "%"};
+
+                for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+                    graphics.BeginFrame();
+                    graphics.SetViewProjection(view, projection);
+                    graphics.SetTexture(texture);
+                    for (const glm::mat4& model : buildings) {
+                        graphics.SetModelMatrix(model);
+                        graphics.SetBounds(glm::vec3(-0.5f), glm::vec3(0.5f));
+                        graphics.RenderIndexedBuffer(box.vertices, box.indices, box.index_count);
+                    }
+                    graphics.EndFrame();
+
+                    if (i < kWarmupFrames + 2) {
+                        continue;
+                    }
+                    if (graphics.GetLastGpuFrameTime().has_value()) {
+                        gpu_result.samples.push_back(graphics.GetLastGpuFrameTime().value());
+                    }
+                    // Read back a frame late, by then the pyramid has settled
+                    OcclusionStats stats = graphics.GetOcclusionStats();
+                    if (culling && stats.candidate_count > 0) {
+                        double candidates = stats.candidate_count;
+                        drawn_result.samples.push_back(100.0 * stats.GetDrawnCount() / candidates);
+                        culled_result.samples.push_back(100.0 * stats.GetCulledCount() / candidates);
+                    }
+                }
+
+                runner.AddResult(std::move(gpu_result));
+                if (culling) {
+                    runner.AddResult(std::move(drawn_result));
+                    runner.AddResult(std::move(culled_result));
+                }
+            }
+        }
+
+        graphics.SetOcclusionCulling(true);
+        graphics.WaitIdle();
+        graphics.DestroyTexture(texture);
+        DestroyQuad(graphics, box);
+        std::filesystem::remove(image);
+    }
+
+    void RunAssetBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kTextureCount = 16;
+        constexpr std::uint32_t kTextureSize = 1024;
+
+        std::filesystem::path image = WriteTestImage(kTextureSize);
+        std::vector<std::filesystem::path> loose_files;
+        AssetArchiveWriter writer;
+        for (std::uint32_t i = 0; i < kTextureCount; i++) {
+            std::filesystem::path path =
+                std::filesystem::temp_directory_path() / fmt::format("veng_bench_asset_{}.ppm", i);
+            std::filesystem::copy_file(image, path, std::filesystem::copy_options::overwrite_existing);
+            writer.AddFile(path, path.filename().string());
+            loose_files.push_back(path);
+        }
+        std::filesystem::path archive_path = std::filesystem::temp_directory_path() / "veng_bench_assets.vpak";
+        writer.Write(archive_path);
+
+        std::uint32_t iterations = runner.GetSlowIterations();
+        std::vector<TextureHandle> textures;
+        auto release = [&]() {
+            for (TextureHandle texture : textures) {
+                graphics.DestroyTexture(texture);
+            }
+            textures.clear();
+        };
+
+        // Everything from opening the files until the last upload has landed
+        BenchmarkResult loose_result{"assets", fmt::format("{}_textures_loose_cold", kTextureCount), "ms"};
+        for (std::uint32_t i = 0; i < iterations; i++) {
+            for (const std::filesystem::path& path : loose_files) {
+                DropFromPageCache(path);
+            }
+            loose_result.samples.push_back(MeasureMilliseconds([&]() {
+                for (const std::filesystem::path& path : loose_files) {
+                    textures.push_back(graphics.CreateTexture(path.string().c_str()));
+                }
+                graphics.WaitForUploads();
+            }));
+            release();
+        }
+
+        BenchmarkResult archive_result{"assets", fmt::format("{}_textures_archive_cold", kTextureCount), "ms"};
+        for (std::uint32_t i = 0; i < iterations; i++) {
+            DropFromPageCache(archive_path);
+            archive_result.samples.push_back(MeasureMilliseconds([&]() {
+                AssetArchive archive(archive_path);
+                for (const std::filesystem::path& path : loose_files) {
+                    textures.push_back(graphics.CreateTexture(archive, path.filename().string()));
+                }
+                graphics.WaitForUploads();
+            }));
+            release();
+        }
+
+        runner.AddResult(std::move(loose_result));
+        runner.AddResult(std::move(archive_result));
+
+        graphics.WaitIdle();
+        for (const std::filesystem::path& path : loose_files) {
+            std::filesystem::remove(path);
+        }
+        std::filesystem::remove(archive_path);
+        std::filesystem::remove(image);
+    }
+
+    void RunAsyncIoBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kTextureCount = 32;
+        constexpr std::uint32_t kTextureSize = 1024;
+
+        std::filesystem::path image = WriteTestImage(kTextureSize);
+        std::vector<std::filesystem::path> files;
+        for (std::uint32_t i = 0; i < kTextureCount; i++) {
+            std::filesystem::path path =
+                std::filesystem::temp_directory_path() / fmt::format("veng_bench_async_{}.ppm", i);
+            std::filesystem::copy_file(image, path, std::filesystem::copy_options::overwrite_existing);
+            files.push_back(path);
+        }
+
+        AsyncFileReader reader;
+        spdlog::info("Reading through {}", reader.UsesIoUring() ? "io_uring" : "the thread pool");
+
+        std::uint32_t iterations = runner.GetSlowIterations();
+        std::vector<TextureHandle> textures;
+        auto release = [&]() {
+            // Streamed textures are only handed over inside BeginFrame
+            while (textures.size() < kTextureCount) {
+                graphics.BeginFrame();
+                graphics.EndFrame();
+            }
+            for (TextureHandle texture : textures) {
+                graphics.DestroyTexture(texture);
+            }
+            textures.clear();
+        };
+        auto drop_caches = [&]() {
+            for (const std::filesystem::path& path : files) {
+                DropFromPageCache(path);
+            }
+        };
+
+        // A level load, from opening the first file until the last upload has landed
+        BenchmarkResult blocking_result{"async_io", fmt::format("{}_textures_blocking_cold", kTextureCount), "ms"};
+        for (std::uint32_t i = 0; i < iterations; i++) {
+            drop_caches();
+            blocking_result.samples.push_back(MeasureMilliseconds([&]() {
+                for (const std::filesystem::path& path : files) {
+                    textures.push_back(graphics.CreateTexture(path.string().c_str()));
+                }
+                graphics.WaitForUploads();
+            }));
+            release();
+        }
+        runner.AddResult(std::move(blocking_result));
+
+        // Every read is queued up front, decoding one file overlaps with the reads behind it
+        for (bool direct : {false, true}) {
+            std::string name = fmt::format("{}_textures_async{}_cold", kTextureCount, direct ? "_direct" : "");
+            BenchmarkResult async_result{"async_io", name, "ms"};
+            for (std::uint32_t i = 0; i < iterations; i++) {
+                drop_caches();
+                async_result.samples.push_back(MeasureMilliseconds([&]() {
+                    for (const std::filesystem::path& path : files) {
+                        reader.Read(path, [&](FileReadResult result) {
+                            graphics.StreamTexture(result.data.GetSpan(), "async io benchmark",
+                                                   [&](TextureHandle texture) { textures.push_back(texture); });
+                        }, direct);
+                    }
+                    reader.WaitIdle();
+                    graphics.WaitForUploads();
+                }));
+                release();
+            }
+            runner.AddResult(std::move(async_result));
+        }
+
+        graphics.WaitIdle();
+        for (const std::filesystem::path& path : files) {
+            std::filesystem::remove(path);
+        }
+        std::filesystem::remove(image);
+    }
+
+    void RunCompressionBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kTextureCount = 16;
+        constexpr std::uint32_t kTextureSize = 1024;
+
+        struct TestFormat {
+            std::string_view name;
+            VkFormat format;
+            std::uint32_t dxgi_format;
+        };
+        constexpr std::array<TestFormat, 4> kFormats = {{
+            {"rgba8", VK_FORMAT_R8G8B8A8_SRGB, 29},
+            {"bc1", VK_FORMAT_BC1_RGBA_SRGB_BLOCK, 72},
+            {"bc5", VK_FORMAT_BC5_UNORM_BLOCK, 83},
+            {"bc7", VK_FORMAT_BC7_SRGB_BLOCK, 99},
+        }};
+
+        QuadMesh quad = CreateQuad(graphics);
+        SetupCamera(graphics);
+
+        for (const TestFormat& test_format : kFormats) {
+            if (!graphics.IsTextureFormatSupported(test_format.format)) {
+                spdlog::warn("Skipping {}, the device can't sample it", test_format.name);
+                continue;
+            }
+            std::filesystem::path path = WriteTestDds(kTextureSize, test_format.format, test_format.dxgi_format);
+
+            std::vector<TextureHandle> textures;
+            BenchmarkResult load_result{"compression", fmt::format("{}_{}_textures_load", test_format.name,
+                                                                   kTextureCount), "ms"};
+            BenchmarkResult memory_result{"compression", fmt::format("{}_{}_textures_memory", test_format.name,
+                                                                     kTextureCount), "MiB"};
+            memory_result.samples.push_back(MeasureImageMebibytes(graphics, [&]() {
+                load_result.samples.push_back(MeasureMilliseconds([&]() {
+                    for (std::uint32_t i = 0; i < kTextureCount; i++) {
+                        textures.push_back(graphics.CreateTexture(path.string().c_str()));
+                    }
+                    graphics.WaitForUploads();
+                }));
+            }));
+
+            BenchmarkResult gpu_result{"compression", fmt::format("{}_1000_draws_gpu_frame", test_format.name), "ms"};
+            for (std::uint32_t i = 0; i < kWarmupFrames + runner.GetIterations(); i++) {
+                graphics.BeginFrame();
+                RecordDraws(graphics, quad, textures, 1000);
+                graphics.EndFrame();
+                if (i >= kWarmupFrames + 2 && graphics.GetLastGpuFrameTime().has_value()) {
+                    gpu_result.samples.push_back(graphics.GetLastGpuFrameTime().value());
+                }
+            }
+
+            runner.AddResult(std::move(load_result));
+            runner.AddResult(std::move(memory_result));
+            runner.AddResult(std::move(gpu_result));
+
+            for (TextureHandle texture : textures) {
+                graphics.DestroyTexture(texture);
+            }
+            std::filesystem::remove(path);
+        }
+
+        graphics.WaitIdle();
+        DestroyQuad(graphics, quad);
+    }
+
+    void RunTextureDecodeBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kTextureCount = 8;
+        constexpr std::uint32_t kTextureSize = 2048;
+
+        // PPM is RGB, so the staging ring run also expands to RGBA on the way into staging
+        std::filesystem::path image = WriteTestImage(kTextureSize);
+        std::uint32_t iterations = runner.GetSlowIterations();
+
+        for (bool staging_ring : {false, true}) {
+            graphics.SetStagingRing(staging_ring);
+            std::string_view mode = staging_ring ? "staging_ring" : "heap_copy";
+            BenchmarkResult load_result{"texture_decode",
+                                        fmt::format("{}_textures_{}_{}_load", kTextureCount, kTextureSize, mode), "ms"};
+            BenchmarkResult memory_result{
+                "texture_decode", fmt::format("{}_textures_{}_{}_peak_rss", kTextureCount, kTextureSize, mode), "MiB"};
+
+            // The first round only makes the ring's pages resident, they are part of every baseline after it
+            for (std::uint32_t i = 0; i < 1 + iterations; i++) {
+                std::vector<TextureHandle> textures;
+                double baseline = ResetPeakResidentMemory();
+                double milliseconds = MeasureMilliseconds([&]() {
+                    for (std::uint32_t j = 0; j < kTextureCount; j++) {
+                        textures.push_back(graphics.CreateTexture(image.string().c_str()));
+                    }
+                    graphics.WaitForUploads();
+                });
+                double peak = GetResidentMemory("VmHWM:");
+                if (i >= 1) {
+                    load_result.samples.push_back(milliseconds);
+                    memory_result.samples.push_back(peak - baseline);
+                }
+
+                for (TextureHandle texture : textures) {
+                    graphics.DestroyTexture(texture);
+                }
+                graphics.WaitIdle();
+            }
+
+            runner.AddResult(std::move(load_result));
+            runner.AddResult(std::move(memory_result));
+        }
+
+        graphics.SetStagingRing(true);
+        std::filesystem::remove(image);
+    }
+
+    void RunResourceCacheBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kMaterialCount = 64;
+        constexpr std::uint32_t kUniqueTextureCount = 8;
+
+        // Every material points at one of a few textures, as in a scene built from a small material library
+        std::vector<std::filesystem::path> images;
+        for (std::uint32_t i = 0; i < kUniqueTextureCount; i++) {
+            images.push_back(WriteTestImage(512 + i * 8));
+        }
+        std::uint32_t iterations = runner.GetSlowIterations();
+
+        for (bool cached : {false, true}) {
+            std::string_view mode = cached ? "cache" : "direct";
+            BenchmarkResult load_result{
+                "resource_cache", fmt::format("{}_materials_{}_textures_{}_load", kMaterialCount, kUniqueTextureCount,
+                                              mode), "ms"};
+            BenchmarkResult memory_result{
+                "resource_cache", fmt::format("{}_materials_{}_textures_{}_memory", kMaterialCount,
+                                              kUniqueTextureCount, mode), "MiB"};
+
+            for (std::uint32_t i = 0; i < iterations; i++) {
+                ResourceCache cache(graphics);
+                std::vector<TextureHandle> textures;
+
+                memory_result.samples.push_back(MeasureImageMebibytes(graphics, [&]() {
+                    load_result.samples.push_back(MeasureMilliseconds([&]() {
+                        for (std::uint32_t j = 0; j < kMaterialCount; j++) {
+                            std::string path = images[j % kUniqueTextureCount].string();
+                            textures.push_back(cached ? cache.AcquireTexture(path.c_str())
+                                                      : graphics.CreateTexture(path.c_str()));
+                        }
+                        graphics.WaitForUploads();
+                    }));
+                }));
+
+                for (TextureHandle texture : textures) {
+                    if (cached) {
+                        cache.Release(texture);
+                    } else {
+                        graphics.DestroyTexture(texture);
+                    }
+                }
+            }
+            graphics.WaitIdle();
+
+            runner.AddResult(std::move(load_result));
+            runner.AddResult(std::move(memory_result));
+        }
+
+        for (const std::filesystem::path& image : images) {
+            std::filesystem::remove(image);
+        }
+    }
+}
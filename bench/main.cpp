@@ -0,0 +1,74 @@
+#include <precomp.h>
+#include <suites.h>
+#include <filesystem>
+#include <fstream>
+#include <spdlog/spdlog.h>
+
+// VulkanEngineBenchmark [--filter=<suite>] [--iterations=<n>] [--out=<file.json>]
+// Runs headless, so VK_ICD_FILENAMES can point it at lavapipe or any other driver.
+std::int32_t main(std::int32_t argc, gsl::zstring* argv) {
+    std::string filter;
+    std::uint32_t iterations = 100;
+    std::filesystem::path output = "benchmark_results.json";
+
+    for (gsl::czstring argument : gsl::span<gsl::zstring>(argv, argc).subspan(1)) {
+        std::string_view value(argument);
+        if (value.starts_with("--filter=")) {
+            filter = value.substr(std::string_view("--filter=").size());
+        } else if (value.starts_with("--iterations=")) {
+            iterations = std::stoul(std::string(value.substr(std::string_view("--iterations=").size())));
+        } else if (value.starts_with("--out=")) {
+            output = value.substr(std::string_view("--out=").size());
+        } else {
+            spdlog::error("Unknown argument {}", value);
+            return EXIT_FAILURE;
+        }
+    }
+
+    veng::Graphics graphics(glm::ivec2(1280, 720), "assets.vpak");
+    graphics.SetDynamicResolution(false);
+    spdlog::info("Benchmarking on {}", graphics.GetDeviceName());
+
+    veng::bench::BenchmarkRunner runner(filter, iterations);
+
+    using SuiteFunction = void (*)(veng::Graphics&, veng::bench::BenchmarkRunner&);
+    const std::array<std::pair<std::string_view, SuiteFunction>, 18> suites = {{
+        {"draw_calls", veng::bench::RunDrawCallBenchmarks},
+        {"upload", veng::bench::RunUploadBenchmarks},
+        {"descriptors", veng::bench::RunDescriptorBenchmarks},
+        {"pipelines", veng::bench::RunPipelineBenchmarks},
+        {"frame_latency", veng::bench::RunFrameLatencyBenchmarks},
+        {"compute", veng::bench::RunComputeBenchmarks},
+        {"streaming", veng::bench::RunStreamingBenchmarks},
+        {"particles", veng::bench::RunParticleBenchmarks},
+        {"occlusion", veng::bench::RunOcclusionBenchmarks},
+        {"transforms", veng::bench::RunTransformBenchmarks},
+        {"culling", veng::bench::RunCullingBenchmarks},
+        {"bvh", veng::bench::RunBvhBenchmarks},
+        {"assets", veng::bench::RunAssetBenchmarks},
+        {"async_io", veng::bench::RunAsyncIoBenchmarks},
+        {"compression", veng::bench::RunCompressionBenchmarks},
+        {"bc_encode", veng::bench::RunBcEncodeBenchmarks},
+        {"texture_decode", veng::bench::RunTextureDecodeBenchmarks},
+        {"resource_cache", veng::bench::RunResourceCacheBenchmarks},
+    }};
+
+    for (auto [name, run] : suites) {
+        if (runner.ShouldRun(name)) {
+            spdlog::info("Running {}", name);
+            run(graphics, runner);
+        }
+    }
+
+    runner.PrintSummary();
+
+    std::ofstream file(output);
+    if (!file.is_open()) {
+        spdlog::error("Cannot write {}", output.string());
+        return EXIT_FAILURE;
+    }
+    runner.WriteJson(file, graphics.GetDeviceName());
+    spdlog::info("Results written to {}", output.string());
+
+    return EXIT_SUCCESS;
+}
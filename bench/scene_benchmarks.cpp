@@ -0,0 +1,237 @@
+#include <precomp.h>
+#include <suites.h>
+#include <bc_encoder.h>
+#include <bvh.h>
+#include <frustum_culling.h>
+#include <job_system.h>
+#include <transform_hierarchy.h>
+#include <algorithm>
+#include <array>
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+#include <spdlog/spdlog.h>
+
+namespace veng::bench {
+
+    namespace {
+
+        constexpr std::uint32_t kWarmupIterations = 3;
+    }
+
+    // CPU only, the device isn't touched
+    void RunTransformBenchmarks(Graphics&, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kRootCount = 1024;
+        constexpr std::uint32_t kFanout = 31;
+
+        // 1024 trees of 1 + 31 + 961 nodes, a bit over a million in total
+        TransformHierarchy hierarchy;
+        hierarchy.Reserve(kRootCount * (1 + kFanout + kFanout * kFanout));
+        std::vector<TransformHandle> roots;
+        for (std::uint32_t root_index = 0; root_index < kRootCount; root_index++) {
+            TransformHandle root = hierarchy.Create();
+            hierarchy.SetTranslation(root, glm::vec3(root_index % 32, 0.0f, root_index / 32) * 10.0f);
+            roots.push_back(root);
+            for (std::uint32_t i = 0; i < kFanout; i++) {
+                TransformHandle child = hierarchy.Create(root);
+                hierarchy.SetTranslation(child, glm::vec3(i, 1.0f, 0.0f));
+                hierarchy.SetRotation(child, glm::angleAxis(0.1f * i, glm::vec3(0.0f, 1.0f, 0.0f)));
+                for (std::uint32_t j = 0; j < kFanout; j++) {
+                    TransformHandle leaf = hierarchy.Create(child);
+                    hierarchy.SetTranslation(leaf, glm::vec3(0.0f, 0.0f, j));
+                    hierarchy.SetScale(leaf, glm::vec3(0.5f));
+                }
+            }
+        }
+        // Sorts the nodes by depth, which is a one off
+        hierarchy.Update();
+
+        JobSystem job_system;
+        spdlog::info("Updating {} transforms on {} workers", hierarchy.GetCount(), job_system.GetWorkerCount());
+
+        auto measure = [&](std::string_view name, std::uint32_t moved_root_stride, JobSystem* jobs) {
+            BenchmarkResult result{"transforms", std::string(name), "ms"};
+            for (std::uint32_t i = 0; i < kWarmupIterations + runner.GetIterations(); i++) {
+                // Moving a root dirties its whole tree
+                glm::quat rotation = glm::angleAxis(0.01f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+                for (std::uint32_t root = 0; root < roots.size(); root += moved_root_stride) {
+                    hierarchy.SetRotation(roots[root], rotation);
+                }
+
+                double milliseconds = MeasureMilliseconds([&]() { hierarchy.Update(jobs); });
+                if (i >= kWarmupIterations) {
+                    result.samples.push_back(milliseconds);
+                }
+            }
+            runner.AddResult(std::move(result));
+        };
+
+        measure("1m_nodes_all_moved_single_thread", 1, nullptr);
+        measure("1m_nodes_all_moved_parallel", 1, &job_system);
+        measure("1m_nodes_10pct_moved_parallel", 10, &job_system);
+    }
+
+    void RunCullingBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kObjectCount = 1024 * 1024;
+
+        // Half boxes, half spheres, scattered through a cube around the camera
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.5f, 5.0f);
+        FrustumCuller culler;
+        culler.Reserve(kObjectCount);
+        for (std::uint32_t i = 0; i < kObjectCount; i++) {
+            glm::vec3 center(position(random), position(random), position(random));
+            if (i % 2 == 0) {
+                glm::vec3 extent(size(random), size(random), size(random));
+                culler.AddBox(center - extent, center + extent);
+            } else {
+                culler.AddSphere(center, size(random));
+            }
+        }
+
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+        graphics.SetViewProjection(view, projection);
+        Frustum frustum = graphics.GetFrustum();
+
+        JobSystem job_system;
+        std::vector<std::uint32_t> visible;
+        auto measure = [&](std::string_view name, JobSystem* jobs) {
+            BenchmarkResult result{"culling", std::string(name), "ms"};
+            for (std::uint32_t i = 0; i < kWarmupIterations + runner.GetIterations(); i++) {
+                double milliseconds = MeasureMilliseconds([&]() { culler.Cull(frustum, visible, jobs); });
+                if (i >= kWarmupIterations) {
+                    result.samples.push_back(milliseconds);
+                }
+            }
+            runner.AddResult(std::move(result));
+        };
+
+        measure("1m_objects_single_thread", nullptr);
+        measure("1m_objects_parallel", &job_system);
+        spdlog::info("{} of {} objects visible", visible.size(), kObjectCount);
+    }
+
+    void RunBvhBenchmarks(Graphics& graphics, BenchmarkRunner& runner) {
+        constexpr std::uint32_t kObjectCount = 1024 * 1024;
+        constexpr std::uint32_t kRayCount = 1000;
+
+        std::mt19937 random(1234);
+        std::uniform_real_distribution<float> position(-500.0f, 500.0f);
+        std::uniform_real_distribution<float> size(0.5f, 5.0f);
+        std::vector<Aabb> bounds;
+        bounds.reserve(kObjectCount);
+        for (std::uint32_t i = 0; i < kObjectCount; i++) {
+            glm::vec3 center(position(random), position(random), position(random));
+            glm::vec3 extent(size(random), size(random), size(random));
+            bounds.push_back({center - extent, center + extent});
+        }
+
+        glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 400.0f);
+        graphics.SetViewProjection(view, projection);
+        Frustum frustum = graphics.GetFrustum();
+
+        std::vector<Ray> rays;
+        std::uniform_real_distribution<float> pixel(0.0f, 1.0f);
+        for (std::uint32_t i = 0; i < kRayCount; i++) {
+            glm::vec2 point(pixel(random) * 1280.0f, pixel(random) * 720.0f);
+            rays.push_back(MakePickRay(point, glm::vec2(1280.0f, 720.0f), projection * view));
+        }
+
+        Bvh bvh;
+        std::vector<Aabb> moved = bounds;
+        std::vector<std::uint32_t> visible;
+        BenchmarkResult build_result{"bvh", "1m_objects_build", "ms"};
+        BenchmarkResult refit_result{"bvh", "1m_objects_refit", "ms"};
+        BenchmarkResult frustum_result{"bvh", "1m_objects_frustum_query", "ms"};
+        BenchmarkResult pick_result{"bvh", fmt::format("1m_objects_{}_picks", kRayCount), "ms"};
+
+        // Builds are slow enough that a tenth of the iterations still gives a stable median
+        std::uint32_t iterations = runner.GetSlowIterations();
+        for (std::uint32_t i = 0; i < kWarmupIterations + iterations; i++) {
+            double build_milliseconds = MeasureMilliseconds([&]() { bvh.Build(bounds); });
+
+            // Everything drifts a little, as with a frame of animation
+            for (Aabb& box : moved) {
+                box.min.x += 0.1f;
+                box.max.x += 0.1f;
+            }
+            double refit_milliseconds = MeasureMilliseconds([&]() { bvh.Refit(moved); });
+            bvh.Build(bounds);
+
+            double frustum_milliseconds = MeasureMilliseconds([&]() {
+                visible.clear();
+                bvh.QueryFrustum(frustum, visible);
+            });
+            double pick_milliseconds = MeasureMilliseconds([&]() {
+                for (const Ray& ray : rays) {
+                    bvh.Pick(ray);
+                }
+            });
+
+            if (i >= kWarmupIterations) {
+                build_result.samples.push_back(build_milliseconds);
+                refit_result.samples.push_back(refit_milliseconds);
+                frustum_result.samples.push_back(frustum_milliseconds);
+                pick_result.samples.push_back(pick_milliseconds);
+            }
+        }
+
+        runner.AddResult(std::move(build_result));
+        runner.AddResult(std::move(refit_result));
+        runner.AddResult(std::move(frustum_result));
+        runner.AddResult(std::move(pick_result));
+        spdlog::info("{} nodes, {} objects visible", bvh.GetNodeCount(), visible.size());
+    }
+
+    // CPU only, the device isn't touched. Megapixels per second, higher is better.
+    void RunBcEncodeBenchmarks(Graphics&, BenchmarkRunner& runner) {
+        const glm::ivec2 kSize(512, 512);
+
+        // Smooth gradients with noise on top, so neither the endpoint fit nor the index search has it easy
+        std::mt19937 random(7);
+        std::uniform_int_distribution<std::int32_t> noise(-12, 12);
+        std::vector<std::uint8_t> rgba(std::size_t(kSize.x) * kSize.y * 4);
+        for (std::int32_t y = 0; y < kSize.y; y++) {
+            for (std::int32_t x = 0; x < kSize.x; x++) {
+                std::uint8_t* texel = rgba.data() + (std::size_t(y) * kSize.x + x) * 4;
+                texel[0] = std::clamp(x / 2 + noise(random), 0, 255);
+                texel[1] = std::clamp(y / 2 + noise(random), 0, 255);
+                texel[2] = std::clamp((x ^ y) / 2 + noise(random), 0, 255);
+                texel[3] = std::clamp(192 + noise(random) * 4, 0, 255);
+            }
+        }
+
+        JobSystem job_system;
+        spdlog::info("Encoding {}x{} on {} workers", kSize.x, kSize.y, job_system.GetWorkerCount());
+
+        constexpr std::array<std::pair<std::string_view, BcFormat>, 4> kFormats = {{
+            {"bc1", BcFormat::kBc1},
+            {"bc4", BcFormat::kBc4},
+            {"bc5", BcFormat::kBc5},
+            {"bc7", BcFormat::kBc7},
+        }};
+        // Encodes take up to a few hundred milliseconds each
+        std::uint32_t iterations = runner.GetSlowIterations();
+        double megapixels = kSize.x * kSize.y / 1e6;
+        for (const std::pair<std::string_view, BcFormat>& format : kFormats) {
+            for (EncodeQuality quality : {EncodeQuality::kFast, EncodeQuality::kQuality}) {
+                for (JobSystem* jobs : {static_cast<JobSystem*>(nullptr), &job_system}) {
+                    std::string name = fmt::format("{}_{}_{}", format.first,
+                                                   quality == EncodeQuality::kFast ? "fast" : "quality",
+                                                   jobs == nullptr ? "single_thread" : "parallel");
+                    BenchmarkResult result{"bc_encode", name, "MP/s"};
+                    for (std::uint32_t i = 0; i < kWarmupIterations + iterations; i++) {
+                        double milliseconds =
+                            MeasureMilliseconds([&]() { EncodeBc(rgba, kSize, format.second, quality, jobs); });
+                        if (i >= kWarmupIterations) {
+                            result.samples.push_back(megapixels / (milliseconds / 1000.0));
+                        }
+                    }
+                    runner.AddResult(std::move(result));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <benchmark.h>
+#include <graphics.h>
+
+namespace veng::bench {
+
+    void RunDrawCallBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunUploadBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunDescriptorBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunPipelineBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunFrameLatencyBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunComputeBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunStreamingBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunParticleBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunOcclusionBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunTransformBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunCullingBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunBvhBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunAssetBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunAsyncIoBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunCompressionBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunBcEncodeBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunTextureDecodeBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+    void RunResourceCacheBenchmarks(Graphics& graphics, BenchmarkRunner& runner);
+}
@@ -0,0 +1,20 @@
+# Packs ASSET_FILES into ARCHIVE with the PACKER executable target (VulkanEnginePack or VulkanEngineBake)
+# whenever one of them changes. Anything after OPTIONS is passed to the packer before the files.
+function(add_asset_archive TARGET_NAME PACKER ARCHIVE)
+	cmake_parse_arguments(PARSE_ARGV 3 ARCHIVE "" "" "OPTIONS")
+	set(ASSET_FILES ${ARCHIVE_UNPARSED_ARGUMENTS})
+	list(LENGTH ASSET_FILES FILE_COUNT)
+	if(FILE_COUNT EQUAL 0)
+		message(FATAL_ERROR "Cannot add asset archive target without asset files!")
+	endif()
+
+	add_custom_command(
+		OUTPUT "${ARCHIVE}"
+		COMMAND ${PACKER} ${ARCHIVE_OPTIONS} "${ARCHIVE}" ${ASSET_FILES}
+		DEPENDS ${PACKER} ${ASSET_FILES}
+		COMMENT "Packing assets..."
+	)
+
+	add_custom_target(${TARGET_NAME} ALL DEPENDS "${ARCHIVE}")
+
+endfunction()
@@ -15,6 +15,8 @@ function(add_shaders TARGET_NAME)
 		# COMMANDS
 		list(APPEND SHADER_COMMANDS COMMAND)
 		list(APPEND SHADER_COMMANDS Vulkan::glslc)
+		# SPIR-V 1.3 for subgroup operations
+		list(APPEND SHADER_COMMANDS --target-env=vulkan1.1)
 		list(APPEND SHADER_COMMANDS "${SHADER_SOURCE}")
 		list(APPEND SHADER_COMMANDS -o)
 		list(APPEND SHADER_COMMANDS "${CMAKE_CURRENT_BINARY_DIR}/${SHADER_NAME}.spv")
@@ -0,0 +1,32 @@
+#version 450
+#include "common.glsl"
+#include "particles.glsl"
+
+layout(set = 2, binding = 0) readonly buffer Particles {
+	Particle particles[];
+};
+
+layout(push_constant) uniform Model {
+	mat4 transformation;
+} model;
+
+layout(location = 0) out vec2 vertex_uv;
+layout(location = 1) out vec4 vertex_color;
+
+const vec2 kCorners[6] = vec2[](
+	vec2(-0.5, -0.5), vec2(0.5, -0.5), vec2(0.5, 0.5),
+	vec2(-0.5, -0.5), vec2(0.5, 0.5), vec2(-0.5, 0.5)
+);
+
+void main() {
+	Particle particle = particles[gl_InstanceIndex];
+	vec2 corner = kCorners[gl_VertexIndex];
+
+	// Expanded in view space so the quad always faces the camera
+	vec4 view_position = camera.view * model.transformation * vec4(particle.position_size.xyz, 1.0);
+	view_position.xy += corner * particle.position_size.w;
+
+	gl_Position = camera.projection * view_position;
+	vertex_uv = vec2(corner.x + 0.5, 0.5 - corner.y);
+	vertex_color = particle.color;
+}
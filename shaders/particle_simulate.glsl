@@ -0,0 +1,57 @@
+#include "particles.glsl"
+
+layout(local_size_x = 256) in;
+
+layout(set = 0, binding = 0) buffer State {
+	ParticleCounters counters;
+};
+
+layout(set = 0, binding = 1) readonly buffer Source {
+	Particle source[];
+};
+
+layout(set = 0, binding = 2) writeonly buffer Destination {
+	Particle destination[];
+};
+
+layout(push_constant) uniform Simulate {
+	vec4 gravity_delta;     // xyz gravity, w seconds since the last frame
+	uint source_index;
+} simulate;
+
+// Every invocation has to get here, survivors get consecutive slots in the destination
+uint AllocateSlot(bool keep, uint destination_index) {
+#ifdef PARTICLE_SUBGROUP_COMPACTION
+	// Prefix sum over the subgroup, then one atomic for the whole subgroup
+	uint local_offset = subgroupExclusiveAdd(keep ? 1u : 0u);
+	uint subgroup_count = subgroupAdd(keep ? 1u : 0u);
+	uint base = 0u;
+	if (subgroupElect() && subgroup_count > 0u) {
+		base = atomicAdd(counters.count[destination_index], subgroup_count);
+	}
+	return subgroupMax(base) + local_offset;
+#else
+	return keep ? atomicAdd(counters.count[destination_index], 1u) : 0u;
+#endif
+}
+
+void main() {
+	uint index = gl_GlobalInvocationID.x;
+	uint destination_index = 1u - simulate.source_index;
+
+	Particle particle;
+	bool keep = false;
+	if (index < counters.count[simulate.source_index]) {
+		particle = source[index];
+		float delta = simulate.gravity_delta.w;
+		particle.velocity_life.xyz += simulate.gravity_delta.xyz * delta;
+		particle.position_size.xyz += particle.velocity_life.xyz * delta;
+		particle.velocity_life.w -= delta;
+		keep = particle.velocity_life.w > 0.0;
+	}
+
+	uint slot = AllocateSlot(keep, destination_index);
+	if (keep) {
+		destination[slot] = particle;
+	}
+}
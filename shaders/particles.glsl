@@ -0,0 +1,13 @@
+// Shared by the particle compute shaders and particle.vert, matches veng::Particle
+struct Particle {
+	vec4 position_size;     // xyz position, w quad size
+	vec4 velocity_life;     // xyz velocity, w seconds left
+	vec4 color;
+};
+
+// Alive counts of both particle buffers followed by the indirect arguments for the next frame
+struct ParticleCounters {
+	uint count[2];
+	uint dispatch[3];
+	uint draw[4];
+};
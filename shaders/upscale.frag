@@ -0,0 +1,38 @@
+#version 450
+
+layout(location = 0) in vec2 screen_uv;
+
+layout(location = 0) out vec4 out_color;
+
+layout(set = 0, binding = 0) uniform sampler2D scene_color;
+
+layout(push_constant) uniform Upscale {
+	vec2 uv_scale;		// part of the render target that was actually rendered
+	vec2 texel_size;	// 1 / render target size
+	float sharpness;
+} upscale;
+
+vec3 SampleScene(vec2 uv) {
+	// Keep bilinear taps inside the rendered region
+	vec2 max_uv = upscale.uv_scale - 0.5 * upscale.texel_size;
+	return texture(scene_color, clamp(uv, 0.5 * upscale.texel_size, max_uv)).rgb;
+}
+
+void main() {
+	vec2 uv = screen_uv * upscale.uv_scale;
+
+	vec3 center = SampleScene(uv);
+	vec3 north = SampleScene(uv - vec2(0.0, upscale.texel_size.y));
+	vec3 south = SampleScene(uv + vec2(0.0, upscale.texel_size.y));
+	vec3 west = SampleScene(uv - vec2(upscale.texel_size.x, 0.0));
+	vec3 east = SampleScene(uv + vec2(upscale.texel_size.x, 0.0));
+
+	// Contrast adaptive sharpening: back off where local contrast is already high
+	vec3 min_color = min(center, min(min(north, south), min(west, east)));
+	vec3 max_color = max(center, max(max(north, south), max(west, east)));
+	vec3 amplitude = clamp(min(min_color, 1.0 - max_color) / max(max_color, vec3(1.0e-4)), 0.0, 1.0);
+	vec3 weight = -sqrt(amplitude) * 0.2 * upscale.sharpness;
+
+	vec3 color = (center + (north + south + west + east) * weight) / (1.0 + 4.0 * weight);
+	out_color = vec4(clamp(color, 0.0, 1.0), 1.0);
+}
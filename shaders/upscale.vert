@@ -0,0 +1,9 @@
+#version 450
+
+layout(location = 0) out vec2 screen_uv;
+
+void main() {
+	// One triangle that covers the whole screen
+	screen_uv = vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2);
+	gl_Position = vec4(screen_uv * 2.0 - 1.0, 0.0, 1.0);
+}
@@ -0,0 +1,242 @@
+#include <precomp.h>
+#include <asset_archive.h>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <fstream>
+#include <numeric>
+#include <spdlog/spdlog.h>
+#include <stb_image.h>
+
+namespace veng {
+
+    std::uint64_t HashAssetName(std::string_view name) {
+        std::uint64_t hash = 14695981039346656037ull;
+        for (char character : name) {
+            hash ^= static_cast<std::uint8_t>(character);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::uint64_t HashContent(gsl::span<const std::uint8_t> data, std::uint64_t seed) {
+        std::uint64_t hash = 14695981039346656037ull ^ seed;
+        std::size_t word_count = data.size() / sizeof(std::uint64_t);
+        for (std::size_t i = 0; i < word_count; i++) {
+            std::uint64_t word;
+            std::memcpy(&word, data.data() + i * sizeof(word), sizeof(word));
+            hash = (hash ^ word) * 1099511628211ull;
+        }
+        for (std::size_t i = word_count * sizeof(std::uint64_t); i < data.size(); i++) {
+            hash = (hash ^ data[i]) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    gsl::span<const Vertex> GetMeshVertices(const AssetView& mesh) {
+        std::uint64_t index_bytes = std::uint64_t(mesh.index_count) * sizeof(std::uint32_t);
+        if (mesh.type != AssetType::kMesh || index_bytes > mesh.data.size()) {
+            return {};
+        }
+        // Blobs start on a page boundary, so the vertices are aligned in place
+        return {reinterpret_cast<const Vertex*>(mesh.data.data()), (mesh.data.size() - index_bytes) / sizeof(Vertex)};
+    }
+
+    gsl::span<const std::uint32_t> GetMeshIndices(const AssetView& mesh) {
+        std::uint64_t index_bytes = std::uint64_t(mesh.index_count) * sizeof(std::uint32_t);
+        if (mesh.type != AssetType::kMesh || index_bytes > mesh.data.size()) {
+            return {};
+        }
+        return {reinterpret_cast<const std::uint32_t*>(mesh.data.data() + mesh.data.size() - index_bytes),
+                mesh.index_count};
+    }
+
+    AssetArchive::AssetArchive(const std::filesystem::path& path) : file_(path, FileAccess::kRandom) {
+        if (!file_.IsOpen()) {
+            return;
+        }
+
+        gsl::span<const std::uint8_t> data = file_.GetData();
+        if (data.size() < sizeof(ArchiveHeader)) {
+            spdlog::error("{} is not an asset archive", path.string());
+            return;
+        }
+
+        ArchiveHeader header;
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != kArchiveMagic || header.version != kArchiveVersion || header.bucket_bits > 24) {
+            spdlog::error("{} is not a version {} asset archive", path.string(), kArchiveVersion);
+            return;
+        }
+
+        // Everything the lookups touch has to be inside the file, blobs are checked as they're found
+        std::uint64_t buckets_offset = header.toc_offset + std::uint64_t(header.entry_count) * sizeof(ArchiveEntry);
+        std::uint64_t bucket_count = (1ull << header.bucket_bits) + 1;
+        if (header.toc_offset % alignof(ArchiveEntry) != 0 ||
+            buckets_offset + bucket_count * sizeof(std::uint32_t) > header.names_offset ||
+            header.names_offset > data.size()) {
+            spdlog::error("{} has a truncated table of contents", path.string());
+            return;
+        }
+
+        // The mapping is page aligned and so is every offset the writer produces
+        entries_ = reinterpret_cast<const ArchiveEntry*>(data.data() + header.toc_offset);
+        bucket_starts_ = reinterpret_cast<const std::uint32_t*>(data.data() + buckets_offset);
+        names_ = reinterpret_cast<const char*>(data.data() + header.names_offset);
+        entry_count_ = header.entry_count;
+        bucket_bits_ = header.bucket_bits;
+    }
+
+    std::optional<AssetView> AssetArchive::Find(std::string_view name) const {
+        if (!IsOpen() || entry_count_ == 0) {
+            return std::nullopt;
+        }
+
+        std::uint64_t hash = HashAssetName(name);
+        std::uint64_t bucket = bucket_bits_ == 0 ? 0 : hash >> (64 - bucket_bits_);
+        gsl::span<const std::uint8_t> data = file_.GetData();
+        std::uint64_t names_size = data.size() - (reinterpret_cast<const std::uint8_t*>(names_) - data.data());
+
+        for (std::uint32_t i = bucket_starts_[bucket]; i < bucket_starts_[bucket + 1] && i < entry_count_; i++) {
+            const ArchiveEntry& entry = entries_[i];
+            if (entry.name_hash != hash || entry.name_length != name.size() ||
+                std::uint64_t(entry.name_offset) + entry.name_length > names_size ||
+                std::string_view(names_ + entry.name_offset, entry.name_length) != name) {
+                continue;
+            }
+            if (entry.offset > data.size() || entry.size > data.size() - entry.offset) {
+                spdlog::error("Asset {} points outside its archive", name);
+                return std::nullopt;
+            }
+
+            return AssetView{entry.type, data.subspan(entry.offset, entry.size), entry.width, entry.height,
+                             entry.format, entry.mip_count, entry.index_count};
+        }
+        return std::nullopt;
+    }
+
+    bool AssetArchiveWriter::AddFile(const std::filesystem::path& path, std::string name) {
+        MappedFile file(path);
+        if (!file.IsOpen()) {
+            spdlog::error("Cannot read {}", path.string());
+            return false;
+        }
+        gsl::span<const std::uint8_t> data = file.GetData();
+
+        if (path.extension() == ".spv") {
+            AddAsset(std::move(name), AssetView{AssetType::kShader, data});
+            return true;
+        }
+
+        glm::ivec2 extents;
+        std::int32_t channels;
+        if (!stbi_info_from_memory(data.data(), data.size(), &extents.x, &extents.y, &channels)) {
+            AddAsset(std::move(name), AssetView{AssetType::kRaw, data});
+            return true;
+        }
+
+        stbi_uc* pixels =
+            stbi_load_from_memory(data.data(), data.size(), &extents.x, &extents.y, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr) {
+            spdlog::error("Cannot decode {}", path.string());
+            return false;
+        }
+        AssetView texture;
+        texture.type = AssetType::kTexture;
+        texture.data = gsl::span<const std::uint8_t>(pixels, std::size_t(extents.x) * extents.y * 4);
+        texture.width = extents.x;
+        texture.height = extents.y;
+        texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+        AddAsset(std::move(name), texture);
+        stbi_image_free(pixels);
+        return true;
+    }
+
+    void AssetArchiveWriter::AddAsset(std::string name, const AssetView& asset_view) {
+        PendingAsset asset;
+        asset.entry.name_hash = HashAssetName(name);
+        asset.entry.size = asset_view.data.size();
+        asset.entry.name_length = name.size();
+        asset.entry.type = asset_view.type;
+        asset.entry.width = asset_view.width;
+        asset.entry.height = asset_view.height;
+        asset.entry.format = asset_view.format;
+        asset.entry.mip_count = asset_view.mip_count;
+        asset.entry.index_count = asset_view.index_count;
+        asset.name = std::move(name);
+        asset.data.assign(asset_view.data.begin(), asset_view.data.end());
+        assets_.push_back(std::move(asset));
+    }
+
+    bool AssetArchiveWriter::Write(const std::filesystem::path& path) const {
+        auto align = [](std::uint64_t offset) {
+            return (offset + kArchiveAlignment - 1) / kArchiveAlignment * kArchiveAlignment;
+        };
+
+        std::vector<ArchiveEntry> entries;
+        std::string names;
+        std::uint64_t offset = align(sizeof(ArchiveHeader));
+        for (const PendingAsset& asset : assets_) {
+            ArchiveEntry entry = asset.entry;
+            entry.offset = offset;
+            entry.name_offset = names.size();
+            names += asset.name;
+            entries.push_back(entry);
+            offset = align(offset + asset.data.size());
+        }
+
+        std::vector<std::uint32_t> order(entries.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](std::uint32_t left, std::uint32_t right) {
+            return entries[left].name_hash < entries[right].name_hash;
+        });
+        std::vector<ArchiveEntry> sorted_entries;
+        for (std::uint32_t index : order) {
+            sorted_entries.push_back(entries[index]);
+        }
+
+        // About one entry per bucket
+        ArchiveHeader header;
+        header.entry_count = entries.size();
+        header.bucket_bits = entries.size() <= 1 ? 0 : std::bit_width(entries.size() - 1);
+        header.toc_offset = offset;
+        std::vector<std::uint32_t> bucket_starts((1ull << header.bucket_bits) + 1, header.entry_count);
+        for (std::uint32_t i = sorted_entries.size(); i-- > 0;) {
+            std::uint64_t hash = sorted_entries[i].name_hash;
+            std::uint64_t bucket = header.bucket_bits == 0 ? 0 : hash >> (64 - header.bucket_bits);
+            bucket_starts[bucket] = i;
+        }
+        // Empty buckets start where the next one does
+        for (std::uint32_t bucket = bucket_starts.size() - 1; bucket-- > 0;) {
+            bucket_starts[bucket] = std::min(bucket_starts[bucket], bucket_starts[bucket + 1]);
+        }
+        header.names_offset = header.toc_offset + sorted_entries.size() * sizeof(ArchiveEntry) +
+                              bucket_starts.size() * sizeof(std::uint32_t);
+
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            spdlog::error("Cannot write {}", path.string());
+            return false;
+        }
+
+        auto write = [&](const void* data, std::uint64_t size) {
+            file.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+        };
+        auto pad_to = [&](std::uint64_t target) {
+            static constexpr std::array<char, kArchiveAlignment> kZeros = {};
+            std::uint64_t position = file.tellp();
+            write(kZeros.data(), target - position);
+        };
+
+        write(&header, sizeof(header));
+        for (std::uint32_t i = 0; i < assets_.size(); i++) {
+            pad_to(entries[i].offset);
+            write(assets_[i].data.data(), assets_[i].data.size());
+        }
+        pad_to(header.toc_offset);
+        write(sorted_entries.data(), sorted_entries.size() * sizeof(ArchiveEntry));
+        write(bucket_starts.data(), bucket_starts.size() * sizeof(std::uint32_t));
+        write(names.data(), names.size());
+        return file.good();
+    }
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+#include <array>
+#include <filesystem>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <mapped_file.h>
+#include <texture_file.h>
+#include <vertex.h>
+
+namespace veng {
+
+    // .vpak layout, little endian:
+    //   ArchiveHeader
+    //   blobs, each starting on a kArchiveAlignment boundary
+    //   ArchiveEntry[entry_count], sorted by name_hash
+    //   uint32 bucket_starts[(1 << bucket_bits) + 1], first entry whose hash has the bucket's top bits
+    //   names, not null terminated
+    constexpr std::array<char, 4> kArchiveMagic = {'V', 'P', 'A', 'K'};
+    constexpr std::uint32_t kArchiveVersion = 2;
+    // Page sized, so a blob can be mapped, read or DMA'd on its own
+    constexpr std::uint64_t kArchiveAlignment = 4096;
+
+    enum class AssetType : std::uint32_t {
+        kRaw,
+        // Tightly packed pixels in format, ready for a staging buffer, mip levels follow each other
+        kTexture,
+        kShader,
+        // Vertex[] followed by index_count uint32 indices
+        kMesh,
+    };
+
+    struct ArchiveHeader {
+        std::array<char, 4> magic = kArchiveMagic;
+        std::uint32_t version = kArchiveVersion;
+        std::uint32_t entry_count = 0;
+        std::uint32_t bucket_bits = 0;
+        std::uint64_t toc_offset = 0;
+        std::uint64_t names_offset = 0;
+    };
+
+    struct ArchiveEntry {
+        std::uint64_t name_hash = 0;
+        std::uint64_t offset = 0;
+        std::uint64_t size = 0;
+        std::uint32_t name_offset = 0;
+        std::uint32_t name_length = 0;
+        AssetType type = AssetType::kRaw;
+        // Textures only
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::uint32_t mip_count = 1;
+        // Meshes only
+        std::uint32_t index_count = 0;
+    };
+
+    static_assert(sizeof(ArchiveHeader) == 32);
+    static_assert(sizeof(ArchiveEntry) == 56);
+
+    // FNV-1a, the archive is only valid for the hash it was written with
+    std::uint64_t HashAssetName(std::string_view name);
+    // FNV-1a over whole words, for cache keys rather than anything that has to resist collisions on purpose
+    std::uint64_t HashContent(gsl::span<const std::uint8_t> data, std::uint64_t seed = 0);
+
+    struct AssetView {
+        AssetType type = AssetType::kRaw;
+        // Points into the mapping, valid as long as the archive is open
+        gsl::span<const std::uint8_t> data;
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::uint32_t mip_count = 1;
+        std::uint32_t index_count = 0;
+    };
+
+    gsl::span<const Vertex> GetMeshVertices(const AssetView& mesh);
+    gsl::span<const std::uint32_t> GetMeshIndices(const AssetView& mesh);
+
+    // Maps a .vpak and finds assets by name without parsing anything: the header is checked once and
+    // a lookup is a bucket index plus, on average, one entry comparison
+    class AssetArchive {
+        public:
+        AssetArchive() = default;
+        // Closed when the file is missing or isn't a valid archive
+        explicit AssetArchive(const std::filesystem::path& path);
+
+        bool IsOpen() const { return entries_ != nullptr; }
+        std::optional<AssetView> Find(std::string_view name) const;
+        std::uint32_t GetAssetCount() const { return entry_count_; }
+
+        private:
+        MappedFile file_;
+        const ArchiveEntry* entries_ = nullptr;
+        const std::uint32_t* bucket_starts_ = nullptr;
+        const char* names_ = nullptr;
+        std::uint32_t entry_count_ = 0;
+        std::uint32_t bucket_bits_ = 0;
+    };
+
+    // Builds a .vpak. Images are decoded to RGBA8 on the way in, so the archive holds the upload payload.
+    class AssetArchiveWriter {
+        public:
+        // The type comes from the extension: .spv is a shader, anything stb_image decodes is a texture,
+        // the rest is stored as is. False when the file can't be read or decoded.
+        bool AddFile(const std::filesystem::path& path, std::string name);
+        // Copies the data, the rest of the entry comes from the view
+        void AddAsset(std::string name, const AssetView& asset);
+
+        bool Write(const std::filesystem::path& path) const;
+
+        private:
+        struct PendingAsset {
+            std::string name;
+            ArchiveEntry entry;
+            std::vector<std::uint8_t> data;
+        };
+
+        std::vector<PendingAsset> assets_;
+    };
+}
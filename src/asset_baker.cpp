@@ -0,0 +1,509 @@
+#include <precomp.h>
+#include <asset_baker.h>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <numeric>
+#include <spdlog/spdlog.h>
+#include <stb_image.h>
+#include <unordered_map>
+
+namespace veng {
+
+    namespace {
+
+        // Name of the single asset in every cache file
+        constexpr std::string_view kCachedAssetName = "baked";
+        constexpr std::uint32_t kVertexCacheSize = 32;
+
+        // Normal maps and other data textures must not be gamma decoded by the sampler
+        bool IsLinearTexture(std::string_view name) {
+            return name.find("normal") != std::string_view::npos;
+        }
+
+        float SrgbToLinear(float value) {
+            return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+        }
+
+        float LinearToSrgb(float value) {
+            return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+        }
+
+        // Forsyth's weights: the last triangle's vertices score flat so they aren't rushed, older
+        // entries decay towards eviction, and vertices with few triangles left get a boost to finish them
+        float ScoreVertex(std::int32_t cache_position, std::uint32_t remaining_triangles) {
+            if (remaining_triangles == 0) {
+                return -1.0f;
+            }
+            float score = 0.0f;
+            if (cache_position >= 0 && cache_position < 3) {
+                score = 0.75f;
+            } else if (cache_position >= 3) {
+                float scale = 1.0f / (kVertexCacheSize - 3);
+                score = std::pow(1.0f - (cache_position - 3) * scale, 1.5f);
+            }
+            return score + 2.0f / std::sqrt(static_cast<float>(remaining_triangles));
+        }
+
+        template <typename T>
+        bool ParseNumbers(std::string_view text, gsl::span<T> values) {
+            for (T& value : values) {
+                std::size_t start = text.find_first_not_of(" \t");
+                if (start == std::string_view::npos) {
+                    return false;
+                }
+                text.remove_prefix(start);
+                std::from_chars_result result = std::from_chars(text.data(), text.data() + text.size(), value);
+                if (result.ec != std::errc()) {
+                    return false;
+                }
+                text.remove_prefix(result.ptr - text.data());
+            }
+            return true;
+        }
+
+        // 1 based, negative counts back from the last one parsed
+        std::optional<std::uint32_t> ResolveObjIndex(std::int64_t index, std::size_t count) {
+            std::int64_t resolved = index < 0 ? std::int64_t(count) + index : index - 1;
+            if (index == 0 || resolved < 0 || resolved >= std::int64_t(count)) {
+                return std::nullopt;
+            }
+            return static_cast<std::uint32_t>(resolved);
+        }
+    }
+
+    std::uint32_t GetMipCount(glm::ivec2 size) {
+        std::uint32_t mip_count = 1;
+        for (std::int32_t largest = std::max(size.x, size.y); largest > 1; largest /= 2) {
+            mip_count++;
+        }
+        return mip_count;
+    }
+
+    std::vector<std::uint8_t> GenerateMipChain(gsl::span<const std::uint8_t> rgba, glm::ivec2 size, bool srgb) {
+        std::array<float, 256> to_linear;
+        for (std::uint32_t i = 0; i < to_linear.size(); i++) {
+            to_linear[i] = srgb ? SrgbToLinear(i / 255.0f) : i / 255.0f;
+        }
+
+        std::vector<std::uint8_t> chain(rgba.begin(), rgba.end());
+        std::size_t source_offset = 0;
+        glm::ivec2 source_size = size;
+        for (std::uint32_t level = 1; level < GetMipCount(size); level++) {
+            glm::ivec2 level_size(std::max(source_size.x / 2, 1), std::max(source_size.y / 2, 1));
+            std::size_t level_offset = chain.size();
+            chain.resize(level_offset + std::size_t(level_size.x) * level_size.y * 4);
+
+            const std::uint8_t* source = chain.data() + source_offset;
+            std::uint8_t* target = chain.data() + level_offset;
+            for (std::int32_t y = 0; y < level_size.y; y++) {
+                std::int32_t y0 = std::min(y * 2, source_size.y - 1);
+                std::int32_t y1 = std::min(y * 2 + 1, source_size.y - 1);
+                for (std::int32_t x = 0; x < level_size.x; x++) {
+                    std::int32_t x0 = std::min(x * 2, source_size.x - 1);
+                    std::int32_t x1 = std::min(x * 2 + 1, source_size.x - 1);
+                    std::array<const std::uint8_t*, 4> texels = {
+                        source + (std::size_t(y0) * source_size.x + x0) * 4,
+                        source + (std::size_t(y0) * source_size.x + x1) * 4,
+                        source + (std::size_t(y1) * source_size.x + x0) * 4,
+                        source + (std::size_t(y1) * source_size.x + x1) * 4,
+                    };
+
+                    std::uint8_t* output = target + (std::size_t(y) * level_size.x + x) * 4;
+                    for (std::uint32_t channel = 0; channel < 4; channel++) {
+                        // Alpha is coverage, never gamma encoded
+                        bool linear = channel == 3 || !srgb;
+                        float sum = 0.0f;
+                        for (const std::uint8_t* texel : texels) {
+                            sum += linear ? texel[channel] / 255.0f : to_linear[texel[channel]];
+                        }
+                        float average = sum * 0.25f;
+                        float encoded = linear ? average : LinearToSrgb(average);
+                        output[channel] = static_cast<std::uint8_t>(std::clamp(encoded, 0.0f, 1.0f) * 255.0f + 0.5f);
+                    }
+                }
+            }
+
+            source_offset = level_offset;
+            source_size = level_size;
+        }
+        return chain;
+    }
+
+    bool ParseObj(std::string_view text, std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices) {
+        std::vector<glm::vec3> positions;
+        std::vector<glm::vec2> uvs;
+        std::unordered_map<std::uint64_t, std::uint32_t> unique_vertices;
+        std::vector<std::uint32_t> face;
+
+        while (!text.empty()) {
+            std::size_t line_end = std::min(text.find('\n'), text.size());
+            std::string_view line = text.substr(0, line_end);
+            text.remove_prefix(std::min(line_end + 1, text.size()));
+            if (!line.empty() && line.back() == '\r') {
+                line.remove_suffix(1);
+            }
+
+            if (line.starts_with("v ")) {
+                glm::vec3 position;
+                if (!ParseNumbers(line.substr(2), gsl::span<float>(&position.x, 3))) {
+                    return false;
+                }
+                positions.push_back(position);
+            } else if (line.starts_with("vt ")) {
+                glm::vec2 uv;
+                if (!ParseNumbers(line.substr(3), gsl::span<float>(&uv.x, 2))) {
+                    return false;
+                }
+                // OBJ puts v = 0 at the bottom of the image
+                uvs.emplace_back(uv.x, 1.0f - uv.y);
+            } else if (line.starts_with("f ")) {
+                face.clear();
+                std::string_view corners = line.substr(2);
+                while (true) {
+                    std::size_t start = corners.find_first_not_of(" \t");
+                    if (start == std::string_view::npos) {
+                        break;
+                    }
+                    corners.remove_prefix(start);
+                    std::string_view corner = corners.substr(0, corners.find_first_of(" \t"));
+                    corners.remove_prefix(corner.size());
+
+                    // v, v/vt, v//vn or v/vt/vn, normals aren't part of Vertex
+                    std::int64_t position_index = 0;
+                    std::int64_t uv_index = 0;
+                    std::string_view position_text = corner.substr(0, corner.find('/'));
+                    if (!ParseNumbers(position_text, gsl::span<std::int64_t>(&position_index, 1))) {
+                        return false;
+                    }
+                    std::optional<std::uint32_t> position = ResolveObjIndex(position_index, positions.size());
+                    std::optional<std::uint32_t> uv;
+                    if (position_text.size() < corner.size()) {
+                        std::string_view uv_text = corner.substr(position_text.size() + 1);
+                        uv_text = uv_text.substr(0, uv_text.find('/'));
+                        if (!uv_text.empty()) {
+                            if (!ParseNumbers(uv_text, gsl::span<std::int64_t>(&uv_index, 1))) {
+                                return false;
+                            }
+                            uv = ResolveObjIndex(uv_index, uvs.size());
+                            if (!uv.has_value()) {
+                                return false;
+                            }
+                        }
+                    }
+                    if (!position.has_value()) {
+                        return false;
+                    }
+
+                    std::uint64_t key = std::uint64_t(position.value()) << 32 | (uv.has_value() ? uv.value() + 1 : 0);
+                    auto [it, inserted] = unique_vertices.try_emplace(key, vertices.size());
+                    if (inserted) {
+                        vertices.emplace_back(positions[position.value()], uv.has_value() ? uvs[uv.value()]
+                                                                                          : glm::vec2(0.0f));
+                    }
+                    face.push_back(it->second);
+                }
+
+                // Polygons as fans
+                for (std::size_t i = 2; i < face.size(); i++) {
+                    indices.insert(indices.end(), {face[0], face[i - 1], face[i]});
+                }
+            }
+        }
+        return true;
+    }
+
+    void OptimizeVertexCache(gsl::span<std::uint32_t> indices, std::uint32_t vertex_count) {
+        std::uint32_t triangle_count = indices.size() / 3;
+        if (triangle_count == 0) {
+            return;
+        }
+
+        // Triangles using each vertex, shrunk as they're emitted
+        std::vector<std::uint32_t> remaining(vertex_count, 0);
+        for (std::uint32_t index : indices) {
+            remaining[index]++;
+        }
+        std::vector<std::uint32_t> adjacency_offsets(vertex_count + 1, 0);
+        std::partial_sum(remaining.begin(), remaining.end(), adjacency_offsets.begin() + 1);
+        std::vector<std::uint32_t> adjacency(indices.size());
+        std::vector<std::uint32_t> cursor(adjacency_offsets.begin(), adjacency_offsets.end() - 1);
+        for (std::uint32_t i = 0; i < triangle_count * 3; i++) {
+            adjacency[cursor[indices[i]]++] = i / 3;
+        }
+
+        std::vector<std::int32_t> cache_position(vertex_count, -1);
+        std::vector<float> vertex_score(vertex_count);
+        for (std::uint32_t vertex = 0; vertex < vertex_count; vertex++) {
+            vertex_score[vertex] = ScoreVertex(-1, remaining[vertex]);
+        }
+        std::vector<float> triangle_score(triangle_count, 0.0f);
+        for (std::uint32_t i = 0; i < triangle_count * 3; i++) {
+            triangle_score[i / 3] += vertex_score[indices[i]];
+        }
+        std::vector<bool> emitted(triangle_count, false);
+
+        std::uint32_t best = std::max_element(triangle_score.begin(), triangle_score.end()) - triangle_score.begin();
+        std::uint32_t scan = 0;
+        std::vector<std::uint32_t> cache;
+        std::vector<std::uint32_t> next_cache;
+        std::vector<std::uint32_t> output;
+        output.reserve(triangle_count * 3);
+
+        while (output.size() < triangle_count * 3) {
+            // Nothing in the cache touches an open triangle, take the next one in input order
+            if (best == UINT32_MAX) {
+                while (emitted[scan]) {
+                    scan++;
+                }
+                best = scan;
+            }
+
+            emitted[best] = true;
+            std::array<std::uint32_t, 3> corners = {indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2]};
+            output.insert(output.end(), corners.begin(), corners.end());
+
+            next_cache.clear();
+            for (std::uint32_t vertex : corners) {
+                std::uint32_t* begin = adjacency.data() + adjacency_offsets[vertex];
+                std::uint32_t* end = begin + remaining[vertex];
+                std::uint32_t* found = std::find(begin, end, best);
+                std::swap(*found, *(end - 1));
+                remaining[vertex]--;
+                if (std::find(next_cache.begin(), next_cache.end(), vertex) == next_cache.end()) {
+                    next_cache.push_back(vertex);
+                }
+            }
+            for (std::uint32_t vertex : cache) {
+                if (std::find(corners.begin(), corners.end(), vertex) == corners.end()) {
+                    next_cache.push_back(vertex);
+                }
+            }
+            cache.swap(next_cache);
+
+            // Rescore everything that moved, including what just fell out of the cache
+            for (std::uint32_t i = 0; i < cache.size(); i++) {
+                std::uint32_t vertex = cache[i];
+                cache_position[vertex] = i < kVertexCacheSize ? i : -1;
+                float score = ScoreVertex(cache_position[vertex], remaining[vertex]);
+                float delta = score - vertex_score[vertex];
+                vertex_score[vertex] = score;
+                for (std::uint32_t j = 0; j < remaining[vertex]; j++) {
+                    triangle_score[adjacency[adjacency_offsets[vertex] + j]] += delta;
+                }
+            }
+            cache.resize(std::min<std::size_t>(cache.size(), kVertexCacheSize));
+
+            best = UINT32_MAX;
+            float best_score = -1.0f;
+            for (std::uint32_t vertex : cache) {
+                for (std::uint32_t j = 0; j < remaining[vertex]; j++) {
+                    std::uint32_t triangle = adjacency[adjacency_offsets[vertex] + j];
+                    if (triangle_score[triangle] > best_score) {
+                        best_score = triangle_score[triangle];
+                        best = triangle;
+                    }
+                }
+            }
+        }
+
+        std::copy(output.begin(), output.end(), indices.begin());
+    }
+
+    void OptimizeVertexFetch(std::vector<Vertex>& vertices, gsl::span<std::uint32_t> indices) {
+        std::vector<std::uint32_t> remap(vertices.size(), UINT32_MAX);
+        std::vector<Vertex> ordered;
+        ordered.reserve(vertices.size());
+        for (std::uint32_t& index : indices) {
+            if (remap[index] == UINT32_MAX) {
+                remap[index] = ordered.size();
+                ordered.push_back(vertices[index]);
+            }
+            index = remap[index];
+        }
+        vertices.swap(ordered);
+    }
+
+    float GetAverageCacheMissRatio(gsl::span<const std::uint32_t> indices, std::uint32_t cache_size) {
+        if (indices.size() < 3) {
+            return 0.0f;
+        }
+        std::vector<std::uint32_t> cache;
+        std::uint32_t misses = 0;
+        for (std::uint32_t index : indices) {
+            if (std::find(cache.begin(), cache.end(), index) != cache.end()) {
+                continue;
+            }
+            misses++;
+            cache.insert(cache.begin(), index);
+            if (cache.size() > cache_size) {
+                cache.pop_back();
+            }
+        }
+        return static_cast<float>(misses) / (indices.size() / 3);
+    }
+
+    AssetBaker::AssetBaker(std::filesystem::path cache_directory) : cache_directory_(std::move(cache_directory)) {}
+
+    void AssetBaker::Add(const std::filesystem::path& path, std::string name) {
+        sources_.push_back({path, std::move(name)});
+    }
+
+    void AssetBaker::SetCompression(std::optional<BcFormat> format, EncodeQuality quality) {
+        compression_ = format;
+        quality_ = quality;
+    }
+
+    bool AssetBaker::Bake(const std::filesystem::path& archive, JobSystem& jobs) {
+        std::error_code error;
+        std::filesystem::create_directories(cache_directory_, error);
+        if (error) {
+            spdlog::error("Cannot create the bake cache {}", cache_directory_.string());
+            return false;
+        }
+
+        std::vector<std::optional<BakedAsset>> results(sources_.size());
+        std::vector<std::filesystem::path> cache_paths(sources_.size());
+        std::vector<std::uint8_t> from_cache(sources_.size(), 0);
+        jobs.ParallelFor(sources_.size(), 1, [&](std::uint32_t begin, std::uint32_t end) {
+            for (std::uint32_t i = begin; i < end; i++) {
+                bool cached = false;
+                results[i] = BakeSource(sources_[i], cache_paths[i], cached);
+                from_cache[i] = cached;
+            }
+        });
+
+        // One texture at a time with its blocks spread over the workers, ParallelFor can't nest and a
+        // few large textures would leave most workers idle if each got one
+        for (std::uint32_t i = 0; i < sources_.size(); i++) {
+            if (results[i].has_value() && !from_cache[i]) {
+                Compress(*results[i], sources_[i], jobs);
+            }
+        }
+
+        // Written aside and renamed, so an interrupted bake never leaves a truncated entry behind
+        jobs.ParallelFor(sources_.size(), 1, [&](std::uint32_t begin, std::uint32_t end) {
+            for (std::uint32_t i = begin; i < end; i++) {
+                if (!results[i].has_value() || from_cache[i]) {
+                    continue;
+                }
+                AssetArchiveWriter writer;
+                writer.AddAsset(std::string(kCachedAssetName), results[i]->GetView());
+                std::filesystem::path temporary_path = cache_paths[i];
+                temporary_path += fmt::format(".{}", std::hash<std::thread::id>()(std::this_thread::get_id()));
+                std::error_code error;
+                if (writer.Write(temporary_path)) {
+                    std::filesystem::rename(temporary_path, cache_paths[i], error);
+                }
+                if (error) {
+                    std::filesystem::remove(temporary_path, error);
+                }
+            }
+        });
+
+        cached_count_ = std::count(from_cache.begin(), from_cache.end(), 1);
+        baked_count_ = sources_.size() - cached_count_;
+
+        AssetArchiveWriter writer;
+        for (std::uint32_t i = 0; i < sources_.size(); i++) {
+            if (!results[i].has_value()) {
+                return false;
+            }
+            writer.AddAsset(sources_[i].name, results[i]->GetView());
+        }
+        return writer.Write(archive);
+    }
+
+    std::optional<BakedAsset> AssetBaker::BakeSource(const Source& source, std::filesystem::path& cache_path,
+                                                     bool& from_cache) const {
+        MappedFile file(source.path);
+        if (!file.IsOpen()) {
+            spdlog::error("Cannot read {}", source.path.string());
+            return std::nullopt;
+        }
+        gsl::span<const std::uint8_t> data = file.GetData();
+
+        // Everything that decides the output goes into the key
+        std::string extension = source.path.extension().string();
+        std::string settings = fmt::format("{} {} {} {} {}", kBakeVersion, extension, IsLinearTexture(source.name),
+                                           compression_.has_value() ? static_cast<std::int32_t>(*compression_) : -1,
+                                           static_cast<std::int32_t>(quality_));
+        std::uint64_t key = HashContent(data, HashAssetName(settings));
+        cache_path = cache_directory_ / fmt::format("{:016x}.vpak", key);
+
+        AssetArchive cached(cache_path);
+        if (std::optional<AssetView> view = cached.Find(kCachedAssetName)) {
+            from_cache = true;
+            BakedAsset asset;
+            asset.type = view->type;
+            asset.data.assign(view->data.begin(), view->data.end());
+            asset.width = view->width;
+            asset.height = view->height;
+            asset.format = view->format;
+            asset.mip_count = view->mip_count;
+            asset.index_count = view->index_count;
+            return asset;
+        }
+
+        BakedAsset asset;
+        glm::ivec2 extents;
+        std::int32_t channels;
+        if (extension == ".spv") {
+            asset.type = AssetType::kShader;
+            asset.data.assign(data.begin(), data.end());
+        } else if (extension == ".obj") {
+            std::vector<Vertex> vertices;
+            std::vector<std::uint32_t> indices;
+            if (!ParseObj(std::string_view(reinterpret_cast<const char*>(data.data()), data.size()), vertices,
+                          indices)) {
+                spdlog::error("Cannot parse {}", source.path.string());
+                return std::nullopt;
+            }
+            float input_ratio = GetAverageCacheMissRatio(indices);
+            OptimizeVertexCache(indices, vertices.size());
+            OptimizeVertexFetch(vertices, indices);
+            spdlog::info("{}: {} triangles, ACMR {:.2f} -> {:.2f}", source.name, indices.size() / 3, input_ratio,
+                         GetAverageCacheMissRatio(indices));
+
+            asset.type = AssetType::kMesh;
+            asset.index_count = indices.size();
+            std::size_t vertex_bytes = vertices.size() * sizeof(Vertex);
+            asset.data.resize(vertex_bytes + indices.size() * sizeof(std::uint32_t));
+            std::memcpy(asset.data.data(), vertices.data(), vertex_bytes);
+            std::memcpy(asset.data.data() + vertex_bytes, indices.data(), indices.size() * sizeof(std::uint32_t));
+        } else if (stbi_info_from_memory(data.data(), data.size(), &extents.x, &extents.y, &channels)) {
+            stbi_uc* pixels =
+                stbi_load_from_memory(data.data(), data.size(), &extents.x, &extents.y, &channels, STBI_rgb_alpha);
+            if (pixels == nullptr) {
+                spdlog::error("Cannot decode {}", source.path.string());
+                return std::nullopt;
+            }
+            bool srgb = !IsLinearTexture(source.name);
+            asset.type = AssetType::kTexture;
+            asset.data = GenerateMipChain(gsl::span<const std::uint8_t>(pixels, std::size_t(extents.x) * extents.y * 4),
+                                          extents, srgb);
+            stbi_image_free(pixels);
+            asset.width = extents.x;
+            asset.height = extents.y;
+            asset.format = srgb ? VK_FORMAT_R8G8B8A8_SRGB : VK_FORMAT_R8G8B8A8_UNORM;
+            asset.mip_count = GetMipCount(extents);
+        } else {
+            asset.data.assign(data.begin(), data.end());
+        }
+
+        return asset;
+    }
+
+    void AssetBaker::Compress(BakedAsset& asset, const Source& source, JobSystem& jobs) const {
+        if (!compression_.has_value() || asset.type != AssetType::kTexture) {
+            return;
+        }
+        // Two independent channels keep far more of a normal than the correlated colour formats do
+        bool linear = IsLinearTexture(source.name);
+        BcFormat format = linear ? BcFormat::kBc5 : *compression_;
+        glm::ivec2 size(asset.width, asset.height);
+        asset.data = EncodeBcMipChain(asset.data, size, asset.mip_count, format, quality_, &jobs);
+        asset.format = GetBcVkFormat(format, !linear);
+    }
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include <asset_archive.h>
+#include <bc_encoder.h>
+#include <job_system.h>
+
+namespace veng {
+
+    // Part of every cache key, bump it whenever the baked output of an unchanged source changes
+    constexpr std::uint32_t kBakeVersion = 1;
+
+    // An asset the way it goes into the archive, owning its data
+    struct BakedAsset {
+        AssetType type = AssetType::kRaw;
+        std::vector<std::uint8_t> data;
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::uint32_t mip_count = 1;
+        std::uint32_t index_count = 0;
+
+        AssetView GetView() const { return {type, data, width, height, format, mip_count, index_count}; }
+    };
+
+    // Down to 1x1
+    std::uint32_t GetMipCount(glm::ivec2 size);
+    // Every level of an RGBA8 image, starting with the image itself. sRGB images are filtered in linear space.
+    std::vector<std::uint8_t> GenerateMipChain(gsl::span<const std::uint8_t> rgba, glm::ivec2 size, bool srgb);
+
+    // Triangulated, with one vertex per distinct position / uv pair. False on a malformed file.
+    bool ParseObj(std::string_view text, std::vector<Vertex>& vertices, std::vector<std::uint32_t>& indices);
+    // Reorders triangles for the post transform cache (Forsyth's linear speed algorithm)
+    void OptimizeVertexCache(gsl::span<std::uint32_t> indices, std::uint32_t vertex_count);
+    // Reorders vertices by first use so fetches walk memory forward, unused vertices are dropped
+    void OptimizeVertexFetch(std::vector<Vertex>& vertices, gsl::span<std::uint32_t> indices);
+    // Average vertex shader invocations per triangle with a FIFO cache, 0.5 is the best a grid can do
+    float GetAverageCacheMissRatio(gsl::span<const std::uint32_t> indices, std::uint32_t cache_size = 16);
+
+    // Turns source files into GPU ready assets:
+    //   images decode to RGBA8 with every mip, in sRGB unless the name marks a normal map, and are block
+    //   compressed when SetCompression asks for it (normal maps always to BC5)
+    //   .obj meshes get deduplicated vertices and cache optimised indices
+    //   .spv shaders and everything else are copied
+    // Each result is cached under a hash of the source's contents, so a rebake only redoes what changed.
+    class AssetBaker {
+        public:
+        explicit AssetBaker(std::filesystem::path cache_directory);
+
+        void Add(const std::filesystem::path& path, std::string name);
+        // Off by default. The format and quality are part of the cache key.
+        void SetCompression(std::optional<BcFormat> format, EncodeQuality quality);
+        // Bakes the sources in parallel and writes them all to archive. False if any of them failed.
+        bool Bake(const std::filesystem::path& archive, JobSystem& jobs);
+
+        // Of the last Bake
+        std::uint32_t GetBakedCount() const { return baked_count_; }
+        std::uint32_t GetCachedCount() const { return cached_count_; }
+
+        private:
+        struct Source {
+            std::filesystem::path path;
+            std::string name;
+        };
+
+        // Sets cache_path to where the result is cached, whether or not it came from there
+        std::optional<BakedAsset> BakeSource(const Source& source, std::filesystem::path& cache_path,
+                                             bool& from_cache) const;
+        void Compress(BakedAsset& asset, const Source& source, JobSystem& jobs) const;
+
+        std::filesystem::path cache_directory_;
+        std::vector<Source> sources_;
+        std::optional<BcFormat> compression_;
+        EncodeQuality quality_ = EncodeQuality::kQuality;
+        std::uint32_t baked_count_ = 0;
+        std::uint32_t cached_count_ = 0;
+    };
+}
@@ -0,0 +1,405 @@
+#include <precomp.h>
+#include <async_file_reader.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+
+#if defined(_WIN32)
+#include <malloc.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(VENG_HAS_IO_URING)
+#include <liburing.h>
+#endif
+
+namespace veng {
+
+    namespace {
+
+        // Large enough that one file is a handful of requests, small enough that a few big files
+        // don't hold up the small ones queued behind them
+        constexpr std::uint32_t kChunkSize = 1024 * 1024;
+
+        std::size_t AlignUp(std::uint64_t size) {
+            return (size + AlignedBuffer::kAlignment - 1) / AlignedBuffer::kAlignment * AlignedBuffer::kAlignment;
+        }
+
+#if !defined(_WIN32)
+        // Not every file system takes O_DIRECT, those get a regular descriptor
+        std::int32_t OpenFile(const std::filesystem::path& path, bool direct) {
+#if defined(O_DIRECT)
+            if (direct) {
+                std::int32_t file = open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+                if (file >= 0 || errno != EINVAL) {
+                    return file;
+                }
+            }
+#endif
+            return open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+#endif
+    }
+
+#pragma region ALIGNED_BUFFER
+
+    AlignedBuffer::AlignedBuffer(std::size_t size) : size_(size), capacity_(AlignUp(std::max<std::size_t>(size, 1))) {
+#if defined(_WIN32)
+        data_.reset(static_cast<std::uint8_t*>(_aligned_malloc(capacity_, kAlignment)));
+#else
+        data_.reset(static_cast<std::uint8_t*>(std::aligned_alloc(kAlignment, capacity_)));
+#endif
+        if (data_ == nullptr) {
+            throw std::runtime_error("Failed to allocate a read buffer!");
+        }
+    }
+
+    void AlignedBuffer::Deleter::operator()(std::uint8_t* data) const {
+#if defined(_WIN32)
+        _aligned_free(data);
+#else
+        std::free(data);
+#endif
+    }
+
+#pragma endregion
+
+#pragma region IO_URING
+
+#if defined(VENG_HAS_IO_URING)
+    struct AsyncFileReader::Ring {
+        io_uring ring;
+    };
+#else
+    struct AsyncFileReader::Ring {};
+#endif
+
+    struct AsyncFileReader::Chunk {
+        Request* request = nullptr;
+        std::uint64_t offset = 0;
+        std::uint32_t length = 0;
+    };
+
+    AsyncFileReader::AsyncFileReader(std::uint32_t queue_depth, std::uint32_t fallback_threads)
+        : queue_depth_(std::max(queue_depth, 1u)) {
+#if defined(VENG_HAS_IO_URING)
+        auto ring = std::make_unique<Ring>();
+        std::int32_t result = io_uring_queue_init(queue_depth_, &ring->ring, 0);
+        if (result == 0) {
+            ring_ = std::move(ring);
+            return;
+        }
+        // Old kernels and sandboxes that filter the syscalls
+        spdlog::warn("io_uring is unavailable ({}), reading files on threads", result);
+#endif
+
+        for (std::uint32_t i = 0; i < std::max(fallback_threads, 1u); ++i) {
+            workers_.emplace_back(&AsyncFileReader::WorkerLoop, this);
+        }
+    }
+
+    AsyncFileReader::~AsyncFileReader() {
+        if (ring_ != nullptr) {
+            // The kernel may still write into the buffers, they have to outlive the reads
+            while (chunks_in_flight_ > 0) {
+                ReapCompletions(true);
+            }
+            for (const std::unique_ptr<Request>& request : queued_) {
+                if (request->file >= 0) {
+                    close(request->file);
+                }
+            }
+            for (const std::unique_ptr<Request>& request : issued_) {
+                if (request->file >= 0) {
+                    close(request->file);
+                }
+            }
+#if defined(VENG_HAS_IO_URING)
+            io_uring_queue_exit(&ring_->ring);
+#endif
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        work_available_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void AsyncFileReader::Read(const std::filesystem::path& path, std::function<void(FileReadResult)> on_complete,
+                               bool direct) {
+        auto request = std::make_unique<Request>();
+        request->path = path;
+        request->on_complete = std::move(on_complete);
+        request->direct = direct;
+        ++pending_count_;
+
+        if (ring_ != nullptr) {
+            queued_.push_back(std::move(request));
+            SubmitChunks();
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex_);
+            jobs_.push_back(std::move(request));
+        }
+        work_available_.notify_one();
+    }
+
+    std::uint32_t AsyncFileReader::Poll() {
+        if (ring_ != nullptr) {
+            return ReapCompletions(false);
+        }
+
+        std::deque<std::unique_ptr<Request>> finished;
+        {
+            std::lock_guard lock(mutex_);
+            finished.swap(finished_);
+        }
+        for (std::unique_ptr<Request>& request : finished) {
+            Complete(std::move(request));
+        }
+        return finished.size();
+    }
+
+    void AsyncFileReader::WaitIdle() {
+        while (pending_count_ > 0) {
+            if (ring_ != nullptr) {
+                ReapCompletions(true);
+                continue;
+            }
+
+            {
+                std::unique_lock lock(mutex_);
+                work_done_.wait(lock, [this] { return !finished_.empty(); });
+            }
+            Poll();
+        }
+    }
+
+    bool AsyncFileReader::OpenRequest(Request& request) {
+#if defined(_WIN32)
+        return false;
+#else
+        request.file = OpenFile(request.path, request.direct);
+        if (request.file < 0) {
+            return false;
+        }
+        struct stat status;
+        if (fstat(request.file, &status) != 0) {
+            return false;
+        }
+        request.size = status.st_size;
+        // O_DIRECT reads whole blocks, the tail block lands in the padding
+        request.buffer = AlignedBuffer(request.size);
+        return true;
+#endif
+    }
+
+    void AsyncFileReader::SubmitChunks() {
+#if defined(VENG_HAS_IO_URING)
+        std::uint32_t prepared = 0;
+        auto prepare = [&](std::unique_ptr<Chunk> chunk) {
+            io_uring_sqe* entry = io_uring_get_sqe(&ring_->ring);
+            std::uint8_t* target = chunk->request->buffer.GetData() + chunk->offset;
+            io_uring_prep_read(entry, chunk->request->file, target, chunk->length, chunk->offset);
+            io_uring_sqe_set_data(entry, chunk.release());
+            ++chunks_in_flight_;
+            ++prepared;
+        };
+
+        while (chunks_in_flight_ < queue_depth_ && !retries_.empty()) {
+            prepare(std::move(retries_.front()));
+            retries_.pop_front();
+        }
+
+        while (chunks_in_flight_ < queue_depth_ && !queued_.empty()) {
+            Request& request = *queued_.front();
+            if (request.file < 0 && !OpenRequest(request)) {
+                request.failed = true;
+            }
+
+            if (!request.failed && request.next_offset < request.size) {
+                auto chunk = std::make_unique<Chunk>();
+                chunk->request = &request;
+                chunk->offset = request.next_offset;
+                chunk->length = std::min<std::uint64_t>(kChunkSize, AlignUp(request.size) - request.next_offset);
+                request.next_offset += chunk->length;
+                ++request.chunks_in_flight;
+                prepare(std::move(chunk));
+            }
+
+            if (request.failed || request.next_offset >= request.size) {
+                // Empty or unreadable files have nothing in flight that would complete them later
+                if (request.chunks_in_flight == 0) {
+                    finished_.push_back(std::move(queued_.front()));
+                } else {
+                    issued_.push_back(std::move(queued_.front()));
+                }
+                queued_.pop_front();
+            }
+        }
+
+        if (prepared > 0) {
+            io_uring_submit(&ring_->ring);
+        }
+#endif
+    }
+
+    std::uint32_t AsyncFileReader::ReapCompletions([[maybe_unused]] bool wait) {
+        std::uint32_t completed = 0;
+#if defined(VENG_HAS_IO_URING)
+        // Requests that never reached the kernel, or failed before all their chunks were issued
+        auto complete_finished = [&]() {
+            while (!finished_.empty()) {
+                std::unique_ptr<Request> request = std::move(finished_.front());
+                finished_.pop_front();
+                Complete(std::move(request));
+                ++completed;
+            }
+        };
+        complete_finished();
+
+        io_uring_cqe* completion = nullptr;
+        if (wait && completed == 0 && chunks_in_flight_ > 0) {
+            io_uring_wait_cqe(&ring_->ring, &completion);
+        }
+
+        while (io_uring_peek_cqe(&ring_->ring, &completion) == 0) {
+            std::unique_ptr<Chunk> chunk(static_cast<Chunk*>(io_uring_cqe_get_data(completion)));
+            std::int32_t result = completion->res;
+            io_uring_cqe_seen(&ring_->ring, completion);
+            --chunks_in_flight_;
+
+            Request& request = *chunk->request;
+            --request.chunks_in_flight;
+            if (result < 0) {
+                request.failed = true;
+            } else if (static_cast<std::uint32_t>(result) < chunk->length &&
+                       chunk->offset + result < request.size) {
+                // A short read before the end of the file, go again for the rest
+                if (result == 0) {
+                    request.failed = true;
+                } else {
+                    chunk->offset += result;
+                    chunk->length -= result;
+                    ++request.chunks_in_flight;
+                    retries_.push_back(std::move(chunk));
+                }
+            }
+
+            // A request that failed while still at the front of queued_ isn't in issued_, SubmitChunks
+            // moves it to finished_ below
+            bool issued = request.failed || request.next_offset >= request.size;
+            if (request.chunks_in_flight == 0 && issued) {
+                auto it = std::find_if(issued_.begin(), issued_.end(),
+                                       [&](const std::unique_ptr<Request>& other) { return other.get() == &request; });
+                if (it != issued_.end()) {
+                    std::unique_ptr<Request> done = std::move(*it);
+                    issued_.erase(it);
+                    Complete(std::move(done));
+                    ++completed;
+                }
+            }
+        }
+
+        SubmitChunks();
+        complete_finished();
+#endif
+        return completed;
+    }
+
+    void AsyncFileReader::Complete(std::unique_ptr<Request> request) {
+#if !defined(_WIN32)
+        if (request->file >= 0) {
+            close(request->file);
+        }
+#endif
+        --pending_count_;
+
+        FileReadResult result;
+        result.path = std::move(request->path);
+        result.success = !request->failed;
+        if (result.success) {
+            request->buffer.Shrink(request->size);
+            result.data = std::move(request->buffer);
+        } else {
+            spdlog::error("Cannot read {}", result.path.string());
+        }
+        request->on_complete(std::move(result));
+    }
+
+#pragma endregion
+
+#pragma region THREAD_POOL
+
+    void AsyncFileReader::WorkerLoop() {
+        while (true) {
+            std::unique_ptr<Request> request;
+            {
+                std::unique_lock lock(mutex_);
+                work_available_.wait(lock, [this] { return stopping_ || !jobs_.empty(); });
+                if (stopping_) {
+                    return;
+                }
+                request = std::move(jobs_.front());
+                jobs_.pop_front();
+            }
+
+            ReadBlocking(*request);
+
+            {
+                std::lock_guard lock(mutex_);
+                finished_.push_back(std::move(request));
+            }
+            work_done_.notify_all();
+        }
+    }
+
+    void AsyncFileReader::ReadBlocking(Request& request) {
+#if defined(_WIN32)
+        std::ifstream file(request.path, std::ios::binary | std::ios::ate);
+        if (!file.is_open()) {
+            request.failed = true;
+            return;
+        }
+        request.size = file.tellg();
+        request.buffer = AlignedBuffer(request.size);
+        file.seekg(0);
+        file.read(reinterpret_cast<char*>(request.buffer.GetData()), request.size);
+        request.failed = file.gcount() != static_cast<std::streamsize>(request.size);
+#else
+        if (!OpenRequest(request)) {
+            request.failed = true;
+        }
+        while (!request.failed && request.next_offset < request.size) {
+            std::size_t length = std::min<std::uint64_t>(kChunkSize, AlignUp(request.size) - request.next_offset);
+            ssize_t result = pread(request.file, request.buffer.GetData() + request.next_offset, length,
+                                   request.next_offset);
+            if (result < 0 && errno == EINTR) {
+                continue;
+            }
+            if (result <= 0) {
+                request.failed = true;
+                break;
+            }
+            request.next_offset += result;
+        }
+        if (request.file >= 0) {
+            close(request.file);
+            request.file = -1;
+        }
+#endif
+    }
+
+#pragma endregion
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace veng {
+
+    // Heap memory on a page boundary, as O_DIRECT wants it
+    class AlignedBuffer {
+        public:
+        static constexpr std::size_t kAlignment = 4096;
+
+        AlignedBuffer() = default;
+        // The allocation is rounded up to kAlignment, size stays what was asked for
+        explicit AlignedBuffer(std::size_t size);
+
+        std::uint8_t* GetData() { return data_.get(); }
+        gsl::span<const std::uint8_t> GetSpan() const { return {data_.get(), size_}; }
+        std::size_t GetSize() const { return size_; }
+        std::size_t GetCapacity() const { return capacity_; }
+        // Never grows past the capacity
+        void Shrink(std::size_t size) { size_ = std::min(size, capacity_); }
+
+        private:
+        struct Deleter {
+            void operator()(std::uint8_t* data) const;
+        };
+
+        std::unique_ptr<std::uint8_t[], Deleter> data_;
+        std::size_t size_ = 0;
+        std::size_t capacity_ = 0;
+    };
+
+    struct FileReadResult {
+        std::filesystem::path path;
+        AlignedBuffer data;
+        bool success = false;
+    };
+
+    // Keeps many whole-file reads in flight at once. On Linux they go through io_uring when the build
+    // found liburing and the kernel allows it, everywhere else a few threads issue blocking reads.
+    // Either way the callbacks run on the thread that calls Poll or WaitIdle, so decoding a finished
+    // file overlaps with the reads still queued behind it.
+    class AsyncFileReader {
+        public:
+        explicit AsyncFileReader(std::uint32_t queue_depth = 64, std::uint32_t fallback_threads = 4);
+        ~AsyncFileReader();
+        AsyncFileReader(const AsyncFileReader&) = delete;
+        AsyncFileReader& operator=(const AsyncFileReader&) = delete;
+
+        // direct bypasses the page cache with O_DIRECT where the file system supports it, for data that
+        // is read once and would only evict something more useful
+        void Read(const std::filesystem::path& path, std::function<void(FileReadResult)> on_complete,
+                  bool direct = false);
+        // Runs the callbacks of the reads that have finished and returns how many there were
+        std::uint32_t Poll();
+        // Until every read has finished and its callback has run
+        void WaitIdle();
+
+        bool UsesIoUring() const { return ring_ != nullptr; }
+        std::uint32_t GetPendingCount() const { return pending_count_; }
+
+        private:
+        struct Request {
+            std::filesystem::path path;
+            std::function<void(FileReadResult)> on_complete;
+            bool direct = false;
+            std::int32_t file = -1;
+            AlignedBuffer buffer;
+            std::uint64_t size = 0;
+            // Where the next chunk starts and how many are still in the kernel
+            std::uint64_t next_offset = 0;
+            std::uint32_t chunks_in_flight = 0;
+            bool failed = false;
+        };
+
+        struct Chunk;
+        struct Ring;
+
+        // io_uring
+        static bool OpenRequest(Request& request);
+        void SubmitChunks();
+        std::uint32_t ReapCompletions(bool wait);
+        void Complete(std::unique_ptr<Request> request);
+
+        // Thread pool, in both modes finished_ holds requests whose callbacks are due
+        void WorkerLoop();
+        static void ReadBlocking(Request& request);
+
+        std::uint32_t queue_depth_;
+        std::uint32_t pending_count_ = 0;
+
+        std::unique_ptr<Ring> ring_;
+        std::uint32_t chunks_in_flight_ = 0;
+        // Not opened yet, or opened but not every chunk is issued
+        std::deque<std::unique_ptr<Request>> queued_;
+        // Every chunk issued, waiting for the last to complete
+        std::vector<std::unique_ptr<Request>> issued_;
+        std::deque<std::unique_ptr<Chunk>> retries_;
+
+        std::vector<std::thread> workers_;
+        std::mutex mutex_;
+        std::condition_variable work_available_;
+        std::condition_variable work_done_;
+        std::deque<std::unique_ptr<Request>> jobs_;
+        std::deque<std::unique_ptr<Request>> finished_;
+        bool stopping_ = false;
+    };
+}
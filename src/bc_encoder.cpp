@@ -0,0 +1,582 @@
+#include <precomp.h>
+#include <bc_encoder.h>
+#include <simd.h>
+#include <texture_file.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <limits>
+
+namespace veng {
+
+    namespace {
+
+        constexpr std::uint32_t kBlockTexels = 16;
+
+        // 4x4 texels, one row of floats per channel so the fitting runs across texels
+        struct Block {
+            alignas(32) float channels[4][kBlockTexels];
+        };
+
+        struct Endpoints {
+            std::array<float, 4> low = {};
+            std::array<float, 4> high = {};
+        };
+
+        using Palette = std::array<std::array<float, 4>, 16>;
+        using Indices = std::array<std::uint8_t, kBlockTexels>;
+
+        // Fraction of the way from low to high for each palette index
+        constexpr std::array<float, 4> kBc1Weights = {0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f};
+        constexpr std::array<std::int32_t, 16> kBc7Weights = {0, 4, 9, 13, 17, 21, 26, 30,
+                                                              34, 38, 43, 47, 51, 55, 60, 64};
+
+        // 128 bits written from the least significant end, as BC7 lays its fields out
+        class BitWriter {
+            public:
+            void Write(std::uint64_t value, std::uint32_t count) {
+                std::uint32_t word = position_ / 64;
+                std::uint32_t offset = position_ % 64;
+                bits_[word] |= value << offset;
+                if (offset + count > 64) {
+                    bits_[word + 1] |= value >> (64 - offset);
+                }
+                position_ += count;
+            }
+
+            void CopyTo(std::uint8_t* output) const { std::memcpy(output, bits_.data(), sizeof(bits_)); }
+
+            private:
+            std::array<std::uint64_t, 2> bits_ = {};
+            std::uint32_t position_ = 0;
+        };
+
+        void LoadBlock(gsl::span<const std::uint8_t> rgba, glm::ivec2 size, std::uint32_t block_x,
+                       std::uint32_t block_y, Block& block) {
+            for (std::uint32_t y = 0; y < 4; y++) {
+                std::uint32_t source_y = std::min<std::uint32_t>(block_y * 4 + y, size.y - 1);
+                for (std::uint32_t x = 0; x < 4; x++) {
+                    std::uint32_t source_x = std::min<std::uint32_t>(block_x * 4 + x, size.x - 1);
+                    const std::uint8_t* texel = rgba.data() + (std::size_t(source_y) * size.x + source_x) * 4;
+                    for (std::uint32_t channel = 0; channel < 4; channel++) {
+                        block.channels[channel][y * 4 + x] = texel[channel];
+                    }
+                }
+            }
+        }
+
+        // Nearest palette entry for every texel over channels [first, first + count), returns the summed
+        // squared error. This is where encoding spends its time, so texels go through in SIMD lanes.
+        float FitIndices(const Block& block, std::uint32_t first, std::uint32_t count, const Palette& palette,
+                         std::uint32_t palette_size, Indices& indices) {
+            float total_error = 0.0f;
+            std::uint32_t texel = 0;
+#if defined(VENG_SIMD_SSE)
+            for (; texel + simd::kLaneCount <= kBlockTexels; texel += simd::kLaneCount) {
+                simd::Lanes best_error = simd::Splat(std::numeric_limits<float>::max());
+                simd::Lanes best_index = simd::Splat(0.0f);
+                for (std::uint32_t entry = 0; entry < palette_size; entry++) {
+                    simd::Lanes error = simd::Splat(0.0f);
+                    for (std::uint32_t channel = first; channel < first + count; channel++) {
+                        simd::Lanes texels = simd::Load(&block.channels[channel][texel]);
+                        simd::Lanes difference = simd::Sub(texels, simd::Splat(palette[entry][channel]));
+                        error = simd::Add(error, simd::Mul(difference, difference));
+                    }
+                    simd::Lanes closer = simd::Less(error, best_error);
+                    best_error = simd::Min(error, best_error);
+                    best_index = simd::Select(closer, simd::Splat(static_cast<float>(entry)), best_index);
+                }
+
+                alignas(32) float errors[simd::kLaneCount];
+                alignas(32) float lane_indices[simd::kLaneCount];
+                simd::Store(errors, best_error);
+                simd::Store(lane_indices, best_index);
+                for (std::uint32_t lane = 0; lane < simd::kLaneCount; lane++) {
+                    total_error += errors[lane];
+                    indices[texel + lane] = static_cast<std::uint8_t>(lane_indices[lane]);
+                }
+            }
+#endif
+            for (; texel < kBlockTexels; texel++) {
+                float best_error = std::numeric_limits<float>::max();
+                for (std::uint32_t entry = 0; entry < palette_size; entry++) {
+                    float error = 0.0f;
+                    for (std::uint32_t channel = first; channel < first + count; channel++) {
+                        float difference = block.channels[channel][texel] - palette[entry][channel];
+                        error += difference * difference;
+                    }
+                    if (error < best_error) {
+                        best_error = error;
+                        indices[texel] = entry;
+                    }
+                }
+                total_error += best_error;
+            }
+            return total_error;
+        }
+
+        // The line through the texels' principal axis, clipped to their extent along it
+        Endpoints PrincipalEndpoints(const Block& block, std::uint32_t first, std::uint32_t count,
+                                     std::uint32_t iterations) {
+            Endpoints endpoints;
+            std::array<float, 4> mean = {};
+            for (std::uint32_t channel = first; channel < first + count; channel++) {
+                for (float value : block.channels[channel]) {
+                    mean[channel] += value;
+                }
+                mean[channel] /= kBlockTexels;
+            }
+
+            std::array<std::array<float, 4>, 4> covariance = {};
+            for (std::uint32_t texel = 0; texel < kBlockTexels; texel++) {
+                for (std::uint32_t row = first; row < first + count; row++) {
+                    for (std::uint32_t column = first; column < first + count; column++) {
+                        covariance[row][column] += (block.channels[row][texel] - mean[row]) *
+                                                   (block.channels[column][texel] - mean[column]);
+                    }
+                }
+            }
+
+            // Power iteration, starting from the row of the channel that varies most so the start
+            // can't be perpendicular to the axis
+            std::uint32_t widest = first;
+            for (std::uint32_t channel = first; channel < first + count; channel++) {
+                if (covariance[channel][channel] > covariance[widest][widest]) {
+                    widest = channel;
+                }
+            }
+            std::array<float, 4> axis = covariance[widest];
+            for (std::uint32_t iteration = 0; iteration < iterations; iteration++) {
+                std::array<float, 4> next = {};
+                float largest = 0.0f;
+                for (std::uint32_t row = first; row < first + count; row++) {
+                    for (std::uint32_t column = first; column < first + count; column++) {
+                        next[row] += covariance[row][column] * axis[column];
+                    }
+                    largest = std::max(largest, std::abs(next[row]));
+                }
+                if (largest == 0.0f) {
+                    break;
+                }
+                for (std::uint32_t channel = first; channel < first + count; channel++) {
+                    axis[channel] = next[channel] / largest;
+                }
+            }
+
+            float length_squared = 0.0f;
+            for (std::uint32_t channel = first; channel < first + count; channel++) {
+                length_squared += axis[channel] * axis[channel];
+            }
+            if (length_squared < 1e-12f) {
+                // A flat block
+                endpoints.low = mean;
+                endpoints.high = mean;
+                return endpoints;
+            }
+            float inverse_length = 1.0f / std::sqrt(length_squared);
+
+            float low = std::numeric_limits<float>::max();
+            float high = std::numeric_limits<float>::lowest();
+            for (std::uint32_t texel = 0; texel < kBlockTexels; texel++) {
+                float projection = 0.0f;
+                for (std::uint32_t channel = first; channel < first + count; channel++) {
+                    projection += (block.channels[channel][texel] - mean[channel]) * axis[channel] * inverse_length;
+                }
+                low = std::min(low, projection);
+                high = std::max(high, projection);
+            }
+            for (std::uint32_t channel = first; channel < first + count; channel++) {
+                float direction = axis[channel] * inverse_length;
+                endpoints.low[channel] = std::clamp(mean[channel] + direction * low, 0.0f, 255.0f);
+                endpoints.high[channel] = std::clamp(mean[channel] + direction * high, 0.0f, 255.0f);
+            }
+            return endpoints;
+        }
+
+        // Least squares endpoints for fixed indices, false when the indices don't pin them down
+        bool RefineEndpoints(const Block& block, std::uint32_t first, std::uint32_t count, const Indices& indices,
+                             gsl::span<const float> weights, Endpoints& endpoints) {
+            float low_low = 0.0f;
+            float low_high = 0.0f;
+            float high_high = 0.0f;
+            std::array<float, 4> low_texel = {};
+            std::array<float, 4> high_texel = {};
+            for (std::uint32_t texel = 0; texel < kBlockTexels; texel++) {
+                float high_weight = weights[indices[texel]];
+                float low_weight = 1.0f - high_weight;
+                low_low += low_weight * low_weight;
+                low_high += low_weight * high_weight;
+                high_high += high_weight * high_weight;
+                for (std::uint32_t channel = first; channel < first + count; channel++) {
+                    low_texel[channel] += low_weight * block.channels[channel][texel];
+                    high_texel[channel] += high_weight * block.channels[channel][texel];
+                }
+            }
+
+            float determinant = low_low * high_high - low_high * low_high;
+            if (std::abs(determinant) < 1e-6f) {
+                return false;
+            }
+            for (std::uint32_t channel = first; channel < first + count; channel++) {
+                float low = (low_texel[channel] * high_high - high_texel[channel] * low_high) / determinant;
+                float high = (high_texel[channel] * low_low - low_texel[channel] * low_high) / determinant;
+                endpoints.low[channel] = std::clamp(low, 0.0f, 255.0f);
+                endpoints.high[channel] = std::clamp(high, 0.0f, 255.0f);
+            }
+            return true;
+        }
+
+#pragma region BC1
+
+        std::uint16_t ToRgb565(const std::array<float, 4>& color) {
+            auto quantize = [](float value, float levels) {
+                return static_cast<std::uint16_t>(std::clamp(value * levels / 255.0f + 0.5f, 0.0f, levels));
+            };
+            return quantize(color[0], 31.0f) << 11 | quantize(color[1], 63.0f) << 5 | quantize(color[2], 31.0f);
+        }
+
+        std::array<float, 4> FromRgb565(std::uint16_t color) {
+            std::uint32_t red = color >> 11;
+            std::uint32_t green = (color >> 5) & 63;
+            std::uint32_t blue = color & 31;
+            return {static_cast<float>(red << 3 | red >> 2), static_cast<float>(green << 2 | green >> 4),
+                    static_cast<float>(blue << 3 | blue >> 2), 255.0f};
+        }
+
+        void EncodeBc1Block(const Block& block, EncodeQuality quality, std::uint8_t* output) {
+            std::array<std::uint16_t, 2> colors = {};
+            Indices indices = {};
+
+            auto evaluate = [&](const Endpoints& endpoints, std::array<std::uint16_t, 2>& candidate_colors,
+                                Indices& candidate_indices) {
+                candidate_colors = {ToRgb565(endpoints.low), ToRgb565(endpoints.high)};
+                std::array<float, 4> low = FromRgb565(candidate_colors[0]);
+                std::array<float, 4> high = FromRgb565(candidate_colors[1]);
+                Palette palette;
+                for (std::uint32_t entry = 0; entry < kBc1Weights.size(); entry++) {
+                    for (std::uint32_t channel = 0; channel < 3; channel++) {
+                        float weight = kBc1Weights[entry];
+                        palette[entry][channel] = low[channel] * (1.0f - weight) + high[channel] * weight;
+                    }
+                }
+                // Equal colors select the three color mode, where only index 0 is the same color
+                std::uint32_t palette_size = candidate_colors[0] == candidate_colors[1] ? 1 : 4;
+                return FitIndices(block, 0, 3, palette, palette_size, candidate_indices);
+            };
+
+            Endpoints endpoints = PrincipalEndpoints(block, 0, 3, quality == EncodeQuality::kQuality ? 8 : 3);
+            float best_error = evaluate(endpoints, colors, indices);
+            if (quality == EncodeQuality::kQuality) {
+                for (std::uint32_t iteration = 0; iteration < 2 && best_error > 0.0f; iteration++) {
+                    Endpoints refined = endpoints;
+                    if (!RefineEndpoints(block, 0, 3, indices, kBc1Weights, refined)) {
+                        break;
+                    }
+                    std::array<std::uint16_t, 2> refined_colors;
+                    Indices refined_indices;
+                    float error = evaluate(refined, refined_colors, refined_indices);
+                    if (error >= best_error) {
+                        break;
+                    }
+                    best_error = error;
+                    endpoints = refined;
+                    colors = refined_colors;
+                    indices = refined_indices;
+                }
+            }
+
+            // Four color mode needs color 0 above color 1
+            if (colors[0] < colors[1]) {
+                std::swap(colors[0], colors[1]);
+                for (std::uint8_t& index : indices) {
+                    index ^= 1;
+                }
+            }
+
+            std::uint32_t index_bits = 0;
+            for (std::uint32_t texel = 0; texel < kBlockTexels; texel++) {
+                index_bits |= std::uint32_t(indices[texel]) << (texel * 2);
+            }
+            std::memcpy(output, colors.data(), sizeof(colors));
+            std::memcpy(output + sizeof(colors), &index_bits, sizeof(index_bits));
+        }
+
+#pragma endregion
+
+#pragma region BC4
+
+        void EncodeBc4Block(const Block& block, std::uint32_t channel, EncodeQuality quality, std::uint8_t* output) {
+            Indices indices = {};
+            std::array<std::int32_t, 2> values = {};
+
+            // Eight interpolated values when the first is larger, otherwise six plus 0 and 255
+            auto evaluate = [&](std::int32_t first, std::int32_t second, Indices& candidate_indices) {
+                Palette palette;
+                palette[0][channel] = first;
+                palette[1][channel] = second;
+                if (first > second) {
+                    for (std::int32_t entry = 2; entry < 8; entry++) {
+                        palette[entry][channel] = ((8 - entry) * first + (entry - 1) * second) / 7.0f;
+                    }
+                } else {
+                    for (std::int32_t entry = 2; entry < 6; entry++) {
+                        palette[entry][channel] = ((6 - entry) * first + (entry - 1) * second) / 5.0f;
+                    }
+                    palette[6][channel] = 0.0f;
+                    palette[7][channel] = 255.0f;
+                }
+                return FitIndices(block, channel, 1, palette, 8, candidate_indices);
+            };
+
+            const float* texels = block.channels[channel];
+            std::int32_t low = static_cast<std::int32_t>(*std::min_element(texels, texels + kBlockTexels));
+            std::int32_t high = static_cast<std::int32_t>(*std::max_element(texels, texels + kBlockTexels));
+            values = {high, low};
+            float best_error = evaluate(high, low, indices);
+
+            if (quality == EncodeQuality::kQuality && best_error > 0.0f) {
+                std::array<std::array<std::int32_t, 2>, 17> candidates;
+                std::uint32_t candidate_count = 0;
+                // Pulling the ends in spends the interpolated steps where most texels are
+                for (std::int32_t high_inset = 0; high_inset < 4; high_inset++) {
+                    for (std::int32_t low_inset = 0; low_inset < 4; low_inset++) {
+                        if (high - high_inset > low + low_inset) {
+                            candidates[candidate_count++] = {high - high_inset, low + low_inset};
+                        }
+                    }
+                }
+                // The six value mode has exact 0 and 255 for free, the rest only has to cover the middle
+                std::int32_t inner_low = 255;
+                std::int32_t inner_high = 0;
+                for (float texel : block.channels[channel]) {
+                    if (texel > 0.0f && texel < 255.0f) {
+                        inner_low = std::min(inner_low, static_cast<std::int32_t>(texel));
+                        inner_high = std::max(inner_high, static_cast<std::int32_t>(texel));
+                    }
+                }
+                if (inner_low <= inner_high) {
+                    candidates[candidate_count++] = {inner_low, inner_high};
+                }
+
+                for (std::uint32_t candidate = 0; candidate < candidate_count; candidate++) {
+                    Indices candidate_indices;
+                    float error = evaluate(candidates[candidate][0], candidates[candidate][1], candidate_indices);
+                    if (error < best_error) {
+                        best_error = error;
+                        values = candidates[candidate];
+                        indices = candidate_indices;
+                    }
+                }
+            }
+
+            std::uint64_t index_bits = 0;
+            for (std::uint32_t texel = 0; texel < kBlockTexels; texel++) {
+                index_bits |= std::uint64_t(indices[texel]) << (texel * 3);
+            }
+            output[0] = static_cast<std::uint8_t>(values[0]);
+            output[1] = static_cast<std::uint8_t>(values[1]);
+            for (std::uint32_t byte = 0; byte < 6; byte++) {
+                output[2 + byte] = static_cast<std::uint8_t>(index_bits >> (byte * 8));
+            }
+        }
+
+#pragma endregion
+
+#pragma region BC7
+
+        // Mode 6 only: one subset, 7 bit RGBA endpoints with a shared low bit each and 4 bit indices. It is
+        // the best single mode for most content and keeps the encoder a fraction of a full mode search.
+        struct Bc7Endpoints {
+            std::array<std::array<std::int32_t, 4>, 2> colors = {};
+            std::array<std::int32_t, 2> p_bits = {};
+        };
+
+        std::int32_t QuantizeBc7(float value, std::int32_t p_bit) {
+            return std::clamp(static_cast<std::int32_t>((value - p_bit) * 0.5f + 0.5f), 0, 127);
+        }
+
+        float EvaluateBc7(const Block& block, const Endpoints& endpoints, std::int32_t low_p_bit,
+                          std::int32_t high_p_bit, Bc7Endpoints& quantized, Indices& indices) {
+            quantized.p_bits = {low_p_bit, high_p_bit};
+            for (std::uint32_t channel = 0; channel < 4; channel++) {
+                quantized.colors[0][channel] = QuantizeBc7(endpoints.low[channel], low_p_bit);
+                quantized.colors[1][channel] = QuantizeBc7(endpoints.high[channel], high_p_bit);
+            }
+
+            Palette palette;
+            for (std::uint32_t entry = 0; entry < kBc7Weights.size(); entry++) {
+                for (std::uint32_t channel = 0; channel < 4; channel++) {
+                    std::int32_t low = quantized.colors[0][channel] << 1 | low_p_bit;
+                    std::int32_t high = quantized.colors[1][channel] << 1 | high_p_bit;
+                    palette[entry][channel] =
+                        static_cast<float>(((64 - kBc7Weights[entry]) * low + kBc7Weights[entry] * high + 32) >> 6);
+                }
+            }
+            return FitIndices(block, 0, 4, palette, kBc7Weights.size(), indices);
+        }
+
+        // The shared bit that rounds the endpoint best on its own
+        std::int32_t PickBc7PBit(const std::array<float, 4>& color) {
+            std::array<float, 2> errors = {};
+            for (std::int32_t p_bit = 0; p_bit < 2; p_bit++) {
+                for (float value : color) {
+                    float difference = value - static_cast<float>(QuantizeBc7(value, p_bit) << 1 | p_bit);
+                    errors[p_bit] += difference * difference;
+                }
+            }
+            return errors[1] < errors[0] ? 1 : 0;
+        }
+
+        void EncodeBc7Block(const Block& block, EncodeQuality quality, std::uint8_t* output) {
+            Bc7Endpoints quantized;
+            Indices indices = {};
+
+            Endpoints endpoints = PrincipalEndpoints(block, 0, 4, quality == EncodeQuality::kQuality ? 8 : 3);
+            float best_error = EvaluateBc7(block, endpoints, PickBc7PBit(endpoints.low), PickBc7PBit(endpoints.high),
+                                           quantized, indices);
+
+            if (quality == EncodeQuality::kQuality) {
+                std::array<float, kBc7Weights.size()> weights;
+                for (std::uint32_t entry = 0; entry < weights.size(); entry++) {
+                    weights[entry] = kBc7Weights[entry] / 64.0f;
+                }
+
+                for (std::uint32_t iteration = 0; iteration < 3 && best_error > 0.0f; iteration++) {
+                    Endpoints refined = endpoints;
+                    if (iteration > 0 && !RefineEndpoints(block, 0, 4, indices, weights, refined)) {
+                        break;
+                    }
+                    bool improved = false;
+                    for (std::int32_t p_bits = 0; p_bits < 4; p_bits++) {
+                        Bc7Endpoints candidate;
+                        Indices candidate_indices;
+                        float error =
+                            EvaluateBc7(block, refined, p_bits & 1, p_bits >> 1, candidate, candidate_indices);
+                        if (error < best_error) {
+                            best_error = error;
+                            quantized = candidate;
+                            indices = candidate_indices;
+                            improved = true;
+                        }
+                    }
+                    if (!improved && iteration > 0) {
+                        break;
+                    }
+                    endpoints = refined;
+                }
+            }
+
+            // The first texel's index drops its top bit, so it has to be in the lower half
+            if (indices[0] >= 8) {
+                std::swap(quantized.colors[0], quantized.colors[1]);
+                std::swap(quantized.p_bits[0], quantized.p_bits[1]);
+                for (std::uint8_t& index : indices) {
+                    index = 15 - index;
+                }
+            }
+
+            BitWriter writer;
+            writer.Write(1 << 6, 7);
+            for (std::uint32_t channel = 0; channel < 4; channel++) {
+                writer.Write(quantized.colors[0][channel], 7);
+                writer.Write(quantized.colors[1][channel], 7);
+            }
+            writer.Write(quantized.p_bits[0], 1);
+            writer.Write(quantized.p_bits[1], 1);
+            writer.Write(indices[0], 3);
+            for (std::uint32_t texel = 1; texel < kBlockTexels; texel++) {
+                writer.Write(indices[texel], 4);
+            }
+            writer.CopyTo(output);
+        }
+
+#pragma endregion
+    }
+
+    VkFormat GetBcVkFormat(BcFormat format, bool srgb) {
+        switch (format) {
+            case BcFormat::kBc1:
+                return srgb ? VK_FORMAT_BC1_RGB_SRGB_BLOCK : VK_FORMAT_BC1_RGB_UNORM_BLOCK;
+            case BcFormat::kBc4:
+                return VK_FORMAT_BC4_UNORM_BLOCK;
+            case BcFormat::kBc5:
+                return VK_FORMAT_BC5_UNORM_BLOCK;
+            case BcFormat::kBc7:
+                return srgb ? VK_FORMAT_BC7_SRGB_BLOCK : VK_FORMAT_BC7_UNORM_BLOCK;
+        }
+        return VK_FORMAT_UNDEFINED;
+    }
+
+    std::optional<BcFormat> ParseBcFormat(std::string_view name) {
+        constexpr std::array<std::pair<std::string_view, BcFormat>, 4> kNames = {{
+            {"bc1", BcFormat::kBc1},
+            {"bc4", BcFormat::kBc4},
+            {"bc5", BcFormat::kBc5},
+            {"bc7", BcFormat::kBc7},
+        }};
+        for (auto [format_name, format] : kNames) {
+            if (name == format_name) {
+                return format;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::vector<std::uint8_t> EncodeBc(gsl::span<const std::uint8_t> rgba, glm::ivec2 size, BcFormat format,
+                                       EncodeQuality quality, JobSystem* jobs) {
+        VkFormat vk_format = GetBcVkFormat(format, false);
+        std::uint32_t block_bytes = GetTextureLevelSize(vk_format, 4, 4);
+        std::uint32_t blocks_x = (size.x + 3) / 4;
+        std::uint32_t blocks_y = (size.y + 3) / 4;
+        std::vector<std::uint8_t> output(GetTextureLevelSize(vk_format, size.x, size.y));
+
+        auto encode_rows = [&](std::uint32_t begin, std::uint32_t end) {
+            Block block;
+            for (std::uint32_t block_y = begin; block_y < end; block_y++) {
+                for (std::uint32_t block_x = 0; block_x < blocks_x; block_x++) {
+                    LoadBlock(rgba, size, block_x, block_y, block);
+                    std::uint8_t* target = output.data() + (std::size_t(block_y) * blocks_x + block_x) * block_bytes;
+                    switch (format) {
+                        case BcFormat::kBc1:
+                            EncodeBc1Block(block, quality, target);
+                            break;
+                        case BcFormat::kBc4:
+                            EncodeBc4Block(block, 0, quality, target);
+                            break;
+                        case BcFormat::kBc5:
+                            EncodeBc4Block(block, 0, quality, target);
+                            EncodeBc4Block(block, 1, quality, target + 8);
+                            break;
+                        case BcFormat::kBc7:
+                            EncodeBc7Block(block, quality, target);
+                            break;
+                    }
+                }
+            }
+        };
+
+        // A row per batch, workers that finish early take the next row rather than waiting on a fixed split
+        if (jobs != nullptr) {
+            jobs->ParallelFor(blocks_y, 1, encode_rows);
+        } else {
+            encode_rows(0, blocks_y);
+        }
+        return output;
+    }
+
+    std::vector<std::uint8_t> EncodeBcMipChain(gsl::span<const std::uint8_t> rgba, glm::ivec2 size,
+                                               std::uint32_t mip_count, BcFormat format, EncodeQuality quality,
+                                               JobSystem* jobs) {
+        std::vector<std::uint8_t> chain;
+        std::size_t offset = 0;
+        for (std::uint32_t mip = 0; mip < mip_count; mip++) {
+            glm::ivec2 level_size(std::max(size.x >> mip, 1), std::max(size.y >> mip, 1));
+            std::size_t level_bytes = GetTextureLevelSize(VK_FORMAT_R8G8B8A8_UNORM, level_size.x, level_size.y);
+            std::vector<std::uint8_t> level =
+                EncodeBc(rgba.subspan(offset, level_bytes), level_size, format, quality, jobs);
+            chain.insert(chain.end(), level.begin(), level.end());
+            offset += level_bytes;
+        }
+        return chain;
+    }
+}
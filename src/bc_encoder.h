@@ -0,0 +1,38 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <job_system.h>
+
+namespace veng {
+
+    enum class BcFormat {
+        // RGB at 4 bits per texel, alpha is dropped
+        kBc1,
+        // Red only at 4 bits per texel, e.g. roughness or height
+        kBc4,
+        // Red and green at 8 bits per texel, meant for normal maps
+        kBc5,
+        // RGBA at 8 bits per texel, the best quality
+        kBc7,
+    };
+
+    enum class EncodeQuality {
+        // Principal axis endpoints, indices fitted once
+        kFast,
+        // Refines the endpoints by least squares and searches the remaining endpoint bits
+        kQuality,
+    };
+
+    VkFormat GetBcVkFormat(BcFormat format, bool srgb);
+    std::optional<BcFormat> ParseBcFormat(std::string_view name);
+
+    // Encodes one RGBA8 image of any size, edge blocks repeat the last row / column. Block rows are
+    // spread over the job system's workers when one is given, which must not be inside ParallelFor already.
+    std::vector<std::uint8_t> EncodeBc(gsl::span<const std::uint8_t> rgba, glm::ivec2 size, BcFormat format,
+                                       EncodeQuality quality, JobSystem* jobs = nullptr);
+    // Every level of a chain as GenerateMipChain lays it out, into the same layout in the block format
+    std::vector<std::uint8_t> EncodeBcMipChain(gsl::span<const std::uint8_t> rgba, glm::ivec2 size,
+                                               std::uint32_t mip_count, BcFormat format, EncodeQuality quality,
+                                               JobSystem* jobs = nullptr);
+}
@@ -0,0 +1,358 @@
+#include <precomp.h>
+#include <bvh.h>
+#include <algorithm>
+#include <numeric>
+
+namespace veng {
+
+    namespace {
+
+        constexpr std::uint32_t kBinCount = 12;
+        constexpr std::uint32_t kMaxLeafObjects = 4;
+        // Leaves are only allowed to grow past kMaxLeafObjects when no split is cheaper
+        constexpr std::uint32_t kMaxSahLeafObjects = 16;
+        // Relative to testing one object
+        constexpr float kTraversalCost = 1.0f;
+
+        enum class Containment {
+            kOutside,
+            kIntersecting,
+            kInside,
+        };
+
+        float SurfaceArea(const Aabb& box) {
+            glm::vec3 size = glm::max(box.max - box.min, glm::vec3(0.0f));
+            return 2.0f * (size.x * size.y + size.y * size.z + size.z * size.x);
+        }
+
+        Aabb EmptyAabb() {
+            return {glm::vec3(std::numeric_limits<float>::max()), glm::vec3(std::numeric_limits<float>::lowest())};
+        }
+
+        void Grow(Aabb& box, const Aabb& other) {
+            box.min = glm::min(box.min, other.min);
+            box.max = glm::max(box.max, other.max);
+        }
+
+        Containment Classify(const Frustum& frustum, glm::vec3 bounds_min, glm::vec3 bounds_max) {
+            glm::vec3 center = (bounds_min + bounds_max) * 0.5f;
+            glm::vec3 extent = (bounds_max - bounds_min) * 0.5f;
+
+            Containment containment = Containment::kInside;
+            for (const glm::vec4& plane : frustum.planes) {
+                glm::vec3 normal(plane);
+                float distance = glm::dot(center, normal) + plane.w;
+                float reach = glm::dot(extent, glm::abs(normal));
+                if (distance + reach < 0.0f) {
+                    return Containment::kOutside;
+                }
+                if (distance - reach < 0.0f) {
+                    containment = Containment::kIntersecting;
+                }
+            }
+            return containment;
+        }
+
+        // Distance to where the ray enters the box, infinity when it misses it before max_distance
+        float IntersectBox(glm::vec3 bounds_min, glm::vec3 bounds_max, const Ray& ray, glm::vec3 inverse_direction,
+                           float max_distance) {
+            glm::vec3 near_hits = (bounds_min - ray.origin) * inverse_direction;
+            glm::vec3 far_hits = (bounds_max - ray.origin) * inverse_direction;
+            glm::vec3 entries = glm::min(near_hits, far_hits);
+            glm::vec3 exits = glm::max(near_hits, far_hits);
+            float entry = std::max(std::max(entries.x, entries.y), std::max(entries.z, 0.0f));
+            float exit = std::min(std::min(exits.x, exits.y), std::min(exits.z, max_distance));
+            return entry <= exit ? entry : std::numeric_limits<float>::infinity();
+        }
+    }
+
+    Ray MakePickRay(glm::vec2 pixel, glm::vec2 viewport_size, const glm::mat4& view_projection) {
+        // Nothing flips y, so the top of the viewport is at -1 like the framebuffer
+        glm::vec2 ndc = (pixel + 0.5f) / viewport_size * 2.0f - 1.0f;
+        glm::mat4 inverse = glm::inverse(view_projection);
+        glm::vec4 near_point = inverse * glm::vec4(ndc, -1.0f, 1.0f);
+        glm::vec4 far_point = inverse * glm::vec4(ndc, 1.0f, 1.0f);
+
+        glm::vec3 origin = glm::vec3(near_point) / near_point.w;
+        return {origin, glm::normalize(glm::vec3(far_point) / far_point.w - origin)};
+    }
+
+    void Bvh::Build(gsl::span<const Aabb> bounds) {
+        object_bounds_.assign(bounds.begin(), bounds.end());
+        object_indices_.resize(bounds.size());
+        std::iota(object_indices_.begin(), object_indices_.end(), 0);
+
+        nodes_.clear();
+        if (bounds.empty()) {
+            return;
+        }
+
+        std::vector<glm::vec3> centroids;
+        centroids.reserve(bounds.size());
+        for (const Aabb& box : bounds) {
+            centroids.push_back((box.min + box.max) * 0.5f);
+        }
+
+        nodes_.reserve(bounds.size() * 2 - 1);
+        BuildNode(0, bounds.size(), centroids);
+    }
+
+    std::uint32_t Bvh::BuildNode(std::uint32_t first, std::uint32_t count, const std::vector<glm::vec3>& centroids) {
+        std::uint32_t node_index = nodes_.size();
+        nodes_.emplace_back();
+
+        Aabb bounds = EmptyAabb();
+        Aabb centroid_bounds = EmptyAabb();
+        for (std::uint32_t i = first; i < first + count; i++) {
+            std::uint32_t object = object_indices_[i];
+            Grow(bounds, object_bounds_[object]);
+            Grow(centroid_bounds, {centroids[object], centroids[object]});
+        }
+        nodes_[node_index] = {bounds.min, first, bounds.max, count};
+
+        glm::vec3 centroid_extent = centroid_bounds.max - centroid_bounds.min;
+        std::uint32_t axis = 0;
+        if (centroid_extent.y > centroid_extent[axis]) {
+            axis = 1;
+        }
+        if (centroid_extent.z > centroid_extent[axis]) {
+            axis = 2;
+        }
+
+        // Objects stacked on the same centroid can't be told apart by any plane
+        if (count <= kMaxLeafObjects || centroid_extent[axis] <= 0.0f) {
+            return node_index;
+        }
+
+        float bin_scale = kBinCount / centroid_extent[axis];
+        auto get_bin = [&](std::uint32_t object) {
+            float offset = centroids[object][axis] - centroid_bounds.min[axis];
+            return std::min(static_cast<std::uint32_t>(offset * bin_scale), kBinCount - 1);
+        };
+
+        std::array<Aabb, kBinCount> bin_bounds;
+        bin_bounds.fill(EmptyAabb());
+        std::array<std::uint32_t, kBinCount> bin_counts = {};
+        for (std::uint32_t i = first; i < first + count; i++) {
+            std::uint32_t object = object_indices_[i];
+            std::uint32_t bin = get_bin(object);
+            Grow(bin_bounds[bin], object_bounds_[object]);
+            bin_counts[bin]++;
+        }
+
+        // Sweep from the right first, then evaluate every plane between two bins from the left
+        std::array<float, kBinCount - 1> right_costs;
+        Aabb right_bounds = EmptyAabb();
+        std::uint32_t right_count = 0;
+        for (std::uint32_t plane = kBinCount - 1; plane > 0; plane--) {
+            Grow(right_bounds, bin_bounds[plane]);
+            right_count += bin_counts[plane];
+            right_costs[plane - 1] = right_count > 0 ? SurfaceArea(right_bounds) * right_count : 0.0f;
+        }
+
+        float best_cost = std::numeric_limits<float>::max();
+        std::uint32_t best_plane = 0;
+        Aabb left_bounds = EmptyAabb();
+        std::uint32_t left_count = 0;
+        for (std::uint32_t plane = 0; plane < kBinCount - 1; plane++) {
+            Grow(left_bounds, bin_bounds[plane]);
+            left_count += bin_counts[plane];
+            float left_cost = left_count > 0 ? SurfaceArea(left_bounds) * left_count : 0.0f;
+            if (left_cost + right_costs[plane] < best_cost) {
+                best_cost = left_cost + right_costs[plane];
+                best_plane = plane;
+            }
+        }
+
+        float split_cost = kTraversalCost + best_cost / SurfaceArea(bounds);
+        if (split_cost >= static_cast<float>(count) && count <= kMaxSahLeafObjects) {
+            return node_index;
+        }
+
+        auto begin = object_indices_.begin() + first;
+        auto middle = std::partition(
+            begin, begin + count, [&](std::uint32_t object) { return get_bin(object) <= best_plane; });
+        std::uint32_t left_size = middle - begin;
+
+        // Every centroid fell on one side of the best plane, split by object count instead
+        if (left_size == 0 || left_size == count) {
+            left_size = count / 2;
+            std::nth_element(begin, begin + left_size, begin + count, [&](std::uint32_t left, std::uint32_t right) {
+                return centroids[left][axis] < centroids[right][axis];
+            });
+        }
+
+        BuildNode(first, left_size, centroids);
+        std::uint32_t right_child = BuildNode(first + left_size, count - left_size, centroids);
+        nodes_[node_index].first = right_child;
+        nodes_[node_index].count = 0;
+        return node_index;
+    }
+
+    void Bvh::Refit(gsl::span<const Aabb> bounds) {
+        if (bounds.size() != object_bounds_.size()) {
+            throw std::runtime_error("Refit needs the objects the BVH was built with!");
+        }
+        object_bounds_.assign(bounds.begin(), bounds.end());
+
+        // Children always come after their parent
+        for (std::uint32_t node_index = nodes_.size(); node_index-- > 0;) {
+            Node& node = nodes_[node_index];
+            Aabb node_bounds = EmptyAabb();
+            if (node.IsLeaf()) {
+                for (std::uint32_t i = node.first; i < node.first + node.count; i++) {
+                    Grow(node_bounds, object_bounds_[object_indices_[i]]);
+                }
+            } else {
+                const Node& left = nodes_[node_index + 1];
+                const Node& right = nodes_[node.first];
+                node_bounds.min = glm::min(left.bounds_min, right.bounds_min);
+                node_bounds.max = glm::max(left.bounds_max, right.bounds_max);
+            }
+            node.bounds_min = node_bounds.min;
+            node.bounds_max = node_bounds.max;
+        }
+    }
+
+    void Bvh::QueryFrustum(const Frustum& frustum, std::vector<std::uint32_t>& objects) const {
+        if (nodes_.empty()) {
+            return;
+        }
+
+        std::vector<std::uint32_t> stack = {0};
+        while (!stack.empty()) {
+            std::uint32_t node_index = stack.back();
+            const Node& node = nodes_[node_index];
+            stack.pop_back();
+
+            Containment containment = Classify(frustum, node.bounds_min, node.bounds_max);
+            if (containment == Containment::kOutside) {
+                continue;
+            }
+            if (containment == Containment::kInside) {
+                // A subtree owns one run of object_indices_, from its leftmost leaf to its rightmost
+                std::uint32_t leftmost = node_index;
+                while (!nodes_[leftmost].IsLeaf()) {
+                    leftmost++;
+                }
+                std::uint32_t rightmost = node_index;
+                while (!nodes_[rightmost].IsLeaf()) {
+                    rightmost = nodes_[rightmost].first;
+                }
+                objects.insert(objects.end(), object_indices_.begin() + nodes_[leftmost].first,
+                               object_indices_.begin() + nodes_[rightmost].first + nodes_[rightmost].count);
+                continue;
+            }
+
+            if (node.IsLeaf()) {
+                for (std::uint32_t i = node.first; i < node.first + node.count; i++) {
+                    const Aabb& box = object_bounds_[object_indices_[i]];
+                    if (Classify(frustum, box.min, box.max) != Containment::kOutside) {
+                        objects.push_back(object_indices_[i]);
+                    }
+                }
+            } else {
+                stack.push_back(node.first);
+                stack.push_back(node_index + 1);
+            }
+        }
+    }
+
+    void Bvh::QueryRay(const Ray& ray, float max_distance, std::vector<std::uint32_t>& objects) const {
+        if (nodes_.empty()) {
+            return;
+        }
+
+        glm::vec3 inverse_direction = 1.0f / ray.direction;
+        std::vector<std::uint32_t> stack = {0};
+        while (!stack.empty()) {
+            std::uint32_t node_index = stack.back();
+            const Node& node = nodes_[node_index];
+            stack.pop_back();
+
+            if (std::isinf(IntersectBox(node.bounds_min, node.bounds_max, ray, inverse_direction, max_distance))) {
+                continue;
+            }
+
+            if (node.IsLeaf()) {
+                for (std::uint32_t i = node.first; i < node.first + node.count; i++) {
+                    const Aabb& box = object_bounds_[object_indices_[i]];
+                    if (!std::isinf(IntersectBox(box.min, box.max, ray, inverse_direction, max_distance))) {
+                        objects.push_back(object_indices_[i]);
+                    }
+                }
+            } else {
+                stack.push_back(node.first);
+                stack.push_back(node_index + 1);
+            }
+        }
+    }
+
+    std::optional<RayHit> Bvh::Pick(
+        const Ray& ray, float max_distance,
+        const std::function<std::optional<float>(std::uint32_t object, const Ray& ray)>& intersect) const {
+        if (nodes_.empty()) {
+            return std::nullopt;
+        }
+
+        glm::vec3 inverse_direction = 1.0f / ray.direction;
+        std::optional<RayHit> best = std::nullopt;
+        float best_distance = max_distance;
+
+        // Nodes with the distance the ray enters them, nearer children are popped first
+        std::vector<std::pair<std::uint32_t, float>> stack;
+        float root_entry =
+            IntersectBox(nodes_[0].bounds_min, nodes_[0].bounds_max, ray, inverse_direction, max_distance);
+        if (!std::isinf(root_entry)) {
+            stack.emplace_back(0, root_entry);
+        }
+
+        while (!stack.empty()) {
+            auto [node_index, entry] = stack.back();
+            stack.pop_back();
+            if (entry > best_distance) {
+                continue;
+            }
+
+            const Node& node = nodes_[node_index];
+            if (node.IsLeaf()) {
+                for (std::uint32_t i = node.first; i < node.first + node.count; i++) {
+                    std::uint32_t object = object_indices_[i];
+                    const Aabb& box = object_bounds_[object];
+                    float box_distance = IntersectBox(box.min, box.max, ray, inverse_direction, best_distance);
+                    if (std::isinf(box_distance)) {
+                        continue;
+                    }
+
+                    std::optional<float> distance = box_distance;
+                    if (intersect != nullptr) {
+                        distance = intersect(object, ray);
+                    }
+                    if (distance.has_value() && distance.value() <= best_distance) {
+                        best_distance = distance.value();
+                        best = RayHit{object, distance.value()};
+                    }
+                }
+                continue;
+            }
+
+            std::uint32_t near_child = node_index + 1;
+            std::uint32_t far_child = node.first;
+            float near_entry = IntersectBox(nodes_[near_child].bounds_min, nodes_[near_child].bounds_max, ray,
+                                            inverse_direction, best_distance);
+            float far_entry = IntersectBox(nodes_[far_child].bounds_min, nodes_[far_child].bounds_max, ray,
+                                           inverse_direction, best_distance);
+            if (far_entry < near_entry) {
+                std::swap(near_child, far_child);
+                std::swap(near_entry, far_entry);
+            }
+            if (!std::isinf(far_entry)) {
+                stack.emplace_back(far_child, far_entry);
+            }
+            if (!std::isinf(near_entry)) {
+                stack.emplace_back(near_child, near_entry);
+            }
+        }
+        return best;
+    }
+}
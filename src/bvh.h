@@ -0,0 +1,69 @@
+#pragma once
+
+#include <limits>
+#include <vector>
+#include <frustum_culling.h>
+
+namespace veng {
+
+    struct Aabb {
+        glm::vec3 min = glm::vec3(0.0f);
+        glm::vec3 max = glm::vec3(0.0f);
+    };
+
+    struct Ray {
+        glm::vec3 origin = glm::vec3(0.0f);
+        glm::vec3 direction = glm::vec3(0.0f, 0.0f, -1.0f);
+    };
+
+    struct RayHit {
+        std::uint32_t object = UINT32_MAX;
+        // Along the ray direction, in units of its length
+        float distance = 0.0f;
+    };
+
+    // Through a pixel of the viewport, for the same -w..w clip depth as ExtractFrustum
+    Ray MakePickRay(glm::vec2 pixel, glm::vec2 viewport_size, const glm::mat4& view_projection);
+
+    // Over world space boxes that keep the index they were built with. Split with binned SAH and laid
+    // out depth first, so a left child sits right after its parent and a subtree covers one run of
+    // object indices.
+    class Bvh {
+        public:
+        void Build(gsl::span<const Aabb> bounds);
+        // For the same objects after they moved. Only the node bounds change, so queries get slower the
+        // further things drift from where they were at the last Build.
+        void Refit(gsl::span<const Aabb> bounds);
+
+        // Appends the objects that touch the frustum, subtrees fully inside are taken without tests
+        void QueryFrustum(const Frustum& frustum, std::vector<std::uint32_t>& objects) const;
+        // Appends every object whose box the ray enters before max_distance
+        void QueryRay(const Ray& ray, float max_distance, std::vector<std::uint32_t>& objects) const;
+        // Closest box along the ray, or the closest exact hit when intersect is given. intersect only
+        // runs for objects whose box is closer than the best hit so far.
+        std::optional<RayHit> Pick(
+            const Ray& ray, float max_distance = std::numeric_limits<float>::infinity(),
+            const std::function<std::optional<float>(std::uint32_t object, const Ray& ray)>& intersect = nullptr) const;
+
+        std::uint32_t GetNodeCount() const { return nodes_.size(); }
+        std::uint32_t GetObjectCount() const { return object_bounds_.size(); }
+
+        private:
+        // Two per cache line. Leaves have a count and own object_indices_[first, first + count), inner
+        // nodes have their right child at first.
+        struct alignas(32) Node {
+            glm::vec3 bounds_min;
+            std::uint32_t first;
+            glm::vec3 bounds_max;
+            std::uint32_t count;
+
+            bool IsLeaf() const { return count != 0; }
+        };
+
+        std::uint32_t BuildNode(std::uint32_t first, std::uint32_t count, const std::vector<glm::vec3>& centroids);
+
+        std::vector<Node> nodes_;
+        std::vector<std::uint32_t> object_indices_;
+        std::vector<Aabb> object_bounds_;
+    };
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <buffer_handle.h>
+#include <texture_handle.h>
+#include <resource_state.h>
+
+namespace veng {
+	// Declared in binding order, the shader puts them all in set 0
+	enum class ComputeBindingType {
+		kStorageBuffer,
+		kStorageImage,
+		kSampledImage,
+	};
+
+	struct ComputePipelineHandle {
+		VkPipeline pipeline = VK_NULL_HANDLE;
+		VkPipelineLayout layout = VK_NULL_HANDLE;
+		VkDescriptorSetLayout set_layout = VK_NULL_HANDLE;
+		std::vector<ComputeBindingType> bindings;
+		std::uint32_t push_constant_size = 0;
+	};
+
+	// What goes into one binding of a compute set
+	struct ComputeResource {
+		ComputeResource(BufferHandle handle) : buffer(handle.buffer) {}
+		ComputeResource(TextureHandle handle) : image_view(handle.image_view) {}
+		// A single mip or a transient view, layout only matters for sampled images
+		ComputeResource(VkImageView view, VkImageLayout layout) : image_view(view), image_layout(layout) {}
+
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkImageView image_view = VK_NULL_HANDLE;
+		VkImageLayout image_layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	};
+
+	// A buffer handed to the async compute queue and back, graphics_usage is how the frames before and
+	// after use it, compute_usage how the submission does
+	struct AsyncComputeBuffer {
+		BufferHandle buffer;
+		ResourceUsage graphics_usage = ResourceUsage::kComputeStorageWrite;
+		ResourceUsage compute_usage = ResourceUsage::kComputeStorageWrite;
+	};
+}
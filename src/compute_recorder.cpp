@@ -0,0 +1,50 @@
+#include <precomp.h>
+#include <compute_recorder.h>
+
+namespace veng {
+
+    void ComputeRecorder::Bind(const ComputePipelineHandle& pipeline, VkDescriptorSet set, const void* push_constants) {
+        if (pipeline.pipeline != bound_pipeline_) {
+            vkCmdBindPipeline(command_buffer_, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.pipeline);
+            bound_pipeline_ = pipeline.pipeline;
+        }
+
+        if (set != VK_NULL_HANDLE) {
+            vkCmdBindDescriptorSets(
+                command_buffer_, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.layout, 0, 1, &set, 0, nullptr);
+        }
+
+        if (pipeline.push_constant_size > 0 && push_constants != nullptr) {
+            vkCmdPushConstants(command_buffer_, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                               pipeline.push_constant_size, push_constants);
+        }
+    }
+
+    void ComputeRecorder::Dispatch(const ComputePipelineHandle& pipeline, VkDescriptorSet set, glm::uvec3 group_count,
+                                   const void* push_constants) {
+        Bind(pipeline, set, push_constants);
+        vkCmdDispatch(command_buffer_, group_count.x, group_count.y, group_count.z);
+    }
+
+    void ComputeRecorder::DispatchIndirect(const ComputePipelineHandle& pipeline, VkDescriptorSet set,
+                                           BufferHandle arguments, VkDeviceSize offset, const void* push_constants) {
+        Bind(pipeline, set, push_constants);
+        vkCmdDispatchIndirect(command_buffer_, arguments.buffer, offset);
+    }
+
+    void ComputeRecorder::BufferBarrier(BufferHandle buffer, ResourceUsage from, ResourceUsage to) {
+        RecordBufferBarrier(command_buffer_, buffer.buffer, from, to);
+    }
+
+    void ComputeRecorder::ImageBarrier(TextureHandle texture, ResourceUsage from, ResourceUsage to) {
+        // Storage images are always color
+        VkImageMemoryBarrier2 barrier = MakeImageBarrier(
+            texture.image, VK_IMAGE_ASPECT_COLOR_BIT, GetResourceState(from), GetResourceState(to));
+
+        VkDependencyInfo dependency_info = {};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.imageMemoryBarrierCount = 1;
+        dependency_info.pImageMemoryBarriers = &barrier;
+        vkCmdPipelineBarrier2(command_buffer_, &dependency_info);
+    }
+}
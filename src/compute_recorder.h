@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <compute_pipeline_handle.h>
+#include <resource_state.h>
+
+namespace veng {
+
+    // Records dispatches into either the frame's compute pass or a standalone submission.
+    // Barriers between dispatches are the caller's job, the render graph doesn't see these resources.
+    class ComputeRecorder {
+        public:
+        explicit ComputeRecorder(VkCommandBuffer command_buffer) : command_buffer_(command_buffer) {}
+
+        // push_constants must hold pipeline.push_constant_size bytes
+        void Dispatch(const ComputePipelineHandle& pipeline, VkDescriptorSet set, glm::uvec3 group_count,
+                      const void* push_constants = nullptr);
+        void DispatchIndirect(const ComputePipelineHandle& pipeline, VkDescriptorSet set, BufferHandle arguments,
+                              VkDeviceSize offset = 0, const void* push_constants = nullptr);
+
+        void BufferBarrier(BufferHandle buffer, ResourceUsage from, ResourceUsage to);
+        void ImageBarrier(TextureHandle texture, ResourceUsage from, ResourceUsage to);
+
+        VkCommandBuffer GetCommandBuffer() const { return command_buffer_; }
+
+        private:
+        void Bind(const ComputePipelineHandle& pipeline, VkDescriptorSet set, const void* push_constants);
+
+        VkCommandBuffer command_buffer_;
+        VkPipeline bound_pipeline_ = VK_NULL_HANDLE;
+    };
+}
@@ -0,0 +1,166 @@
+#include <precomp.h>
+#include <device_capabilities.h>
+
+namespace veng {
+
+    static bool HasExtension(gsl::span<VkExtensionProperties> extensions, gsl::czstring name) {
+        return std::any_of(extensions.begin(), extensions.end(),
+                           [name](const VkExtensionProperties& properties) { return streq(properties.extensionName, name); });
+    }
+
+    static std::vector<VkExtensionProperties> GetDeviceExtensions(VkPhysicalDevice device) {
+        std::uint32_t count = 0;
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &count, nullptr);
+        std::vector<VkExtensionProperties> extensions(count);
+        vkEnumerateDeviceExtensionProperties(device, nullptr, &count, extensions.data());
+        return extensions;
+    }
+
+    static void PushFeature(void* feature, void*& head) {
+        static_cast<VkBaseOutStructure*>(feature)->pNext = static_cast<VkBaseOutStructure*>(head);
+        head = feature;
+    }
+
+    DeviceCapabilities QueryDeviceCapabilities(VkPhysicalDevice device, std::uint32_t instance_api_version) {
+        DeviceCapabilities capabilities;
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(device, &properties);
+        capabilities.name = properties.deviceName;
+        capabilities.type = properties.deviceType;
+        // Device level functionality is capped by what the instance asked for
+        capabilities.api_version = std::min(properties.apiVersion, instance_api_version);
+
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        vkGetPhysicalDeviceMemoryProperties(device, &memory_properties);
+        gsl::span<VkMemoryHeap> heaps(memory_properties.memoryHeaps, memory_properties.memoryHeapCount);
+        for (const VkMemoryHeap& heap : heaps) {
+            if (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+                capabilities.device_local_bytes += heap.size;
+            }
+        }
+
+        std::uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(device, &family_count, families.data());
+
+        for (std::uint32_t i = 0; i < families.size(); i++) {
+            VkQueueFlags flags = families[i].queueFlags;
+            if ((flags & VK_QUEUE_COMPUTE_BIT) && !(flags & VK_QUEUE_GRAPHICS_BIT) &&
+                !capabilities.dedicated_compute_family.has_value()) {
+                capabilities.dedicated_compute_family = i;
+            }
+            if ((flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)) &&
+                !capabilities.dedicated_transfer_family.has_value()) {
+                capabilities.dedicated_transfer_family = i;
+            }
+        }
+
+        std::vector<VkExtensionProperties> extensions = GetDeviceExtensions(device);
+
+        // Only chain the structs the device knows about, older devices are rejected anyway
+        VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing = {};
+        descriptor_indexing.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+
+        void* chain = nullptr;
+        if (capabilities.api_version >= kRequiredApiVersion) {
+            PushFeature(&descriptor_indexing, chain);
+        }
+
+        VkPhysicalDeviceFeatures2 features = {};
+        features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features.pNext = chain;
+        vkGetPhysicalDeviceFeatures2(device, &features);
+
+        capabilities.descriptor_indexing = descriptor_indexing.runtimeDescriptorArray &&
+                                           descriptor_indexing.shaderSampledImageArrayNonUniformIndexing &&
+                                           descriptor_indexing.descriptorBindingPartiallyBound &&
+                                           descriptor_indexing.descriptorBindingVariableDescriptorCount;
+        capabilities.memory_budget = HasExtension(extensions, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        capabilities.texture_compression_bc = features.features.textureCompressionBC;
+
+        VkPhysicalDeviceSubgroupProperties subgroup = {};
+        subgroup.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties2 = {};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &subgroup;
+        vkGetPhysicalDeviceProperties2(device, &properties2);
+
+        constexpr VkSubgroupFeatureFlags kArithmetic = VK_SUBGROUP_FEATURE_BASIC_BIT | VK_SUBGROUP_FEATURE_ARITHMETIC_BIT;
+        capabilities.subgroup_arithmetic = (subgroup.supportedStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+                                           (subgroup.supportedOperations & kArithmetic) == kArithmetic;
+
+        return capabilities;
+    }
+
+    std::uint64_t ScoreDevice(const DeviceCapabilities& capabilities) {
+        // Device type dominates, then features, then VRAM as the tie breaker
+        std::uint64_t score = 0;
+        switch (capabilities.type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU:
+            score += 100000;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU:
+            score += 50000;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU:
+            score += 20000;
+            break;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU:
+            score += 10000;
+            break;
+        default:
+            break;
+        }
+
+        std::array<bool, 3> features = {capabilities.descriptor_indexing, capabilities.memory_budget,
+                                        capabilities.texture_compression_bc};
+        score += std::count(features.begin(), features.end(), true) * 2000;
+
+        if (capabilities.dedicated_compute_family.has_value()) {
+            score += 1000;
+        }
+        if (capabilities.dedicated_transfer_family.has_value()) {
+            score += 1000;
+        }
+
+        constexpr VkDeviceSize kMebibyte = 1024 * 1024;
+        score += std::min<VkDeviceSize>(capabilities.device_local_bytes / kMebibyte, 64 * 1024) / 64;
+
+        return score;
+    }
+
+    DeviceFeatureChain::DeviceFeatureChain(const DeviceCapabilities& capabilities,
+                                           std::vector<gsl::czstring>& extensions) {
+        // Core and mandatory at kRequiredApiVersion, but still off unless asked for
+        timeline_semaphore_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+        timeline_semaphore_.timelineSemaphore = VK_TRUE;
+        Push(&timeline_semaphore_);
+
+        synchronization2_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES;
+        synchronization2_.synchronization2 = VK_TRUE;
+        Push(&synchronization2_);
+
+        dynamic_rendering_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DYNAMIC_RENDERING_FEATURES;
+        dynamic_rendering_.dynamicRendering = VK_TRUE;
+        Push(&dynamic_rendering_);
+
+        if (capabilities.descriptor_indexing) {
+            descriptor_indexing_.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
+            descriptor_indexing_.runtimeDescriptorArray = VK_TRUE;
+            descriptor_indexing_.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+            descriptor_indexing_.descriptorBindingPartiallyBound = VK_TRUE;
+            descriptor_indexing_.descriptorBindingVariableDescriptorCount = VK_TRUE;
+            Push(&descriptor_indexing_);
+        }
+
+        if (capabilities.memory_budget) {
+            extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+    }
+
+    void DeviceFeatureChain::Push(void* feature) {
+        PushFeature(feature, head_);
+    }
+}
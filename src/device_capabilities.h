@@ -0,0 +1,52 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace veng {
+
+    // Timeline semaphores, synchronization2 and dynamic rendering are core from here on and nothing
+    // else is implemented, so older devices and loaders are rejected
+    constexpr std::uint32_t kRequiredApiVersion = VK_API_VERSION_1_3;
+
+    // What the picked device can do beyond the baseline, faster paths branch on these
+    struct DeviceCapabilities {
+        std::string name;
+        VkPhysicalDeviceType type = VK_PHYSICAL_DEVICE_TYPE_OTHER;
+        std::uint32_t api_version = VK_API_VERSION_1_0;
+        VkDeviceSize device_local_bytes = 0;
+
+        // Families without graphics (compute) or without graphics and compute (transfer)
+        std::optional<std::uint32_t> dedicated_compute_family = std::nullopt;
+        std::optional<std::uint32_t> dedicated_transfer_family = std::nullopt;
+
+        bool descriptor_indexing = false;
+        bool memory_budget = false;
+        // Subgroup add / exclusive add in compute shaders, core since 1.1 but the operations are optional
+        bool subgroup_arithmetic = false;
+        // BC1-BC7 sampling, the alternative on desktop is shipping everything uncompressed
+        bool texture_compression_bc = false;
+    };
+
+    DeviceCapabilities QueryDeviceCapabilities(VkPhysicalDevice device, std::uint32_t instance_api_version);
+    std::uint64_t ScoreDevice(const DeviceCapabilities& capabilities);
+
+    // Feature structs and extensions that turn on everything the capabilities report
+    class DeviceFeatureChain {
+        public:
+        DeviceFeatureChain(const DeviceCapabilities& capabilities, std::vector<gsl::czstring>& extensions);
+        DeviceFeatureChain(const DeviceFeatureChain&) = delete;
+        DeviceFeatureChain& operator=(const DeviceFeatureChain&) = delete;
+
+        void* GetHead() { return head_; }
+
+        private:
+        void Push(void* feature);
+
+        VkPhysicalDeviceTimelineSemaphoreFeatures timeline_semaphore_ = {};
+        VkPhysicalDeviceSynchronization2Features synchronization2_ = {};
+        VkPhysicalDeviceDescriptorIndexingFeatures descriptor_indexing_ = {};
+        VkPhysicalDeviceDynamicRenderingFeatures dynamic_rendering_ = {};
+        void* head_ = nullptr;
+    };
+}
@@ -0,0 +1,49 @@
+#include <precomp.h>
+#include <dynamic_resolution.h>
+
+namespace veng {
+
+    void ResolutionController::SetScaleRange(float min_scale, float max_scale) {
+        min_scale_ = std::clamp(min_scale, 0.1f, 1.0f);
+        max_scale_ = std::clamp(max_scale, min_scale_, 1.0f);
+        scale_ = std::clamp(scale_, min_scale_, max_scale_);
+    }
+
+    bool ResolutionController::AddFrameTime(double gpu_milliseconds) {
+        accumulated_ms_ += gpu_milliseconds;
+        sample_count_++;
+        if (sample_count_ < kAdjustInterval) {
+            return false;
+        }
+
+        const double average_ms = accumulated_ms_ / sample_count_;
+        accumulated_ms_ = 0.0;
+        sample_count_ = 0;
+
+        // Aim a little under the budget and leave a dead band so the scale doesn't oscillate
+        const double target_ms = budget_ms_ * 0.9;
+        if (average_ms > budget_ms_ * 0.85 && average_ms < budget_ms_ * 0.95) {
+            return false;
+        }
+
+        // Fill-rate bound work scales with pixel count, i.e. with the square of the scale
+        float desired = scale_ * static_cast<float>(std::sqrt(target_ms / std::max(average_ms, 0.01)));
+
+        // Drop quickly when over budget, climb back slowly
+        desired = std::clamp(desired, scale_ * 0.85f, scale_ * 1.05f);
+        desired = std::clamp(std::round(desired * 64.0f) / 64.0f, min_scale_, max_scale_);
+
+        if (desired == scale_) {
+            return false;
+        }
+
+        scale_ = desired;
+        return true;
+    }
+
+    void ResolutionController::Reset() {
+        scale_ = max_scale_;
+        accumulated_ms_ = 0.0;
+        sample_count_ = 0;
+    }
+}
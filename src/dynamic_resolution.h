@@ -0,0 +1,28 @@
+#pragma once
+
+namespace veng {
+
+    // Picks a render scale every few frames so the measured GPU time stays inside the budget
+    class ResolutionController {
+        public:
+        void SetFrameBudget(double milliseconds) { budget_ms_ = milliseconds; }
+        void SetScaleRange(float min_scale, float max_scale);
+
+        // Returns true when the scale changed
+        bool AddFrameTime(double gpu_milliseconds);
+        void Reset();
+
+        float GetScale() const { return scale_; }
+
+        private:
+        static constexpr std::uint32_t kAdjustInterval = 8;
+
+        double budget_ms_ = 1000.0 / 60.0;
+        float min_scale_ = 0.5f;
+        float max_scale_ = 1.0f;
+        float scale_ = 1.0f;
+
+        double accumulated_ms_ = 0.0;
+        std::uint32_t sample_count_ = 0;
+    };
+}
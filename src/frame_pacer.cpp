@@ -0,0 +1,77 @@
+#include <precomp.h>
+#include <frame_pacer.h>
+#include <thread>
+
+namespace veng {
+
+    void FramePacer::SetFrameRateLimit(std::uint32_t frames_per_second) {
+        if (frames_per_second == 0) {
+            target_frame_time_ = Clock::duration::zero();
+        } else {
+            target_frame_time_ = std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(1.0 / frames_per_second));
+        }
+        next_deadline_ = Clock::now();
+    }
+
+    void FramePacer::WaitForNextFrame() {
+        if (target_frame_time_ > Clock::duration::zero()) {
+            // Sleep is only accurate to ~1 ms on most platforms, so spin for the remainder
+            constexpr auto kSpinThreshold = std::chrono::milliseconds(1);
+
+            if (next_deadline_ - Clock::now() > kSpinThreshold) {
+                std::this_thread::sleep_until(next_deadline_ - kSpinThreshold);
+            }
+            while (Clock::now() < next_deadline_) {
+                std::this_thread::yield();
+            }
+
+            next_deadline_ += target_frame_time_;
+
+            // Don't try to catch up after a hitch, that would just burst frames
+            if (next_deadline_ < Clock::now()) {
+                next_deadline_ = Clock::now() + target_frame_time_;
+            }
+        }
+
+        const Clock::time_point now = Clock::now();
+        if (last_frame_start_.has_value()) {
+            RecordFrameTime(std::chrono::duration<double, std::milli>(now - last_frame_start_.value()).count());
+        }
+        last_frame_start_ = now;
+    }
+
+    void FramePacer::RecordFrameTime(double frame_time_ms) {
+        count_++;
+        const double delta = frame_time_ms - mean_;
+        mean_ += delta / count_;
+        sum_squared_deltas_ += delta * (frame_time_ms - mean_);
+
+        if (count_ == 1) {
+            min_ = frame_time_ms;
+            max_ = frame_time_ms;
+        } else {
+            min_ = std::min(min_, frame_time_ms);
+            max_ = std::max(max_, frame_time_ms);
+        }
+    }
+
+    void FramePacer::ResetStats() {
+        count_ = 0;
+        mean_ = 0.0;
+        sum_squared_deltas_ = 0.0;
+        min_ = 0.0;
+        max_ = 0.0;
+        last_frame_start_ = std::nullopt;
+    }
+
+    FrameTimeStats FramePacer::GetStats() const {
+        FrameTimeStats stats;
+        stats.frame_count = count_;
+        stats.mean_ms = mean_;
+        stats.variance_ms = count_ > 1 ? sum_squared_deltas_ / (count_ - 1) : 0.0;
+        stats.min_ms = min_;
+        stats.max_ms = max_;
+        return stats;
+    }
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <chrono>
+
+namespace veng {
+
+    struct FrameTimeStats {
+        std::uint64_t frame_count = 0;
+        double mean_ms = 0.0;
+        double variance_ms = 0.0;   // in ms^2
+        double min_ms = 0.0;
+        double max_ms = 0.0;
+
+        double StandardDeviation() const { return std::sqrt(variance_ms); }
+    };
+
+    class FramePacer {
+        public:
+        // 0 turns the limiter off
+        void SetFrameRateLimit(std::uint32_t frames_per_second);
+        void WaitForNextFrame();
+
+        void ResetStats();
+        FrameTimeStats GetStats() const;
+
+        private:
+        using Clock = std::chrono::steady_clock;
+
+        void RecordFrameTime(double frame_time_ms);
+
+        Clock::duration target_frame_time_ = Clock::duration::zero();
+        Clock::time_point next_deadline_;
+        std::optional<Clock::time_point> last_frame_start_ = std::nullopt;
+
+        // Welford running mean / variance
+        std::uint64_t count_ = 0;
+        double mean_ = 0.0;
+        double sum_squared_deltas_ = 0.0;
+        double min_ = 0.0;
+        double max_ = 0.0;
+    };
+}
@@ -0,0 +1,169 @@
+#include <precomp.h>
+#include <frustum_culling.h>
+#include <algorithm>
+#include <bit>
+#include <simd.h>
+
+namespace veng {
+
+    namespace {
+
+        // A multiple of every lane count
+        constexpr std::uint32_t kCullBatchSize = 16384;
+    }
+
+    Frustum ExtractFrustum(const glm::mat4& view_projection) {
+        glm::mat4 rows = glm::transpose(view_projection);
+        Frustum frustum = {{
+            rows[3] + rows[0],   // left
+            rows[3] - rows[0],   // right
+            rows[3] + rows[1],   // bottom
+            rows[3] - rows[1],   // top
+            rows[3] + rows[2],   // near
+            rows[3] - rows[2],   // far
+        }};
+
+        for (glm::vec4& plane : frustum.planes) {
+            plane /= glm::length(glm::vec3(plane));
+        }
+        return frustum;
+    }
+
+    std::uint32_t FrustumCuller::AddBox(glm::vec3 bounds_min, glm::vec3 bounds_max) {
+        for (std::uint32_t i = 0; i < 3; i++) {
+            center_[i].push_back(0.0f);
+            extent_[i].push_back(0.0f);
+        }
+        radius_.push_back(0.0f);
+
+        std::uint32_t index = radius_.size() - 1;
+        SetBox(index, bounds_min, bounds_max);
+        return index;
+    }
+
+    std::uint32_t FrustumCuller::AddSphere(glm::vec3 center, float radius) {
+        std::uint32_t index = AddBox(center, center);
+        radius_[index] = radius;
+        return index;
+    }
+
+    void FrustumCuller::SetBox(std::uint32_t index, glm::vec3 bounds_min, glm::vec3 bounds_max) {
+        for (std::uint32_t i = 0; i < 3; i++) {
+            center_[i][index] = (bounds_min[i] + bounds_max[i]) * 0.5f;
+            extent_[i][index] = (bounds_max[i] - bounds_min[i]) * 0.5f;
+        }
+        radius_[index] = 0.0f;
+    }
+
+    void FrustumCuller::SetSphere(std::uint32_t index, glm::vec3 center, float radius) {
+        SetBox(index, center, center);
+        radius_[index] = radius;
+    }
+
+    void FrustumCuller::Reserve(std::uint32_t count) {
+        for (std::uint32_t i = 0; i < 3; i++) {
+            center_[i].reserve(count);
+            extent_[i].reserve(count);
+        }
+        radius_.reserve(count);
+    }
+
+    void FrustumCuller::Clear() {
+        for (std::uint32_t i = 0; i < 3; i++) {
+            center_[i].clear();
+            extent_[i].clear();
+        }
+        radius_.clear();
+    }
+
+    void FrustumCuller::Cull(const Frustum& frustum, std::vector<std::uint32_t>& visible, JobSystem* job_system) const {
+        std::uint32_t count = GetCount();
+        visible.resize(count);
+        if (job_system == nullptr) {
+            visible.resize(CullRange(frustum, 0, count, visible.data()));
+            return;
+        }
+
+        // Every batch writes where its own objects start, then the gaps are closed in order
+        std::vector<std::uint32_t> batch_counts((count + kCullBatchSize - 1) / kCullBatchSize, 0);
+        job_system->ParallelFor(count, kCullBatchSize, [&](std::uint32_t begin, std::uint32_t end) {
+            batch_counts[begin / kCullBatchSize] = CullRange(frustum, begin, end, visible.data() + begin);
+        });
+
+        std::uint32_t visible_count = 0;
+        for (std::uint32_t batch = 0; batch < batch_counts.size(); batch++) {
+            auto source = visible.begin() + batch * kCullBatchSize;
+            std::copy(source, source + batch_counts[batch], visible.begin() + visible_count);
+            visible_count += batch_counts[batch];
+        }
+        visible.resize(visible_count);
+    }
+
+    std::uint32_t FrustumCuller::CullRange(const Frustum& frustum, std::uint32_t begin, std::uint32_t end,
+                                           std::uint32_t* output) const {
+        std::uint32_t visible_count = 0;
+        std::uint32_t index = begin;
+
+        // A volume is outside once its center is further behind any plane than it reaches along that
+        // plane's normal
+#if defined(VENG_SIMD_SSE)
+        // Plain arrays, std::array would drop the vector types' alignment attributes
+        simd::Lanes normals[6][4];
+        simd::Lanes absolute_normals[6][3];
+        for (std::uint32_t plane = 0; plane < frustum.planes.size(); plane++) {
+            for (std::uint32_t i = 0; i < 4; i++) {
+                normals[plane][i] = simd::Splat(frustum.planes[plane][i]);
+            }
+            for (std::uint32_t i = 0; i < 3; i++) {
+                absolute_normals[plane][i] = simd::Splat(std::abs(frustum.planes[plane][i]));
+            }
+        }
+
+        simd::Lanes zero = simd::Splat(0.0f);
+        for (; index + simd::kLaneCount <= end; index += simd::kLaneCount) {
+            simd::Lanes center_x = simd::Load(&center_[0][index]);
+            simd::Lanes center_y = simd::Load(&center_[1][index]);
+            simd::Lanes center_z = simd::Load(&center_[2][index]);
+            simd::Lanes extent_x = simd::Load(&extent_[0][index]);
+            simd::Lanes extent_y = simd::Load(&extent_[1][index]);
+            simd::Lanes extent_z = simd::Load(&extent_[2][index]);
+            simd::Lanes radius = simd::Load(&radius_[index]);
+
+            simd::Lanes outside = zero;
+            for (std::uint32_t plane = 0; plane < frustum.planes.size(); plane++) {
+                const simd::Lanes* normal = normals[plane];
+                const simd::Lanes* absolute_normal = absolute_normals[plane];
+                simd::Lanes distance = simd::Add(simd::Mul(center_x, normal[0]), normal[3]);
+                distance = simd::Add(distance, simd::Mul(center_y, normal[1]));
+                distance = simd::Add(distance, simd::Mul(center_z, normal[2]));
+                simd::Lanes reach = simd::Add(simd::Mul(extent_x, absolute_normal[0]), radius);
+                reach = simd::Add(reach, simd::Mul(extent_y, absolute_normal[1]));
+                reach = simd::Add(reach, simd::Mul(extent_z, absolute_normal[2]));
+                outside = simd::Or(outside, simd::Less(simd::Add(distance, reach), zero));
+            }
+
+            std::uint32_t visible_lanes = ~simd::MoveMask(outside) & ((1u << simd::kLaneCount) - 1);
+            while (visible_lanes != 0) {
+                output[visible_count++] = index + std::countr_zero(visible_lanes);
+                visible_lanes &= visible_lanes - 1;
+            }
+        }
+#endif
+
+        for (; index < end; index++) {
+            glm::vec3 center(center_[0][index], center_[1][index], center_[2][index]);
+            glm::vec3 extent(extent_[0][index], extent_[1][index], extent_[2][index]);
+
+            bool outside = false;
+            for (const glm::vec4& plane : frustum.planes) {
+                glm::vec3 normal(plane);
+                float reach = glm::dot(extent, glm::abs(normal)) + radius_[index];
+                outside |= glm::dot(center, normal) + plane.w + reach < 0.0f;
+            }
+            if (!outside) {
+                output[visible_count++] = index;
+            }
+        }
+        return visible_count;
+    }
+}
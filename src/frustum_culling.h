@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <job_system.h>
+
+namespace veng {
+
+    // Normals point inwards and are normalized, a point p is inside a plane when dot(xyz, p) + w >= 0
+    struct Frustum {
+        std::array<glm::vec4, 6> planes;
+    };
+
+    // Gribb / Hartmann, for the -w..w clip depth glm::perspective produces
+    Frustum ExtractFrustum(const glm::mat4& view_projection);
+
+    // World space volumes in one float stream per component. Every object is a box plus a radius, so
+    // spheres are boxes without extent and both go through the same test, one SIMD register of
+    // objects against each plane.
+    class FrustumCuller {
+        public:
+        std::uint32_t AddBox(glm::vec3 bounds_min, glm::vec3 bounds_max);
+        std::uint32_t AddSphere(glm::vec3 center, float radius);
+        void SetBox(std::uint32_t index, glm::vec3 bounds_min, glm::vec3 bounds_max);
+        void SetSphere(std::uint32_t index, glm::vec3 center, float radius);
+        void Reserve(std::uint32_t count);
+        void Clear();
+        std::uint32_t GetCount() const { return radius_.size(); }
+
+        // Replaces visible with the ascending indices of the objects that touch the frustum. Large
+        // counts are split across the job system's workers when there is one.
+        void Cull(const Frustum& frustum, std::vector<std::uint32_t>& visible, JobSystem* job_system = nullptr) const;
+
+        private:
+        // Writes the visible indices of [begin, end) to output and returns how many there were
+        std::uint32_t CullRange(const Frustum& frustum, std::uint32_t begin, std::uint32_t end,
+                                std::uint32_t* output) const;
+
+        std::array<std::vector<float>, 3> center_;
+        std::array<std::vector<float>, 3> extent_;
+        std::vector<float> radius_;
+    };
+}
@@ -0,0 +1,95 @@
+#include <precomp.h>
+#include <gpu_profiler.h>
+#include <spdlog/spdlog.h>
+
+namespace veng {
+
+    void GpuProfiler::Initialize(
+        VkPhysicalDevice physical_device, VkDevice device, std::uint32_t queue_family, std::uint32_t frame_count) {
+        device_ = device;
+        results_pending_.assign(frame_count, false);
+
+        VkPhysicalDeviceProperties properties;
+        vkGetPhysicalDeviceProperties(physical_device, &properties);
+
+        std::uint32_t family_count = 0;
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, nullptr);
+        std::vector<VkQueueFamilyProperties> families(family_count);
+        vkGetPhysicalDeviceQueueFamilyProperties(physical_device, &family_count, families.data());
+
+        std::uint32_t valid_bits = families[queue_family].timestampValidBits;
+        if (valid_bits == 0 || properties.limits.timestampPeriod == 0.0f) {
+            spdlog::warn("GPU timestamps are not supported, GPU frame times are unavailable");
+            return;
+        }
+
+        timestamp_period_ns_ = properties.limits.timestampPeriod;
+        timestamp_mask_ = valid_bits >= 64 ? ~0ull : (1ull << valid_bits) - 1;
+
+        VkQueryPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        pool_info.queryCount = 2 * frame_count;
+
+        if (vkCreateQueryPool(device_, &pool_info, nullptr, &query_pool_) != VK_SUCCESS) {
+            spdlog::warn("Cannot create timestamp query pool");
+            query_pool_ = VK_NULL_HANDLE;
+        }
+    }
+
+    void GpuProfiler::Destroy() {
+        if (query_pool_ != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device_, query_pool_, nullptr);
+            query_pool_ = VK_NULL_HANDLE;
+        }
+    }
+
+    void GpuProfiler::BeginFrame(VkCommandBuffer command_buffer, std::uint32_t frame_index) {
+        if (!IsSupported()) {
+            return;
+        }
+
+        vkCmdResetQueryPool(command_buffer, query_pool_, frame_index * 2, 2);
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool_, frame_index * 2);
+    }
+
+    void GpuProfiler::EndFrame(VkCommandBuffer command_buffer, std::uint32_t frame_index) {
+        if (!IsSupported()) {
+            return;
+        }
+
+        vkCmdWriteTimestamp(command_buffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool_, frame_index * 2 + 1);
+        results_pending_[frame_index] = true;
+    }
+
+    std::optional<double> GpuProfiler::CollectFrameTime(std::uint32_t frame_index) {
+        std::optional<GpuInterval> interval = CollectFrameInterval(frame_index);
+        if (!interval.has_value()) {
+            return std::nullopt;
+        }
+        return interval->Duration();
+    }
+
+    std::optional<GpuInterval> GpuProfiler::CollectFrameInterval(std::uint32_t frame_index) {
+        if (!IsSupported() || !results_pending_[frame_index]) {
+            return std::nullopt;
+        }
+
+        std::array<std::uint64_t, 2> timestamps = {};
+        VkResult result = vkGetQueryPoolResults(
+            device_, query_pool_, frame_index * 2, timestamps.size(), sizeof(timestamps), timestamps.data(),
+            sizeof(std::uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (result != VK_SUCCESS) {
+            return std::nullopt;
+        }
+
+        results_pending_[frame_index] = false;
+        std::uint64_t begin = timestamps[0] & timestamp_mask_;
+        std::uint64_t ticks = ((timestamps[1] & timestamp_mask_) - begin) & timestamp_mask_;
+
+        GpuInterval interval;
+        interval.begin_ms = begin * timestamp_period_ns_ / 1'000'000.0;
+        interval.end_ms = interval.begin_ms + ticks * timestamp_period_ns_ / 1'000'000.0;
+        return interval;
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace veng {
+
+    // Timestamps converted to milliseconds, only comparable between queues that share a time domain
+    struct GpuInterval {
+        double begin_ms = 0.0;
+        double end_ms = 0.0;
+
+        double Duration() const { return end_ms - begin_ms; }
+        double Overlap(const GpuInterval& other) const {
+            return std::max(0.0, std::min(end_ms, other.end_ms) - std::max(begin_ms, other.begin_ms));
+        }
+    };
+
+    struct AsyncComputeStats {
+        std::uint64_t submission_count = 0;
+        double busy_ms = 0.0;
+        // Compute queue time spent while a frame was executing on the graphics queue
+        double overlapped_ms = 0.0;
+
+        double OverlapRatio() const { return busy_ms > 0.0 ? overlapped_ms / busy_ms : 0.0; }
+    };
+
+    // Brackets each frame's command buffer with timestamps to measure GPU frame time
+    class GpuProfiler {
+        public:
+        void Initialize(
+            VkPhysicalDevice physical_device, VkDevice device, std::uint32_t queue_family, std::uint32_t frame_count);
+        void Destroy();
+
+        bool IsSupported() const { return query_pool_ != VK_NULL_HANDLE; }
+
+        void BeginFrame(VkCommandBuffer command_buffer, std::uint32_t frame_index);
+        void EndFrame(VkCommandBuffer command_buffer, std::uint32_t frame_index);
+
+        // Only valid once the frame that recorded the timestamps has finished executing
+        std::optional<double> CollectFrameTime(std::uint32_t frame_index);
+        std::optional<GpuInterval> CollectFrameInterval(std::uint32_t frame_index);
+
+        private:
+        VkDevice device_ = VK_NULL_HANDLE;
+        VkQueryPool query_pool_ = VK_NULL_HANDLE;
+        double timestamp_period_ns_ = 1.0;
+        std::uint64_t timestamp_mask_ = ~0ull;
+        std::vector<bool> results_pending_;
+    };
+}
@@ -0,0 +1,115 @@
+#include <precomp.h>
+#include <gpu_timeline.h>
+
+namespace veng {
+
+    void GpuTimeline::Initialize(VkDevice device, VkQueue queue) {
+        device_ = device;
+        queue_ = queue;
+
+        VkSemaphoreTypeCreateInfo type_info = {};
+        type_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        type_info.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        type_info.initialValue = 0;
+
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        semaphore_info.pNext = &type_info;
+
+        if (vkCreateSemaphore(device_, &semaphore_info, nullptr, &semaphore_) != VK_SUCCESS) {
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    void GpuTimeline::Destroy() {
+        if (semaphore_ != VK_NULL_HANDLE) {
+            vkDestroySemaphore(device_, semaphore_, nullptr);
+            semaphore_ = VK_NULL_HANDLE;
+        }
+    }
+
+    std::uint64_t GpuTimeline::Submit(const QueueSubmission& submission) {
+        std::lock_guard lock(submit_mutex_);
+        std::uint64_t signal_value = submitted_value_ + 1;
+
+        std::vector<VkSemaphoreSubmitInfo> wait_infos;
+        for (const SemaphoreWait& wait : submission.waits) {
+            VkSemaphoreSubmitInfo wait_info = {};
+            wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+            wait_info.semaphore = wait.semaphore;
+            wait_info.value = wait.value;
+            wait_info.stageMask = wait.stage;
+            wait_infos.push_back(wait_info);
+        }
+
+        std::vector<VkCommandBufferSubmitInfo> command_buffer_infos;
+        for (VkCommandBuffer command_buffer : submission.command_buffers) {
+            VkCommandBufferSubmitInfo command_buffer_info = {};
+            command_buffer_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO;
+            command_buffer_info.commandBuffer = command_buffer;
+            command_buffer_infos.push_back(command_buffer_info);
+        }
+
+        // Binary signals ignore the value, our own timeline signals once everything has finished
+        std::vector<VkSemaphoreSubmitInfo> signal_infos;
+        for (VkSemaphore semaphore : submission.binary_signals) {
+            VkSemaphoreSubmitInfo signal_info = {};
+            signal_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+            signal_info.semaphore = semaphore;
+            signal_info.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            signal_infos.push_back(signal_info);
+        }
+
+        VkSemaphoreSubmitInfo timeline_signal = {};
+        timeline_signal.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO;
+        timeline_signal.semaphore = semaphore_;
+        timeline_signal.value = signal_value;
+        timeline_signal.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+        signal_infos.push_back(timeline_signal);
+
+        VkSubmitInfo2 submit_info = {};
+        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2;
+        submit_info.waitSemaphoreInfoCount = wait_infos.size();
+        submit_info.pWaitSemaphoreInfos = wait_infos.data();
+        submit_info.commandBufferInfoCount = command_buffer_infos.size();
+        submit_info.pCommandBufferInfos = command_buffer_infos.data();
+        submit_info.signalSemaphoreInfoCount = signal_infos.size();
+        submit_info.pSignalSemaphoreInfos = signal_infos.data();
+
+        if (vkQueueSubmit2(queue_, 1, &submit_info, VK_NULL_HANDLE) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to submit to queue!");
+        }
+
+        submitted_value_ = signal_value;
+        return signal_value;
+    }
+
+    std::uint64_t GpuTimeline::GetCompletedValue() {
+        std::uint64_t completed_value = 0;
+        vkGetSemaphoreCounterValue(device_, semaphore_, &completed_value);
+        completed_value_ = completed_value;
+        return completed_value;
+    }
+
+    bool GpuTimeline::IsComplete(std::uint64_t value) {
+        // Skip the driver call when the cached value already answers it
+        return value <= completed_value_ || value <= GetCompletedValue();
+    }
+
+    void GpuTimeline::Wait(std::uint64_t value) {
+        if (value <= completed_value_) {
+            return;
+        }
+
+        VkSemaphoreWaitInfo wait_info = {};
+        wait_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+        wait_info.semaphoreCount = 1;
+        wait_info.pSemaphores = &semaphore_;
+        wait_info.pValues = &value;
+
+        if (vkWaitSemaphores(device_, &wait_info, UINT64_MAX) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to wait for timeline semaphore!");
+        }
+        completed_value_ = std::max(completed_value_.load(), value);
+    }
+}
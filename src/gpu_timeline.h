@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace veng {
+
+    // value is ignored for binary semaphores
+    struct SemaphoreWait {
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        std::uint64_t value = 0;
+        VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+    };
+
+    struct QueueSubmission {
+        std::vector<VkCommandBuffer> command_buffers;
+        std::vector<SemaphoreWait> waits;
+        std::vector<VkSemaphore> binary_signals;
+    };
+
+    // A timeline semaphore bound to one queue. Every submission signals the next value,
+    // so "is this work done" is a single integer comparison against GetCompletedValue().
+    // Submissions are serialized, so threads can share the queue through one timeline.
+    class GpuTimeline {
+        public:
+        void Initialize(VkDevice device, VkQueue queue);
+        void Destroy();
+
+        VkSemaphore GetSemaphore() const { return semaphore_; }
+        VkQueue GetQueue() const { return queue_; }
+        // For anything else that touches the queue, e.g. presenting
+        std::unique_lock<std::mutex> LockQueue() { return std::unique_lock(submit_mutex_); }
+
+        // Returns the value that will be signaled once the submission has finished
+        std::uint64_t Submit(const QueueSubmission& submission);
+
+        std::uint64_t GetSubmittedValue() const { return submitted_value_.load(); }
+        std::uint64_t GetCompletedValue();
+        bool IsComplete(std::uint64_t value);
+        void Wait(std::uint64_t value);
+        void WaitIdle() { Wait(submitted_value_); }
+
+        // A wait on this timeline for another queue's submission
+        SemaphoreWait WaitFor(std::uint64_t value, VkPipelineStageFlags2 stage) const { return {semaphore_, value, stage}; }
+
+        private:
+        VkDevice device_ = VK_NULL_HANDLE;
+        VkQueue queue_ = VK_NULL_HANDLE;
+        VkSemaphore semaphore_ = VK_NULL_HANDLE;
+        std::mutex submit_mutex_;
+        std::atomic<std::uint64_t> submitted_value_ = 0;
+        // Only a cache, a stale value costs an extra driver call
+        std::atomic<std::uint64_t> completed_value_ = 0;
+    };
+}
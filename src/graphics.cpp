@@ -2,6 +2,8 @@
 #include <graphics.h>
 #include <GLFW/glfw3.h>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <spdlog/spdlog.h>
 #include <set>
 #include <uniform_transformations.h>
@@ -42,6 +44,15 @@ VKAPI_ATTR void VKAPI_CALL vkDestroyDebugUtilsMessengerEXT(
 
 namespace veng {
 
+    struct UpscaleConstants {
+        glm::vec2 uv_scale;
+        glm::vec2 texel_size;
+        std::float_t sharpness;
+    };
+
+    constexpr std::float_t kUpscaleSharpness = 0.5f;
+    constexpr VkFormat kDepthFormat = VK_FORMAT_D32_SFLOAT;
+
     #pragma region VALIDATION_LAYERS
     static VKAPI_ATTR VkBool32 VKAPI_CALL ValidationCallback(
         VkDebugUtilsMessageSeverityFlagBitsEXT severity,
@@ -128,7 +139,12 @@ namespace veng {
     }
     
     std::vector<gsl::czstring> Graphics::GetRequiredInstanceExtensions() {
-        gsl::span<gsl::czstring> suggested_extensions = GetSuggestedInstanceExtensions();
+        // Headless rendering doesn't need any window system extensions
+        gsl::span<gsl::czstring> suggested_extensions;
+        if (!IsHeadless()) {
+            suggested_extensions = GetSuggestedInstanceExtensions();
+        }
+
         std::vector<gsl::czstring> required_extensions(suggested_extensions.size());
         std::copy(suggested_extensions.begin(), suggested_extensions.end(), required_extensions.begin());
 
@@ -181,6 +197,16 @@ namespace veng {
 
         std::vector<gsl::czstring> required_extensions = GetRequiredInstanceExtensions();
 
+        // Devices get capped to the instance version later, so nothing newer is asked for
+        std::uint32_t loader_version = VK_API_VERSION_1_0;
+        vkEnumerateInstanceVersion(&loader_version);
+        if (loader_version < kRequiredApiVersion) {
+            spdlog::error("The Vulkan loader is older than the required Vulkan {}.{}",
+                          VK_API_VERSION_MAJOR(kRequiredApiVersion), VK_API_VERSION_MINOR(kRequiredApiVersion));
+            std::exit(EXIT_FAILURE);
+        }
+        instance_api_version_ = kRequiredApiVersion;
+
         VkApplicationInfo app_info = {};
         app_info.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
         app_info.pNext = nullptr;   // no extensions (custom)
@@ -188,7 +214,7 @@ namespace veng {
         app_info.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
         app_info.pEngineName = "VEng";
         app_info.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-        app_info.apiVersion = VK_API_VERSION_1_0;
+        app_info.apiVersion = instance_api_version_;
 
         VkInstanceCreateInfo instance_creation_info = {};
         instance_creation_info.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -226,10 +252,35 @@ namespace veng {
 
         auto graphics_family_it =
             std::find_if(families.begin(), families.end(), [](const VkQueueFamilyProperties &props)
-                         { return props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_TRANSFER_BIT); });
+                         { return props.queueFlags & VK_QUEUE_GRAPHICS_BIT; });
 
         QueueFamilyIndices result;
-        result.graphics_family = graphics_family_it - families.begin();
+        if (graphics_family_it != families.end()) {
+            result.graphics_family = graphics_family_it - families.begin();
+        }
+
+        auto compute_family_it =
+            std::find_if(families.begin(), families.end(), [](const VkQueueFamilyProperties &props)
+                         { return (props.queueFlags & VK_QUEUE_COMPUTE_BIT) &&
+                                  !(props.queueFlags & VK_QUEUE_GRAPHICS_BIT); });
+
+        if (compute_family_it != families.end()) {
+            result.compute_family = compute_family_it - families.begin();
+        }
+
+        auto transfer_family_it =
+            std::find_if(families.begin(), families.end(), [](const VkQueueFamilyProperties &props)
+                         { return (props.queueFlags & VK_QUEUE_TRANSFER_BIT) &&
+                                  !(props.queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)); });
+
+        if (transfer_family_it != families.end()) {
+            result.transfer_family = transfer_family_it - families.begin();
+        }
+
+        if (IsHeadless()) {
+            result.presentation_family = result.graphics_family;
+            return result;
+        }
 
         for (std::uint32_t i = 0; i < families.size(); i++) {
             VkBool32 has_presentation_support = false;
@@ -279,7 +330,30 @@ namespace veng {
 
     bool Graphics::IsDeviceSuitable(VkPhysicalDevice device) {
         QueueFamilyIndices families = FindQueueFamilies(device);
-        return families.IsValid() && AreAllDeviceExtensionSupported(device) && GetSwapChainProperties(device).IsValid();
+        bool can_present = IsHeadless() || GetSwapChainProperties(device).IsValid();
+        // Everything the renderer needs beyond the extensions is core at the required version
+        bool has_required_version =
+            QueryDeviceCapabilities(device, instance_api_version_).api_version >= kRequiredApiVersion;
+        return families.IsValid() && AreAllDeviceExtensionSupported(device) && can_present && has_required_version;
+    }
+
+    // VENG_DEVICE=<index> or a case sensitive part of the device name
+    std::optional<VkPhysicalDevice> Graphics::FindDeviceOverride(gsl::span<VkPhysicalDevice> devices) {
+        gsl::czstring override_value = std::getenv("VENG_DEVICE");
+        if (override_value == nullptr || *override_value == '\0') {
+            return std::nullopt;
+        }
+
+        std::string_view requested(override_value);
+        for (std::uint32_t i = 0; i < devices.size(); i++) {
+            std::string name = QueryDeviceCapabilities(devices[i], instance_api_version_).name;
+            if (requested == std::to_string(i) || name.find(requested) != std::string::npos) {
+                return devices[i];
+            }
+        }
+
+        spdlog::warn("VENG_DEVICE={} matches no suitable device, picking by score", requested);
+        return std::nullopt;
     }
 
     void Graphics::PickPhysicalDevice() {
@@ -288,11 +362,35 @@ namespace veng {
         std::erase_if(devices, std::not_fn(std::bind_front(&Graphics::IsDeviceSuitable, this)));
 
         if (devices.empty()) {
-            spdlog::error("No physical devices that match the criteria");
+            spdlog::error("No physical devices that match the criteria, Vulkan {}.{} is required",
+                          VK_API_VERSION_MAJOR(kRequiredApiVersion), VK_API_VERSION_MINOR(kRequiredApiVersion));
             std::exit(EXIT_FAILURE);
         }
 
-        physical_device_ = devices[0];
+        std::optional<VkPhysicalDevice> forced_device = FindDeviceOverride(devices);
+        if (forced_device.has_value()) {
+            physical_device_ = forced_device.value();
+        } else {
+            std::uint64_t best_score = 0;
+            for (VkPhysicalDevice device : devices) {
+                DeviceCapabilities capabilities = QueryDeviceCapabilities(device, instance_api_version_);
+                std::uint64_t score = ScoreDevice(capabilities);
+                spdlog::info("Device {} scored {}", capabilities.name, score);
+
+                if (physical_device_ == VK_NULL_HANDLE || score > best_score) {
+                    physical_device_ = device;
+                    best_score = score;
+                }
+            }
+        }
+
+        capabilities_ = QueryDeviceCapabilities(physical_device_, instance_api_version_);
+        spdlog::info("Using {} (Vulkan {}.{}), descriptor indexing {}, memory budget {}, subgroup arithmetic {}, "
+                     "BC textures {}",
+                     capabilities_.name, VK_API_VERSION_MAJOR(capabilities_.api_version),
+                     VK_API_VERSION_MINOR(capabilities_.api_version), capabilities_.descriptor_indexing,
+                     capabilities_.memory_budget, capabilities_.subgroup_arithmetic,
+                     capabilities_.texture_compression_bc);
     }
 
     std::vector<VkPhysicalDevice> Graphics::GetAvailableDevices() {
@@ -319,7 +417,13 @@ namespace veng {
         std::set<std::uint32_t> unique_queue_families = {
             picked_device_families.graphics_family.value(),
             picked_device_families.presentation_family.value()};
-        
+        if (picked_device_families.compute_family.has_value()) {
+            unique_queue_families.insert(picked_device_families.compute_family.value());
+        }
+        if (picked_device_families.transfer_family.has_value()) {
+            unique_queue_families.insert(picked_device_families.transfer_family.value());
+        }
+
         std::float_t queue_priority = 1.0f;
 
         std::vector<VkDeviceQueueCreateInfo> queue_create_infos;
@@ -335,14 +439,20 @@ namespace veng {
         VkPhysicalDeviceFeatures required_features = {};
         required_features.depthBounds = true;
         required_features.depthClamp = true;
+        required_features.textureCompressionBC = capabilities_.texture_compression_bc;
+
+        // Optional features ride along in the pNext chain, with their extensions when they aren't core yet
+        std::vector<gsl::czstring> enabled_extensions = required_device_extensions_;
+        DeviceFeatureChain optional_features(capabilities_, enabled_extensions);
 
         VkDeviceCreateInfo device_info = {};
         device_info.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+        device_info.pNext = optional_features.GetHead();
         device_info.queueCreateInfoCount = queue_create_infos.size();
         device_info.pQueueCreateInfos = queue_create_infos.data();
         device_info.pEnabledFeatures = &required_features;
-        device_info.enabledExtensionCount = required_device_extensions_.size();
-        device_info.ppEnabledExtensionNames = required_device_extensions_.data();
+        device_info.enabledExtensionCount = enabled_extensions.size();
+        device_info.ppEnabledExtensionNames = enabled_extensions.data();
         device_info.enabledLayerCount = 0;  // deprecated for new Vulcan
 
         VkResult result = vkCreateDevice(physical_device_, &device_info, nullptr, &logical_device_);
@@ -352,6 +462,26 @@ namespace veng {
 
         vkGetDeviceQueue(logical_device_, picked_device_families.graphics_family.value(), 0, &graphics_queue_);
         vkGetDeviceQueue(logical_device_, picked_device_families.presentation_family.value(), 0, &present_queue_);
+        graphics_family_ = picked_device_families.graphics_family.value();
+
+        memory_tracker_.Initialize(physical_device_, capabilities_.memory_budget);
+        graphics_timeline_.Initialize(logical_device_, graphics_queue_);
+
+        if (picked_device_families.compute_family.has_value()) {
+            compute_family_ = picked_device_families.compute_family.value();
+            vkGetDeviceQueue(logical_device_, compute_family_, 0, &compute_queue_);
+            compute_timeline_.Initialize(logical_device_, compute_queue_);
+        }
+
+        if (picked_device_families.transfer_family.has_value()) {
+            transfer_family_ = picked_device_families.transfer_family.value();
+            vkGetDeviceQueue(logical_device_, transfer_family_, 0, &transfer_queue_);
+            transfer_timeline_.Initialize(logical_device_, transfer_queue_);
+            upload_queue_.Initialize(logical_device_, transfer_timeline_, transfer_family_);
+            spdlog::info("Uploads on transfer queue family {}", transfer_family_);
+        } else {
+            upload_queue_.Initialize(logical_device_, graphics_timeline_, graphics_family_);
+        }
     }
 
     #pragma endregion
@@ -392,15 +522,34 @@ namespace veng {
         return formats[0];
     }
 
-    bool IsMailboxPresentMode(const VkPresentModeKHR& mode) {
-        return mode == VK_PRESENT_MODE_MAILBOX_KHR;
+    static gsl::span<const VkPresentModeKHR> GetPreferredPresentModes(PresentPolicy policy) {
+        static constexpr std::array<VkPresentModeKHR, 3> kLowLatencyModes = {
+            VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_KHR};
+        static constexpr std::array<VkPresentModeKHR, 1> kVsyncModes = {VK_PRESENT_MODE_FIFO_KHR};
+        static constexpr std::array<VkPresentModeKHR, 4> kUncappedModes = {
+            VK_PRESENT_MODE_IMMEDIATE_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR,
+            VK_PRESENT_MODE_FIFO_KHR};
+
+        switch (policy) {
+            case PresentPolicy::kLowLatency:
+                return kLowLatencyModes;
+            case PresentPolicy::kUncapped:
+                return kUncappedModes;
+            case PresentPolicy::kVsync:
+            case PresentPolicy::kPowerSaving:
+                return kVsyncModes;
+        }
+        return kVsyncModes;
     }
 
     VkPresentModeKHR Graphics::ChooseSwapPresentMode(gsl::span<VkPresentModeKHR> present_modes) {
-        if (std::any_of(present_modes.begin(), present_modes.end(), IsMailboxPresentMode)) {
-            return VK_PRESENT_MODE_MAILBOX_KHR;
+        for (VkPresentModeKHR preferred : GetPreferredPresentModes(present_policy_)) {
+            if (std::find(present_modes.begin(), present_modes.end(), preferred) != present_modes.end()) {
+                return preferred;
+            }
         }
 
+        // FIFO is the only mode every implementation has to support
         return VK_PRESENT_MODE_FIFO_KHR;
     }
 
@@ -426,7 +575,14 @@ namespace veng {
     }
 
     std::uint32_t Graphics::ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities) {
-        std::uint32_t image_count = capabilities.minImageCount + 1;
+        // Power saving keeps the queue as short as the surface allows, everything else
+        // asks for one spare image so the CPU never blocks on acquire
+        std::uint32_t image_count = capabilities.minImageCount;
+        if (present_policy_ != PresentPolicy::kPowerSaving) {
+            image_count++;
+        }
+        image_count = std::max(image_count, 2u);
+
         if (capabilities.maxImageCount > 0 && capabilities.maxImageCount < image_count) {
             image_count = capabilities.maxImageCount;
         }
@@ -434,13 +590,49 @@ namespace veng {
         return image_count;
     }
 
-    void Graphics::CreateSwapChain() {
+    void Graphics::SetPresentPolicy(PresentPolicy policy) {
+        if (policy == present_policy_) {
+            return;
+        }
+
+        ReportFrameTimeStats();
+        present_policy_ = policy;
+        frame_pacer_.SetFrameRateLimit(policy == PresentPolicy::kPowerSaving ? 30 : 0);
+        frame_pacer_.ResetStats();
+        RecreateSwapChain();
+    }
+
+    void Graphics::ReportFrameTimeStats() {
+        FrameTimeStats stats = frame_pacer_.GetStats();
+        if (stats.frame_count == 0) {
+            return;
+        }
+
+        spdlog::info(
+            "Present policy '{}': {} frames, mean {:.3f} ms, variance {:.4f} ms^2 (stddev {:.3f} ms), min {:.3f} ms, max {:.3f} ms",
+            ToString(present_policy_), stats.frame_count, stats.mean_ms, stats.variance_ms,
+            stats.StandardDeviation(), stats.min_ms, stats.max_ms);
+    }
+
+    void Graphics::ReportAsyncComputeStats() {
+        if (async_compute_stats_.submission_count == 0 || !HasAsyncComputeQueue()) {
+            return;
+        }
+
+        spdlog::info("Async compute: {} submissions, busy {:.3f} ms, {:.3f} ms ({:.1f}%) overlapped with frames",
+                     async_compute_stats_.submission_count, async_compute_stats_.busy_ms,
+                     async_compute_stats_.overlapped_ms, async_compute_stats_.OverlapRatio() * 100.0);
+    }
+
+    void Graphics::CreateSwapChain(VkSwapchainKHR old_swap_chain) {
         SwapChainProperties properties = GetSwapChainProperties(physical_device_);
 
         surface_format_ = ChooseSwapSurfaceFormat(properties.formats);
         present_mode_ = ChooseSwapPresentMode(properties.present_modes);
         extent_ = ChooseSwapExtent(properties.capabilities);
         std::uint32_t image_count = ChooseSwapImageCount(properties.capabilities);
+        spdlog::info("Swap chain: present mode {}, {} images, policy '{}'",
+            static_cast<std::int32_t>(present_mode_), image_count, ToString(present_policy_));
 
         VkSwapchainCreateInfoKHR info = {};
         info.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
@@ -455,7 +647,7 @@ namespace veng {
         info.preTransform = properties.capabilities.currentTransform;
         info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
         info.clipped = VK_TRUE;
-        info.oldSwapchain = VK_NULL_HANDLE;
+        info.oldSwapchain = old_swap_chain;
         
         QueueFamilyIndices indices = FindQueueFamilies(physical_device_);
 
@@ -477,11 +669,14 @@ namespace veng {
             std::exit(EXIT_FAILURE);
         }
 
+        // The implementation may create more images than the minimum we asked for
+        vkGetSwapchainImagesKHR(logical_device_, swap_chain_, &image_count, nullptr);
         swap_chain_images_.resize(image_count);
         vkGetSwapchainImagesKHR(logical_device_, swap_chain_, &image_count, swap_chain_images_.data());
     }
     
-    VkImageView Graphics::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flag) {
+    VkImageView Graphics::CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flag,
+                                          std::uint32_t base_mip, std::uint32_t mip_count) {
 
         VkImageViewCreateInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
@@ -493,8 +688,8 @@ namespace veng {
         info.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
         info.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
         info.subresourceRange.aspectMask = aspect_flag;
-        info.subresourceRange.baseMipLevel = 0;
-        info.subresourceRange.levelCount = 1;
+        info.subresourceRange.baseMipLevel = base_mip;
+        info.subresourceRange.levelCount = mip_count;
         info.subresourceRange.baseArrayLayer = 0;
         info.subresourceRange.layerCount = 1;
 
@@ -520,7 +715,7 @@ namespace veng {
 
     #pragma region GRAPHICS_PIPELINE
 
-    VkShaderModule Graphics::CreateShaderModule(gsl::span<std::uint8_t> buffer) {
+    VkShaderModule Graphics::CreateShaderModule(gsl::span<const std::uint8_t> buffer) {
         if (buffer.empty()) {
             return VK_NULL_HANDLE;
         }
@@ -528,7 +723,7 @@ namespace veng {
         VkShaderModuleCreateInfo info = {};
         info.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
         info.codeSize = buffer.size();
-        info.pCode = reinterpret_cast<std::uint32_t*>(buffer.data());
+        info.pCode = reinterpret_cast<const std::uint32_t*>(buffer.data());
 
         VkShaderModule shader_module;
         VkResult result = vkCreateShaderModule(logical_device_, &info, nullptr, &shader_module);
@@ -539,16 +734,28 @@ namespace veng {
         return shader_module;
     }
 
+    VkShaderModule Graphics::LoadShaderModule(const std::filesystem::path& path) {
+        // Baked under their file name, blobs are page aligned so the SPIR-V is read in place
+        std::error_code error;
+        if (!shaders_from_disk_ || !std::filesystem::is_regular_file(path, error)) {
+            std::optional<AssetView> shader = shader_archive_.Find(path.filename().string());
+            if (shader.has_value() && shader->type == AssetType::kShader) {
+                return CreateShaderModule(shader->data);
+            }
+        }
+
+        MappedFile shader_file(path);
+        return CreateShaderModule(shader_file.GetData());
+    }
+
     void Graphics::CreateGraphicsPipeline() {
 
-        std::vector<std::uint8_t> basic_vertex_data = ReadFile("./basic.vert.spv");
-        VkShaderModule vertex_shader = CreateShaderModule(basic_vertex_data);
+        VkShaderModule vertex_shader = LoadShaderModule("./basic.vert.spv");
         gsl::final_action destroy_vertex([this, vertex_shader]() {
             vkDestroyShaderModule(logical_device_, vertex_shader, nullptr);
         });
 
-        std::vector<std::uint8_t> basic_fragment_data = ReadFile("./basic.frag.spv");
-        VkShaderModule fragment_shader = CreateShaderModule(basic_fragment_data);
+        VkShaderModule fragment_shader = LoadShaderModule("./basic.frag.spv");
         gsl::final_action destroy_fragment([this, fragment_shader]() {
             vkDestroyShaderModule(logical_device_, fragment_shader, nullptr);
         });
@@ -583,8 +790,8 @@ namespace veng {
         dynamic_state_info.dynamicStateCount = dynamic_states.size();
         dynamic_state_info.pDynamicStates = dynamic_states.data();
 
-        VkViewport viewport = GetViewport();
-        VkRect2D scissor = GetScissor();
+        VkViewport viewport = GetViewport(extent_);
+        VkRect2D scissor = GetScissor(extent_);
 
         VkPipelineViewportStateCreateInfo viewport_info = {};
         viewport_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
@@ -672,8 +879,16 @@ namespace veng {
             std::exit(EXIT_FAILURE);
         }
 
+        // Matches the attachments the scene pass writes
+        VkPipelineRenderingCreateInfo rendering_info = {};
+        rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        rendering_info.colorAttachmentCount = 1;
+        rendering_info.pColorAttachmentFormats = &surface_format_.format;
+        rendering_info.depthAttachmentFormat = kDepthFormat;
+
         VkGraphicsPipelineCreateInfo pipeline_info = {};
         pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipeline_info.pNext = &rendering_info;
         pipeline_info.stageCount = stage_infos.size();
         pipeline_info.pStages = stage_infos.data();
         pipeline_info.pVertexInputState = &vertex_input_info;
@@ -685,8 +900,7 @@ namespace veng {
         pipeline_info.pColorBlendState = &color_blending_info;
         pipeline_info.pDynamicState = &dynamic_state_info;
         pipeline_info.layout = pipeline_layout_;
-        pipeline_info.renderPass = render_pass_;
-        pipeline_info.subpass = 0;
+        pipeline_info.renderPass = VK_NULL_HANDLE;
 
         VkResult pipeline_result = vkCreateGraphicsPipelines(
             logical_device_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &pipeline_);
@@ -695,261 +909,756 @@ namespace veng {
         }
     }
 
-    VkViewport Graphics::GetViewport() {
-        VkViewport viewport = {};
-        viewport.x = 0.0f;
-        viewport.y = 0.0f;
-        viewport.width = static_cast<std::float_t>(extent_.width);
-        viewport.height = static_cast<std::float_t>(extent_.height);
-        viewport.minDepth = 0.0f;
-        viewport.maxDepth = 1.0f;
-
-        return viewport;
-    }
+    void Graphics::CreateUpscalePipeline() {
+        VkShaderModule vertex_shader = LoadShaderModule("./upscale.vert.spv");
+        gsl::final_action destroy_vertex([this, vertex_shader]() {
+            vkDestroyShaderModule(logical_device_, vertex_shader, nullptr);
+        });
 
-    VkRect2D Graphics::GetScissor() {
-        VkRect2D scissor = {};
-        scissor.offset = { 0, 0 };
-        scissor.extent = extent_;
-        return scissor;
-    }
+        VkShaderModule fragment_shader = LoadShaderModule("./upscale.frag.spv");
+        gsl::final_action destroy_fragment([this, fragment_shader]() {
+            vkDestroyShaderModule(logical_device_, fragment_shader, nullptr);
+        });
 
-    void Graphics::CreateRenderPass() {
-        VkAttachmentDescription color_attachment = {};
-        color_attachment.format = surface_format_.format;
-        color_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        color_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
-        color_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        color_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        color_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        color_attachment.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
-
-        VkAttachmentReference color_attachment_ref = {};
-        color_attachment_ref.attachment = 0;
-        color_attachment_ref.layout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL;
-
-        VkAttachmentDescription depth_attachment = {};
-        depth_attachment.format = VK_FORMAT_D32_SFLOAT;
-        depth_attachment.samples = VK_SAMPLE_COUNT_1_BIT;
-        depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
-        depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depth_attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
-        depth_attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-        depth_attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-        depth_attachment.finalLayout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-        VkAttachmentReference depth_attachment_ref = {};
-        depth_attachment_ref.attachment = 1;
-        depth_attachment_ref.layout = VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL;
-
-        VkSubpassDescription main_subpass = {};
-        main_subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
-        main_subpass.colorAttachmentCount = 1;
-        main_subpass.pColorAttachments = &color_attachment_ref;
-        main_subpass.pDepthStencilAttachment = &depth_attachment_ref;
-
-        VkSubpassDependency dependency = {};
-        dependency.srcSubpass = VK_SUBPASS_EXTERNAL;
-        dependency.dstSubpass = 0;
-        dependency.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.srcAccessMask = 0;
-        dependency.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        dependency.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-        std::array<VkAttachmentDescription, 2> attachments = { color_attachment, depth_attachment };
-
-        VkRenderPassCreateInfo render_pass_info = {};
-        render_pass_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO;
-        render_pass_info.attachmentCount = attachments.size();
-        render_pass_info.pAttachments = attachments.data();
-        render_pass_info.subpassCount = 1;
-        render_pass_info.pSubpasses = &main_subpass;
-        render_pass_info.dependencyCount = 1;
-        render_pass_info.pDependencies = &dependency;
-
-
-        VkResult result = vkCreateRenderPass(logical_device_, &render_pass_info, nullptr, &render_pass_);
-        if (result != VK_SUCCESS) {
-            std:exit(EXIT_FAILURE);
+        if (vertex_shader == VK_NULL_HANDLE || fragment_shader == VK_NULL_HANDLE) {
+            std::exit(EXIT_FAILURE);
         }
-    }
 
-    #pragma endregion
-
-    #pragma region DRAWING
-
-    void Graphics::CreateFramebuffers() {
-        swap_chain_framebuffers_.resize(swap_chain_image_views_.size());
-
-        for (std::uint32_t i = 0; i < swap_chain_image_views_.size(); i++) {
-            std::array<VkImageView, 2> attachment = { swap_chain_image_views_[i], depth_texture_.image_view };
-
-            VkFramebufferCreateInfo info = {};
-            info.sType = VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO;
-            info.renderPass = render_pass_;
-            info.attachmentCount = attachment.size();
-            info.pAttachments = attachment.data();
-            info.width = extent_.width;
-            info.height = extent_.height;
-            info.layers = 1;
-
-            VkResult result =
-                vkCreateFramebuffer(logical_device_, &info, nullptr, &swap_chain_framebuffers_[i]);
-            if (result != VK_SUCCESS) {
-                std::exit(EXIT_FAILURE);
-            }
-        }
-    }
+        VkPipelineShaderStageCreateInfo vertex_stage_info = {};
+        vertex_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertex_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertex_stage_info.module = vertex_shader;
+        vertex_stage_info.pName = "main";
 
-    void Graphics::CreateCommandPool() {
-        QueueFamilyIndices indices = FindQueueFamilies(physical_device_);
-        VkCommandPoolCreateInfo pool_info = {};
-        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-        pool_info.queueFamilyIndex = indices.graphics_family.value();
+        VkPipelineShaderStageCreateInfo fragment_stage_info = {};
+        fragment_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        fragment_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        fragment_stage_info.module = fragment_shader;
+        fragment_stage_info.pName = "main";
 
-        VkResult result = vkCreateCommandPool(logical_device_, &pool_info, nullptr, &command_pool_);
-        if (result != VK_SUCCESS) {
-            std::exit(EXIT_FAILURE);
-        }
-    }
+        std::array<VkPipelineShaderStageCreateInfo, 2> stage_infos = {
+            vertex_stage_info, fragment_stage_info
+        };
 
-    void Graphics::CreateCommandBuffer() {
-        VkCommandBufferAllocateInfo info = {};
-        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        info.commandPool = command_pool_;
-        info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        info.commandBufferCount = 1;
+        std::array<VkDynamicState, 2> dynamic_states = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR,
+        };
 
-        VkResult result = vkAllocateCommandBuffers(logical_device_, &info, &command_buffer_);
-        if (result != VK_SUCCESS) {
-            std::exit(EXIT_FAILURE);
-        }
-    }
+        VkPipelineDynamicStateCreateInfo dynamic_state_info = {};
+        dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic_state_info.dynamicStateCount = dynamic_states.size();
+        dynamic_state_info.pDynamicStates = dynamic_states.data();
 
-    void Graphics::BeginCommands() {
-        vkResetCommandBuffer(command_buffer_, 0);
-        VkCommandBufferBeginInfo begin_info = {};
-        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        VkPipelineViewportStateCreateInfo viewport_info = {};
+        viewport_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport_info.viewportCount = 1;
+        viewport_info.scissorCount = 1;
 
-        VkResult begin_state = vkBeginCommandBuffer(command_buffer_, &begin_info);
-        if (begin_state != VK_SUCCESS) {
-            throw std::runtime_error("Failed to begin command buffer!");
-        }
+        // The full screen triangle is generated from gl_VertexIndex
+        VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+        vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 
-        VkRenderPassBeginInfo render_pass_begin_info = {};
-        render_pass_begin_info.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-        render_pass_begin_info.renderPass = render_pass_;
-        render_pass_begin_info.framebuffer = swap_chain_framebuffers_[current_image_index_];
-        render_pass_begin_info.renderArea.offset = { 0,0 };
-        render_pass_begin_info.renderArea.extent = extent_;
+        VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {};
+        input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        input_assembly_info.primitiveRestartEnable = VK_FALSE;
 
-        std::array<VkClearValue, 2> clear_values;
-        clear_values[0].color = {{0.0f, 0.0f, 0.0f, 1.0f}};
-        clear_values[1].depthStencil = {1.0f, 0};
+        VkPipelineRasterizationStateCreateInfo rasterization_state_info = {};
+        rasterization_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterization_state_info.depthClampEnable = VK_FALSE;
+        rasterization_state_info.rasterizerDiscardEnable = VK_FALSE;
+        rasterization_state_info.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterization_state_info.lineWidth = 1.0f;
+        rasterization_state_info.cullMode = VK_CULL_MODE_NONE;
+        rasterization_state_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterization_state_info.depthBiasEnable = VK_FALSE;
 
-        render_pass_begin_info.clearValueCount = clear_values.size();
-        render_pass_begin_info.pClearValues = clear_values.data();
-        vkCmdBeginRenderPass(command_buffer_, &render_pass_begin_info, VK_SUBPASS_CONTENTS_INLINE);
+        VkPipelineMultisampleStateCreateInfo multisampling_info = {};
+        multisampling_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling_info.sampleShadingEnable = VK_FALSE;
+        multisampling_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
 
-        vkCmdBindPipeline(command_buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
-        VkViewport viewport = GetViewport();
-        VkRect2D scissor = GetScissor();
+        VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+        color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                                VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        color_blend_attachment.blendEnable = VK_FALSE;
 
-        vkCmdSetViewport(command_buffer_, 0, 1, &viewport);
-        vkCmdSetScissor(command_buffer_, 0, 1, &scissor);
-    }
+        VkPipelineColorBlendStateCreateInfo color_blending_info = {};
+        color_blending_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        color_blending_info.logicOpEnable = VK_FALSE;
+        color_blending_info.attachmentCount = 1;
+        color_blending_info.pAttachments = &color_blend_attachment;
 
-    void Graphics::EndCommands() {
-        vkCmdEndRenderPass(command_buffer_);
-        VkResult end_buffer_result = vkEndCommandBuffer(command_buffer_);
-        if (end_buffer_result != VK_SUCCESS) {
-            throw std::runtime_error("Failed to record command buffer!");
-        }
-    }
+        VkPushConstantRange upscale_range = {};
+        upscale_range.offset = 0;
+        upscale_range.size = sizeof(UpscaleConstants);
+        upscale_range.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 
-    void Graphics::CreateSignals() {
-        VkSemaphoreCreateInfo semaphore_info = {};
-        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        VkPipelineLayoutCreateInfo layout_info = {};
+        layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layout_info.pushConstantRangeCount = 1;
+        layout_info.pPushConstantRanges = &upscale_range;
+        layout_info.setLayoutCount = 1;
+        layout_info.pSetLayouts = &texture_set_layout_;
 
-        if (vkCreateSemaphore(logical_device_, &semaphore_info, nullptr, &image_available_signal_) !=
-            VK_SUCCESS) {
+        if (vkCreatePipelineLayout(logical_device_, &layout_info, nullptr, &upscale_pipeline_layout_) != VK_SUCCESS) {
             std::exit(EXIT_FAILURE);
         }
 
-        if (vkCreateSemaphore(logical_device_, &semaphore_info, nullptr, &render_finished_signal_) !=
-            VK_SUCCESS) {
-            std::exit(EXIT_FAILURE);
-        }
+        VkPipelineRenderingCreateInfo rendering_info = {};
+        rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        rendering_info.colorAttachmentCount = 1;
+        rendering_info.pColorAttachmentFormats = &surface_format_.format;
 
-        VkFenceCreateInfo fence_info = {};
-        fence_info.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fence_info.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        VkGraphicsPipelineCreateInfo pipeline_info = {};
+        pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipeline_info.pNext = &rendering_info;
+        pipeline_info.stageCount = stage_infos.size();
+        pipeline_info.pStages = stage_infos.data();
+        pipeline_info.pVertexInputState = &vertex_input_info;
+        pipeline_info.pInputAssemblyState = &input_assembly_info;
+        pipeline_info.pViewportState = &viewport_info;
+        pipeline_info.pRasterizationState = &rasterization_state_info;
+        pipeline_info.pMultisampleState = &multisampling_info;
+        pipeline_info.pDepthStencilState = nullptr;
+        pipeline_info.pColorBlendState = &color_blending_info;
+        pipeline_info.pDynamicState = &dynamic_state_info;
+        pipeline_info.layout = upscale_pipeline_layout_;
+        pipeline_info.renderPass = VK_NULL_HANDLE;
 
-        if (vkCreateFence(logical_device_, &fence_info, nullptr, &still_rendering_fence_) !=
+        if (vkCreateGraphicsPipelines(logical_device_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &upscale_pipeline_) !=
             VK_SUCCESS) {
             std::exit(EXIT_FAILURE);
         }
     }
 
-    bool Graphics::BeginFrame() {
-        vkWaitForFences(logical_device_, 1, &still_rendering_fence_, VK_TRUE, UINT64_MAX);
-
-        VkResult image_acquire_result = vkAcquireNextImageKHR(
-            logical_device_,
-            swap_chain_,
-            UINT64_MAX,
-            image_available_signal_,
-            VK_NULL_HANDLE,
-            &current_image_index_);
+    void Graphics::CreateParticlePipeline() {
+        VkShaderModule vertex_shader = LoadShaderModule("./particle.vert.spv");
+        gsl::final_action destroy_vertex([this, vertex_shader]() {
+            vkDestroyShaderModule(logical_device_, vertex_shader, nullptr);
+        });
 
-        if (image_acquire_result == VK_ERROR_OUT_OF_DATE_KHR) {
-            RecreateSwapChain();
-            return false;
-        }
+        VkShaderModule fragment_shader = LoadShaderModule("./particle.frag.spv");
+        gsl::final_action destroy_fragment([this, fragment_shader]() {
+            vkDestroyShaderModule(logical_device_, fragment_shader, nullptr);
+        });
 
-        if (image_acquire_result != VK_SUCCESS && image_acquire_result != VK_SUBOPTIMAL_KHR) {
-            throw std::runtime_error("Couldn't acquire render image!");
+        if (vertex_shader == VK_NULL_HANDLE || fragment_shader == VK_NULL_HANDLE) {
+            std::exit(EXIT_FAILURE);
         }
 
-        vkResetFences(logical_device_, 1, &still_rendering_fence_);
-        BeginCommands();
-        SetModelMatrix(glm::mat4(1.0f));
-        return true;
-    }
+        VkPipelineShaderStageCreateInfo vertex_stage_info = {};
+        vertex_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        vertex_stage_info.stage = VK_SHADER_STAGE_VERTEX_BIT;
+        vertex_stage_info.module = vertex_shader;
+        vertex_stage_info.pName = "main";
 
-    void Graphics::EndFrame() {
-        EndCommands();
+        VkPipelineShaderStageCreateInfo fragment_stage_info = {};
+        fragment_stage_info.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        fragment_stage_info.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+        fragment_stage_info.module = fragment_shader;
+        fragment_stage_info.pName = "main";
 
-        VkSubmitInfo submit_info = {};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        std::array<VkPipelineShaderStageCreateInfo, 2> stage_infos = {
+            vertex_stage_info, fragment_stage_info
+        };
 
-        VkPipelineStageFlags wait_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        submit_info.waitSemaphoreCount = 1;
-        submit_info.pWaitSemaphores = &image_available_signal_;
-        submit_info.pWaitDstStageMask = &wait_stage;
+        std::array<VkDynamicState, 2> dynamic_states = {
+            VK_DYNAMIC_STATE_VIEWPORT,
+            VK_DYNAMIC_STATE_SCISSOR,
+        };
 
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &command_buffer_;
+        VkPipelineDynamicStateCreateInfo dynamic_state_info = {};
+        dynamic_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+        dynamic_state_info.dynamicStateCount = dynamic_states.size();
+        dynamic_state_info.pDynamicStates = dynamic_states.data();
 
-        submit_info.signalSemaphoreCount = 1;
-        submit_info.pSignalSemaphores = &render_finished_signal_;
+        VkPipelineViewportStateCreateInfo viewport_info = {};
+        viewport_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+        viewport_info.viewportCount = 1;
+        viewport_info.scissorCount = 1;
 
-        VkResult submit_result = vkQueueSubmit(graphics_queue_, 1, &submit_info, still_rendering_fence_);
-        if (submit_result != VK_SUCCESS) {
-            throw std::runtime_error("Failed to submit draw commands!");
-        }
+        // Quad corners come from gl_VertexIndex, the particle from gl_InstanceIndex
+        VkPipelineVertexInputStateCreateInfo vertex_input_info = {};
+        vertex_input_info.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+        VkPipelineInputAssemblyStateCreateInfo input_assembly_info = {};
+        input_assembly_info.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+        input_assembly_info.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+        input_assembly_info.primitiveRestartEnable = VK_FALSE;
+
+        VkPipelineRasterizationStateCreateInfo rasterization_state_info = {};
+        rasterization_state_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+        rasterization_state_info.depthClampEnable = VK_FALSE;
+        rasterization_state_info.rasterizerDiscardEnable = VK_FALSE;
+        rasterization_state_info.polygonMode = VK_POLYGON_MODE_FILL;
+        rasterization_state_info.lineWidth = 1.0f;
+        rasterization_state_info.cullMode = VK_CULL_MODE_NONE;
+        rasterization_state_info.frontFace = VK_FRONT_FACE_CLOCKWISE;
+        rasterization_state_info.depthBiasEnable = VK_FALSE;
+
+        VkPipelineMultisampleStateCreateInfo multisampling_info = {};
+        multisampling_info.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+        multisampling_info.sampleShadingEnable = VK_FALSE;
+        multisampling_info.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+        VkPipelineColorBlendAttachmentState color_blend_attachment = {};
+        color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                                VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        color_blend_attachment.blendEnable = VK_TRUE;
+        color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
+        color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
+        color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
+        color_blend_attachment.srcAlphaBlendFactor = VK_BLEND_FACTOR_ONE;
+        color_blend_attachment.dstAlphaBlendFactor = VK_BLEND_FACTOR_ZERO;
+        color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
+
+        VkPipelineColorBlendStateCreateInfo color_blending_info = {};
+        color_blending_info.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+        color_blending_info.logicOpEnable = VK_FALSE;
+        color_blending_info.attachmentCount = 1;
+        color_blending_info.pAttachments = &color_blend_attachment;
+
+        // Tested against the scene but not written, the particles aren't sorted
+        VkPipelineDepthStencilStateCreateInfo depth_stencil_info = {};
+        depth_stencil_info.sType = VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO;
+        depth_stencil_info.depthTestEnable = VK_TRUE;
+        depth_stencil_info.depthWriteEnable = VK_FALSE;
+        depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS;
+        depth_stencil_info.depthBoundsTestEnable = VK_FALSE;
+        depth_stencil_info.stencilTestEnable = VK_FALSE;
+
+        VkPushConstantRange model_matrix_range = {};
+        model_matrix_range.offset = 0;
+        model_matrix_range.size = sizeof(glm::mat4);
+        model_matrix_range.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        std::array<VkDescriptorSetLayout, 3> set_layouts = {
+            uniform_set_layout_, texture_set_layout_, particle_set_layout_
+        };
+
+        VkPipelineLayoutCreateInfo layout_info = {};
+        layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layout_info.pushConstantRangeCount = 1;
+        layout_info.pPushConstantRanges = &model_matrix_range;
+        layout_info.setLayoutCount = set_layouts.size();
+        layout_info.pSetLayouts = set_layouts.data();
+
+        if (vkCreatePipelineLayout(logical_device_, &layout_info, nullptr, &particle_pipeline_layout_) != VK_SUCCESS) {
+            std::exit(EXIT_FAILURE);
+        }
+
+        VkPipelineRenderingCreateInfo rendering_info = {};
+        rendering_info.sType = VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO;
+        rendering_info.colorAttachmentCount = 1;
+        rendering_info.pColorAttachmentFormats = &surface_format_.format;
+        rendering_info.depthAttachmentFormat = kDepthFormat;
+
+        VkGraphicsPipelineCreateInfo pipeline_info = {};
+        pipeline_info.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
+        pipeline_info.pNext = &rendering_info;
+        pipeline_info.stageCount = stage_infos.size();
+        pipeline_info.pStages = stage_infos.data();
+        pipeline_info.pVertexInputState = &vertex_input_info;
+        pipeline_info.pInputAssemblyState = &input_assembly_info;
+        pipeline_info.pViewportState = &viewport_info;
+        pipeline_info.pRasterizationState = &rasterization_state_info;
+        pipeline_info.pMultisampleState = &multisampling_info;
+        pipeline_info.pDepthStencilState = &depth_stencil_info;
+        pipeline_info.pColorBlendState = &color_blending_info;
+        pipeline_info.pDynamicState = &dynamic_state_info;
+        pipeline_info.layout = particle_pipeline_layout_;
+        pipeline_info.renderPass = VK_NULL_HANDLE;
+
+        if (vkCreateGraphicsPipelines(logical_device_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &particle_pipeline_) !=
+            VK_SUCCESS) {
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    VkViewport Graphics::GetViewport(VkExtent2D extent) {
+        VkViewport viewport = {};
+        viewport.x = 0.0f;
+        viewport.y = 0.0f;
+        viewport.width = static_cast<std::float_t>(extent.width);
+        viewport.height = static_cast<std::float_t>(extent.height);
+        viewport.minDepth = 0.0f;
+        viewport.maxDepth = 1.0f;
+
+        return viewport;
+    }
+
+    VkRect2D Graphics::GetScissor(VkExtent2D extent) {
+        VkRect2D scissor = {};
+        scissor.offset = { 0, 0 };
+        scissor.extent = extent;
+        return scissor;
+    }
+
+    #pragma endregion
+
+    #pragma region DRAWING
+
+    void Graphics::CreateCommandPool() {
+        QueueFamilyIndices indices = FindQueueFamilies(physical_device_);
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = indices.graphics_family.value();
+
+        VkResult result = vkCreateCommandPool(logical_device_, &pool_info, nullptr, &command_pool_);
+        if (result != VK_SUCCESS) {
+            std::exit(EXIT_FAILURE);
+        }
+    }
+
+    void Graphics::CreateCommandBuffer() {
+        VkCommandBufferAllocateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        info.commandPool = command_pool_;
+        info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        info.commandBufferCount = 1;
+
+        for (Frame& frame : frames_) {
+            VkResult result = vkAllocateCommandBuffers(logical_device_, &info, &frame.command_buffer);
+            if (result != VK_SUCCESS) {
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    void Graphics::CreateRenderGraph() {
+        // Transients live in device local memory that is tracked and retired like everything else
+        RenderGraphAllocator allocator;
+        allocator.allocate = [this](const VkMemoryRequirements& requirements, std::string_view owner) {
+            return AllocateMemory(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryUsage::kInternal, owner);
+        };
+        allocator.free = [this](VkDeviceMemory memory) { FreeMemory(memory); };
+        allocator.defer_destruction = [this](std::function<void()> destroy) { DeferDestruction(std::move(destroy)); };
+
+        render_graph_.Initialize(logical_device_, std::move(allocator));
+    }
+
+    void Graphics::BeginCommands() {
+        vkResetCommandBuffer(command_buffer_, 0);
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+        VkResult begin_state = vkBeginCommandBuffer(command_buffer_, &begin_info);
+        if (begin_state != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin command buffer!");
+        }
+
+        gpu_profiler_.BeginFrame(command_buffer_, frame_index_);
+    }
+
+    void Graphics::EndCommands() {
+        // Resources coming over from async compute and the transfer queue have to be acquired
+        // before any pass touches them
+        std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+        std::vector<VkImageMemoryBarrier2> image_barriers;
+        for (const AsyncComputeBuffer& acquire : frame_acquires_) {
+            buffer_barriers.push_back(
+                MakeBufferAcquire(acquire.buffer.buffer, acquire.graphics_usage, compute_family_, graphics_family_));
+        }
+        for (const PendingUpload& upload : frame_uploads_) {
+            if (upload.buffer_acquire.has_value()) {
+                buffer_barriers.push_back(upload.buffer_acquire.value());
+            }
+            if (upload.image_acquire.has_value()) {
+                image_barriers.push_back(upload.image_acquire.value());
+            }
+        }
+        RecordBarriers(command_buffer_, buffer_barriers, image_barriers);
+
+        BuildRenderGraph();
+        render_graph_.Compile();
+        render_graph_.Execute(command_buffer_);
+        gpu_profiler_.EndFrame(command_buffer_, frame_index_);
+
+        VkResult end_buffer_result = vkEndCommandBuffer(command_buffer_);
+        if (end_buffer_result != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record command buffer!");
+        }
+    }
+
+    void Graphics::BuildRenderGraph() {
+        render_graph_.Reset();
+
+        // Allocated at full size; lower resolutions only render into the top left corner
+        RenderGraphImage scene_color = render_graph_.CreateImage("scene color", {surface_format_.format, extent_});
+        RenderGraphImage depth = render_graph_.CreateImage("depth", {kDepthFormat, extent_});
+
+        // The graph doesn't know what the compute work touches, so it always runs
+        if (!compute_records_.empty()) {
+            render_graph_.AddPass("compute", RenderGraphQueue::kCompute)
+                .SetSideEffect()
+                .SetExecute([this](VkCommandBuffer command_buffer) {
+                    ComputeRecorder recorder(command_buffer);
+                    for (const std::function<void(ComputeRecorder&)>& record : compute_records_) {
+                        record(recorder);
+                    }
+                });
+        }
+
+        if (cull_objects_.empty()) {
+            render_graph_.AddPass("scene")
+                .WriteColor(scene_color, VkClearColorValue{{0.0f, 0.0f, 0.0f, 1.0f}})
+                .WriteDepth(depth, VkClearDepthStencilValue{1.0f, 0})
+                .SetRenderArea(render_extent_)
+                .SetExecute([this](VkCommandBuffer command_buffer) { RecordScene(command_buffer); });
+        } else {
+            WriteCullInputs();
+
+            // The pyramid carries over to the next frame, so it ends up where it started
+            ResourceUsage pyramid_usage = ResourceUsage::kComputeSampledGeneral;
+            RenderGraphImage hi_z = render_graph_.ImportImage("hi-z", hi_z_.image, hi_z_.image_view,
+                                                              VK_FORMAT_R32_SFLOAT, hi_z_extent_,
+                                                              GetResourceState(pyramid_usage), pyramid_usage);
+            RenderGraphBuffer cull_draws = render_graph_.ImportBuffer(
+                "cull draws", cull_draws_.buffer, GetResourceState(ResourceUsage::kIndirectBuffer));
+
+            render_graph_.AddPass("occlusion cull", RenderGraphQueue::kCompute)
+                .Read(hi_z, ResourceUsage::kComputeSampledGeneral)
+                .Write(cull_draws, ResourceUsage::kComputeStorageWrite)
+                .SetExecute([this](VkCommandBuffer command_buffer) { RecordOcclusionCull(command_buffer, 0); });
+
+            render_graph_.AddPass("scene")
+                .WriteColor(scene_color, VkClearColorValue{{0.0f, 0.0f, 0.0f, 1.0f}})
+                .WriteDepth(depth, VkClearDepthStencilValue{1.0f, 0})
+                .Read(cull_draws, ResourceUsage::kIndirectBuffer)
+                .SetRenderArea(render_extent_)
+                .SetExecute([this](VkCommandBuffer command_buffer) { RecordScene(command_buffer); });
+
+            render_graph_.AddPass("hi-z", RenderGraphQueue::kCompute)
+                .Read(depth, ResourceUsage::kComputeSampled)
+                .Write(hi_z, ResourceUsage::kComputeStorageWrite)
+                .SetExecute([this, depth](VkCommandBuffer command_buffer) {
+                    RecordHiZBuild(command_buffer, render_graph_.GetImageView(depth));
+                });
+
+            render_graph_.AddPass("occlusion cull disoccluded", RenderGraphQueue::kCompute)
+                .Read(hi_z, ResourceUsage::kComputeSampledGeneral)
+                .Write(cull_draws, ResourceUsage::kComputeStorageWrite)
+                .SetExecute([this](VkCommandBuffer command_buffer) { RecordOcclusionCull(command_buffer, 1); });
+
+            render_graph_.AddPass("scene disoccluded")
+                .WriteColor(scene_color)
+                .WriteDepth(depth)
+                .Read(cull_draws, ResourceUsage::kIndirectBuffer)
+                .SetRenderArea(render_extent_)
+                .SetExecute([this](VkCommandBuffer command_buffer) { RecordScene(command_buffer, true); });
+        }
+
+        if (IsHeadless()) {
+            render_graph_.MarkOutput(scene_color);
+            return;
+        }
+
+        // The acquire semaphore is waited on at color attachment output, the first barrier chains off it
+        ResourceState acquired = {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE,
+                                  VK_IMAGE_LAYOUT_UNDEFINED};
+        RenderGraphImage swap_chain_image = render_graph_.ImportImage(
+            "swap chain image", swap_chain_images_[current_image_index_], swap_chain_image_views_[current_image_index_],
+            surface_format_.format, extent_, acquired, ResourceUsage::kPresent);
+
+        render_graph_.AddPass("upscale")
+            .Read(scene_color, ResourceUsage::kFragmentSampled)
+            .WriteColor(swap_chain_image, VkClearColorValue{{0.0f, 0.0f, 0.0f, 1.0f}})
+            .SetExecute([this, scene_color](VkCommandBuffer command_buffer) {
+                RecordUpscale(command_buffer, render_graph_.GetImageView(scene_color));
+            });
+    }
+
+    void Graphics::RecordScene(VkCommandBuffer command_buffer, bool second_phase) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_);
+        VkViewport viewport = GetViewport(render_extent_);
+        VkRect2D scissor = GetScissor(render_extent_);
+
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+        VkPipeline bound_pipeline = pipeline_;
+        VkDescriptorSet bound_texture_set = VK_NULL_HANDLE;
+        for (const DrawCommand& draw : draw_commands_) {
+            if (second_phase && draw.cull_index == UINT32_MAX) {
+                continue;
+            }
+
+            VkPipeline draw_pipeline = draw.particle_set != VK_NULL_HANDLE ? particle_pipeline_ : pipeline_;
+            if (draw_pipeline != bound_pipeline) {
+                vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, draw_pipeline);
+                bound_pipeline = draw_pipeline;
+            }
+
+            if (draw.texture_set != VK_NULL_HANDLE && draw.texture_set != bound_texture_set) {
+                vkCmdBindDescriptorSets(
+                    command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 1, 1, &draw.texture_set, 0,
+                    nullptr);
+                bound_texture_set = draw.texture_set;
+            }
+
+            vkCmdBindDescriptorSets(
+                command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &uniform_set_, 1,
+                &draw.uniform_offset);
+            vkCmdPushConstants(
+                command_buffer, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &draw.model);
+
+            if (draw.particle_set != VK_NULL_HANDLE) {
+                vkCmdBindDescriptorSets(
+                    command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, particle_pipeline_layout_, 2, 1, &draw.particle_set,
+                    0, nullptr);
+                vkCmdDrawIndirect(
+                    command_buffer, draw.indirect_buffer, draw.indirect_offset, 1, sizeof(VkDrawIndirectCommand));
+                continue;
+            }
+
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(command_buffer, 0, 1, &draw.vertex_buffer, &offset);
+
+            if (draw.cull_index != UINT32_MAX) {
+                std::uint32_t slot = (second_phase ? kMaxCullObjects : 0) + draw.cull_index;
+                vkCmdBindIndexBuffer(command_buffer, draw.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+                vkCmdDrawIndexedIndirect(command_buffer, cull_draws_.buffer, slot * sizeof(VkDrawIndexedIndirectCommand),
+                                         1, sizeof(VkDrawIndexedIndirectCommand));
+            } else if (draw.index_buffer != VK_NULL_HANDLE) {
+                vkCmdBindIndexBuffer(command_buffer, draw.index_buffer, 0, VK_INDEX_TYPE_UINT32);
+                vkCmdDrawIndexed(command_buffer, draw.count, 1, 0, 0, 0);
+            } else {
+                vkCmdDraw(command_buffer, draw.count, 1, 0, 0);
+            }
+        }
+    }
+
+    void Graphics::RecordUpscale(VkCommandBuffer command_buffer, VkImageView scene_color_view) {
+        vkCmdBindPipeline(command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscale_pipeline_);
+        VkViewport viewport = GetViewport(extent_);
+        VkRect2D scissor = GetScissor(extent_);
+        vkCmdSetViewport(command_buffer, 0, 1, &viewport);
+        vkCmdSetScissor(command_buffer, 0, 1, &scissor);
+
+        VkDescriptorSet scene_color_set = GetSceneColorSet(scene_color_view);
+        vkCmdBindDescriptorSets(
+            command_buffer, VK_PIPELINE_BIND_POINT_GRAPHICS, upscale_pipeline_layout_, 0, 1, &scene_color_set, 0,
+            nullptr);
+
+        UpscaleConstants constants = {};
+        constants.uv_scale = {
+            static_cast<std::float_t>(render_extent_.width) / extent_.width,
+            static_cast<std::float_t>(render_extent_.height) / extent_.height };
+        constants.texel_size = { 1.0f / extent_.width, 1.0f / extent_.height };
+        constants.sharpness = render_extent_.width < extent_.width ? kUpscaleSharpness : 0.0f;
+        vkCmdPushConstants(
+            command_buffer, upscale_pipeline_layout_, VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(UpscaleConstants),
+            &constants);
+
+        vkCmdDraw(command_buffer, 3, 1, 0, 0);
+    }
+
+    VkDescriptorSet Graphics::GetSceneColorSet(VkImageView scene_color_view) {
+        if (scene_color_view == scene_color_view_) {
+            return scene_color_set_;
+        }
+
+        // A fresh set every time, the previous one may still be bound by a frame in flight
+        if (scene_color_set_ != VK_NULL_HANDLE) {
+            VkDescriptorSet old_set = scene_color_set_;
+            DeferDestruction([this, old_set]() { vkFreeDescriptorSets(logical_device_, texture_pool_, 1, &old_set); });
+        }
+
+        VkDescriptorSetAllocateInfo set_info = {};
+        set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        set_info.descriptorPool = texture_pool_;
+        set_info.descriptorSetCount = 1;
+        set_info.pSetLayouts = &texture_set_layout_;
+
+        if (vkAllocateDescriptorSets(logical_device_, &set_info, &scene_color_set_) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate scene color descriptor set!");
+        }
+
+        VkDescriptorImageInfo image_info = {};
+        image_info.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+        image_info.imageView = scene_color_view;
+        image_info.sampler = texture_sampler_;
+
+        VkWriteDescriptorSet descriptor_write = {};
+        descriptor_write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptor_write.dstSet = scene_color_set_;
+        descriptor_write.dstBinding = 0;
+        descriptor_write.dstArrayElement = 0;
+        descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+        descriptor_write.descriptorCount = 1;
+        descriptor_write.pImageInfo = &image_info;
+
+        vkUpdateDescriptorSets(logical_device_, 1, &descriptor_write, 0, nullptr);
+
+        scene_color_view_ = scene_color_view;
+        return scene_color_set_;
+    }
+
+    void Graphics::CreateSignals() {
+        // Swap chain acquire / present only take binary semaphores
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        for (Frame& frame : frames_) {
+            if (vkCreateSemaphore(logical_device_, &semaphore_info, nullptr, &frame.image_available_signal) !=
+                VK_SUCCESS) {
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    void Graphics::CreatePresentSignals() {
+        VkSemaphoreCreateInfo semaphore_info = {};
+        semaphore_info.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        render_finished_signals_.resize(swap_chain_images_.size());
+        for (VkSemaphore& signal : render_finished_signals_) {
+            if (vkCreateSemaphore(logical_device_, &semaphore_info, nullptr, &signal) != VK_SUCCESS) {
+                std::exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    bool Graphics::BeginFrame() {
+        frame_pacer_.WaitForNextFrame();
+
+        Frame& frame = frames_[frame_index_];
+        graphics_timeline_.Wait(frame.timeline_value);
+        FlushDeferredDestruction();
+        CollectOcclusionStats();
+
+        std::optional<double> gpu_frame_time = std::nullopt;
+        std::optional<GpuInterval> frame_interval = gpu_profiler_.CollectFrameInterval(frame_index_);
+        if (frame_interval.has_value()) {
+            gpu_frame_time = frame_interval->Duration();
+            last_gpu_frame_time_ = gpu_frame_time;
+            AddFrameInterval(frame_interval.value());
+        }
+        CollectAsyncComputeTimes();
+
+        if (dynamic_resolution_enabled_ && gpu_frame_time.has_value() &&
+            resolution_controller_.AddFrameTime(gpu_frame_time.value())) {
+            UpdateRenderExtent();
+        }
+
+        if (!IsHeadless()) {
+            VkResult image_acquire_result = vkAcquireNextImageKHR(
+                logical_device_,
+                swap_chain_,
+                UINT64_MAX,
+                frame.image_available_signal,
+                VK_NULL_HANDLE,
+                &current_image_index_);
+
+            if (image_acquire_result == VK_ERROR_OUT_OF_DATE_KHR) {
+                RecreateSwapChain();
+                return false;
+            }
+
+            if (image_acquire_result != VK_SUCCESS && image_acquire_result != VK_SUBOPTIMAL_KHR) {
+                throw std::runtime_error("Couldn't acquire render image!");
+            }
+        }
+
+        command_buffer_ = frame.command_buffer;
+        frame_in_progress_ = true;
+        draw_commands_.clear();
+        texture_set_ = VK_NULL_HANDLE;
+        compute_records_.clear();
+        cull_objects_.clear();
+        next_bounds_ = std::nullopt;
+        frame_acquires_.clear();
+        frame_compute_wait_ = 0;
+        frame_compute_wait_stage_ = VK_PIPELINE_STAGE_2_NONE;
+        frame_uploads_.clear();
+
+        // The camera carries over between frames, so it starts off every frame's uniform region
+        uniform_slots_used_ = 0;
+        uniform_offset_ = WriteUniformData(&view_projection_, sizeof(UniformTransformations));
+
+        BeginCommands();
+        SetModelMatrix(glm::mat4(1.0f));
+        TakeUploads();
+        return true;
+    }
+
+    void Graphics::EndFrame() {
+        EndCommands();
+
+        Frame& frame = frames_[frame_index_];
+        VkSemaphore render_finished_signal = VK_NULL_HANDLE;
+
+        QueueSubmission submission;
+        submission.command_buffers.push_back(command_buffer_);
+
+        // Standalone compute results can feed anything from the frame's own compute pass to indirect draws
+        if (!graphics_timeline_.IsComplete(pending_transient_value_)) {
+            submission.waits.push_back(graphics_timeline_.WaitFor(
+                pending_transient_value_, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_INPUT_BIT |
+                                              VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT |
+                                              VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT |
+                                              VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT));
+        }
+
+        // Uploads handed over in this frame may still be copying
+        std::uint64_t upload_wait = 0;
+        VkPipelineStageFlags2 upload_wait_stage = VK_PIPELINE_STAGE_2_NONE;
+        for (const PendingUpload& upload : frame_uploads_) {
+            upload_wait = std::max(upload_wait, upload.value);
+            upload_wait_stage |= upload.stage;
+        }
+        if (upload_wait > 0) {
+            submission.waits.push_back(upload_queue_.GetTimeline().WaitFor(upload_wait, upload_wait_stage));
+        }
+
+        // The acquire barriers only hold back the stages that use what came back
+        if (frame_compute_wait_ > 0) {
+            VkPipelineStageFlags2 wait_stage = frame_compute_wait_stage_ != VK_PIPELINE_STAGE_2_NONE
+                                                   ? frame_compute_wait_stage_
+                                                   : VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT;
+            submission.waits.push_back(compute_timeline_.WaitFor(frame_compute_wait_, wait_stage));
+        }
+
+        // Only the upscale pass touches the swap chain image, the scene can render before it's acquired
+        if (!IsHeadless()) {
+            render_finished_signal = render_finished_signals_[current_image_index_];
+            submission.waits.push_back(
+                {frame.image_available_signal, 0, VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT});
+            submission.binary_signals.push_back(render_finished_signal);
+        }
+
+        frame.timeline_value = graphics_timeline_.Submit(submission);
+        frame.cull_candidates = cull_objects_.size();
+        frame_in_progress_ = false;
+
+        for (DeferredDestruction& destruction : deferred_destructions_) {
+            if (destruction.retire_value == kPendingFrameValue) {
+                destruction.retire_value = frame.timeline_value;
+            }
+        }
+        frame_index_ = (frame_index_ + 1) % kMaxFramesInFlight;
+
+        if (IsHeadless()) {
+            return;
+        }
 
         VkPresentInfoKHR present_info = {};
         present_info.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
         present_info.waitSemaphoreCount = 1;
-        present_info.pWaitSemaphores = &render_finished_signal_;
+        present_info.pWaitSemaphores = &render_finished_signal;
         present_info.swapchainCount = 1;
         present_info.pSwapchains = &swap_chain_;
         present_info.pImageIndices = &current_image_index_;
 
-        VkResult result = vkQueuePresentKHR(present_queue_, &present_info);
+        VkResult result = VK_SUCCESS;
+        {
+            // Loader threads submit to the graphics queue too when there is no transfer queue
+            std::unique_lock<std::mutex> queue_lock = graphics_timeline_.LockQueue();
+            result = vkQueuePresentKHR(present_queue_, &present_info);
+        }
 
         if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
             RecreateSwapChain();
@@ -960,18 +1669,104 @@ namespace veng {
     }
 
     void Graphics::RecreateSwapChain() {
+        if (IsHeadless()) {
+            return;
+        }
+
         glm::ivec2 size = window_->GetFramebufferSize();
-        if (size.x == 0 || size.y == 0) {
-            size = window_->GetFramebufferSize();
+        while (size.x == 0 || size.y == 0) {
             glfwWaitEvents();
+            size = window_->GetFramebufferSize();
         }
 
-        vkDeviceWaitIdle(logical_device_);
-        CleanupSwapChain();
+        // No device idle here: the old chain keeps presenting while the new one is built,
+        // and its resources are released once the frames that may still use them retire.
+        VkSwapchainKHR old_swap_chain = swap_chain_;
+        std::vector<VkImageView> old_image_views = std::move(swap_chain_image_views_);
+        std::vector<VkSemaphore> old_render_finished_signals = std::move(render_finished_signals_);
 
-        CreateSwapChain();
+        // Scene color and depth follow extent_, the graph reallocates them on the next compile
+        CreateSwapChain(old_swap_chain);
         CreateImageViews();
-        CreateFramebuffers();
+        CreatePresentSignals();
+        UpdateRenderExtent();
+        CreateHiZ();
+
+        DeferDestruction([this, old_swap_chain, old_image_views, old_render_finished_signals]() {
+            for (VkSemaphore signal : old_render_finished_signals) {
+                vkDestroySemaphore(logical_device_, signal, nullptr);
+            }
+
+            for (VkImageView image_view : old_image_views) {
+                vkDestroyImageView(logical_device_, image_view, nullptr);
+            }
+
+            vkDestroySwapchainKHR(logical_device_, old_swap_chain, nullptr);
+        });
+    }
+
+    void Graphics::WaitIdle() {
+        vkDeviceWaitIdle(logical_device_);
+    }
+
+    void Graphics::RecreatePipelines() {
+        graphics_timeline_.WaitIdle();
+        shaders_from_disk_ = true;
+
+        vkDestroyPipeline(logical_device_, pipeline_, nullptr);
+        vkDestroyPipelineLayout(logical_device_, pipeline_layout_, nullptr);
+        CreateGraphicsPipeline();
+
+        vkDestroyPipeline(logical_device_, particle_pipeline_, nullptr);
+        vkDestroyPipelineLayout(logical_device_, particle_pipeline_layout_, nullptr);
+        CreateParticlePipeline();
+
+        if (!IsHeadless()) {
+            vkDestroyPipeline(logical_device_, upscale_pipeline_, nullptr);
+            vkDestroyPipelineLayout(logical_device_, upscale_pipeline_layout_, nullptr);
+            CreateUpscalePipeline();
+        }
+    }
+
+    void Graphics::DeferDestruction(std::function<void()> destroy) {
+        // Anything submitted so far on any queue, and the frame currently being built, may reference it
+        DeferredDestruction destruction;
+        destruction.retire_value = frame_in_progress_ ? kPendingFrameValue : graphics_timeline_.GetSubmittedValue();
+        if (HasTransferQueue()) {
+            destruction.transfer_value = transfer_timeline_.GetSubmittedValue();
+        }
+        if (HasAsyncComputeQueue()) {
+            destruction.compute_value = compute_timeline_.GetSubmittedValue();
+        }
+        destruction.destroy = std::move(destroy);
+        deferred_destructions_.push_back(std::move(destruction));
+    }
+
+    void Graphics::DeferDestruction(std::function<void()> destroy, std::uint64_t retire_value) {
+        // Only the graphics queue ever saw it
+        DeferredDestruction destruction;
+        destruction.retire_value = retire_value;
+        destruction.destroy = std::move(destroy);
+        deferred_destructions_.push_back(std::move(destruction));
+    }
+
+    void Graphics::FlushDeferredDestruction(bool force) {
+        ReleaseFinishedStaging(force);
+
+        // Entries are roughly in timeline order, a later one that is already done just waits its turn
+        std::uint64_t completed_value = graphics_timeline_.GetCompletedValue();
+        std::uint64_t transfer_completed = HasTransferQueue() ? transfer_timeline_.GetCompletedValue() : 0;
+        std::uint64_t compute_completed = HasAsyncComputeQueue() ? compute_timeline_.GetCompletedValue() : 0;
+        while (!deferred_destructions_.empty()) {
+            const DeferredDestruction& destruction = deferred_destructions_.front();
+            if (!force && (destruction.retire_value > completed_value ||
+                           destruction.transfer_value > transfer_completed ||
+                           destruction.compute_value > compute_completed)) {
+                break;
+            }
+            destruction.destroy();
+            deferred_destructions_.pop_front();
+        }
     }
 
     void Graphics::CleanupSwapChain() {
@@ -979,10 +1774,6 @@ namespace veng {
             return;
         }
 
-        for (VkFramebuffer framebuffer : swap_chain_framebuffers_) {
-            vkDestroyFramebuffer(logical_device_, framebuffer, nullptr);
-        }
-
         for (VkImageView image_view : swap_chain_image_views_) {
             vkDestroyImageView(logical_device_, image_view, nullptr);
         }
@@ -1003,7 +1794,7 @@ namespace veng {
 
         for (std::uint32_t i = 0; i < memory_types.size(); i++) {
             bool passes_filter = type_bits_filter & (1 << i);
-            bool has_property_flags = memory_types[i].propertyFlags & required_properties;
+            bool has_property_flags = (memory_types[i].propertyFlags & required_properties) == required_properties;
 
             if (passes_filter && has_property_flags) {
                 return i;
@@ -1013,8 +1804,38 @@ namespace veng {
         throw std::runtime_error("Cannot find memory type!");
     }
 
-    BufferHandle Graphics::CreateBuffer(
-        VkDeviceSize size, VkBufferCreateFlags usage, VkMemoryPropertyFlags properties) {
+    VkDeviceMemory Graphics::AllocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                            MemoryUsage usage, std::string_view owner) {
+        std::uint32_t chosen_memory_type = FindMemoryType(requirements.memoryTypeBits, properties);
+
+        VkPhysicalDeviceMemoryProperties memory_properties;
+        vkGetPhysicalDeviceMemoryProperties(physical_device_, &memory_properties);
+        std::uint32_t heap = memory_properties.memoryTypes[chosen_memory_type].heapIndex;
+        if (requirements.size > memory_tracker_.GetAvailableBytes(heap)) {
+            spdlog::warn("Allocating {} bytes for {} exceeds the budget of heap {}", requirements.size, owner, heap);
+        }
+
+        VkMemoryAllocateInfo allocation_info = {};
+        allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        allocation_info.allocationSize = requirements.size;
+        allocation_info.memoryTypeIndex = chosen_memory_type;
+
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        if (vkAllocateMemory(logical_device_, &allocation_info, nullptr, &memory) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate device memory!");
+        }
+
+        memory_tracker_.Track(memory, requirements.size, chosen_memory_type, usage, owner);
+        return memory;
+    }
+
+    void Graphics::FreeMemory(VkDeviceMemory memory) {
+        memory_tracker_.Untrack(memory);
+        vkFreeMemory(logical_device_, memory, nullptr);
+    }
+
+    BufferHandle Graphics::CreateBuffer(VkDeviceSize size, VkBufferCreateFlags usage, VkMemoryPropertyFlags properties,
+                                        MemoryUsage memory_usage, std::string_view owner) {
 
         BufferHandle handle = {};
 
@@ -1031,120 +1852,223 @@ namespace veng {
 
         VkMemoryRequirements memory_requirements;
         vkGetBufferMemoryRequirements(logical_device_, handle.buffer, &memory_requirements);
-
-        std::uint32_t chosen_memory_type = FindMemoryType(memory_requirements.memoryTypeBits, properties);
-
-        VkMemoryAllocateInfo allocation_info = {};
-        allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocation_info.allocationSize = memory_requirements.size;
-        allocation_info.memoryTypeIndex = chosen_memory_type;
-
-        VkResult allocation_result =
-            vkAllocateMemory(logical_device_, &allocation_info, nullptr, &handle.memory);
-
-        if (allocation_result != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate buffer memory!");
-        }
+        handle.memory = AllocateMemory(memory_requirements, properties, memory_usage, owner);
 
         vkBindBufferMemory(logical_device_, handle.buffer, handle.memory, 0);
 
         return handle;
     }
 
-    BufferHandle Graphics::CreateIndexBuffer(gsl::span<std::uint32_t> indices) {
-        VkDeviceSize size = sizeof(std::uint32_t) * indices.size();
+    Graphics::StagingSlice Graphics::AllocateStaging(VkDeviceSize size, std::string_view owner) {
+        // Opportunistically reclaim staging from earlier uploads
+        ReleaseFinishedStaging();
+
+        StagingSlice slice;
+        if (staging_ring_enabled_) {
+            if (std::optional<VkDeviceSize> offset = staging_ring_.Allocate(size)) {
+                slice.buffer = staging_ring_buffer_;
+                slice.offset = offset.value();
+                slice.data = staging_ring_.GetData(slice.offset);
+                slice.from_ring = true;
+                return slice;
+            }
+        }
 
-        BufferHandle staging_handle = CreateBuffer(
+        // Too large for the ring, or it is full of uploads in flight and waiting for them would stall the caller.
+        // Unmapped when its memory is freed.
+        slice.buffer = CreateBuffer(
             size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryUsage::kStaging, owner);
+        void* location = nullptr;
+        vkMapMemory(logical_device_, slice.buffer.memory, 0, size, 0, &location);
+        slice.data = static_cast<std::uint8_t*>(location);
+        return slice;
+    }
 
-        void* data;
-        vkMapMemory(logical_device_, staging_handle.memory, 0, size, 0, &data);
-        std::memcpy(data, indices.data(), size);
-        vkUnmapMemory(logical_device_, staging_handle.memory);
+    void Graphics::AbandonStaging(const StagingSlice& staging) {
+        if (staging.from_ring) {
+            staging_ring_.Abandon(staging.offset);
+        } else {
+            DestroyBufferNow(staging.buffer);
+        }
+    }
 
-        BufferHandle gpu_handle = CreateBuffer(
-            size, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    BufferHandle Graphics::UploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+                                        ResourceUsage target, std::string_view owner) {
+        StagingSlice staging = AllocateStaging(size, owner);
+        std::memcpy(staging.data, data, size);
+        BufferHandle gpu_handle;
+        try {
+            gpu_handle = CreateBuffer(size, usage | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                                      VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryUsage::kBuffer, owner);
+        } catch (...) {
+            AbandonStaging(staging);
+            throw;
+        }
 
-        VkCommandBuffer transient_commands = BeginTransientCommandBuffer();
+        VkCommandBuffer upload_commands = upload_queue_.Begin();
 
         VkBufferCopy copy_info = {};
-        copy_info.srcOffset = 0;
+        copy_info.srcOffset = staging.offset;
         copy_info.dstOffset = 0;
         copy_info.size = size;
-        vkCmdCopyBuffer(transient_commands, staging_handle.buffer, gpu_handle.buffer, 1, &copy_info);
-
-        EndTransientCommandBuffer(transient_commands);
+        vkCmdCopyBuffer(upload_commands, staging.buffer.buffer, gpu_handle.buffer, 1, &copy_info);
 
-        DestroyBuffer(staging_handle);
+        // On the graphics queue the frame's semaphore wait is all the synchronization it needs
+        PendingUpload upload;
+        upload.stage = GetResourceState(target).stage;
+        if (HasTransferQueue()) {
+            VkBufferMemoryBarrier2 release =
+                MakeBufferRelease(gpu_handle.buffer, ResourceUsage::kTransferDst, transfer_family_, graphics_family_);
+            RecordBarriers(upload_commands, gsl::span(&release, 1));
+            upload.buffer_acquire = MakeBufferAcquire(gpu_handle.buffer, target, transfer_family_, graphics_family_);
+        }
 
+        upload.value = upload_queue_.Submit(upload_commands);
+        QueueUpload(std::move(upload), staging);
         return gpu_handle;
     }
 
-    BufferHandle Graphics::CreateVertexBuffer(gsl::span<Vertex> vertices) {
-        VkDeviceSize size = sizeof(Vertex) * vertices.size();
-        BufferHandle staging_handle = CreateBuffer(
-            size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-        
-        void* data;
-        vkMapMemory(logical_device_, staging_handle.memory, 0, size, 0, &data);
-        std::memcpy(data, vertices.data(), size);
-        vkUnmapMemory(logical_device_, staging_handle.memory);
+    void Graphics::QueueUpload(PendingUpload upload, const StagingSlice& staging) {
+        if (staging.from_ring) {
+            staging_ring_.Submit(staging.offset, upload.value);
+        }
 
-        BufferHandle gpu_handle = CreateBuffer(
-            size, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        std::lock_guard lock(upload_mutex_);
+        if (!staging.from_ring) {
+            upload_staging_.emplace_back(upload.value, staging.buffer);
+        }
+        pending_uploads_.push_back(std::move(upload));
+    }
 
-        VkCommandBuffer transient_commands = BeginTransientCommandBuffer();
+    void Graphics::TakeUploads() {
+        {
+            std::lock_guard lock(upload_mutex_);
+
+            // Streamed textures only come over once their copy is done, so frames never wait for them
+            GpuTimeline& timeline = upload_queue_.GetTimeline();
+            auto waiting = std::stable_partition(
+                pending_uploads_.begin(), pending_uploads_.end(), [&timeline](const PendingUpload& upload) {
+                    return upload.on_ready == nullptr || timeline.IsComplete(upload.value);
+                });
+            std::move(pending_uploads_.begin(), waiting, std::back_inserter(frame_uploads_));
+            pending_uploads_.erase(pending_uploads_.begin(), waiting);
+        }
+
+        for (PendingUpload& upload : frame_uploads_) {
+            if (upload.on_ready != nullptr) {
+                CreateTextureSet(upload.texture, upload.format, upload.mip_count);
+                upload.on_ready(upload.texture);
+            }
+        }
+    }
 
-        VkBufferCopy copy_info = {};
-        copy_info.srcOffset = 0;
-        copy_info.dstOffset = 0;
-        copy_info.size = size;
-        vkCmdCopyBuffer(transient_commands, staging_handle.buffer, gpu_handle.buffer, 1, &copy_info);
+    void Graphics::ReleaseFinishedStaging(bool force) {
+        staging_ring_.Release(force ? UINT64_MAX : upload_queue_.GetTimeline().GetCompletedValue());
+
+        std::vector<BufferHandle> finished;
+        {
+            std::lock_guard lock(upload_mutex_);
+            GpuTimeline& timeline = upload_queue_.GetTimeline();
+            auto first_finished = std::partition(
+                upload_staging_.begin(), upload_staging_.end(),
+                [&timeline, force](const auto& staging) { return !force && !timeline.IsComplete(staging.first); });
+            for (auto it = first_finished; it != upload_staging_.end(); it++) {
+                finished.push_back(it->second);
+            }
+            upload_staging_.erase(first_finished, upload_staging_.end());
+        }
 
-        EndTransientCommandBuffer(transient_commands);
+        for (BufferHandle staging : finished) {
+            DestroyBufferNow(staging);
+        }
+    }
 
-        DestroyBuffer(staging_handle);
-        
-        return gpu_handle;
+    BufferHandle Graphics::CreateIndexBuffer(gsl::span<const std::uint32_t> indices, std::string_view owner) {
+        return UploadBuffer(indices.data(), indices.size_bytes(), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                            ResourceUsage::kIndexBuffer, owner);
+    }
+
+    BufferHandle Graphics::CreateVertexBuffer(gsl::span<const Vertex> vertices, std::string_view owner) {
+        return UploadBuffer(vertices.data(), vertices.size_bytes(), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                            ResourceUsage::kVertexBuffer, owner);
     }
 
     void Graphics::DestroyBuffer(BufferHandle handle) {
-        vkDeviceWaitIdle(logical_device_);
+        DeferDestruction([this, handle]() { DestroyBufferNow(handle); });
+    }
+
+    void Graphics::DestroyBufferNow(BufferHandle handle) {
         vkDestroyBuffer(logical_device_, handle.buffer, nullptr);
-        vkFreeMemory(logical_device_, handle.memory, nullptr);
+        FreeMemory(handle.memory);
+    }
+
+    void Graphics::WaitForUploads() {
+        upload_queue_.GetTimeline().WaitIdle();
+        graphics_timeline_.Wait(pending_transient_value_);
+        FlushDeferredDestruction();
     }
 
     void Graphics::RenderBuffer(BufferHandle handle, std::uint32_t vertex_count) {
-        VkDeviceSize offset = 0;
-        vkCmdBindDescriptorSets(command_buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &uniform_set_, 0, nullptr);
-        vkCmdBindVertexBuffers(command_buffer_, 0, 1, &handle.buffer, &offset);
-        vkCmdDraw(command_buffer_, vertex_count, 1, 0, 0);
+        draw_commands_.push_back({handle.buffer, VK_NULL_HANDLE, vertex_count, model_matrix_, texture_set_, uniform_offset_});
     }
 
     void Graphics::RenderIndexedBuffer(
         BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count) {
-        VkDeviceSize offset = 0;
-        vkCmdBindDescriptorSets(
-            command_buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 0, 1, &uniform_set_, 0,
-            nullptr);
-        vkCmdBindVertexBuffers(command_buffer_, 0, 1, &vertex_buffer.buffer, &offset);
-        vkCmdBindIndexBuffer(command_buffer_, index_buffer.buffer, 0, VK_INDEX_TYPE_UINT32);
-        vkCmdDrawIndexed(command_buffer_, count, 1, 0, 0, 0);
+        draw_commands_.push_back(
+            {vertex_buffer.buffer, index_buffer.buffer, count, model_matrix_, texture_set_, uniform_offset_});
+
+        if (next_bounds_.has_value() && occlusion_culling_enabled_ && cull_objects_.size() < kMaxCullObjects) {
+            auto [bounds_min, bounds_max] = next_bounds_.value();
+            draw_commands_.back().cull_index = cull_objects_.size();
+            cull_objects_.push_back(
+                {model_matrix_, glm::vec4(bounds_min, 1.0f), glm::vec4(bounds_max, 1.0f), count, {}});
+        }
+        next_bounds_ = std::nullopt;
         SetModelMatrix(glm::mat4(1.0f));    // Reset model matrix
     }
 
+    void Graphics::SetBounds(glm::vec3 bounds_min, glm::vec3 bounds_max) {
+        next_bounds_ = std::make_pair(bounds_min, bounds_max);
+    }
+
+    void Graphics::RenderParticles(VkDescriptorSet particle_set, BufferHandle draw_arguments, VkDeviceSize offset) {
+        DrawCommand draw = {};
+        draw.model = model_matrix_;
+        draw.texture_set = texture_set_;
+        draw.uniform_offset = uniform_offset_;
+        draw.particle_set = particle_set;
+        draw.indirect_buffer = draw_arguments.buffer;
+        draw.indirect_offset = offset;
+        draw_commands_.push_back(draw);
+        SetModelMatrix(glm::mat4(1.0f));
+    }
+
     void Graphics::SetModelMatrix(glm::mat4 model) {
-        vkCmdPushConstants(
-            command_buffer_, pipeline_layout_, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &model);
+        model_matrix_ = model;
     }
 
     void Graphics::SetViewProjection(glm::mat4 view, glm::mat4 projection) {
-        UniformTransformations transformations(view, projection);
-        std::memcpy(uniform_buffer_location_, &transformations, sizeof(UniformTransformations));
+        view_projection_ = UniformTransformations(view, projection);
+
+        // Outside a frame the camera is picked up by the next BeginFrame
+        if (frame_in_progress_) {
+            uniform_offset_ = WriteUniformData(&view_projection_, sizeof(UniformTransformations));
+        }
+    }
+
+    std::uint32_t Graphics::WriteUniformData(const void* data, VkDeviceSize size) {
+        std::uint32_t slot_count = static_cast<std::uint32_t>((size + uniform_slot_size_ - 1) / uniform_slot_size_);
+        if (uniform_slots_used_ + slot_count > kUniformSlotsPerFrame) {
+            throw std::runtime_error("Uniform ring is out of space for this frame!");
+        }
+
+        // This frame's region was last read by the frame whose fence BeginFrame just waited on
+        VkDeviceSize offset = (frame_index_ * kUniformSlotsPerFrame + uniform_slots_used_) * uniform_slot_size_;
+        std::memcpy(uniform_buffer_location_ + offset, data, size);
+        uniform_slots_used_ += slot_count;
+
+        return static_cast<std::uint32_t>(offset);
     }
 
     VkCommandBuffer Graphics::BeginTransientCommandBuffer() {
@@ -1165,32 +2089,54 @@ namespace veng {
         return buffer;
     }
 
-    void Graphics::EndTransientCommandBuffer(VkCommandBuffer command_buffer) {
+    std::uint64_t Graphics::SubmitTransientCommandBuffer(VkCommandBuffer command_buffer) {
         vkEndCommandBuffer(command_buffer);
 
-        VkSubmitInfo  submit_info = {};
-        submit_info.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submit_info.commandBufferCount = 1;
-        submit_info.pCommandBuffers = &command_buffer;
+        QueueSubmission submission;
+        submission.command_buffers.push_back(command_buffer);
+        pending_transient_value_ = graphics_timeline_.Submit(submission);
 
-        vkQueueSubmit(graphics_queue_, 1, &submit_info, VK_NULL_HANDLE);
-        vkQueueWaitIdle(graphics_queue_);
-        vkFreeCommandBuffers(logical_device_, command_pool_, 1, &command_buffer);
+        DeferDestruction([this, command_buffer]() {
+            vkFreeCommandBuffers(logical_device_, command_pool_, 1, &command_buffer);
+        }, pending_transient_value_);
+
+        // Opportunistically reclaim staging from earlier uploads
+        FlushDeferredDestruction();
+        return pending_transient_value_;
     }
 
     void Graphics::CreateUniformBuffers() {
-        VkDeviceSize buffer_size = sizeof(UniformTransformations);
+        VkPhysicalDeviceProperties properties = {};
+        vkGetPhysicalDeviceProperties(physical_device_, &properties);
+
+        // Dynamic offsets have to be multiples of the device alignment
+        VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 1);
+        uniform_slot_size_ = (sizeof(UniformTransformations) + alignment - 1) / alignment * alignment;
+
+        VkDeviceSize buffer_size = uniform_slot_size_ * kUniformSlotsPerFrame * kMaxFramesInFlight;
         uniform_buffer_ = CreateBuffer(buffer_size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryUsage::kInternal,
+            "uniform ring");
 
-        vkMapMemory(
-            logical_device_, uniform_buffer_.memory, 0, buffer_size, 0, &uniform_buffer_location_);
+        void* location = nullptr;
+        vkMapMemory(logical_device_, uniform_buffer_.memory, 0, buffer_size, 0, &location);
+        uniform_buffer_location_ = static_cast<std::uint8_t*>(location);
+    }
+
+    void Graphics::CreateStagingRing() {
+        staging_ring_buffer_ = CreateBuffer(kStagingRingSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, MemoryUsage::kStaging,
+            "staging ring");
+
+        void* location = nullptr;
+        vkMapMemory(logical_device_, staging_ring_buffer_.memory, 0, kStagingRingSize, 0, &location);
+        staging_ring_.Initialize(static_cast<std::uint8_t*>(location), kStagingRingSize);
     }
 
     void Graphics::CreateDescriptorSetLayouts() {
         VkDescriptorSetLayoutBinding uniform_layout_binding = {};
         uniform_layout_binding.binding = 0;
-        uniform_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniform_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uniform_layout_binding.descriptorCount = 1;
         uniform_layout_binding.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS;
 
@@ -1217,11 +2163,27 @@ namespace veng {
         if (vkCreateDescriptorSetLayout(logical_device_, &texture_layout_info, nullptr, &texture_set_layout_) != VK_SUCCESS) {
             std::exit(EXIT_FAILURE);
         }
+
+        VkDescriptorSetLayoutBinding particle_layout_binding = {};
+        particle_layout_binding.binding = 0;
+        particle_layout_binding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        particle_layout_binding.descriptorCount = 1;
+        particle_layout_binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+        VkDescriptorSetLayoutCreateInfo particle_layout_info = {};
+        particle_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        particle_layout_info.bindingCount = 1;
+        particle_layout_info.pBindings = &particle_layout_binding;
+
+        if (vkCreateDescriptorSetLayout(logical_device_, &particle_layout_info, nullptr, &particle_set_layout_) !=
+            VK_SUCCESS) {
+            std::exit(EXIT_FAILURE);
+        }
     }
 
     void Graphics::CreateDescriptorPools() {
         VkDescriptorPoolSize uniform_pool_size = {};
-        uniform_pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        uniform_pool_size.type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         uniform_pool_size.descriptorCount = 1;
 
         VkDescriptorPoolCreateInfo uniform_pool_info = {};
@@ -1252,6 +2214,23 @@ namespace veng {
         if (vkCreateDescriptorPool(logical_device_, &texture_pool_info, nullptr, &texture_pool_) != VK_SUCCESS) {
             std::exit(EXIT_FAILURE);
         }
+
+        std::array<VkDescriptorPoolSize, 3> compute_pool_sizes = {{
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 256},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 64},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 64},
+        }};
+
+        VkDescriptorPoolCreateInfo compute_pool_info = {};
+        compute_pool_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        compute_pool_info.poolSizeCount = compute_pool_sizes.size();
+        compute_pool_info.pPoolSizes = compute_pool_sizes.data();
+        compute_pool_info.maxSets = 128;
+        compute_pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+
+        if (vkCreateDescriptorPool(logical_device_, &compute_pool_info, nullptr, &compute_pool_) != VK_SUCCESS) {
+            std::exit(EXIT_FAILURE);
+        }
     }
 
     void Graphics::CreateDescriptorSets() {
@@ -1276,7 +2255,7 @@ namespace veng {
         descriptor_write.dstSet = uniform_set_;
         descriptor_write.dstBinding = 0;
         descriptor_write.dstArrayElement = 0;
-        descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+        descriptor_write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
         descriptor_write.descriptorCount = 1;
         descriptor_write.pBufferInfo = &buffer_info;
 
@@ -1303,7 +2282,7 @@ namespace veng {
         sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
         sampler_info.mipLodBias = 0.0f;
         sampler_info.minLod = 0.0f;
-        sampler_info.maxLod = 0.0f;
+        sampler_info.maxLod = VK_LOD_CLAMP_NONE;
         sampler_info.maxAnisotropy = 1.0f;
 
         if (vkCreateSampler(logical_device_, &sampler_info, nullptr, &texture_sampler_) != VK_SUCCESS) {
@@ -1313,33 +2292,186 @@ namespace veng {
 
 
     TextureHandle Graphics::CreateTexture(gsl::czstring path) {
+        MappedFile image_file(path);
+        return CreateTexture(image_file.GetData(), path);
+    }
+
+    TextureHandle Graphics::CreateTexture(gsl::span<const std::uint8_t> image_file_data, std::string_view owner) {
+        // KTX2 and DDS already hold the GPU format and every mip, those go straight into staging
+        if (std::optional<TextureFileView> texture_file = ParseTextureFile(image_file_data)) {
+            if (!IsTextureFormatSupported(texture_file->format)) {
+                throw std::runtime_error("Texture format is not supported by the device!");
+            }
+            glm::ivec2 image_extents(texture_file->width, texture_file->height);
+            TextureHandle handle =
+                UploadTextureLevels(texture_file->levels, image_extents, texture_file->format, owner);
+            CreateTextureSet(handle, texture_file->format, texture_file->levels.size());
+            return handle;
+        }
+
+        TextureHandle handle = DecodeTexture(image_file_data, owner);
+        CreateTextureSet(handle);
+        return handle;
+    }
+
+    TextureHandle Graphics::CreateTexture(const AssetArchive& archive, std::string_view name) {
+        std::optional<AssetView> asset = archive.Find(name);
+        if (!asset.has_value() || asset->type != AssetType::kTexture) {
+            throw std::runtime_error("Texture is missing from the asset archive!");
+        }
+        if (GetTextureLevelSize(asset->format, 1, 1) == 0 || !IsTextureFormatSupported(asset->format)) {
+            throw std::runtime_error("Archived texture has an unsupported format!");
+        }
+
+        glm::ivec2 image_extents(asset->width, asset->height);
+        TextureHandle handle = UploadTexture(asset->data, image_extents, name, nullptr, asset->format, asset->mip_count);
+        CreateTextureSet(handle, asset->format, asset->mip_count);
+        return handle;
+    }
+
+    void Graphics::StreamTexture(gsl::czstring path, std::function<void(TextureHandle)> on_ready) {
+        MappedFile image_file(path);
+        StreamTexture(image_file.GetData(), path, std::move(on_ready));
+    }
+
+    void Graphics::StreamTexture(gsl::span<const std::uint8_t> encoded, std::string_view owner,
+                                 std::function<void(TextureHandle)> on_ready) {
+        DecodeTexture(encoded, owner, std::move(on_ready));
+    }
+
+    void Graphics::StreamTexture(gsl::span<const std::uint8_t> rgba, glm::ivec2 size, std::string_view owner,
+                                 std::function<void(TextureHandle)> on_ready) {
+        UploadTexture(rgba, size, owner, std::move(on_ready));
+    }
+
+    void Graphics::StreamTexture(gsl::span<const std::uint8_t> pixels, glm::ivec2 size, VkFormat format,
+                                 std::uint32_t mip_count, std::string_view owner,
+                                 std::function<void(TextureHandle)> on_ready) {
+        UploadTexture(pixels, size, owner, std::move(on_ready), format, mip_count);
+    }
+
+    TextureHandle Graphics::UploadTexture(gsl::span<const std::uint8_t> pixels, glm::ivec2 size, std::string_view owner,
+                                          std::function<void(TextureHandle)> on_ready, VkFormat format,
+                                          std::uint32_t mip_count) {
+        std::vector<gsl::span<const std::uint8_t>> levels;
+        std::uint64_t offset = 0;
+        for (std::uint32_t mip = 0; mip < mip_count; mip++) {
+            std::uint32_t width = std::max(static_cast<std::uint32_t>(size.x) >> mip, 1u);
+            std::uint32_t height = std::max(static_cast<std::uint32_t>(size.y) >> mip, 1u);
+            std::uint64_t level_size = GetTextureLevelSize(format, width, height);
+            if (level_size > pixels.size() - offset) {
+                throw std::runtime_error("Texture data is smaller than its mip chain!");
+            }
+            levels.push_back(pixels.subspan(offset, level_size));
+            offset += level_size;
+        }
+        return UploadTextureLevels(levels, size, format, owner, std::move(on_ready));
+    }
+
+    TextureHandle Graphics::UploadTextureLevels(gsl::span<const gsl::span<const std::uint8_t>> levels, glm::ivec2 size,
+                                                VkFormat format, std::string_view owner,
+                                                std::function<void(TextureHandle)> on_ready) {
+        VkDeviceSize staging_size = 0;
+        for (gsl::span<const std::uint8_t> level : levels) {
+            staging_size += level.size_bytes();
+        }
+        StagingSlice staging = AllocateStaging(staging_size, owner);
+        std::uint8_t* cursor = staging.data;
+        for (gsl::span<const std::uint8_t> level : levels) {
+            std::memcpy(cursor, level.data(), level.size_bytes());
+            cursor += level.size_bytes();
+        }
+        return SubmitTextureUpload(staging, size, format, levels.size(), owner, std::move(on_ready));
+    }
+
+    TextureHandle Graphics::DecodeTexture(gsl::span<const std::uint8_t> encoded, std::string_view owner,
+                                          std::function<void(TextureHandle)> on_ready) {
         glm::ivec2 image_extents;
         std::int32_t channels;
-        std::vector<std::uint8_t> image_file_data = ReadFile(path);
-        stbi_uc* pixel_data = stbi_load_from_memory(image_file_data.data(), image_file_data.size(),
-            &image_extents.x, &image_extents.y, &channels, STBI_rgb_alpha);
-
-        VkDeviceSize buffer_size = image_extents.x * image_extents.y * 4;
-        BufferHandle staging = CreateBuffer(buffer_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        if (!stbi_info_from_memory(encoded.data(), encoded.size(), &image_extents.x, &image_extents.y, &channels)) {
+            throw std::runtime_error("Failed to decode a texture!");
+        }
 
-        void* data_location;
-        vkMapMemory(logical_device_, staging.memory, 0, buffer_size, 0, &data_location);
-        std::memcpy(data_location, pixel_data, buffer_size);
-        vkUnmapMemory(logical_device_, staging.memory);
+        // stb_image always decodes into a buffer of its own, which is then copied into staging once. RGB
+        // images stay RGB there, a quarter smaller, and get their alpha on the way instead of from stb.
+        bool expand = channels == STBI_rgb;
+        std::unique_ptr<stbi_uc, decltype(&stbi_image_free)> pixel_data(
+            stbi_load_from_memory(encoded.data(), encoded.size(), &image_extents.x, &image_extents.y, &channels,
+                                  expand ? STBI_rgb : STBI_rgb_alpha),
+            &stbi_image_free);
+        if (pixel_data == nullptr) {
+            throw std::runtime_error("Failed to decode a texture!");
+        }
 
-        stbi_image_free(pixel_data);
+        std::size_t pixel_count = std::size_t(image_extents.x) * image_extents.y;
+        StagingSlice staging = AllocateStaging(pixel_count * 4, owner);
+        if (expand) {
+            ExpandRgbToRgba(pixel_data.get(), staging.data, pixel_count);
+        } else {
+            std::memcpy(staging.data, pixel_data.get(), pixel_count * 4);
+        }
+        pixel_data.reset();
+
+        return SubmitTextureUpload(staging, image_extents, VK_FORMAT_R8G8B8A8_SRGB, 1, owner, std::move(on_ready));
+    }
+
+    TextureHandle Graphics::SubmitTextureUpload(const StagingSlice& staging, glm::ivec2 size, VkFormat format,
+                                                std::uint32_t mip_count, std::string_view owner,
+                                                std::function<void(TextureHandle)> on_ready) {
+        // Out of device memory mustn't leave the staging taken for good
+        TextureHandle handle;
+        try {
+            handle = CreateImage(size, format, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryUsage::kImage, owner, mip_count);
+        } catch (...) {
+            AbandonStaging(staging);
+            throw;
+        }
+
+        VkCommandBuffer upload_commands = upload_queue_.Begin();
+        RecordImageTransition(upload_commands, handle.image, format, ResourceUsage::kUndefined,
+                              ResourceUsage::kTransferDst);
+        CopyBufferToImage(upload_commands, staging.buffer.buffer, staging.offset, handle.image, size, format,
+                          mip_count);
+
+        PendingUpload upload;
+        upload.stage = GetResourceState(ResourceUsage::kFragmentSampled).stage;
+        upload.texture = handle;
+        upload.on_ready = std::move(on_ready);
+        upload.format = format;
+        upload.mip_count = mip_count;
+        if (HasTransferQueue()) {
+            VkImageMemoryBarrier2 release =
+                MakeImageRelease(handle.image, format, ResourceUsage::kTransferDst,
+                                 ResourceUsage::kFragmentSampled, transfer_family_, graphics_family_);
+            RecordBarriers(upload_commands, {}, gsl::span(&release, 1));
+            upload.image_acquire =
+                MakeImageAcquire(handle.image, format, ResourceUsage::kTransferDst,
+                                 ResourceUsage::kFragmentSampled, transfer_family_, graphics_family_);
+        } else {
+            RecordImageTransition(upload_commands, handle.image, format, ResourceUsage::kTransferDst,
+                                  ResourceUsage::kFragmentSampled);
+        }
 
-        TextureHandle handle = CreateImage(
-            image_extents, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+        upload.value = upload_queue_.Submit(upload_commands);
+        QueueUpload(std::move(upload), staging);
+        return handle;
+    }
 
-        TransitionImageLayout(
-            handle.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-        CopyBufferToImage(staging.buffer, handle.image, image_extents);
-        TransitionImageLayout(handle.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    bool Graphics::IsTextureFormatSupported(VkFormat format) const {
+        if (IsBlockCompressed(format) && !capabilities_.texture_compression_bc) {
+            return false;
+        }
+        VkFormatProperties properties;
+        vkGetPhysicalDeviceFormatProperties(physical_device_, format, &properties);
+        constexpr VkFormatFeatureFlags kRequired =
+            VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT |
+            VK_FORMAT_FEATURE_TRANSFER_DST_BIT;
+        return (properties.optimalTilingFeatures & kRequired) == kRequired;
+    }
 
-        handle.image_view = CreateImageView(handle.image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
+    void Graphics::CreateTextureSet(TextureHandle& handle, VkFormat format, std::uint32_t mip_count) {
+        handle.image_view = CreateImageView(handle.image, format, VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_count);
 
         VkDescriptorSetAllocateInfo set_info = {};
         set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
@@ -1367,113 +2499,52 @@ namespace veng {
         descriptor_write.pImageInfo = &image_info;
 
         vkUpdateDescriptorSets(logical_device_, 1, &descriptor_write, 0, nullptr);
-
-        DestroyBuffer(staging);
-        return handle;
     }
 
     void Graphics::DestroyTexture(TextureHandle handle) {
-        vkDeviceWaitIdle(logical_device_);
+        DeferDestruction([this, handle]() { DestroyTextureNow(handle); });
+    }
+
+    void Graphics::DestroyTextureNow(TextureHandle handle) {
         vkFreeDescriptorSets(logical_device_, texture_pool_, 1, &handle.set);
         vkDestroyImageView(logical_device_, handle.image_view, nullptr);
         vkDestroyImage(logical_device_, handle.image, nullptr);
-        vkFreeMemory(logical_device_, handle.memory, nullptr);
+        FreeMemory(handle.memory);
     }
 
     void Graphics::SetTexture(TextureHandle handle) {
-        vkCmdBindDescriptorSets(
-            command_buffer_, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline_layout_, 1, 1, &handle.set, 0,
-            nullptr);
-    }
-
-    void Graphics::TransitionImageLayout(VkImage image, VkFormat format,
-        VkImageLayout old_layout, VkImageLayout new_layout) {
-        VkCommandBuffer local_command_buffer = BeginTransientCommandBuffer();
-
-        VkImageMemoryBarrier barrier = {};
-        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-        barrier.oldLayout = old_layout;
-        barrier.newLayout = new_layout;
-        barrier.image = image;
-        barrier.subresourceRange.baseArrayLayer = 0;
-        barrier.subresourceRange.baseMipLevel = 0;
-        barrier.subresourceRange.levelCount = 1;
-        barrier.subresourceRange.layerCount = 1;
-
-        VkPipelineStageFlags source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        VkPipelineStageFlags destination_stage = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT; // safe fallbacks
-
-        if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED &&
-            new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destination_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        } else if (
-            old_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL &&
-            new_layout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
-            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-            barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-            source_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-            destination_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-        }
-        else if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL) {
-            barrier.srcAccessMask = 0;
-            barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-            source_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-            destination_stage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-        }
-
-        // Set aspectMask based on format
-        if (format == VK_FORMAT_D32_SFLOAT ||
-            format == VK_FORMAT_D16_UNORM ||
-            format == VK_FORMAT_D24_UNORM_S8_UINT ||
-            format == VK_FORMAT_D32_SFLOAT_S8_UINT)
-        {
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-
-            // Add stencil bit if format has stencil
-            if (format == VK_FORMAT_D24_UNORM_S8_UINT ||
-                format == VK_FORMAT_D32_SFLOAT_S8_UINT)
-            {
-                barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-            }
-        }
-        else
-        {
-            barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        texture_set_ = handle.set;
+    }
+
+    void Graphics::CopyBufferToImage(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize buffer_offset,
+                                     VkImage image, glm::ivec2 image_size, VkFormat format, std::uint32_t mip_count) {
+        // The levels follow each other in the buffer, one region each
+        std::vector<VkBufferImageCopy> regions(mip_count);
+        VkDeviceSize offset = buffer_offset;
+        for (std::uint32_t mip = 0; mip < mip_count; mip++) {
+            std::uint32_t width = std::max(static_cast<std::uint32_t>(image_size.x) >> mip, 1u);
+            std::uint32_t height = std::max(static_cast<std::uint32_t>(image_size.y) >> mip, 1u);
+
+            VkBufferImageCopy& region = regions[mip];
+            region.bufferOffset = offset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = mip;
+            region.imageSubresource.baseArrayLayer = 0;
+            region.imageSubresource.layerCount = 1;
+            region.imageOffset = { 0,0,0 };
+            region.imageExtent = { width, height, 1 };
+            offset += GetTextureLevelSize(format, width, height);
         }
 
-        vkCmdPipelineBarrier(
-            local_command_buffer, source_stage, destination_stage, 0, 0, nullptr, 0, nullptr, 1,
-            &barrier);
-
-        EndTransientCommandBuffer(local_command_buffer);
-    }
-
-    void Graphics::CopyBufferToImage(VkBuffer buffer, VkImage image, glm::ivec2 image_size) {
-        VkCommandBuffer local_command_buffer = BeginTransientCommandBuffer();
-
-        VkBufferImageCopy region = {};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = 1;
-        region.imageOffset = { 0,0,0 };
-        region.imageExtent = {
-            static_cast<std::uint32_t>(image_size.x), static_cast<std::uint32_t>(image_size.y), 1 };
-
         vkCmdCopyBufferToImage(
-            local_command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-        EndTransientCommandBuffer(local_command_buffer);
+            command_buffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, regions.size(), regions.data());
     }
 
-    TextureHandle Graphics::CreateImage(
-        glm::ivec2 size, VkFormat image_format, VkBufferCreateFlags usage, VkMemoryPropertyFlags properties) {
+    TextureHandle Graphics::CreateImage(glm::ivec2 size, VkFormat image_format, VkBufferCreateFlags usage,
+                                        VkMemoryPropertyFlags properties, MemoryUsage memory_usage, std::string_view owner,
+                                        std::uint32_t mip_levels) {
         TextureHandle handle = {};
 
         VkImageCreateInfo image_info = {};
@@ -1484,7 +2555,7 @@ namespace veng {
         image_info.extent.width = size.x;
         image_info.extent.height = size.y;
         image_info.extent.depth = 1;
-        image_info.mipLevels = 1;
+        image_info.mipLevels = mip_levels;
         image_info.arrayLayers = 1;
         image_info.format = image_format;
         image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
@@ -1500,41 +2571,666 @@ namespace veng {
 
         VkMemoryRequirements memory_requirements;
         vkGetImageMemoryRequirements(logical_device_, handle.image, &memory_requirements);
+        handle.memory = AllocateMemory(memory_requirements, properties, memory_usage, owner);
 
-        std::uint32_t chosen_memory_type = FindMemoryType(memory_requirements.memoryTypeBits, properties);
+        vkBindImageMemory(logical_device_, handle.image, handle.memory, 0);
 
-        VkMemoryAllocateInfo allocation_info = {};
-        allocation_info.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocation_info.allocationSize = memory_requirements.size;
-        allocation_info.memoryTypeIndex = chosen_memory_type;
+        return handle;
+    }
+
+
+    void Graphics::UpdateRenderExtent() {
+        float scale = dynamic_resolution_enabled_ ? resolution_controller_.GetScale() : 1.0f;
+        render_extent_.width = std::max(1u, static_cast<std::uint32_t>(extent_.width * scale));
+        render_extent_.height = std::max(1u, static_cast<std::uint32_t>(extent_.height * scale));
+    }
+
+    void Graphics::SetDynamicResolution(bool enabled) {
+        dynamic_resolution_enabled_ = enabled;
+        resolution_controller_.Reset();
+        UpdateRenderExtent();
+    }
+
+    #pragma endregion
 
-        VkResult allocation_result =
-            vkAllocateMemory(logical_device_, &allocation_info, nullptr, &handle.memory);
+    #pragma region COMPUTE
 
-        if (allocation_result != VK_SUCCESS) {
-            throw std::runtime_error("Failed to allocate image memory!");
+    static VkDescriptorType GetDescriptorType(ComputeBindingType type) {
+        switch (type) {
+        case ComputeBindingType::kStorageBuffer:
+            return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        case ComputeBindingType::kStorageImage:
+            return VK_DESCRIPTOR_TYPE_STORAGE_IMAGE;
+        case ComputeBindingType::kSampledImage:
+            return VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         }
+        return VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    }
 
-        vkBindImageMemory(logical_device_, handle.image, handle.memory, 0);
+    ComputePipelineHandle Graphics::CreateComputePipeline(
+        gsl::czstring path, gsl::span<ComputeBindingType> bindings, std::uint32_t push_constant_size) {
+        ComputePipelineHandle handle;
+        handle.bindings.assign(bindings.begin(), bindings.end());
+        handle.push_constant_size = push_constant_size;
+
+        VkShaderModule shader = LoadShaderModule(path);
+        if (shader == VK_NULL_HANDLE) {
+            throw std::runtime_error("Failed to load compute shader!");
+        }
+        gsl::final_action destroy_shader([this, shader]() {
+            vkDestroyShaderModule(logical_device_, shader, nullptr);
+        });
+
+        std::vector<VkDescriptorSetLayoutBinding> layout_bindings(bindings.size());
+        for (std::uint32_t i = 0; i < bindings.size(); i++) {
+            layout_bindings[i].binding = i;
+            layout_bindings[i].descriptorType = GetDescriptorType(bindings[i]);
+            layout_bindings[i].descriptorCount = 1;
+            layout_bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+
+        VkDescriptorSetLayoutCreateInfo set_layout_info = {};
+        set_layout_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        set_layout_info.bindingCount = layout_bindings.size();
+        set_layout_info.pBindings = layout_bindings.data();
+
+        if (vkCreateDescriptorSetLayout(logical_device_, &set_layout_info, nullptr, &handle.set_layout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute set layout!");
+        }
+
+        VkPushConstantRange push_constant_range = {};
+        push_constant_range.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        push_constant_range.offset = 0;
+        push_constant_range.size = push_constant_size;
+
+        VkPipelineLayoutCreateInfo layout_info = {};
+        layout_info.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        layout_info.setLayoutCount = 1;
+        layout_info.pSetLayouts = &handle.set_layout;
+        layout_info.pushConstantRangeCount = push_constant_size > 0 ? 1 : 0;
+        layout_info.pPushConstantRanges = &push_constant_range;
+
+        if (vkCreatePipelineLayout(logical_device_, &layout_info, nullptr, &handle.layout) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute pipeline layout!");
+        }
+
+        VkComputePipelineCreateInfo pipeline_info = {};
+        pipeline_info.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipeline_info.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipeline_info.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipeline_info.stage.module = shader;
+        pipeline_info.stage.pName = "main";
+        pipeline_info.layout = handle.layout;
+
+        if (vkCreateComputePipelines(logical_device_, VK_NULL_HANDLE, 1, &pipeline_info, nullptr, &handle.pipeline) !=
+            VK_SUCCESS) {
+            throw std::runtime_error("Failed to create compute pipeline!");
+        }
+
+        return handle;
+    }
+
+    void Graphics::DestroyComputePipeline(ComputePipelineHandle handle) {
+        DeferDestruction([this, handle]() {
+            vkDestroyPipeline(logical_device_, handle.pipeline, nullptr);
+            vkDestroyPipelineLayout(logical_device_, handle.layout, nullptr);
+            vkDestroyDescriptorSetLayout(logical_device_, handle.set_layout, nullptr);
+        });
+    }
+
+    VkDescriptorSet Graphics::CreateComputeSet(
+        const ComputePipelineHandle& pipeline, gsl::span<ComputeResource> resources) {
+        if (resources.size() != pipeline.bindings.size()) {
+            throw std::runtime_error("Compute set doesn't match the pipeline bindings!");
+        }
+
+        VkDescriptorSetAllocateInfo set_info = {};
+        set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        set_info.descriptorPool = compute_pool_;
+        set_info.descriptorSetCount = 1;
+        set_info.pSetLayouts = &pipeline.set_layout;
+
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        if (vkAllocateDescriptorSets(logical_device_, &set_info, &set) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate compute descriptor set!");
+        }
+
+        // Reserved up front, the writes point into these
+        std::vector<VkDescriptorBufferInfo> buffer_infos(resources.size());
+        std::vector<VkDescriptorImageInfo> image_infos(resources.size());
+        std::vector<VkWriteDescriptorSet> writes(resources.size());
+
+        for (std::uint32_t i = 0; i < resources.size(); i++) {
+            VkWriteDescriptorSet& write = writes[i];
+            write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            write.dstSet = set;
+            write.dstBinding = i;
+            write.dstArrayElement = 0;
+            write.descriptorType = GetDescriptorType(pipeline.bindings[i]);
+            write.descriptorCount = 1;
+
+            switch (pipeline.bindings[i]) {
+            case ComputeBindingType::kStorageBuffer:
+                buffer_infos[i] = {resources[i].buffer, 0, VK_WHOLE_SIZE};
+                write.pBufferInfo = &buffer_infos[i];
+                break;
+            case ComputeBindingType::kStorageImage:
+                image_infos[i] = {VK_NULL_HANDLE, resources[i].image_view, VK_IMAGE_LAYOUT_GENERAL};
+                write.pImageInfo = &image_infos[i];
+                break;
+            case ComputeBindingType::kSampledImage:
+                image_infos[i] = {texture_sampler_, resources[i].image_view, resources[i].image_layout};
+                write.pImageInfo = &image_infos[i];
+                break;
+            }
+        }
+
+        vkUpdateDescriptorSets(logical_device_, writes.size(), writes.data(), 0, nullptr);
+        return set;
+    }
+
+    void Graphics::DestroyComputeSet(VkDescriptorSet set) {
+        DeferDestruction([this, set]() { vkFreeDescriptorSets(logical_device_, compute_pool_, 1, &set); });
+    }
+
+    VkDescriptorSet Graphics::CreateParticleSet(BufferHandle particles) {
+        VkDescriptorSetAllocateInfo set_info = {};
+        set_info.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        set_info.descriptorPool = compute_pool_;
+        set_info.descriptorSetCount = 1;
+        set_info.pSetLayouts = &particle_set_layout_;
+
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        if (vkAllocateDescriptorSets(logical_device_, &set_info, &set) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to allocate particle descriptor set!");
+        }
+
+        VkDescriptorBufferInfo buffer_info = {particles.buffer, 0, VK_WHOLE_SIZE};
+
+        VkWriteDescriptorSet write = {};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = set;
+        write.dstBinding = 0;
+        write.dstArrayElement = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.descriptorCount = 1;
+        write.pBufferInfo = &buffer_info;
+
+        vkUpdateDescriptorSets(logical_device_, 1, &write, 0, nullptr);
+        return set;
+    }
+
+    BufferHandle Graphics::CreateStorageBuffer(VkDeviceSize size, std::string_view owner) {
+        return CreateBuffer(
+            size,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT |
+                VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryUsage::kBuffer, owner);
+    }
+
+    TextureHandle Graphics::CreateStorageImage(glm::ivec2 size, VkFormat format, std::string_view owner) {
+        TextureHandle handle = CreateImage(
+            size, format,
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT |
+                VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryUsage::kImage, owner);
+        handle.image_view = CreateImageView(handle.image, format, VK_IMAGE_ASPECT_COLOR_BIT);
+
+        VkCommandBuffer transient_commands = BeginTransientCommandBuffer();
+        RecordImageTransition(transient_commands, handle.image, format, ResourceUsage::kUndefined,
+                              ResourceUsage::kComputeStorageWrite);
+        SubmitTransientCommandBuffer(transient_commands);
 
         return handle;
     }
 
+    void Graphics::RecordCompute(std::function<void(ComputeRecorder&)> record) {
+        compute_records_.push_back(std::move(record));
+    }
+
+    std::uint64_t Graphics::SubmitCompute(std::function<void(ComputeRecorder&)> record) {
+        VkCommandBuffer command_buffer = BeginTransientCommandBuffer();
+        ComputeRecorder recorder(command_buffer);
+        record(recorder);
+        return SubmitTransientCommandBuffer(command_buffer);
+    }
+
+    void Graphics::WaitForCompute(std::uint64_t value) {
+        graphics_timeline_.Wait(value);
+        FlushDeferredDestruction();
+    }
+
+    void Graphics::CreateAsyncCompute() {
+        if (!HasAsyncComputeQueue()) {
+            spdlog::info("No dedicated compute queue family, async compute runs on the graphics queue");
+            return;
+        }
+
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = compute_family_;
+
+        if (vkCreateCommandPool(logical_device_, &pool_info, nullptr, &compute_command_pool_) != VK_SUCCESS) {
+            std::exit(EXIT_FAILURE);
+        }
+
+        VkCommandBufferAllocateInfo info = {};
+        info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        info.commandPool = compute_command_pool_;
+        info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        info.commandBufferCount = 1;
+
+        for (AsyncComputeSlot& slot : async_compute_slots_) {
+            if (vkAllocateCommandBuffers(logical_device_, &info, &slot.command_buffer) != VK_SUCCESS) {
+                std::exit(EXIT_FAILURE);
+            }
+        }
+
+        async_compute_profiler_.Initialize(
+            physical_device_, logical_device_, compute_family_, kMaxAsyncComputeInFlight);
+        spdlog::info("Async compute on queue family {}", compute_family_);
+    }
+
+    std::uint64_t Graphics::SubmitAsyncCompute(
+        std::function<void(ComputeRecorder&)> record, gsl::span<AsyncComputeBuffer> buffers) {
+        // One queue keeps everything in submission order, nothing changes hands
+        if (!HasAsyncComputeQueue()) {
+            return SubmitCompute(std::move(record));
+        }
+
+        if (frame_in_progress_) {
+            throw std::runtime_error("Async compute has to be submitted outside a frame!");
+        }
+
+        // Graphics releases the buffers first, the compute submission waits for that on the GPU
+        std::vector<AsyncComputeBuffer> transfers(buffers.begin(), buffers.end());
+        if (!transfers.empty()) {
+            std::vector<VkBufferMemoryBarrier2> releases;
+            for (const AsyncComputeBuffer& transfer : transfers) {
+                releases.push_back(MakeBufferRelease(
+                    transfer.buffer.buffer, transfer.graphics_usage, graphics_family_, compute_family_));
+            }
+
+            VkCommandBuffer release_commands = BeginTransientCommandBuffer();
+            RecordBarriers(release_commands, releases);
+            SubmitTransientCommandBuffer(release_commands);
+        }
+
+        std::uint32_t slot_index = async_compute_stats_.submission_count % kMaxAsyncComputeInFlight;
+        AsyncComputeSlot& slot = async_compute_slots_[slot_index];
+        compute_timeline_.Wait(slot.value);
+        CollectAsyncComputeTimes();
+
+        vkResetCommandBuffer(slot.command_buffer, 0);
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(slot.command_buffer, &begin_info) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin async compute command buffer!");
+        }
+
+        async_compute_profiler_.BeginFrame(slot.command_buffer, slot_index);
+
+        std::vector<VkBufferMemoryBarrier2> barriers;
+        for (const AsyncComputeBuffer& transfer : transfers) {
+            barriers.push_back(
+                MakeBufferAcquire(transfer.buffer.buffer, transfer.compute_usage, graphics_family_, compute_family_));
+        }
+
+        RecordBarriers(slot.command_buffer, barriers);
+
+        ComputeRecorder recorder(slot.command_buffer);
+        record(recorder);
+
+        // Handed straight back, the frame that calls AcquireAsyncCompute records the other half
+        barriers.clear();
+        for (const AsyncComputeBuffer& transfer : transfers) {
+            barriers.push_back(
+                MakeBufferRelease(transfer.buffer.buffer, transfer.compute_usage, compute_family_, graphics_family_));
+        }
+        RecordBarriers(slot.command_buffer, barriers);
+
+        async_compute_profiler_.EndFrame(slot.command_buffer, slot_index);
+        if (vkEndCommandBuffer(slot.command_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record async compute command buffer!");
+        }
+
+        // Releases and other transient work are on the graphics timeline
+        QueueSubmission submission;
+        submission.command_buffers.push_back(slot.command_buffer);
+        if (!graphics_timeline_.IsComplete(pending_transient_value_)) {
+            submission.waits.push_back(
+                graphics_timeline_.WaitFor(pending_transient_value_, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT));
+        }
+
+        slot.value = compute_timeline_.Submit(submission);
+        async_compute_stats_.submission_count++;
+
+        // Nothing to hand back otherwise, AcquireAsyncCompute only needs the value
+        if (!transfers.empty()) {
+            pending_acquires_.push_back({slot.value, std::move(transfers)});
+        }
+        return slot.value;
+    }
+
+    void Graphics::AcquireAsyncCompute(std::uint64_t submission) {
+        if (!HasAsyncComputeQueue()) {
+            return;
+        }
+
+        if (!frame_in_progress_) {
+            throw std::runtime_error("Async compute can only be acquired inside a frame!");
+        }
+
+        frame_compute_wait_ = std::max(frame_compute_wait_, submission);
+        auto pending =
+            std::find_if(pending_acquires_.begin(), pending_acquires_.end(),
+                         [submission](const PendingAcquire& acquire) { return acquire.submission == submission; });
+        if (pending == pending_acquires_.end()) {
+            return;
+        }
+
+        for (const AsyncComputeBuffer& buffer : pending->buffers) {
+            frame_compute_wait_stage_ |= GetResourceState(buffer.graphics_usage).stage;
+            frame_acquires_.push_back(buffer);
+        }
+        pending_acquires_.erase(pending);
+    }
+
+    void Graphics::WaitForAsyncCompute(std::uint64_t submission) {
+        if (!HasAsyncComputeQueue()) {
+            WaitForCompute(submission);
+            return;
+        }
+
+        compute_timeline_.Wait(submission);
+        CollectAsyncComputeTimes();
+
+        // Finished submissions no frame has acquired yet give their buffers back to the graphics queue
+        // here, so callers that only ever wait don't pile up pending acquires
+        auto finished = std::partition(
+            pending_acquires_.begin(), pending_acquires_.end(),
+            [this](const PendingAcquire& acquire) { return !compute_timeline_.IsComplete(acquire.submission); });
+        if (finished == pending_acquires_.end()) {
+            return;
+        }
+
+        std::vector<VkBufferMemoryBarrier2> acquires;
+        for (auto it = finished; it != pending_acquires_.end(); it++) {
+            for (const AsyncComputeBuffer& buffer : it->buffers) {
+                acquires.push_back(
+                    MakeBufferAcquire(buffer.buffer.buffer, buffer.graphics_usage, compute_family_, graphics_family_));
+            }
+        }
+        pending_acquires_.erase(finished, pending_acquires_.end());
+
+        VkCommandBuffer acquire_commands = BeginTransientCommandBuffer();
+        RecordBarriers(acquire_commands, acquires);
+        SubmitTransientCommandBuffer(acquire_commands);
+    }
+
+    void Graphics::CollectAsyncComputeTimes() {
+        if (!HasAsyncComputeQueue()) {
+            return;
+        }
+
+        for (std::uint32_t i = 0; i < kMaxAsyncComputeInFlight; i++) {
+            if (!compute_timeline_.IsComplete(async_compute_slots_[i].value)) {
+                continue;
+            }
+
+            std::optional<GpuInterval> interval = async_compute_profiler_.CollectFrameInterval(i);
+            if (interval.has_value()) {
+                AddAsyncComputeInterval(interval.value());
+            }
+        }
+    }
+
+    void Graphics::AddFrameInterval(const GpuInterval& interval) {
+        for (const GpuInterval& compute : recent_compute_intervals_) {
+            async_compute_stats_.overlapped_ms += interval.Overlap(compute);
+        }
+
+        recent_frame_intervals_.push_back(interval);
+        if (recent_frame_intervals_.size() > kOverlapHistory) {
+            recent_frame_intervals_.pop_front();
+        }
+    }
+
+    void Graphics::AddAsyncComputeInterval(const GpuInterval& interval) {
+        async_compute_stats_.busy_ms += interval.Duration();
+        for (const GpuInterval& frame : recent_frame_intervals_) {
+            async_compute_stats_.overlapped_ms += interval.Overlap(frame);
+        }
+
+        recent_compute_intervals_.push_back(interval);
+        if (recent_compute_intervals_.size() > kOverlapHistory) {
+            recent_compute_intervals_.pop_front();
+        }
+    }
+
+    #pragma endregion
+
+    #pragma region OCCLUSION_CULLING
+
+    namespace {
+        struct HiZBuildConstants {
+            glm::ivec2 source_size;
+            glm::ivec2 destination_size;
+        };
+
+        struct CullConstants {
+            std::uint32_t phase;
+            std::uint32_t frame;
+            std::uint32_t max_objects;
+        };
+
+        constexpr std::uint32_t kHiZGroupSize = 8;
+        constexpr std::uint32_t kCullGroupSize = 64;
+        constexpr std::uint32_t kCullStatsPerFrame = 4;
+    }
+
+    void Graphics::CreateOcclusionCulling() {
+        std::array<ComputeBindingType, 2> hi_z_bindings = {
+            ComputeBindingType::kSampledImage, ComputeBindingType::kStorageImage};
+        hi_z_pipeline_ = CreateComputePipeline("./hi_z_build.comp.spv", hi_z_bindings, sizeof(HiZBuildConstants));
+
+        std::array<ComputeBindingType, 5> cull_bindings = {
+            ComputeBindingType::kStorageBuffer, ComputeBindingType::kStorageBuffer, ComputeBindingType::kStorageBuffer,
+            ComputeBindingType::kStorageBuffer, ComputeBindingType::kSampledImage};
+        cull_pipeline_ = CreateComputePipeline("./occlusion_cull.comp.spv", cull_bindings, sizeof(CullConstants));
+
+        // Written by the CPU every frame, small enough that reading them over the bus doesn't matter
+        VkMemoryPropertyFlags host_visible = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        VkDeviceSize cameras_size = sizeof(CullCamera) * kMaxFramesInFlight;
+        VkDeviceSize objects_size = sizeof(CullObject) * kMaxCullObjects * kMaxFramesInFlight;
+        VkDeviceSize stats_size = sizeof(std::uint32_t) * kCullStatsPerFrame * kMaxFramesInFlight;
+
+        cull_cameras_ = CreateBuffer(
+            cameras_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_visible, MemoryUsage::kInternal, "occlusion culling");
+        cull_objects_buffer_ = CreateBuffer(
+            objects_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_visible, MemoryUsage::kInternal, "occlusion culling");
+        cull_stats_ = CreateBuffer(
+            stats_size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, host_visible, MemoryUsage::kInternal, "occlusion culling");
+        cull_draws_ = CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * kMaxCullObjects * 2,
+                                   VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                   VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryUsage::kInternal, "occlusion culling");
+
+        void* location = nullptr;
+        vkMapMemory(logical_device_, cull_cameras_.memory, 0, cameras_size, 0, &location);
+        cull_cameras_location_ = static_cast<CullCamera*>(location);
+        vkMapMemory(logical_device_, cull_objects_buffer_.memory, 0, objects_size, 0, &location);
+        cull_objects_location_ = static_cast<CullObject*>(location);
+        vkMapMemory(logical_device_, cull_stats_.memory, 0, stats_size, 0, &location);
+        cull_stats_location_ = static_cast<std::uint32_t*>(location);
+        std::memset(cull_stats_location_, 0, stats_size);
+
+        CreateHiZ();
+    }
+
+    void Graphics::CreateHiZ() {
+        // Swap chain recreation can come before the culling pipelines exist
+        if (cull_pipeline_.pipeline == VK_NULL_HANDLE) {
+            return;
+        }
+
+        VkExtent2D extent = GetHiZExtent(extent_);
+        if (hi_z_.image != VK_NULL_HANDLE) {
+            if (extent.width == hi_z_extent_.width && extent.height == hi_z_extent_.height) {
+                return;
+            }
+
+            // Frames in flight may still test against the old pyramid
+            DeferDestruction([this, old_hi_z = hi_z_, old_views = hi_z_mip_views_, old_sets = hi_z_sets_,
+                              old_cull_set = cull_set_]() {
+                vkFreeDescriptorSets(logical_device_, compute_pool_, old_sets.size(), old_sets.data());
+                vkFreeDescriptorSets(logical_device_, compute_pool_, 1, &old_cull_set);
+                for (VkImageView view : old_views) {
+                    vkDestroyImageView(logical_device_, view, nullptr);
+                }
+                DestroyTextureNow(old_hi_z);
+            });
+        }
+
+        hi_z_extent_ = extent;
+        std::uint32_t mip_count = GetHiZMipCount(extent);
+        glm::ivec2 size(extent.width, extent.height);
+        hi_z_ = CreateImage(size, VK_FORMAT_R32_SFLOAT,
+                            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+                            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, MemoryUsage::kInternal, "hi-z", mip_count);
+        hi_z_.image_view = CreateImageView(hi_z_.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, 0, mip_count);
+
+        hi_z_mip_views_.clear();
+        hi_z_sets_.clear();
+        hi_z_depth_view_ = VK_NULL_HANDLE;
+        for (std::uint32_t mip = 0; mip < mip_count; mip++) {
+            hi_z_mip_views_.push_back(
+                CreateImageView(hi_z_.image, VK_FORMAT_R32_SFLOAT, VK_IMAGE_ASPECT_COLOR_BIT, mip, 1));
+        }
+
+        // The first set is written once the depth buffer's view is known
+        hi_z_sets_.push_back(VK_NULL_HANDLE);
+        for (std::uint32_t mip = 1; mip < mip_count; mip++) {
+            std::array<ComputeResource, 2> resources = {
+                ComputeResource(hi_z_mip_views_[mip - 1], VK_IMAGE_LAYOUT_GENERAL),
+                ComputeResource(hi_z_mip_views_[mip], VK_IMAGE_LAYOUT_GENERAL)};
+            hi_z_sets_.push_back(CreateComputeSet(hi_z_pipeline_, resources));
+        }
+
+        std::array<ComputeResource, 5> cull_resources = {
+            cull_cameras_, cull_objects_buffer_, cull_draws_, cull_stats_,
+            ComputeResource(hi_z_.image_view, VK_IMAGE_LAYOUT_GENERAL)};
+        cull_set_ = CreateComputeSet(cull_pipeline_, cull_resources);
+
+        // Cleared to the far plane, nothing is occluded until a frame has rendered into it
+        VkCommandBuffer transient_commands = BeginTransientCommandBuffer();
+        RecordImageTransition(transient_commands, hi_z_.image, VK_FORMAT_R32_SFLOAT, ResourceUsage::kUndefined,
+                              ResourceUsage::kTransferDst);
+        VkClearColorValue far_plane = {{1.0f, 1.0f, 1.0f, 1.0f}};
+        VkImageSubresourceRange range = {VK_IMAGE_ASPECT_COLOR_BIT, 0, VK_REMAINING_MIP_LEVELS, 0, 1};
+        vkCmdClearColorImage(
+            transient_commands, hi_z_.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &far_plane, 1, &range);
+        RecordImageTransition(transient_commands, hi_z_.image, VK_FORMAT_R32_SFLOAT, ResourceUsage::kTransferDst,
+                              ResourceUsage::kComputeSampledGeneral);
+        SubmitTransientCommandBuffer(transient_commands);
+    }
+
+    void Graphics::WriteCullInputs() {
+        CullCamera& camera = cull_cameras_location_[frame_index_];
+        camera.view_projection = view_projection_.projection * view_projection_.view;
+        camera.pyramid_view_projection = hi_z_view_projection_;
+        camera.object_count = cull_objects_.size();
+        camera.mip_count = hi_z_mip_views_.size();
+        camera.pyramid_size = glm::vec2(hi_z_extent_.width, hi_z_extent_.height);
+
+        // This frame's region was last read by the frame BeginFrame waited on
+        std::memcpy(cull_objects_location_ + frame_index_ * kMaxCullObjects, cull_objects_.data(),
+                    cull_objects_.size() * sizeof(CullObject));
+
+        // The pyramid built later in this frame sees the scene from here
+        hi_z_view_projection_ = camera.view_projection;
+    }
+
+    void Graphics::RecordOcclusionCull(VkCommandBuffer command_buffer, std::uint32_t phase) {
+        ComputeRecorder recorder(command_buffer);
+        CullConstants constants = {phase, frame_index_, kMaxCullObjects};
+        std::uint32_t group_count = (cull_objects_.size() + kCullGroupSize - 1) / kCullGroupSize;
+        recorder.Dispatch(cull_pipeline_, cull_set_, {group_count, 1, 1}, &constants);
+
+        // The counters are read on the host once the frame has finished
+        if (phase == 1) {
+            ResourceState written = GetResourceState(ResourceUsage::kComputeStorageWrite);
+            ResourceState host_read = {VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT,
+                                       VK_IMAGE_LAYOUT_UNDEFINED};
+            std::array<VkBufferMemoryBarrier2, 1> barriers = {
+                MakeBufferBarrier(cull_stats_.buffer, written, host_read)};
+            RecordBarriers(command_buffer, barriers);
+        }
+    }
+
+    void Graphics::RecordHiZBuild(VkCommandBuffer command_buffer, VkImageView depth_view) {
+        // A fresh set every time the graph hands out another depth view, the old one may still be in flight
+        if (depth_view != hi_z_depth_view_) {
+            if (hi_z_sets_[0] != VK_NULL_HANDLE) {
+                DestroyComputeSet(hi_z_sets_[0]);
+            }
+            std::array<ComputeResource, 2> resources = {
+                ComputeResource(depth_view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL),
+                ComputeResource(hi_z_mip_views_[0], VK_IMAGE_LAYOUT_GENERAL)};
+            hi_z_sets_[0] = CreateComputeSet(hi_z_pipeline_, resources);
+            hi_z_depth_view_ = depth_view;
+        }
+
+        ComputeRecorder recorder(command_buffer);
+        // Only the top left render_extent_ of the depth buffer has been rendered to
+        glm::ivec2 source_size(render_extent_.width, render_extent_.height);
+        for (std::uint32_t mip = 0; mip < hi_z_sets_.size(); mip++) {
+            VkExtent2D extent = GetHiZMipExtent(hi_z_extent_, mip);
+            HiZBuildConstants constants = {source_size, glm::ivec2(extent.width, extent.height)};
+            glm::uvec3 group_count = {(extent.width + kHiZGroupSize - 1) / kHiZGroupSize,
+                                      (extent.height + kHiZGroupSize - 1) / kHiZGroupSize, 1};
+            recorder.Dispatch(hi_z_pipeline_, hi_z_sets_[mip], group_count, &constants);
+
+            // The next level reads this one
+            recorder.ImageBarrier(hi_z_, ResourceUsage::kComputeStorageWrite, ResourceUsage::kComputeSampledGeneral);
+            source_size = constants.destination_size;
+        }
+    }
+
+    void Graphics::CleanupOcclusionCulling() {
+        for (VkImageView view : hi_z_mip_views_) {
+            vkDestroyImageView(logical_device_, view, nullptr);
+        }
+        if (hi_z_.image != VK_NULL_HANDLE) {
+            DestroyTextureNow(hi_z_);
+        }
+
+        // Unmapped along with their memory
+        DestroyBufferNow(cull_cameras_);
+        DestroyBufferNow(cull_objects_buffer_);
+        DestroyBufferNow(cull_stats_);
+        DestroyBufferNow(cull_draws_);
+    }
 
-    void Graphics::CreateDepthResources() {
-        VkFormat kDepthFormat = VK_FORMAT_D32_SFLOAT;
-        depth_texture_ = CreateImage({ extent_.width, extent_.height }, kDepthFormat, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    void Graphics::CollectOcclusionStats() {
+        Frame& frame = frames_[frame_index_];
+        if (frame.cull_candidates == 0) {
+            return;
+        }
 
-        depth_texture_.image_view =
-            CreateImageView(depth_texture_.image, kDepthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
+        std::uint32_t* stats = cull_stats_location_ + frame_index_ * kCullStatsPerFrame;
+        occlusion_stats_ = {frame.cull_candidates, stats[0], stats[1]};
+        std::memset(stats, 0, sizeof(std::uint32_t) * kCullStatsPerFrame);
+        frame.cull_candidates = 0;
     }
 
     #pragma endregion
 
     #pragma region CLASS
 
-    Graphics::Graphics(gsl::not_null<Window*> window) : window_(window) {
+    Graphics::Graphics(gsl::not_null<Window*> window, const std::filesystem::path& shader_archive)
+        : shader_archive_(shader_archive), window_(window) {
 
         #if !defined(NDEBUG)
         validation_enabled_ = true;
@@ -1543,13 +3239,40 @@ namespace veng {
         InitializeVulkan();
     }
 
+    Graphics::Graphics(glm::ivec2 headless_size, const std::filesystem::path& shader_archive)
+        : shader_archive_(shader_archive) {
+
+        #if !defined(NDEBUG)
+        validation_enabled_ = true;
+        #endif
+
+        required_device_extensions_.clear();
+        extent_ = { static_cast<std::uint32_t>(headless_size.x), static_cast<std::uint32_t>(headless_size.y) };
+        surface_format_ = { VK_FORMAT_R8G8B8A8_SRGB, VK_COLOR_SPACE_SRGB_NONLINEAR_KHR };
+
+        InitializeVulkan();
+    }
+
     Graphics::~Graphics(){
 
+        ReportFrameTimeStats();
+
         if (logical_device_ != VK_NULL_HANDLE) {
             vkDeviceWaitIdle(logical_device_);
+            CollectAsyncComputeTimes();
+            ReportAsyncComputeStats();
 
+            DestroyComputePipeline(hi_z_pipeline_);
+            DestroyComputePipeline(cull_pipeline_);
+            FlushDeferredDestruction(true);
+            CleanupOcclusionCulling();
             CleanupSwapChain();
-            DestroyTexture(depth_texture_);
+            render_graph_.Destroy();
+            gpu_profiler_.Destroy();
+
+            if (scene_color_set_ != VK_NULL_HANDLE) {
+                vkFreeDescriptorSets(logical_device_, texture_pool_, 1, &scene_color_set_);
+            }
 
             if (texture_pool_ != VK_NULL_HANDLE) {
                 vkDestroyDescriptorPool(logical_device_, texture_pool_, nullptr);
@@ -1559,36 +3282,68 @@ namespace veng {
                 vkDestroyDescriptorSetLayout(logical_device_, texture_set_layout_, nullptr);
             }
 
+            if (particle_set_layout_ != VK_NULL_HANDLE) {
+                vkDestroyDescriptorSetLayout(logical_device_, particle_set_layout_, nullptr);
+            }
+
             if (texture_sampler_ != VK_NULL_HANDLE) {
                 vkDestroySampler(logical_device_, texture_sampler_, nullptr);
             }
 
+            if (compute_pool_ != VK_NULL_HANDLE) {
+                vkDestroyDescriptorPool(logical_device_, compute_pool_, nullptr);
+            }
+
             if (uniform_pool_ != VK_NULL_HANDLE) {
                 vkDestroyDescriptorPool(logical_device_, uniform_pool_, nullptr);
             }
 
-            DestroyBuffer(uniform_buffer_);
+            DestroyBufferNow(uniform_buffer_);
+            DestroyBufferNow(staging_ring_buffer_);
 
             if (uniform_set_layout_ != VK_NULL_HANDLE) {
                 vkDestroyDescriptorSetLayout(logical_device_, uniform_set_layout_, nullptr);
             }
 
-            if (image_available_signal_ != VK_NULL_HANDLE) {
-                vkDestroySemaphore(logical_device_, image_available_signal_, nullptr);
+            for (VkSemaphore signal : render_finished_signals_) {
+                vkDestroySemaphore(logical_device_, signal, nullptr);
             }
 
-            if (render_finished_signal_ != VK_NULL_HANDLE) {
-                vkDestroySemaphore(logical_device_, render_finished_signal_, nullptr);
+            for (Frame& frame : frames_) {
+                if (frame.image_available_signal != VK_NULL_HANDLE) {
+                    vkDestroySemaphore(logical_device_, frame.image_available_signal, nullptr);
+                }
+
+                if (frame.command_buffer != VK_NULL_HANDLE) {
+                    vkFreeCommandBuffers(logical_device_, command_pool_, 1, &frame.command_buffer);
+                }
+            }
+
+            for (AsyncComputeSlot& slot : async_compute_slots_) {
+                if (slot.command_buffer != VK_NULL_HANDLE) {
+                    vkFreeCommandBuffers(logical_device_, compute_command_pool_, 1, &slot.command_buffer);
+                }
             }
 
-            if (still_rendering_fence_ != VK_NULL_HANDLE) {
-                vkDestroyFence(logical_device_, still_rendering_fence_, nullptr);
+            if (compute_command_pool_ != VK_NULL_HANDLE) {
+                vkDestroyCommandPool(logical_device_, compute_command_pool_, nullptr);
             }
 
-            if (command_buffer_ != VK_NULL_HANDLE) {
-                vkFreeCommandBuffers(logical_device_, command_pool_, 1, &command_buffer_);
+            async_compute_profiler_.Destroy();
+            compute_timeline_.Destroy();
+
+            // Streamed textures that never made it to a frame
+            for (const PendingUpload& upload : pending_uploads_) {
+                if (upload.on_ready != nullptr) {
+                    vkDestroyImage(logical_device_, upload.texture.image, nullptr);
+                    FreeMemory(upload.texture.memory);
+                }
             }
 
+            upload_queue_.Destroy();
+            transfer_timeline_.Destroy();
+            graphics_timeline_.Destroy();
+
             if (command_pool_ != VK_NULL_HANDLE) {
                 vkDestroyCommandPool(logical_device_, command_pool_, nullptr);
             }
@@ -1601,8 +3356,20 @@ namespace veng {
                 vkDestroyPipelineLayout(logical_device_, pipeline_layout_, nullptr);
             }
 
-            if (render_pass_ != VK_NULL_HANDLE) {
-                vkDestroyRenderPass(logical_device_, render_pass_, nullptr);
+            if (particle_pipeline_ != VK_NULL_HANDLE) {
+                vkDestroyPipeline(logical_device_, particle_pipeline_, nullptr);
+            }
+
+            if (particle_pipeline_layout_ != VK_NULL_HANDLE) {
+                vkDestroyPipelineLayout(logical_device_, particle_pipeline_layout_, nullptr);
+            }
+
+            if (upscale_pipeline_ != VK_NULL_HANDLE) {
+                vkDestroyPipeline(logical_device_, upscale_pipeline_, nullptr);
+            }
+
+            if (upscale_pipeline_layout_ != VK_NULL_HANDLE) {
+                vkDestroyPipelineLayout(logical_device_, upscale_pipeline_layout_, nullptr);
             }
 
             vkDestroyDevice(logical_device_, nullptr);
@@ -1625,27 +3392,38 @@ namespace veng {
     void Graphics::InitializeVulkan() {
         CreateInstance();
         SetupDebugMessenger();
-        CreateSurface();
+        if (!IsHeadless()) {
+            CreateSurface();
+        }
         PickPhysicalDevice();
         CreateLogicalDeviceAndQueues();
-        CreateSwapChain();
-        CreateImageViews();
-        CreateRenderPass();
+        if (!IsHeadless()) {
+            CreateSwapChain();
+            CreateImageViews();
+        }
         CreateDescriptorSetLayouts();
         CreateGraphicsPipeline();
-        CreateDepthResources();
-        CreateFramebuffers();
+        CreateParticlePipeline();
+        if (!IsHeadless()) {
+            CreateUpscalePipeline();
+            CreatePresentSignals();
+        }
         CreateCommandPool();
         CreateCommandBuffer();
         CreateSignals();
         CreateUniformBuffers();
+        CreateStagingRing();
         CreateDescriptorPools();
         CreateDescriptorSets();
         CreateTextureSampler();
-
-        TransitionImageLayout(
-            depth_texture_.image, VK_FORMAT_D32_SFLOAT, VK_IMAGE_LAYOUT_UNDEFINED,
-            VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
+        CreateRenderGraph();
+        CreateAsyncCompute();
+        CreateOcclusionCulling();
+        UpdateRenderExtent();
+
+        gpu_profiler_.Initialize(
+            physical_device_, logical_device_, FindQueueFamilies(physical_device_).graphics_family.value(),
+            kMaxFramesInFlight);
     }
 
     #pragma endregion
@@ -1,38 +1,156 @@
 #pragma once
 
 #include <vector>
+#include <deque>
+#include <mutex>
 #include <vulkan/vulkan.h>
 #include <glfw_window.h>
 #include <vertex.h>
 #include <buffer_handle.h>
 #include <texture_handle.h>
+#include <uniform_transformations.h>
+#include <present_policy.h>
+#include <frame_pacer.h>
+#include <gpu_profiler.h>
+#include <dynamic_resolution.h>
+#include <memory_tracker.h>
+#include <device_capabilities.h>
+#include <gpu_timeline.h>
+#include <render_graph.h>
+#include <compute_pipeline_handle.h>
+#include <compute_recorder.h>
+#include <upload_queue.h>
+#include <staging_ring.h>
+#include <occlusion_culling.h>
+#include <frustum_culling.h>
+#include <mapped_file.h>
+#include <asset_archive.h>
 
 namespace veng {
     
 class Graphics final {
     public:
-    Graphics(gsl::not_null<Window*> window);
+    // Shaders come from shader_archive when it names a .vpak that has them, see LoadShaderModule
+    Graphics(gsl::not_null<Window*> window, const std::filesystem::path& shader_archive = {});
+    // Renders offscreen without a surface or swap chain, used by the benchmarks
+    explicit Graphics(glm::ivec2 headless_size, const std::filesystem::path& shader_archive = {});
     ~Graphics();
 
+    bool IsHeadless() const { return window_ == nullptr; }
+    std::string GetDeviceName() const { return capabilities_.name; }
+    const DeviceCapabilities& GetCapabilities() const { return capabilities_; }
+    void WaitIdle();
+
     bool BeginFrame();
     void SetModelMatrix(glm::mat4 model);
     void SetViewProjection(glm::mat4 view, glm::mat4 projection);
+    // Planes of the camera passed to SetViewProjection, for culling on the CPU before recording draws
+    Frustum GetFrustum() const { return ExtractFrustum(view_projection_.projection * view_projection_.view); }
     void SetTexture(TextureHandle handle);
     void RenderBuffer(BufferHandle handle, std::uint32_t vertex_count);
     void RenderIndexedBuffer(BufferHandle vertex_buffer, BufferHandle index_buffer, std::uint32_t count);
+    // Camera facing quads for the particles in the set's buffer, the VkDrawIndirectCommand at offset is
+    // written on the GPU. Textured through SetTexture like any other draw.
+    void RenderParticles(VkDescriptorSet particle_set, BufferHandle draw_arguments, VkDeviceSize offset = 0);
+    // Local space box of the next RenderIndexedBuffer, which makes it a candidate for occlusion culling
+    void SetBounds(glm::vec3 bounds_min, glm::vec3 bounds_max);
+    // Candidates are tested against a depth pyramid from the previous frame, then whatever that culled
+    // is tested again against one built from this frame's first pass. Uses the camera as of EndFrame.
+    void SetOcclusionCulling(bool enabled) { occlusion_culling_enabled_ = enabled; }
+    // From the latest frame that has finished on the GPU
+    OcclusionStats GetOcclusionStats() const { return occlusion_stats_; }
     void EndFrame();
 
-    BufferHandle CreateVertexBuffer(gsl::span<Vertex> vertices);
-    BufferHandle CreateIndexBuffer(gsl::span<std::uint32_t> indices);
+    // The owner tag shows up in the memory report
+    BufferHandle CreateVertexBuffer(gsl::span<const Vertex> vertices, std::string_view owner = "vertex buffer");
+    BufferHandle CreateIndexBuffer(gsl::span<const std::uint32_t> indices, std::string_view owner = "index buffer");
     void DestroyBuffer(BufferHandle handle);
+    // Images stb_image decodes, or KTX2 / DDS files that are uploaded as they are, compressed and with their mips
     TextureHandle CreateTexture(gsl::czstring path);
+    // The contents of such a file already in memory
+    TextureHandle CreateTexture(gsl::span<const std::uint8_t> file_data, std::string_view owner);
+    // Straight from the archive's mapping into staging with every baked mip, nothing is decoded
+    TextureHandle CreateTexture(const AssetArchive& archive, std::string_view name);
     void DestroyTexture(TextureHandle handle);
+    // Uploads run asynchronously and frames wait for them on the GPU, this is only for the CPU side
+    void WaitForUploads();
+    // Safe to call from loader threads. The texture is handed over once its copy has finished, on_ready
+    // then runs inside BeginFrame and the texture can be drawn from that frame on.
+    void StreamTexture(gsl::czstring path, std::function<void(TextureHandle)> on_ready);
+    // An encoded image already in memory, e.g. a file read by AsyncFileReader
+    void StreamTexture(gsl::span<const std::uint8_t> encoded, std::string_view owner,
+                       std::function<void(TextureHandle)> on_ready);
+    void StreamTexture(gsl::span<const std::uint8_t> rgba, glm::ivec2 size, std::string_view owner,
+                       std::function<void(TextureHandle)> on_ready);
+    // mip_count packed levels of any format IsTextureFormatSupported accepts, e.g. from EncodeBcMipChain
+    void StreamTexture(gsl::span<const std::uint8_t> pixels, glm::ivec2 size, VkFormat format, std::uint32_t mip_count,
+                       std::string_view owner, std::function<void(TextureHandle)> on_ready);
+    // Sampled with linear filtering and filled by copies, BCn also needs the device feature
+    bool IsTextureFormatSupported(VkFormat format) const;
+    // Without one uploads share the graphics queue
+    bool HasTransferQueue() const { return transfer_queue_ != VK_NULL_HANDLE; }
+
+    // Loads <path>, e.g. "./particles.comp.spv" as built by add_shaders, or its file name from the shader archive
+    ComputePipelineHandle CreateComputePipeline(
+        gsl::czstring path, gsl::span<ComputeBindingType> bindings, std::uint32_t push_constant_size = 0);
+    void DestroyComputePipeline(ComputePipelineHandle handle);
+    // One resource per binding of the pipeline, in the same order
+    VkDescriptorSet CreateComputeSet(const ComputePipelineHandle& pipeline, gsl::span<ComputeResource> resources);
+    void DestroyComputeSet(VkDescriptorSet set);
+    // Lets the particle vertex shader read the buffer, free it with DestroyComputeSet
+    VkDescriptorSet CreateParticleSet(BufferHandle particles);
+    // Device local, also usable as vertex, index and indirect argument buffer
+    BufferHandle CreateStorageBuffer(VkDeviceSize size, std::string_view owner = "storage buffer");
+    // Starts out in the GENERAL layout, ready for kComputeStorageWrite
+    TextureHandle CreateStorageImage(glm::ivec2 size, VkFormat format, std::string_view owner = "storage image");
+
+    // Recorded into this frame's compute pass, which runs before the scene
+    void RecordCompute(std::function<void(ComputeRecorder&)> record);
+    // Standalone submission outside a frame, later frames wait for it on the GPU like uploads
+    std::uint64_t SubmitCompute(std::function<void(ComputeRecorder&)> record);
+    void WaitForCompute(std::uint64_t value);
+
+    // Runs on a dedicated compute queue when the device has one, overlapping with the frames. The
+    // buffers belong to the compute queue until a frame acquires them back. Call outside a frame.
+    std::uint64_t SubmitAsyncCompute(
+        std::function<void(ComputeRecorder&)> record, gsl::span<AsyncComputeBuffer> buffers = {});
+    // The frame being recorded waits for the submission on the GPU and takes its buffers back first
+    void AcquireAsyncCompute(std::uint64_t submission);
+    // Also hands the buffers of every finished submission no frame has acquired back to the graphics queue
+    void WaitForAsyncCompute(std::uint64_t submission);
+    // Without one async compute falls back to the graphics queue
+    bool HasAsyncComputeQueue() const { return compute_queue_ != VK_NULL_HANDLE; }
+    AsyncComputeStats GetAsyncComputeStats() const { return async_compute_stats_; }
+
+    MemoryStats GetMemoryStats() const { return memory_tracker_.GetStats(); }
+    // What the device allocated for one handle's memory, padding included
+    VkDeviceSize GetAllocationSize(VkDeviceMemory memory) const { return memory_tracker_.GetSize(memory); }
+    void WriteMemoryReport(std::ostream& out) const { memory_tracker_.WriteJson(out); }
+
+    void SetPresentPolicy(PresentPolicy policy);
+    PresentPolicy GetPresentPolicy() const { return present_policy_; }
+    FrameTimeStats GetFrameTimeStats() const { return frame_pacer_.GetStats(); }
+
+    void SetDynamicResolution(bool enabled);
+    // On by default: uploads stage in a persistently mapped ring. Off gives every upload a staging buffer
+    // of its own, for comparison.
+    void SetStagingRing(bool enabled) { staging_ring_enabled_ = enabled; }
+    void SetFrameBudget(double milliseconds) { resolution_controller_.SetFrameBudget(milliseconds); }
+    float GetResolutionScale() const { return resolution_controller_.GetScale(); }
+    std::optional<double> GetLastGpuFrameTime() const { return last_gpu_frame_time_; }
+
+    // Rebuilds every pipeline from the .spv files on disk, later pipelines load from disk too
+    void RecreatePipelines();
 
     private:
 
     struct QueueFamilyIndices {
         std::optional<std::uint32_t> graphics_family = std::nullopt;
         std::optional<std::uint32_t> presentation_family = std::nullopt;
+        // Compute without graphics, usually runs next to the graphics queue
+        std::optional<std::uint32_t> compute_family = std::nullopt;
+        // Transfer only, usually the copy engine
+        std::optional<std::uint32_t> transfer_family = std::nullopt;
 
         bool IsValid() const { return graphics_family.has_value() && presentation_family.has_value(); }
     };
@@ -44,6 +162,22 @@ class Graphics final {
 
         bool IsValid() const { return !formats.empty() && !present_modes.empty(); }
     };
+
+    struct PendingUpload {
+        // Upload queue timeline value of the copy
+        std::uint64_t value = 0;
+        // Where the graphics queue first uses the resource
+        VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+        // Acquire half of the ownership transfer, only with a transfer queue
+        std::optional<VkBufferMemoryBarrier2> buffer_acquire = std::nullopt;
+        std::optional<VkImageMemoryBarrier2> image_acquire = std::nullopt;
+        TextureHandle texture;
+        // Set for streamed textures, the rest go to the next frame whether their copy is done or not
+        std::function<void(TextureHandle)> on_ready;
+        // For the descriptor set a streamed texture gets once it's handed over
+        VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+        std::uint32_t mip_count = 1;
+    };
     
     void InitializeVulkan();
 
@@ -54,27 +188,46 @@ class Graphics final {
     void PickPhysicalDevice();
     void CreateLogicalDeviceAndQueues();
     void CreateSurface();
-    void CreateSwapChain();
+    void CreateSwapChain(VkSwapchainKHR old_swap_chain = VK_NULL_HANDLE);
     void CreateImageViews();
-    void CreateRenderPass();
     void CreateGraphicsPipeline();
-    void CreateFramebuffers();
+    void CreateUpscalePipeline();
+    void CreateParticlePipeline();
+    void CreateRenderGraph();
+    void CreateAsyncCompute();
+    void CreateOcclusionCulling();
+    void CreateHiZ();
     void CreateCommandPool();
     void CreateCommandBuffer();
     void CreateSignals();
+    void CreatePresentSignals();
     void CreateDescriptorSetLayouts();
     void CreateDescriptorPools();
     void CreateDescriptorSets();
     void CreateTextureSampler();
-    void CreateDepthResources();
+    void UpdateRenderExtent();
 
     void RecreateSwapChain();
     void CleanupSwapChain();
 
+    void DeferDestruction(std::function<void()> destroy);
+    void DeferDestruction(std::function<void()> destroy, std::uint64_t retire_value);
+    void FlushDeferredDestruction(bool force = false);
+
     // Rendering
 
     void BeginCommands();
     void EndCommands();
+    void BuildRenderGraph();
+    // The second phase only draws the candidates the first one culled
+    void RecordScene(VkCommandBuffer command_buffer, bool second_phase = false);
+    void WriteCullInputs();
+    void RecordOcclusionCull(VkCommandBuffer command_buffer, std::uint32_t phase);
+    void RecordHiZBuild(VkCommandBuffer command_buffer, VkImageView depth_view);
+    void CollectOcclusionStats();
+    void CleanupOcclusionCulling();
+    void RecordUpscale(VkCommandBuffer command_buffer, VkImageView scene_color_view);
+    VkDescriptorSet GetSceneColorSet(VkImageView scene_color_view);
 
     std::vector<gsl::czstring> GetRequiredInstanceExtensions();
 
@@ -89,6 +242,7 @@ class Graphics final {
     SwapChainProperties GetSwapChainProperties(VkPhysicalDevice device);
     bool IsDeviceSuitable(VkPhysicalDevice device);
     std::vector<VkPhysicalDevice> GetAvailableDevices();
+    std::optional<VkPhysicalDevice> FindDeviceOverride(gsl::span<VkPhysicalDevice> devices);
     bool AreAllDeviceExtensionSupported(VkPhysicalDevice device);
     std::vector<VkExtensionProperties> GetDeviceAvailableExtensions(VkPhysicalDevice device);
     
@@ -96,70 +250,294 @@ class Graphics final {
     VkPresentModeKHR ChooseSwapPresentMode(gsl::span<VkPresentModeKHR> present_modes);
     VkExtent2D ChooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities);
     std::uint32_t ChooseSwapImageCount(const VkSurfaceCapabilitiesKHR& capabilities);
+    void ReportFrameTimeStats();
+    void ReportAsyncComputeStats();
 
-    VkShaderModule CreateShaderModule(gsl::span<std::uint8_t> buffer);
+    void TakeUploads();
+    void ReleaseFinishedStaging(bool force = false);
+    void CollectAsyncComputeTimes();
+    void AddFrameInterval(const GpuInterval& interval);
+    void AddAsyncComputeInterval(const GpuInterval& interval);
+
+    VkShaderModule CreateShaderModule(gsl::span<const std::uint8_t> buffer);
+    // From the shader archive when it has the file, the loose file otherwise or once shaders_from_disk_ is set
+    VkShaderModule LoadShaderModule(const std::filesystem::path& path);
 
     std::uint32_t FindMemoryType(std::uint32_t type_bits_filter, VkMemoryPropertyFlags required_properties);
 
-    BufferHandle CreateBuffer(VkDeviceSize size, VkBufferCreateFlags usage, VkMemoryPropertyFlags properties);
+    VkDeviceMemory AllocateMemory(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                                  MemoryUsage usage, std::string_view owner);
+    void FreeMemory(VkDeviceMemory memory);
+
+    BufferHandle CreateBuffer(VkDeviceSize size, VkBufferCreateFlags usage, VkMemoryPropertyFlags properties,
+                              MemoryUsage memory_usage, std::string_view owner);
+    // Where an upload's data goes: a piece of the staging ring, or a buffer of its own when the ring can't
+    // fit it right now. Either way it is mapped and released once the upload has finished.
+    struct StagingSlice {
+        BufferHandle buffer;
+        VkDeviceSize offset = 0;
+        std::uint8_t* data = nullptr;
+        bool from_ring = false;
+    };
+    StagingSlice AllocateStaging(VkDeviceSize size, std::string_view owner);
+    // Gives back staging that will never be submitted, when creating the upload's destination threw
+    void AbandonStaging(const StagingSlice& staging);
+    void CreateStagingRing();
+    // Both are thread safe and run on the upload queue
+    BufferHandle UploadBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage, ResourceUsage target,
+                              std::string_view owner);
+    // pixels holds mip_count tightly packed levels of format
+    TextureHandle UploadTexture(gsl::span<const std::uint8_t> pixels, glm::ivec2 size, std::string_view owner,
+                                std::function<void(TextureHandle)> on_ready = nullptr,
+                                VkFormat format = VK_FORMAT_R8G8B8A8_SRGB, std::uint32_t mip_count = 1);
+    // One region per level, largest first
+    TextureHandle UploadTextureLevels(gsl::span<const gsl::span<const std::uint8_t>> levels, glm::ivec2 size,
+                                      VkFormat format, std::string_view owner,
+                                      std::function<void(TextureHandle)> on_ready = nullptr);
+    // mip_count packed levels already in staging
+    TextureHandle SubmitTextureUpload(const StagingSlice& staging, glm::ivec2 size, VkFormat format,
+                                      std::uint32_t mip_count, std::string_view owner,
+                                      std::function<void(TextureHandle)> on_ready);
+    // Anything stb_image reads, decoded into staging as RGBA8
+    TextureHandle DecodeTexture(gsl::span<const std::uint8_t> encoded, std::string_view owner,
+                                std::function<void(TextureHandle)> on_ready = nullptr);
+    void QueueUpload(PendingUpload upload, const StagingSlice& staging);
     VkCommandBuffer BeginTransientCommandBuffer();
-    void EndTransientCommandBuffer(VkCommandBuffer command_buffer);
+    std::uint64_t SubmitTransientCommandBuffer(VkCommandBuffer command_buffer);
+    void DestroyBufferNow(BufferHandle handle);
     void CreateUniformBuffers();
-
-    TextureHandle CreateImage(glm::ivec2 size, VkFormat image_format, VkBufferCreateFlags usage, VkMemoryPropertyFlags properties);
-    void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout);
-    void CopyBufferToImage(VkBuffer buffer, VkImage image, glm::ivec2 image_size);
-    VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flag);
-
-    VkViewport GetViewport();
-    VkRect2D GetScissor();
-
-    std::array<gsl::czstring, 1> required_device_extensions_ = {
+    std::uint32_t WriteUniformData(const void* data, VkDeviceSize size);
+
+    TextureHandle CreateImage(glm::ivec2 size, VkFormat image_format, VkBufferCreateFlags usage, VkMemoryPropertyFlags properties,
+                              MemoryUsage memory_usage, std::string_view owner, std::uint32_t mip_levels = 1);
+    void CopyBufferToImage(VkCommandBuffer command_buffer, VkBuffer buffer, VkDeviceSize buffer_offset, VkImage image,
+                           glm::ivec2 image_size, VkFormat format = VK_FORMAT_R8G8B8A8_SRGB,
+                           std::uint32_t mip_count = 1);
+    VkImageView CreateImageView(VkImage image, VkFormat format, VkImageAspectFlags aspect_flag,
+                                std::uint32_t base_mip = 0, std::uint32_t mip_count = 1);
+    void DestroyTextureNow(TextureHandle handle);
+    void CreateTextureSet(TextureHandle& handle, VkFormat format = VK_FORMAT_R8G8B8A8_SRGB,
+                          std::uint32_t mip_count = 1);
+
+    VkViewport GetViewport(VkExtent2D extent);
+    VkRect2D GetScissor(VkExtent2D extent);
+
+    std::vector<gsl::czstring> required_device_extensions_ = {
         VK_KHR_SWAPCHAIN_EXTENSION_NAME
     };
 
     VkInstance instance_ = VK_NULL_HANDLE;
-    VkDebugUtilsMessengerEXT debug_messenger_;
+    std::uint32_t instance_api_version_ = VK_API_VERSION_1_1;
+    VkDebugUtilsMessengerEXT debug_messenger_ = VK_NULL_HANDLE;
 
     VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+    DeviceCapabilities capabilities_;
     VkDevice logical_device_ = VK_NULL_HANDLE;
     VkQueue graphics_queue_ = VK_NULL_HANDLE;
     VkQueue present_queue_ = VK_NULL_HANDLE;
+    GpuTimeline graphics_timeline_;
+    std::uint32_t graphics_family_ = 0;
+    // Graphics timeline value of the newest transient submission, e.g. standalone compute or an image
+    // transition, the next frame waits for it
+    std::uint64_t pending_transient_value_ = 0;
+
+    // Null without a transfer only family
+    VkQueue transfer_queue_ = VK_NULL_HANDLE;
+    std::uint32_t transfer_family_ = 0;
+    GpuTimeline transfer_timeline_;
+    // On the transfer queue if there is one, the graphics queue otherwise
+    UploadQueue upload_queue_;
+
+    // Filled from any thread
+    std::mutex upload_mutex_;
+    std::vector<PendingUpload> pending_uploads_;
+    // Upload queue timeline values after which the staging buffers can go
+    std::vector<std::pair<std::uint64_t, BufferHandle>> upload_staging_;
+    // Persistently mapped, most uploads stage here instead of allocating and mapping a buffer each
+    static constexpr VkDeviceSize kStagingRingSize = 64ull << 20;
+    BufferHandle staging_ring_buffer_;
+    StagingRing staging_ring_;
+    bool staging_ring_enabled_ = true;
+    // Handed over to the frame being recorded
+    std::vector<PendingUpload> frame_uploads_;
+    MemoryTracker memory_tracker_;
 
     VkSurfaceKHR surface_ = VK_NULL_HANDLE;
     VkSwapchainKHR swap_chain_ = VK_NULL_HANDLE;
     VkSurfaceFormatKHR surface_format_;
     VkPresentModeKHR present_mode_;
+    PresentPolicy present_policy_ = PresentPolicy::kLowLatency;
+    FramePacer frame_pacer_;
     VkExtent2D extent_;
     std::vector<VkImage> swap_chain_images_;
     std::vector<VkImageView> swap_chain_image_views_;
-    std::vector<VkFramebuffer> swap_chain_framebuffers_;
 
+    // Kept open, pipelines are created again whenever the swap chain is
+    AssetArchive shader_archive_;
+    // Set by RecreatePipelines, so edited shaders win over the baked copies
+    bool shaders_from_disk_ = false;
     VkPipelineLayout pipeline_layout_ = VK_NULL_HANDLE;
-    VkRenderPass render_pass_ = VK_NULL_HANDLE;
     VkPipeline pipeline_ = VK_NULL_HANDLE;
 
+    // Shares the push constants and the first two sets with pipeline_, so switching keeps them bound
+    VkDescriptorSetLayout particle_set_layout_ = VK_NULL_HANDLE;
+    VkPipelineLayout particle_pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline particle_pipeline_ = VK_NULL_HANDLE;
+
+    // The scene renders into a transient at render_extent_, then gets upscaled to the swap chain
+    VkPipelineLayout upscale_pipeline_layout_ = VK_NULL_HANDLE;
+    VkPipeline upscale_pipeline_ = VK_NULL_HANDLE;
+    VkExtent2D render_extent_;
+    RenderGraph render_graph_;
+    // Rewritten whenever the graph hands out a different scene color view
+    VkDescriptorSet scene_color_set_ = VK_NULL_HANDLE;
+    VkImageView scene_color_view_ = VK_NULL_HANDLE;
+    GpuProfiler gpu_profiler_;
+    std::optional<double> last_gpu_frame_time_ = std::nullopt;
+    ResolutionController resolution_controller_;
+    bool dynamic_resolution_enabled_ = true;
+
+    static constexpr std::uint32_t kMaxFramesInFlight = 2;
+
+    struct Frame {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        VkSemaphore image_available_signal = VK_NULL_HANDLE;
+        // Graphics timeline value signaled when the frame's commands have finished
+        std::uint64_t timeline_value = 0;
+        // Occlusion culled draws, their stats are read back once the frame is done
+        std::uint32_t cull_candidates = 0;
+    };
+
     VkCommandPool command_pool_ = VK_NULL_HANDLE;
+    std::array<Frame, kMaxFramesInFlight> frames_;
+    std::uint32_t frame_index_ = 0;
+    // The command buffer of the frame being recorded
     VkCommandBuffer command_buffer_ = VK_NULL_HANDLE;
 
-    VkSemaphore image_available_signal_ = VK_NULL_HANDLE;
-    VkSemaphore render_finished_signal_ = VK_NULL_HANDLE;
-    VkFence still_rendering_fence_ = VK_NULL_HANDLE;
+    // One per swap chain image, the presentation engine holds on to them until the image comes back
+    std::vector<VkSemaphore> render_finished_signals_;
 
     std::uint32_t current_image_index_ = 0;
 
+    // Stands in for the value of the frame being recorded until EndFrame submits it
+    static constexpr std::uint64_t kPendingFrameValue = UINT64_MAX;
+
+    // A resource can be in flight on every queue, it goes once each timeline has passed its value
+    struct DeferredDestruction {
+        std::uint64_t retire_value;
+        std::uint64_t transfer_value = 0;
+        std::uint64_t compute_value = 0;
+        std::function<void()> destroy;
+    };
+
+    std::deque<DeferredDestruction> deferred_destructions_;
+
     VkDescriptorSetLayout uniform_set_layout_ = VK_NULL_HANDLE;
     VkDescriptorPool uniform_pool_ = VK_NULL_HANDLE;
     VkDescriptorSet uniform_set_ = VK_NULL_HANDLE;
+    // Persistently mapped ring, kUniformSlotsPerFrame aligned slots for every frame in flight
+    static constexpr std::uint32_t kUniformSlotsPerFrame = 256;
     BufferHandle uniform_buffer_;
-    void* uniform_buffer_location_;
+    std::uint8_t* uniform_buffer_location_ = nullptr;
+    VkDeviceSize uniform_slot_size_ = 0;
+    std::uint32_t uniform_slots_used_ = 0;
+    std::uint32_t uniform_offset_ = 0;
+    bool frame_in_progress_ = false;
+    UniformTransformations view_projection_ = {glm::mat4(1.0f), glm::mat4(1.0f)};
+
+    // Draws are recorded when the graph executes the scene pass
+    struct DrawCommand {
+        VkBuffer vertex_buffer = VK_NULL_HANDLE;
+        VkBuffer index_buffer = VK_NULL_HANDLE;
+        std::uint32_t count = 0;
+        glm::mat4 model = glm::mat4(1.0f);
+        VkDescriptorSet texture_set = VK_NULL_HANDLE;
+        std::uint32_t uniform_offset = 0;
+        // Set for particle draws, the count comes from indirect_buffer
+        VkDescriptorSet particle_set = VK_NULL_HANDLE;
+        VkBuffer indirect_buffer = VK_NULL_HANDLE;
+        VkDeviceSize indirect_offset = 0;
+        // Into cull_objects_, the instance count comes from the culling passes
+        std::uint32_t cull_index = UINT32_MAX;
+    };
+
+    std::vector<DrawCommand> draw_commands_;
+    glm::mat4 model_matrix_ = glm::mat4(1.0f);
+    VkDescriptorSet texture_set_ = VK_NULL_HANDLE;
+    std::vector<std::function<void(ComputeRecorder&)>> compute_records_;
+    std::optional<std::pair<glm::vec3, glm::vec3>> next_bounds_ = std::nullopt;
 
     VkDescriptorSetLayout texture_set_layout_ = VK_NULL_HANDLE;
     VkDescriptorPool texture_pool_ = VK_NULL_HANDLE;
     VkSampler texture_sampler_ = VK_NULL_HANDLE;
-    TextureHandle depth_texture_;
 
-    gsl::not_null<Window*> window_;
+    VkDescriptorPool compute_pool_ = VK_NULL_HANDLE;
+
+    // Null without a dedicated compute family
+    VkQueue compute_queue_ = VK_NULL_HANDLE;
+    std::uint32_t compute_family_ = 0;
+    GpuTimeline compute_timeline_;
+    VkCommandPool compute_command_pool_ = VK_NULL_HANDLE;
+
+    static constexpr std::uint32_t kMaxAsyncComputeInFlight = 4;
+
+    struct AsyncComputeSlot {
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        // Compute timeline value of the submission that last used the slot
+        std::uint64_t value = 0;
+    };
+
+    std::array<AsyncComputeSlot, kMaxAsyncComputeInFlight> async_compute_slots_;
+    GpuProfiler async_compute_profiler_;
+
+    struct PendingAcquire {
+        std::uint64_t submission;
+        std::vector<AsyncComputeBuffer> buffers;
+    };
+
+    std::vector<PendingAcquire> pending_acquires_;
+    // What the frame being recorded takes back from async compute
+    std::vector<AsyncComputeBuffer> frame_acquires_;
+    std::uint64_t frame_compute_wait_ = 0;
+    VkPipelineStageFlags2 frame_compute_wait_stage_ = VK_PIPELINE_STAGE_2_NONE;
+
+    // Recent work on both queues, new intervals are checked against the other side for overlap
+    static constexpr std::size_t kOverlapHistory = 8;
+    std::deque<GpuInterval> recent_frame_intervals_;
+    std::deque<GpuInterval> recent_compute_intervals_;
+    AsyncComputeStats async_compute_stats_;
+
+    // Past this many candidates in a frame draws are no longer culled
+    static constexpr std::uint32_t kMaxCullObjects = 16384;
+    bool occlusion_culling_enabled_ = true;
+    std::vector<CullObject> cull_objects_;
+    ComputePipelineHandle hi_z_pipeline_;
+    ComputePipelineHandle cull_pipeline_;
+
+    // Max depth pyramid, kept in the GENERAL layout. image_view covers every mip for the culling pass.
+    TextureHandle hi_z_;
+    VkExtent2D hi_z_extent_ = {0, 0};
+    std::vector<VkImageView> hi_z_mip_views_;
+    // Set i builds mip i, the first one reads the depth buffer and follows its view
+    std::vector<VkDescriptorSet> hi_z_sets_;
+    VkImageView hi_z_depth_view_ = VK_NULL_HANDLE;
+    // The camera the pyramid was built with
+    glm::mat4 hi_z_view_projection_ = glm::mat4(1.0f);
+
+    // Host visible, one CullCamera, kMaxCullObjects objects and four stats counters per frame in flight
+    BufferHandle cull_cameras_;
+    CullCamera* cull_cameras_location_ = nullptr;
+    BufferHandle cull_objects_buffer_;
+    CullObject* cull_objects_location_ = nullptr;
+    BufferHandle cull_stats_;
+    std::uint32_t* cull_stats_location_ = nullptr;
+    // VkDrawIndexedIndirectCommand per candidate, kMaxCullObjects for each phase
+    BufferHandle cull_draws_;
+    VkDescriptorSet cull_set_ = VK_NULL_HANDLE;
+    OcclusionStats occlusion_stats_;
+
+    // Null when headless
+    Window* window_ = nullptr;
     bool validation_enabled_ = false;
 };
 
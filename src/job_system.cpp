@@ -0,0 +1,85 @@
+#include <precomp.h>
+#include <job_system.h>
+#include <algorithm>
+
+namespace veng {
+
+    JobSystem::JobSystem(std::uint32_t worker_count) {
+        workers_.reserve(worker_count);
+        for (std::uint32_t i = 0; i < worker_count; i++) {
+            workers_.emplace_back([this]() { WorkerLoop(); });
+        }
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        work_available_.notify_all();
+
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void JobSystem::ParallelFor(std::uint32_t count, std::uint32_t batch_size,
+                                const std::function<void(std::uint32_t, std::uint32_t)>& job) {
+        batch_size = std::max(batch_size, 1u);
+        // Waking the workers costs more than a single batch
+        if (workers_.empty() || count <= batch_size) {
+            if (count > 0) {
+                job(0, count);
+            }
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex_);
+            job_ = &job;
+            count_ = count;
+            batch_size_ = batch_size;
+            next_batch_.store(0, std::memory_order_relaxed);
+            active_workers_ = workers_.size();
+            generation_++;
+        }
+        work_available_.notify_all();
+
+        RunBatches();
+
+        // job lives on the caller's stack, every worker has to be done with it
+        std::unique_lock lock(mutex_);
+        work_done_.wait(lock, [this]() { return active_workers_ == 0; });
+        job_ = nullptr;
+    }
+
+    void JobSystem::WorkerLoop() {
+        std::uint64_t seen_generation = 0;
+        while (true) {
+            {
+                std::unique_lock lock(mutex_);
+                work_available_.wait(lock, [&]() { return stopping_ || generation_ != seen_generation; });
+                if (stopping_) {
+                    return;
+                }
+                seen_generation = generation_;
+            }
+
+            RunBatches();
+
+            std::lock_guard lock(mutex_);
+            if (--active_workers_ == 0) {
+                work_done_.notify_one();
+            }
+        }
+    }
+
+    void JobSystem::RunBatches() {
+        std::uint32_t batch_count = (count_ + batch_size_ - 1) / batch_size_;
+        for (std::uint32_t batch = next_batch_.fetch_add(1, std::memory_order_relaxed); batch < batch_count;
+             batch = next_batch_.fetch_add(1, std::memory_order_relaxed)) {
+            std::uint32_t begin = batch * batch_size_;
+            (*job_)(begin, std::min(begin + batch_size_, count_));
+        }
+    }
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace veng {
+
+    // A fixed set of workers that split index ranges between them. The calling thread works on the
+    // range too, so a system without workers simply runs everything inline.
+    class JobSystem {
+        public:
+        // Defaults to one worker per core next to the calling thread
+        explicit JobSystem(std::uint32_t worker_count = std::max(std::thread::hardware_concurrency(), 1u) - 1);
+        ~JobSystem();
+        JobSystem(const JobSystem&) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+
+        // Calls job(begin, end) on batches of at most batch_size indices and returns once all of
+        // [0, count) is done. Not reentrant, a job must not call ParallelFor again.
+        void ParallelFor(std::uint32_t count, std::uint32_t batch_size,
+                         const std::function<void(std::uint32_t begin, std::uint32_t end)>& job);
+
+        std::uint32_t GetWorkerCount() const { return workers_.size(); }
+
+        private:
+        void WorkerLoop();
+        void RunBatches();
+
+        std::vector<std::thread> workers_;
+
+        std::mutex mutex_;
+        std::condition_variable work_available_;
+        std::condition_variable work_done_;
+        // Bumped for every ParallelFor so workers can tell a new range from a spurious wakeup
+        std::uint64_t generation_ = 0;
+        std::uint32_t active_workers_ = 0;
+        bool stopping_ = false;
+
+        const std::function<void(std::uint32_t, std::uint32_t)>* job_ = nullptr;
+        std::uint32_t count_ = 0;
+        std::uint32_t batch_size_ = 1;
+        std::atomic<std::uint32_t> next_batch_ = 0;
+    };
+}
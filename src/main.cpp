@@ -5,6 +5,7 @@
 #include <glfw_window.h>
 #include <graphics.h>
 #include <glm/gtc/matrix_transform.hpp>
+#include <fstream>
 
 std::int32_t main(std::int32_t argc, gsl::zstring* argv) {
 
@@ -13,7 +14,26 @@ std::int32_t main(std::int32_t argc, gsl::zstring* argv) {
     veng::Window window("Vulkan Engine", {800, 600});
     window.TryMoveToMonitor(0);     // default to 0, change to other if needed
 
-    veng::Graphics graphics(&window);
+    veng::Graphics graphics(&window, "assets.vpak");
+
+    // --present=low-latency|vsync|uncapped|power-saving, keys 1-4 switch at runtime
+    constexpr std::string_view kPresentArgument = "--present=";
+    for (gsl::czstring argument : gsl::span<gsl::zstring>(argv, argc)) {
+        std::string_view value(argument);
+        if (value.starts_with(kPresentArgument)) {
+            std::optional<veng::PresentPolicy> policy = veng::ParsePresentPolicy(value.substr(kPresentArgument.size()));
+            if (policy.has_value()) {
+                graphics.SetPresentPolicy(policy.value());
+            }
+        }
+    }
+
+    constexpr std::array<std::pair<std::int32_t, veng::PresentPolicy>, 4> kPolicyKeys = {{
+        {GLFW_KEY_1, veng::PresentPolicy::kLowLatency},
+        {GLFW_KEY_2, veng::PresentPolicy::kVsync},
+        {GLFW_KEY_3, veng::PresentPolicy::kUncapped},
+        {GLFW_KEY_4, veng::PresentPolicy::kPowerSaving},
+    }};
 
     std::array<veng::Vertex, 4> vertices = {
         veng::Vertex{{-0.5f, -0.5f, 0.0f}, {0.0f, 1.0f}},   // top - left
@@ -35,10 +55,29 @@ std::int32_t main(std::int32_t argc, gsl::zstring* argv) {
     glm::mat4 projection = glm::perspective(glm::radians(60.0f), 800.0f / 600.0f, 0.1f, 100.0f);
     graphics.SetViewProjection(view, projection);
 
-    veng::TextureHandle texture = graphics.CreateTexture("paving-stones.jpg");
+    // Baked by the build with every mip, the loose file is only the fallback for builds without the tools
+    veng::AssetArchive assets("assets.vpak");
+    veng::TextureHandle texture = assets.IsOpen() ? graphics.CreateTexture(assets, "paving-stones.jpg")
+                                                  : graphics.CreateTexture("paving-stones.jpg");
+
+    // M dumps every device allocation to memory_report.json
+    bool memory_key_down = false;
     
     while (!window.ShouldClose()) {
         glfwPollEvents();   // not window specific
+        for (auto [key, policy] : kPolicyKeys) {
+            if (glfwGetKey(window.GetHandle(), key) == GLFW_PRESS) {
+                graphics.SetPresentPolicy(policy);
+            }
+        }
+
+        bool memory_key_pressed = glfwGetKey(window.GetHandle(), GLFW_KEY_M) == GLFW_PRESS;
+        if (memory_key_pressed && !memory_key_down) {
+            std::ofstream report("memory_report.json");
+            graphics.WriteMemoryReport(report);
+        }
+        memory_key_down = memory_key_pressed;
+
         if (graphics.BeginFrame()) {
             graphics.SetTexture(texture);
 
@@ -0,0 +1,136 @@
+#include <precomp.h>
+#include <mapped_file.h>
+#include <spdlog/spdlog.h>
+#include <limits>
+#include <utility>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace veng {
+
+    namespace {
+
+        // Null when the file can't be mapped, the handle is closed either way since a mapping
+        // keeps the file alive on its own
+        void* MapFile(const std::filesystem::path& path, std::size_t size, FileAccess access) {
+#if defined(_WIN32)
+            DWORD flags = access == FileAccess::kSequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+            HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, flags,
+                                      nullptr);
+            if (file == INVALID_HANDLE_VALUE) {
+                return nullptr;
+            }
+            HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            CloseHandle(file);
+            if (mapping == nullptr) {
+                return nullptr;
+            }
+            void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, size);
+            CloseHandle(mapping);
+
+            if (view != nullptr && access == FileAccess::kSequential) {
+                WIN32_MEMORY_RANGE_ENTRY range = {view, size};
+                PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+            }
+            return view;
+#else
+            int file = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+            if (file < 0) {
+                return nullptr;
+            }
+            void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+            close(file);
+            if (view == MAP_FAILED) {
+                return nullptr;
+            }
+
+            // Advice only, a kernel that ignores it still serves the pages
+            if (access == FileAccess::kSequential) {
+                madvise(view, size, MADV_SEQUENTIAL);
+                madvise(view, size, MADV_WILLNEED);
+            } else {
+                madvise(view, size, MADV_RANDOM);
+            }
+            return view;
+#endif
+        }
+
+        void UnmapFile(void* view, std::size_t size) {
+#if defined(_WIN32)
+            UnmapViewOfFile(view);
+#else
+            munmap(view, size);
+#endif
+        }
+    }
+
+    MappedFile::MappedFile(const std::filesystem::path& path, FileAccess access) {
+        std::error_code error;
+        if (!std::filesystem::is_regular_file(path, error)) {
+            return;
+        }
+        std::uintmax_t size = std::filesystem::file_size(path, error);
+        if (error || size > std::numeric_limits<std::size_t>::max()) {
+            return;
+        }
+
+        // Nothing to map, but the file is there
+        static constexpr std::uint8_t kEmpty = 0;
+        if (size == 0) {
+            data_ = &kEmpty;
+            return;
+        }
+
+        size_ = size;
+        mapping_ = MapFile(path, size_, access);
+        if (mapping_ != nullptr) {
+            data_ = static_cast<const std::uint8_t*>(mapping_);
+            return;
+        }
+
+        spdlog::warn("Cannot map {}, reading it instead", path.string());
+        contents_ = ReadFile(path);
+        if (contents_.size() == size_) {
+            data_ = contents_.data();
+        } else {
+            size_ = 0;
+        }
+    }
+
+    MappedFile::~MappedFile() {
+        Close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+        if (this != &other) {
+            Close();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            mapping_ = std::exchange(other.mapping_, nullptr);
+            contents_ = std::move(other.contents_);
+        }
+        return *this;
+    }
+
+    void MappedFile::Close() {
+        if (mapping_ != nullptr) {
+            UnmapFile(mapping_, size_);
+        }
+        data_ = nullptr;
+        size_ = 0;
+        mapping_ = nullptr;
+        contents_.clear();
+    }
+}
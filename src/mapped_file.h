@@ -0,0 +1,44 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+
+namespace veng {
+
+    // Tells the kernel how the mapping is going to be read
+    enum class FileAccess {
+        // Read front to back once, e.g. an image or shader handed to a decoder. Read ahead aggressively.
+        kSequential,
+        // Jumped around in, e.g. an archive with a table of contents
+        kRandom,
+    };
+
+    // A read only view of a whole file. The pages come straight from the page cache, so consumers read
+    // the file without a copy into a user space buffer. Falls back to ReadFile when the file can't be
+    // mapped, and is empty when it can't be read at all.
+    class MappedFile {
+        public:
+        MappedFile() = default;
+        explicit MappedFile(const std::filesystem::path& path, FileAccess access = FileAccess::kSequential);
+        ~MappedFile();
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool IsOpen() const { return data_ != nullptr; }
+        bool IsMapped() const { return mapping_ != nullptr; }
+        // Page aligned when mapped, so SPIR-V and other word sized data can be read in place
+        gsl::span<const std::uint8_t> GetData() const { return {data_, size_}; }
+        std::size_t GetSize() const { return size_; }
+
+        private:
+        void Close();
+
+        const std::uint8_t* data_ = nullptr;
+        std::size_t size_ = 0;
+        void* mapping_ = nullptr;
+        // Only used by the fallback
+        std::vector<std::uint8_t> contents_;
+    };
+}
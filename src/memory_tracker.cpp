@@ -0,0 +1,192 @@
+#include <precomp.h>
+#include <memory_tracker.h>
+
+namespace veng {
+
+    gsl::czstring ToString(MemoryUsage usage) {
+        switch (usage) {
+        case MemoryUsage::kBuffer:
+            return "buffer";
+        case MemoryUsage::kImage:
+            return "image";
+        case MemoryUsage::kStaging:
+            return "staging";
+        case MemoryUsage::kInternal:
+            return "internal";
+        }
+        return "unknown";
+    }
+
+    void MemoryTracker::Initialize(VkPhysicalDevice physical_device, bool budget_supported) {
+        physical_device_ = physical_device;
+        budget_supported_ = budget_supported;
+        vkGetPhysicalDeviceMemoryProperties(physical_device, &memory_properties_);
+
+        heap_allocated_.assign(memory_properties_.memoryHeapCount, 0);
+        heap_peak_allocated_.assign(memory_properties_.memoryHeapCount, 0);
+    }
+
+    void MemoryTracker::Track(VkDeviceMemory memory, VkDeviceSize size, std::uint32_t memory_type,
+                              MemoryUsage usage, std::string_view owner) {
+        std::lock_guard lock(mutex_);
+        allocations_[memory] = {size, memory_type, usage, std::string(owner)};
+
+        std::uint32_t heap = memory_properties_.memoryTypes[memory_type].heapIndex;
+        heap_allocated_[heap] += size;
+        heap_peak_allocated_[heap] = std::max(heap_peak_allocated_[heap], heap_allocated_[heap]);
+    }
+
+    void MemoryTracker::Untrack(VkDeviceMemory memory) {
+        std::lock_guard lock(mutex_);
+        auto allocation = allocations_.find(memory);
+        if (allocation == allocations_.end()) {
+            return;
+        }
+
+        std::uint32_t heap = memory_properties_.memoryTypes[allocation->second.memory_type].heapIndex;
+        heap_allocated_[heap] -= allocation->second.size;
+        allocations_.erase(allocation);
+    }
+
+    VkDeviceSize MemoryTracker::GetSize(VkDeviceMemory memory) const {
+        std::lock_guard lock(mutex_);
+        auto allocation = allocations_.find(memory);
+        return allocation == allocations_.end() ? 0 : allocation->second.size;
+    }
+
+    void MemoryTracker::QueryBudgets(MemoryStats& stats) const {
+        if (!budget_supported_) {
+            return;
+        }
+
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budget_properties = {};
+        budget_properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+        VkPhysicalDeviceMemoryProperties2 properties = {};
+        properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        properties.pNext = &budget_properties;
+        vkGetPhysicalDeviceMemoryProperties2(physical_device_, &properties);
+
+        for (std::uint32_t i = 0; i < stats.heaps.size(); i++) {
+            stats.heaps[i].budget = budget_properties.heapBudget[i];
+            stats.heaps[i].driver_usage = budget_properties.heapUsage[i];
+        }
+    }
+
+    VkDeviceSize MemoryTracker::GetAvailableBytes(std::uint32_t heap_index) const {
+        if (budget_supported_) {
+            MemoryStats stats;
+            stats.heaps.resize(memory_properties_.memoryHeapCount);
+            QueryBudgets(stats);
+
+            const MemoryHeapStats& heap = stats.heaps[heap_index];
+            return heap.budget.value() > heap.driver_usage.value() ? heap.budget.value() - heap.driver_usage.value() : 0;
+        }
+
+        std::lock_guard lock(mutex_);
+        VkDeviceSize heap_size = memory_properties_.memoryHeaps[heap_index].size;
+        return heap_size > heap_allocated_[heap_index] ? heap_size - heap_allocated_[heap_index] : 0;
+    }
+
+    MemoryStats MemoryTracker::GetStats() const {
+        std::lock_guard lock(mutex_);
+        MemoryStats stats;
+
+        gsl::span<const VkMemoryHeap> heaps(memory_properties_.memoryHeaps, memory_properties_.memoryHeapCount);
+        for (std::uint32_t i = 0; i < heaps.size(); i++) {
+            MemoryHeapStats heap_stats;
+            heap_stats.size = heaps[i].size;
+            heap_stats.device_local = heaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+            heap_stats.allocated = heap_allocated_[i];
+            heap_stats.peak_allocated = heap_peak_allocated_[i];
+            stats.heaps.push_back(heap_stats);
+        }
+
+        gsl::span<const VkMemoryType> types(memory_properties_.memoryTypes, memory_properties_.memoryTypeCount);
+        for (const VkMemoryType& type : types) {
+            stats.types.push_back({type.heapIndex, type.propertyFlags});
+        }
+
+        for (const auto& [memory, allocation] : allocations_) {
+            stats.types[allocation.memory_type].allocated += allocation.size;
+            stats.types[allocation.memory_type].allocation_count++;
+            stats.heaps[types[allocation.memory_type].heapIndex].allocation_count++;
+            stats.allocated_by_usage[static_cast<std::size_t>(allocation.usage)] += allocation.size;
+            stats.total_allocated += allocation.size;
+            stats.allocation_count++;
+        }
+
+        QueryBudgets(stats);
+        return stats;
+    }
+
+    static std::string EscapeJson(std::string_view text) {
+        std::string escaped;
+        for (char character : text) {
+            if (character == '"' || character == '\\') {
+                escaped.push_back('\\');
+            }
+            escaped.push_back(character);
+        }
+        return escaped;
+    }
+
+    void MemoryTracker::WriteJson(std::ostream& out) const {
+        MemoryStats stats = GetStats();
+        std::lock_guard lock(mutex_);
+
+        out << "{\n";
+        out << "  \"total_allocated\": " << stats.total_allocated << ",\n";
+        out << "  \"allocation_count\": " << stats.allocation_count << ",\n";
+
+        out << "  \"usage\": {";
+        for (std::size_t i = 0; i < stats.allocated_by_usage.size(); i++) {
+            out << "\"" << ToString(static_cast<MemoryUsage>(i)) << "\": " << stats.allocated_by_usage[i]
+                << (i + 1 < stats.allocated_by_usage.size() ? ", " : "");
+        }
+        out << "},\n";
+
+        out << "  \"heaps\": [\n";
+        for (std::size_t i = 0; i < stats.heaps.size(); i++) {
+            const MemoryHeapStats& heap = stats.heaps[i];
+            out << "    {\"index\": " << i << ", \"size\": " << heap.size
+                << ", \"device_local\": " << (heap.device_local ? "true" : "false")
+                << ", \"allocated\": " << heap.allocated << ", \"peak_allocated\": " << heap.peak_allocated
+                << ", \"allocation_count\": " << heap.allocation_count;
+            if (heap.budget.has_value()) {
+                out << ", \"budget\": " << heap.budget.value() << ", \"driver_usage\": " << heap.driver_usage.value();
+            }
+            out << "}" << (i + 1 < stats.heaps.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n";
+
+        out << "  \"types\": [\n";
+        for (std::size_t i = 0; i < stats.types.size(); i++) {
+            const MemoryTypeStats& type = stats.types[i];
+            out << "    {\"index\": " << i << ", \"heap\": " << type.heap_index
+                << ", \"flags\": " << type.property_flags << ", \"allocated\": " << type.allocated
+                << ", \"allocation_count\": " << type.allocation_count << "}"
+                << (i + 1 < stats.types.size() ? ",\n" : "\n");
+        }
+        out << "  ],\n";
+
+        // Largest first, that's where bloat shows up
+        std::vector<const Allocation*> sorted;
+        for (const auto& [memory, allocation] : allocations_) {
+            sorted.push_back(&allocation);
+        }
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const Allocation* a, const Allocation* b) { return a->size > b->size; });
+
+        out << "  \"allocations\": [\n";
+        for (std::size_t i = 0; i < sorted.size(); i++) {
+            const Allocation& allocation = *sorted[i];
+            out << "    {\"size\": " << allocation.size << ", \"type\": " << allocation.memory_type
+                << ", \"heap\": " << memory_properties_.memoryTypes[allocation.memory_type].heapIndex
+                << ", \"usage\": \"" << ToString(allocation.usage) << "\", \"owner\": \""
+                << EscapeJson(allocation.owner) << "\"}" << (i + 1 < sorted.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n";
+        out << "}\n";
+    }
+}
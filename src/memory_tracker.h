@@ -0,0 +1,82 @@
+#pragma once
+
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+#include <vulkan/vulkan.h>
+
+namespace veng {
+
+    enum class MemoryUsage {
+        kBuffer,     // vertex / index buffers
+        kImage,      // textures
+        kStaging,    // host visible upload buffers
+        kInternal,   // render targets, depth, uniform ring
+    };
+
+    gsl::czstring ToString(MemoryUsage usage);
+
+    struct MemoryHeapStats {
+        VkDeviceSize size = 0;
+        bool device_local = false;
+        VkDeviceSize allocated = 0;
+        VkDeviceSize peak_allocated = 0;
+        std::uint32_t allocation_count = 0;
+        // From VK_EXT_memory_budget, includes other processes and driver internals
+        std::optional<VkDeviceSize> budget = std::nullopt;
+        std::optional<VkDeviceSize> driver_usage = std::nullopt;
+    };
+
+    struct MemoryTypeStats {
+        std::uint32_t heap_index = 0;
+        VkMemoryPropertyFlags property_flags = 0;
+        VkDeviceSize allocated = 0;
+        std::uint32_t allocation_count = 0;
+    };
+
+    struct MemoryStats {
+        std::vector<MemoryHeapStats> heaps;
+        std::vector<MemoryTypeStats> types;
+        std::array<VkDeviceSize, 4> allocated_by_usage = {};
+        VkDeviceSize total_allocated = 0;
+        std::uint32_t allocation_count = 0;
+    };
+
+    // Accounts every VkDeviceMemory the engine allocates by heap, type, usage and owner. Thread safe,
+    // uploads allocate from loader threads.
+    class MemoryTracker {
+        public:
+        void Initialize(VkPhysicalDevice physical_device, bool budget_supported);
+
+        void Track(VkDeviceMemory memory, VkDeviceSize size, std::uint32_t memory_type, MemoryUsage usage,
+                   std::string_view owner);
+        void Untrack(VkDeviceMemory memory);
+        // 0 for memory that isn't tracked
+        VkDeviceSize GetSize(VkDeviceMemory memory) const;
+
+        // Remaining budget of the heap, or the unallocated heap size without VK_EXT_memory_budget
+        VkDeviceSize GetAvailableBytes(std::uint32_t heap_index) const;
+
+        MemoryStats GetStats() const;
+        void WriteJson(std::ostream& out) const;
+
+        private:
+        struct Allocation {
+            VkDeviceSize size;
+            std::uint32_t memory_type;
+            MemoryUsage usage;
+            std::string owner;
+        };
+
+        void QueryBudgets(MemoryStats& stats) const;
+
+        VkPhysicalDevice physical_device_ = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties memory_properties_ = {};
+        bool budget_supported_ = false;
+
+        mutable std::mutex mutex_;
+        std::unordered_map<VkDeviceMemory, Allocation> allocations_;
+        std::vector<VkDeviceSize> heap_allocated_;
+        std::vector<VkDeviceSize> heap_peak_allocated_;
+    };
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <buffer_handle.h>
+
+namespace veng {
+	struct MeshHandle {
+		BufferHandle vertices;
+		BufferHandle indices;
+		std::uint32_t index_count = 0;
+	};
+}
\ No newline at end of file
@@ -0,0 +1,19 @@
+#include <precomp.h>
+#include <occlusion_culling.h>
+#include <algorithm>
+#include <bit>
+
+namespace veng {
+
+    VkExtent2D GetHiZExtent(VkExtent2D depth_extent) {
+        return {std::bit_floor(std::max(depth_extent.width, 1u)), std::bit_floor(std::max(depth_extent.height, 1u))};
+    }
+
+    std::uint32_t GetHiZMipCount(VkExtent2D hi_z_extent) {
+        return std::bit_width(std::max(hi_z_extent.width, hi_z_extent.height));
+    }
+
+    VkExtent2D GetHiZMipExtent(VkExtent2D hi_z_extent, std::uint32_t mip) {
+        return {std::max(hi_z_extent.width >> mip, 1u), std::max(hi_z_extent.height >> mip, 1u)};
+    }
+}
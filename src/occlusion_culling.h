@@ -0,0 +1,41 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace veng {
+
+    // Draws that had bounds in the frame, and in which phase they made it through
+    struct OcclusionStats {
+        std::uint32_t candidate_count = 0;
+        // Passed against last frame's pyramid
+        std::uint32_t first_phase_visible = 0;
+        // Culled by the first phase but visible against this frame's, i.e. disoccluded
+        std::uint32_t second_phase_visible = 0;
+
+        std::uint32_t GetDrawnCount() const { return first_phase_visible + second_phase_visible; }
+        std::uint32_t GetCulledCount() const { return candidate_count - GetDrawnCount(); }
+    };
+
+    // Match CullObject and CullCamera in occlusion_cull.comp
+    struct CullObject {
+        glm::mat4 model;
+        glm::vec4 bounds_min;
+        glm::vec4 bounds_max;
+        std::uint32_t index_count;
+        std::uint32_t padding[3];
+    };
+
+    struct CullCamera {
+        glm::mat4 view_projection;
+        // What the pyramid being tested was rendered with
+        glm::mat4 pyramid_view_projection;
+        std::uint32_t object_count;
+        std::uint32_t mip_count;
+        glm::vec2 pyramid_size;
+    };
+
+    // Largest power of two that fits the depth buffer, so every level is exactly half of the one above
+    VkExtent2D GetHiZExtent(VkExtent2D depth_extent);
+    std::uint32_t GetHiZMipCount(VkExtent2D hi_z_extent);
+    VkExtent2D GetHiZMipExtent(VkExtent2D hi_z_extent, std::uint32_t mip);
+}
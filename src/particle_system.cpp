@@ -0,0 +1,159 @@
+#include <precomp.h>
+#include <particle_system.h>
+#include <algorithm>
+#include <cstddef>
+
+namespace veng {
+
+    namespace {
+        // Matches ParticleCounters in particles.glsl
+        struct ParticleCounters {
+            std::uint32_t count[2];
+            VkDispatchIndirectCommand dispatch;
+            VkDrawIndirectCommand draw;
+        };
+
+        struct SimulateConstants {
+            glm::vec4 gravity_delta;
+            std::uint32_t source_index;
+        };
+
+        struct EmitConstants {
+            glm::vec4 origin_radius;
+            glm::vec4 velocity_spread;
+            glm::vec4 color;
+            float lifetime;
+            float size;
+            std::uint32_t count;
+            std::uint32_t seed;
+            std::uint32_t destination_index;
+            std::uint32_t capacity;
+        };
+
+        struct FinalizeConstants {
+            std::uint32_t emitted;
+            std::uint32_t destination_index;
+            std::uint32_t capacity;
+        };
+
+        constexpr std::uint32_t kGroupSize = 256;
+    }
+
+    ParticleSystem::ParticleSystem(Graphics& graphics, std::uint32_t capacity, std::string_view owner)
+        : graphics_(graphics), capacity_(capacity) {
+        // Without subgroup arithmetic every survivor takes its own atomic
+        gsl::czstring simulate_path = graphics_.GetCapabilities().subgroup_arithmetic
+                                          ? "./particle_simulate.comp.spv"
+                                          : "./particle_simulate_atomic.comp.spv";
+
+        std::array<ComputeBindingType, 3> simulate_bindings = {
+            ComputeBindingType::kStorageBuffer, ComputeBindingType::kStorageBuffer, ComputeBindingType::kStorageBuffer};
+        std::array<ComputeBindingType, 2> emit_bindings = {
+            ComputeBindingType::kStorageBuffer, ComputeBindingType::kStorageBuffer};
+        std::array<ComputeBindingType, 1> finalize_bindings = {ComputeBindingType::kStorageBuffer};
+
+        simulate_pipeline_ = graphics_.CreateComputePipeline(simulate_path, simulate_bindings, sizeof(SimulateConstants));
+        emit_pipeline_ = graphics_.CreateComputePipeline("./particle_emit.comp.spv", emit_bindings, sizeof(EmitConstants));
+        finalize_pipeline_ = graphics_.CreateComputePipeline(
+            "./particle_finalize.comp.spv", finalize_bindings, sizeof(FinalizeConstants));
+
+        counters_ = graphics_.CreateStorageBuffer(sizeof(ParticleCounters), owner);
+        for (BufferHandle& particles : particles_) {
+            particles = graphics_.CreateStorageBuffer(static_cast<VkDeviceSize>(capacity_) * sizeof(Particle), owner);
+        }
+
+        for (std::uint32_t i = 0; i < 2; i++) {
+            std::array<ComputeResource, 3> simulate_resources = {counters_, particles_[i], particles_[1 - i]};
+            simulate_sets_[i] = graphics_.CreateComputeSet(simulate_pipeline_, simulate_resources);
+            std::array<ComputeResource, 2> emit_resources = {counters_, particles_[i]};
+            emit_sets_[i] = graphics_.CreateComputeSet(emit_pipeline_, emit_resources);
+            draw_sets_[i] = graphics_.CreateParticleSet(particles_[i]);
+        }
+        std::array<ComputeResource, 1> finalize_resources = {counters_};
+        finalize_set_ = graphics_.CreateComputeSet(finalize_pipeline_, finalize_resources);
+
+        // Zero counts and zero sized indirect arguments until the first Update
+        BufferHandle counters = counters_;
+        graphics_.SubmitCompute([counters](ComputeRecorder& recorder) {
+            vkCmdFillBuffer(recorder.GetCommandBuffer(), counters.buffer, 0, VK_WHOLE_SIZE, 0);
+            recorder.BufferBarrier(counters, ResourceUsage::kTransferDst, ResourceUsage::kIndirectBuffer);
+        });
+    }
+
+    ParticleSystem::~ParticleSystem() {
+        for (std::uint32_t i = 0; i < 2; i++) {
+            graphics_.DestroyComputeSet(simulate_sets_[i]);
+            graphics_.DestroyComputeSet(emit_sets_[i]);
+            graphics_.DestroyComputeSet(draw_sets_[i]);
+            graphics_.DestroyBuffer(particles_[i]);
+        }
+        graphics_.DestroyComputeSet(finalize_set_);
+        graphics_.DestroyBuffer(counters_);
+
+        graphics_.DestroyComputePipeline(simulate_pipeline_);
+        graphics_.DestroyComputePipeline(emit_pipeline_);
+        graphics_.DestroyComputePipeline(finalize_pipeline_);
+    }
+
+    void ParticleSystem::Update(float delta_seconds) {
+        std::uint32_t source = current_;
+        std::uint32_t destination = 1 - current_;
+
+        float emit = emitter_.rate * delta_seconds + emit_remainder_;
+        std::uint32_t emitted = static_cast<std::uint32_t>(emit);
+        emit_remainder_ = emit - static_cast<float>(emitted);
+        emitted = std::min(emitted + burst_, capacity_);
+        burst_ = 0;
+
+        SimulateConstants simulate = {glm::vec4(gravity_, delta_seconds), source};
+        EmitConstants emit_constants = {glm::vec4(emitter_.origin, emitter_.radius),
+                                        glm::vec4(emitter_.velocity, emitter_.spread),
+                                        emitter_.color,
+                                        emitter_.lifetime,
+                                        emitter_.size,
+                                        emitted,
+                                        seed_++,
+                                        destination,
+                                        capacity_};
+        FinalizeConstants finalize = {emitted, destination, capacity_};
+
+        graphics_.RecordCompute([this, source, destination, simulate, emit_constants, finalize](
+                                    ComputeRecorder& recorder) {
+            BufferHandle source_particles = particles_[source];
+            BufferHandle destination_particles = particles_[destination];
+
+            // Last frame's draw read the source, the one before it the destination
+            recorder.BufferBarrier(counters_, ResourceUsage::kIndirectBuffer, ResourceUsage::kComputeStorageWrite);
+            recorder.BufferBarrier(
+                source_particles, ResourceUsage::kVertexStorageRead, ResourceUsage::kComputeStorageRead);
+            recorder.BufferBarrier(
+                destination_particles, ResourceUsage::kVertexStorageRead, ResourceUsage::kComputeStorageWrite);
+
+            recorder.DispatchIndirect(simulate_pipeline_, simulate_sets_[source], counters_,
+                                      offsetof(ParticleCounters, dispatch), &simulate);
+            // Emission appends after the survivors, so it needs their final count
+            recorder.BufferBarrier(counters_, ResourceUsage::kComputeStorageWrite, ResourceUsage::kComputeStorageWrite);
+
+            if (emit_constants.count > 0) {
+                std::uint32_t group_count = (emit_constants.count + kGroupSize - 1) / kGroupSize;
+                recorder.Dispatch(emit_pipeline_, emit_sets_[destination], {group_count, 1, 1}, &emit_constants);
+                recorder.BufferBarrier(
+                    counters_, ResourceUsage::kComputeStorageRead, ResourceUsage::kComputeStorageWrite);
+            }
+
+            // The simulate dispatch read its arguments from the buffer finalize rewrites
+            recorder.BufferBarrier(counters_, ResourceUsage::kIndirectBuffer, ResourceUsage::kComputeStorageWrite);
+            recorder.Dispatch(finalize_pipeline_, finalize_set_, {1, 1, 1}, &finalize);
+
+            recorder.BufferBarrier(counters_, ResourceUsage::kComputeStorageWrite, ResourceUsage::kIndirectBuffer);
+            recorder.BufferBarrier(
+                destination_particles, ResourceUsage::kComputeStorageWrite, ResourceUsage::kVertexStorageRead);
+        });
+
+        current_ = destination;
+    }
+
+    void ParticleSystem::Render() {
+        graphics_.RenderParticles(draw_sets_[current_], counters_, offsetof(ParticleCounters, draw));
+    }
+}
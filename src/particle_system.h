@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <graphics.h>
+
+namespace veng {
+
+    // Matches the Particle struct in particles.glsl
+    struct Particle {
+        glm::vec4 position_size;
+        glm::vec4 velocity_life;
+        glm::vec4 color;
+    };
+
+    struct ParticleEmitter {
+        glm::vec3 origin = glm::vec3(0.0f);
+        // Particles start anywhere in this sphere
+        float radius = 0.0f;
+        glm::vec3 velocity = glm::vec3(0.0f, 1.0f, 0.0f);
+        // Added along a random direction
+        float spread = 0.5f;
+        glm::vec4 color = glm::vec4(1.0f);
+        // Seconds, each particle gets between half and all of it
+        float lifetime = 2.0f;
+        float size = 0.05f;
+        // Particles per second
+        float rate = 1000.0f;
+    };
+
+    // Emission, simulation and drawing all stay on the GPU. Every frame simulates one particle buffer
+    // into the other and drops the dead on the way, so the destination is the compacted alive list and
+    // the CPU never learns how many particles there are.
+    class ParticleSystem {
+        public:
+        ParticleSystem(Graphics& graphics, std::uint32_t capacity, std::string_view owner = "particles");
+        ~ParticleSystem();
+        ParticleSystem(const ParticleSystem&) = delete;
+        ParticleSystem& operator=(const ParticleSystem&) = delete;
+
+        void SetEmitter(const ParticleEmitter& emitter) { emitter_ = emitter; }
+        void SetGravity(glm::vec3 gravity) { gravity_ = gravity; }
+        // Emitted on top of the rate with the next Update
+        void Burst(std::uint32_t count) { burst_ += count; }
+
+        // Both go between BeginFrame and EndFrame, Update records into the frame's compute pass and
+        // Render draws what it produced with the current texture and model matrix
+        void Update(float delta_seconds);
+        void Render();
+
+        std::uint32_t GetCapacity() const { return capacity_; }
+
+        private:
+        Graphics& graphics_;
+        std::uint32_t capacity_;
+
+        ComputePipelineHandle simulate_pipeline_;
+        ComputePipelineHandle emit_pipeline_;
+        ComputePipelineHandle finalize_pipeline_;
+
+        // Alive counts and the indirect arguments the GPU writes for the next frame
+        BufferHandle counters_;
+        std::array<BufferHandle, 2> particles_;
+        // Indexed by the source buffer
+        std::array<VkDescriptorSet, 2> simulate_sets_ = {};
+        // Indexed by the destination buffer
+        std::array<VkDescriptorSet, 2> emit_sets_ = {};
+        std::array<VkDescriptorSet, 2> draw_sets_ = {};
+        VkDescriptorSet finalize_set_ = VK_NULL_HANDLE;
+
+        // The buffer the last Update wrote
+        std::uint32_t current_ = 0;
+        ParticleEmitter emitter_;
+        glm::vec3 gravity_ = glm::vec3(0.0f, -9.81f, 0.0f);
+        float emit_remainder_ = 0.0f;
+        std::uint32_t burst_ = 0;
+        std::uint32_t seed_ = 0;
+    };
+}
@@ -0,0 +1,29 @@
+#include <precomp.h>
+#include <present_policy.h>
+
+namespace veng {
+
+    gsl::czstring ToString(PresentPolicy policy) {
+        switch (policy) {
+            case PresentPolicy::kLowLatency:
+                return "low-latency";
+            case PresentPolicy::kVsync:
+                return "vsync";
+            case PresentPolicy::kUncapped:
+                return "uncapped";
+            case PresentPolicy::kPowerSaving:
+                return "power-saving";
+        }
+        return "unknown";
+    }
+
+    std::optional<PresentPolicy> ParsePresentPolicy(std::string_view name) {
+        for (PresentPolicy policy : {PresentPolicy::kLowLatency, PresentPolicy::kVsync,
+                                     PresentPolicy::kUncapped, PresentPolicy::kPowerSaving}) {
+            if (name == ToString(policy)) {
+                return policy;
+            }
+        }
+        return std::nullopt;
+    }
+}
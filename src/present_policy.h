@@ -0,0 +1,14 @@
+#pragma once
+
+namespace veng {
+
+    enum class PresentPolicy {
+        kLowLatency,    // MAILBOX, then IMMEDIATE; newest frame wins, no CPU cap
+        kVsync,         // FIFO with a spare image for steady pacing
+        kUncapped,      // IMMEDIATE or FIFO_RELAXED, tearing allowed
+        kPowerSaving,   // FIFO with the fewest images and a CPU frame cap
+    };
+
+    gsl::czstring ToString(PresentPolicy policy);
+    std::optional<PresentPolicy> ParsePresentPolicy(std::string_view name);
+}
@@ -0,0 +1,584 @@
+#include <precomp.h>
+#include <render_graph.h>
+#include <algorithm>
+#include <numeric>
+#include <spdlog/spdlog.h>
+
+namespace veng {
+
+    #pragma region DECLARATION
+
+    RenderGraphPassBuilder& RenderGraphPassBuilder::WriteColor(
+        RenderGraphImage image, std::optional<VkClearColorValue> clear) {
+        RenderGraph::Pass& pass = graph_.passes_[pass_index_];
+
+        VkClearValue clear_value = {};
+        if (clear.has_value()) {
+            clear_value.color = clear.value();
+        }
+        VkAttachmentLoadOp load_op = clear.has_value() ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+
+        pass.color_attachments.push_back({image.index, load_op, clear_value});
+        pass.accesses.push_back({image.index, false, ResourceUsage::kColorAttachment, !clear.has_value(), true});
+        return *this;
+    }
+
+    RenderGraphPassBuilder& RenderGraphPassBuilder::WriteDepth(
+        RenderGraphImage image, std::optional<VkClearDepthStencilValue> clear) {
+        RenderGraph::Pass& pass = graph_.passes_[pass_index_];
+
+        VkClearValue clear_value = {};
+        if (clear.has_value()) {
+            clear_value.depthStencil = clear.value();
+        }
+        VkAttachmentLoadOp load_op = clear.has_value() ? VK_ATTACHMENT_LOAD_OP_CLEAR : VK_ATTACHMENT_LOAD_OP_LOAD;
+
+        pass.depth_attachment = RenderGraph::Attachment{image.index, load_op, clear_value};
+        pass.accesses.push_back({image.index, false, ResourceUsage::kDepthAttachment, !clear.has_value(), true});
+        return *this;
+    }
+
+    RenderGraphPassBuilder& RenderGraphPassBuilder::Read(RenderGraphImage image, ResourceUsage usage) {
+        graph_.passes_[pass_index_].accesses.push_back({image.index, false, usage, true, false});
+        return *this;
+    }
+
+    RenderGraphPassBuilder& RenderGraphPassBuilder::Write(RenderGraphImage image, ResourceUsage usage) {
+        // Storage writes may only touch part of the image, so keep what was there
+        graph_.passes_[pass_index_].accesses.push_back({image.index, false, usage, true, true});
+        return *this;
+    }
+
+    RenderGraphPassBuilder& RenderGraphPassBuilder::Read(RenderGraphBuffer buffer, ResourceUsage usage) {
+        graph_.passes_[pass_index_].accesses.push_back({buffer.index, true, usage, true, false});
+        return *this;
+    }
+
+    RenderGraphPassBuilder& RenderGraphPassBuilder::Write(RenderGraphBuffer buffer, ResourceUsage usage) {
+        graph_.passes_[pass_index_].accesses.push_back({buffer.index, true, usage, true, true});
+        return *this;
+    }
+
+    RenderGraphPassBuilder& RenderGraphPassBuilder::SetRenderArea(VkExtent2D extent) {
+        graph_.passes_[pass_index_].render_area = extent;
+        return *this;
+    }
+
+    RenderGraphPassBuilder& RenderGraphPassBuilder::SetSideEffect() {
+        graph_.passes_[pass_index_].side_effect = true;
+        return *this;
+    }
+
+    RenderGraphPassBuilder& RenderGraphPassBuilder::SetExecute(std::function<void(VkCommandBuffer)> execute) {
+        graph_.passes_[pass_index_].execute = std::move(execute);
+        return *this;
+    }
+
+    void RenderGraph::Initialize(VkDevice device, RenderGraphAllocator allocator) {
+        device_ = device;
+        allocator_ = std::move(allocator);
+    }
+
+    void RenderGraph::Destroy() {
+        for (PhysicalImage& physical : physical_images_) {
+            vkDestroyImageView(device_, physical.view, nullptr);
+            vkDestroyImage(device_, physical.image, nullptr);
+        }
+        for (VkDeviceMemory memory : transient_memory_) {
+            allocator_.free(memory);
+        }
+
+        physical_images_.clear();
+        transient_memory_.clear();
+        compiled_keys_.clear();
+    }
+
+    void RenderGraph::Reset() {
+        passes_.clear();
+        images_.clear();
+        buffers_.clear();
+        live_passes_.clear();
+    }
+
+    RenderGraphImage RenderGraph::CreateImage(std::string_view name, const TransientImageDesc& desc) {
+        Image image;
+        image.name = name;
+        image.transient = true;
+        image.desc = desc;
+        images_.push_back(std::move(image));
+        return {static_cast<std::uint32_t>(images_.size() - 1)};
+    }
+
+    RenderGraphImage RenderGraph::ImportImage(std::string_view name, VkImage vk_image, VkImageView view,
+                                              VkFormat format, VkExtent2D extent, ResourceState initial,
+                                              std::optional<ResourceUsage> final) {
+        Image image;
+        image.name = name;
+        image.transient = false;
+        image.desc = {format, extent};
+        image.image = vk_image;
+        image.view = view;
+        image.initial = initial;
+        image.final = final;
+        images_.push_back(std::move(image));
+        return {static_cast<std::uint32_t>(images_.size() - 1)};
+    }
+
+    RenderGraphBuffer RenderGraph::ImportBuffer(std::string_view name, VkBuffer buffer, ResourceState initial) {
+        buffers_.push_back({std::string(name), buffer, initial});
+        return {static_cast<std::uint32_t>(buffers_.size() - 1)};
+    }
+
+    RenderGraphPassBuilder RenderGraph::AddPass(std::string_view name, RenderGraphQueue queue) {
+        Pass pass;
+        pass.name = name;
+        pass.queue = queue;
+        passes_.push_back(std::move(pass));
+        return RenderGraphPassBuilder(*this, passes_.size() - 1);
+    }
+
+    void RenderGraph::MarkOutput(RenderGraphImage image) {
+        images_[image.index].output = true;
+    }
+
+    VkImage RenderGraph::GetImage(RenderGraphImage image) const {
+        return images_[image.index].image;
+    }
+
+    VkImageView RenderGraph::GetImageView(RenderGraphImage image) const {
+        return images_[image.index].view;
+    }
+
+    #pragma endregion
+
+    #pragma region COMPILE
+
+    void RenderGraph::CullPasses() {
+        // Imported resources outlive the frame, so writes to them always matter
+        std::vector<bool> needed_images(images_.size());
+        for (std::uint32_t i = 0; i < images_.size(); i++) {
+            needed_images[i] = images_[i].output || !images_[i].transient;
+        }
+        std::vector<bool> needed_buffers(buffers_.size(), true);
+
+        std::vector<bool> live(passes_.size(), false);
+        for (std::int32_t i = static_cast<std::int32_t>(passes_.size()) - 1; i >= 0; i--) {
+            const Pass& pass = passes_[i];
+
+            live[i] = pass.side_effect || std::any_of(pass.accesses.begin(), pass.accesses.end(), [&](const Access& access) {
+                return access.write && (access.is_buffer ? needed_buffers[access.resource] : needed_images[access.resource]);
+            });
+
+            if (!live[i]) {
+                continue;
+            }
+
+            // A full overwrite makes whatever was written before it dead
+            for (const Access& access : pass.accesses) {
+                std::vector<bool>& needed = access.is_buffer ? needed_buffers : needed_images;
+                if (access.write && !access.read) {
+                    needed[access.resource] = false;
+                }
+            }
+            for (const Access& access : pass.accesses) {
+                std::vector<bool>& needed = access.is_buffer ? needed_buffers : needed_images;
+                if (access.read) {
+                    needed[access.resource] = true;
+                }
+            }
+        }
+
+        live_passes_.clear();
+        for (std::uint32_t i = 0; i < passes_.size(); i++) {
+            if (live[i]) {
+                live_passes_.push_back(i);
+            }
+        }
+
+        stats_.pass_count = passes_.size();
+        stats_.culled_pass_count = passes_.size() - live_passes_.size();
+    }
+
+    void RenderGraph::Compile() {
+        CullPasses();
+
+        std::vector<TransientKey> keys;
+        std::vector<std::uint32_t> key_for_image(images_.size(), UINT32_MAX);
+
+        for (std::uint32_t live_index = 0; live_index < live_passes_.size(); live_index++) {
+            for (const Access& access : passes_[live_passes_[live_index]].accesses) {
+                if (access.is_buffer || !images_[access.resource].transient) {
+                    continue;
+                }
+
+                std::uint32_t& key_index = key_for_image[access.resource];
+                if (key_index == UINT32_MAX) {
+                    key_index = keys.size();
+                    keys.push_back({images_[access.resource].desc, 0, live_index, live_index});
+                }
+
+                TransientKey& key = keys[key_index];
+                ResourceState state = GetResourceState(access.usage);
+                key.usage |= GetImageUsageFlags(access.usage);
+                key.last_pass = live_index;
+                key.stages |= state.stage;
+                if (access.write) {
+                    key.write_access |= state.access;
+                }
+            }
+        }
+
+        if (keys != compiled_keys_) {
+            ReleaseTransients();
+            AllocateTransients(keys);
+            compiled_keys_ = keys;
+
+            spdlog::info("Render graph compiled: {} passes ({} culled), {} transient images in {} KiB ({} KiB unaliased)",
+                         stats_.pass_count, stats_.culled_pass_count, stats_.transient_image_count,
+                         stats_.transient_bytes / 1024, stats_.unaliased_bytes / 1024);
+        }
+
+        transient_physical_ = key_for_image;
+        for (std::uint32_t i = 0; i < images_.size(); i++) {
+            if (key_for_image[i] != UINT32_MAX) {
+                images_[i].image = physical_images_[key_for_image[i]].image;
+                images_[i].view = physical_images_[key_for_image[i]].view;
+            }
+        }
+    }
+
+    void RenderGraph::AllocateTransients(const std::vector<TransientKey>& keys) {
+        struct Placement {
+            VkMemoryRequirements requirements;
+            std::uint32_t block = UINT32_MAX;
+            VkDeviceSize offset = 0;
+        };
+
+        struct Block {
+            std::uint32_t memory_type_bits;
+            VkDeviceSize size = 0;
+            VkDeviceSize alignment = 1;
+            std::vector<std::uint32_t> members;
+        };
+
+        physical_images_.resize(keys.size());
+        std::vector<Placement> placements(keys.size());
+        stats_.unaliased_bytes = 0;
+
+        for (std::uint32_t i = 0; i < keys.size(); i++) {
+            const TransientKey& key = keys[i];
+
+            VkImageCreateInfo image_info = {};
+            image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            image_info.imageType = VK_IMAGE_TYPE_2D;
+            image_info.format = key.desc.format;
+            image_info.extent = {key.desc.extent.width, key.desc.extent.height, 1};
+            image_info.mipLevels = 1;
+            image_info.arrayLayers = 1;
+            image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+            image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+            image_info.usage = key.usage;
+            image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+
+            if (vkCreateImage(device_, &image_info, nullptr, &physical_images_[i].image) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create transient image!");
+            }
+
+            vkGetImageMemoryRequirements(device_, physical_images_[i].image, &placements[i].requirements);
+            stats_.unaliased_bytes += placements[i].requirements.size;
+        }
+
+        // Biggest first, each one goes to the lowest offset that doesn't overlap
+        // anything alive at the same time
+        std::vector<std::uint32_t> order(keys.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&placements](std::uint32_t a, std::uint32_t b) {
+            return placements[a].requirements.size > placements[b].requirements.size;
+        });
+
+        auto lifetimes_overlap = [&keys](std::uint32_t a, std::uint32_t b) {
+            return keys[a].first_pass <= keys[b].last_pass && keys[b].first_pass <= keys[a].last_pass;
+        };
+
+        std::vector<Block> blocks;
+        for (std::uint32_t i : order) {
+            Placement& placement = placements[i];
+            VkDeviceSize size = placement.requirements.size;
+            VkDeviceSize alignment = placement.requirements.alignment;
+
+            for (std::uint32_t b = 0; b < blocks.size() && placement.block == UINT32_MAX; b++) {
+                Block& block = blocks[b];
+                if ((block.memory_type_bits & placement.requirements.memoryTypeBits) == 0) {
+                    continue;
+                }
+
+                std::vector<VkDeviceSize> candidates = {0};
+                for (std::uint32_t member : block.members) {
+                    if (lifetimes_overlap(i, member)) {
+                        const Placement& other = placements[member];
+                        candidates.push_back((other.offset + other.requirements.size + alignment - 1) / alignment * alignment);
+                    }
+                }
+                std::sort(candidates.begin(), candidates.end());
+
+                for (VkDeviceSize offset : candidates) {
+                    bool fits = std::none_of(block.members.begin(), block.members.end(), [&](std::uint32_t member) {
+                        const Placement& other = placements[member];
+                        return lifetimes_overlap(i, member) && offset < other.offset + other.requirements.size &&
+                               other.offset < offset + size;
+                    });
+
+                    if (fits) {
+                        placement.block = b;
+                        placement.offset = offset;
+                        break;
+                    }
+                }
+            }
+
+            if (placement.block == UINT32_MAX) {
+                placement.block = blocks.size();
+                placement.offset = 0;
+                blocks.push_back({placement.requirements.memoryTypeBits});
+            }
+
+            Block& block = blocks[placement.block];
+            block.memory_type_bits &= placement.requirements.memoryTypeBits;
+            block.size = std::max(block.size, placement.offset + size);
+            block.alignment = std::max(block.alignment, alignment);
+            block.members.push_back(i);
+        }
+
+        stats_.transient_bytes = 0;
+        for (const Block& block : blocks) {
+            VkMemoryRequirements block_requirements = {block.size, block.alignment, block.memory_type_bits};
+            transient_memory_.push_back(allocator_.allocate(block_requirements, "render graph transients"));
+            stats_.transient_bytes += block.size;
+        }
+        stats_.transient_image_count = keys.size();
+
+        for (std::uint32_t i = 0; i < keys.size(); i++) {
+            const Placement& placement = placements[i];
+            PhysicalImage& physical = physical_images_[i];
+            vkBindImageMemory(device_, physical.image, transient_memory_[placement.block], placement.offset);
+
+            VkImageViewCreateInfo view_info = {};
+            view_info.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+            view_info.image = physical.image;
+            view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+            view_info.format = keys[i].desc.format;
+            view_info.subresourceRange.aspectMask = GetImageAspect(keys[i].desc.format);
+            view_info.subresourceRange.levelCount = 1;
+            view_info.subresourceRange.layerCount = 1;
+
+            if (vkCreateImageView(device_, &view_info, nullptr, &physical.view) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to create transient image view!");
+            }
+
+            // The first use each frame waits for everyone who touched this memory last frame,
+            // or earlier in this one
+            physical.alias_source = {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED};
+            for (std::uint32_t member : blocks[placement.block].members) {
+                const Placement& other = placements[member];
+                if (placement.offset < other.offset + other.requirements.size &&
+                    other.offset < placement.offset + placement.requirements.size) {
+                    physical.alias_source.stage |= keys[member].stages;
+                    physical.alias_source.access |= keys[member].write_access;
+                }
+            }
+        }
+    }
+
+    void RenderGraph::ReleaseTransients() {
+        if (physical_images_.empty() && transient_memory_.empty()) {
+            return;
+        }
+
+        // Frames in flight may still be rendering into them
+        allocator_.defer_destruction([device = device_, free_memory = allocator_.free, images = physical_images_,
+                                      memory = transient_memory_]() {
+            for (const PhysicalImage& physical : images) {
+                vkDestroyImageView(device, physical.view, nullptr);
+                vkDestroyImage(device, physical.image, nullptr);
+            }
+            for (VkDeviceMemory block : memory) {
+                free_memory(block);
+            }
+        });
+
+        physical_images_.clear();
+        transient_memory_.clear();
+    }
+
+    #pragma endregion
+
+    #pragma region EXECUTE
+
+    void RenderGraph::Execute(VkCommandBuffer command_buffer) {
+        image_states_.assign(images_.size(), {});
+        for (std::uint32_t i = 0; i < images_.size(); i++) {
+            // Transient contents never carry over, but the memory may still be in use
+            ResourceState initial = images_[i].transient && transient_physical_[i] != UINT32_MAX
+                                        ? physical_images_[transient_physical_[i]].alias_source
+                                        : images_[i].initial;
+            image_states_[i].layout = images_[i].transient ? VK_IMAGE_LAYOUT_UNDEFINED : initial.layout;
+            image_states_[i].write_stage = initial.stage;
+            image_states_[i].write_access = initial.access;
+        }
+
+        buffer_states_.assign(buffers_.size(), {});
+        for (std::uint32_t i = 0; i < buffers_.size(); i++) {
+            buffer_states_[i].write_stage = buffers_[i].initial.stage;
+            buffer_states_[i].write_access = buffers_[i].initial.access;
+        }
+
+        for (std::uint32_t live_index = 0; live_index < live_passes_.size(); live_index++) {
+            const Pass& pass = passes_[live_passes_[live_index]];
+            RecordBarriers(command_buffer, pass);
+
+            bool renders = pass.queue == RenderGraphQueue::kGraphics &&
+                           (!pass.color_attachments.empty() || pass.depth_attachment.has_value());
+            if (renders) {
+                BeginRendering(command_buffer, pass, live_index);
+            }
+            if (pass.execute) {
+                pass.execute(command_buffer);
+            }
+            if (renders) {
+                vkCmdEndRendering(command_buffer);
+            }
+        }
+
+        std::vector<VkImageMemoryBarrier2> final_barriers;
+        for (std::uint32_t i = 0; i < images_.size(); i++) {
+            if (images_[i].transient || !images_[i].final.has_value()) {
+                continue;
+            }
+
+            const TrackedState& state = image_states_[i];
+            ResourceState from = {state.write_stage | state.read_stage, state.write_access, state.layout};
+            final_barriers.push_back(MakeImageBarrier(images_[i].image, GetImageAspect(images_[i].desc.format), from,
+                                                      GetResourceState(images_[i].final.value())));
+        }
+
+        if (!final_barriers.empty()) {
+            VkDependencyInfo dependency_info = {};
+            dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+            dependency_info.imageMemoryBarrierCount = final_barriers.size();
+            dependency_info.pImageMemoryBarriers = final_barriers.data();
+            vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+        }
+    }
+
+    void RenderGraph::RecordBarriers(VkCommandBuffer command_buffer, const Pass& pass) {
+        std::vector<VkImageMemoryBarrier2> image_barriers;
+        std::vector<VkBufferMemoryBarrier2> buffer_barriers;
+
+        for (const Access& access : pass.accesses) {
+            ResourceState target = GetResourceState(access.usage);
+            TrackedState& state = access.is_buffer ? buffer_states_[access.resource] : image_states_[access.resource];
+
+            bool layout_change = !access.is_buffer && state.layout != target.layout;
+            bool already_visible = (state.read_stage & target.stage) == target.stage &&
+                                   (state.read_access & target.access) == target.access;
+            bool needs_barrier = access.write || layout_change ||
+                                 (state.write_stage != VK_PIPELINE_STAGE_2_NONE && !already_visible);
+
+            if (needs_barrier) {
+                // Reads only need an execution dependency, writes also have to be made available
+                ResourceState from = {state.write_stage, state.write_access, state.layout};
+                if (access.write || layout_change) {
+                    from.stage |= state.read_stage;
+                }
+
+                if (access.is_buffer) {
+                    buffer_barriers.push_back(MakeBufferBarrier(buffers_[access.resource].buffer, from, target));
+                } else {
+                    const Image& image = images_[access.resource];
+                    image_barriers.push_back(
+                        MakeImageBarrier(image.image, GetImageAspect(image.desc.format), from, target));
+                }
+            }
+
+            if (access.write) {
+                state = {target.layout, target.stage, target.access, VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE};
+            } else if (layout_change) {
+                // The transition is a write that happens before the target stage
+                state = {target.layout, target.stage, VK_ACCESS_2_NONE, target.stage, target.access};
+            } else {
+                state.read_stage |= target.stage;
+                state.read_access |= target.access;
+            }
+        }
+
+        if (image_barriers.empty() && buffer_barriers.empty()) {
+            return;
+        }
+
+        VkDependencyInfo dependency_info = {};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.imageMemoryBarrierCount = image_barriers.size();
+        dependency_info.pImageMemoryBarriers = image_barriers.data();
+        dependency_info.bufferMemoryBarrierCount = buffer_barriers.size();
+        dependency_info.pBufferMemoryBarriers = buffer_barriers.data();
+        vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+    }
+
+    bool RenderGraph::IsAccessedAfter(std::uint32_t image, std::uint32_t live_index) const {
+        if (!images_[image].transient || images_[image].output) {
+            return true;
+        }
+
+        for (std::uint32_t i = live_index + 1; i < live_passes_.size(); i++) {
+            const Pass& pass = passes_[live_passes_[i]];
+            for (const Access& access : pass.accesses) {
+                if (!access.is_buffer && access.resource == image && access.read) {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void RenderGraph::BeginRendering(VkCommandBuffer command_buffer, const Pass& pass, std::uint32_t live_index) {
+        auto make_attachment = [&](const Attachment& attachment, VkImageLayout layout) {
+            VkRenderingAttachmentInfo info = {};
+            info.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO;
+            info.imageView = images_[attachment.image].view;
+            info.imageLayout = layout;
+            info.loadOp = attachment.load_op;
+            // Nobody reads it afterwards, so the tile memory can be thrown away
+            info.storeOp = IsAccessedAfter(attachment.image, live_index) ? VK_ATTACHMENT_STORE_OP_STORE
+                                                                          : VK_ATTACHMENT_STORE_OP_DONT_CARE;
+            info.clearValue = attachment.clear_value;
+            return info;
+        };
+
+        std::vector<VkRenderingAttachmentInfo> color_attachments;
+        for (const Attachment& attachment : pass.color_attachments) {
+            color_attachments.push_back(make_attachment(attachment, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL));
+        }
+
+        VkRenderingAttachmentInfo depth_attachment = {};
+        if (pass.depth_attachment.has_value()) {
+            depth_attachment = make_attachment(pass.depth_attachment.value(), VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
+        }
+
+        std::uint32_t first_attachment =
+            pass.color_attachments.empty() ? pass.depth_attachment->image : pass.color_attachments.front().image;
+
+        VkRenderingInfo rendering_info = {};
+        rendering_info.sType = VK_STRUCTURE_TYPE_RENDERING_INFO;
+        rendering_info.renderArea.offset = {0, 0};
+        rendering_info.renderArea.extent = pass.render_area.value_or(images_[first_attachment].desc.extent);
+        rendering_info.layerCount = 1;
+        rendering_info.colorAttachmentCount = color_attachments.size();
+        rendering_info.pColorAttachments = color_attachments.data();
+        rendering_info.pDepthAttachment = pass.depth_attachment.has_value() ? &depth_attachment : nullptr;
+
+        vkCmdBeginRendering(command_buffer, &rendering_info);
+    }
+
+    #pragma endregion
+}
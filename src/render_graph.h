@@ -0,0 +1,203 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <resource_state.h>
+
+namespace veng {
+
+    struct RenderGraphImage {
+        std::uint32_t index = UINT32_MAX;
+        bool IsValid() const { return index != UINT32_MAX; }
+    };
+
+    struct RenderGraphBuffer {
+        std::uint32_t index = UINT32_MAX;
+        bool IsValid() const { return index != UINT32_MAX; }
+    };
+
+    // Usage flags come from how the passes access the image
+    struct TransientImageDesc {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        VkExtent2D extent = {0, 0};
+
+        bool operator==(const TransientImageDesc& other) const {
+            return format == other.format && extent.width == other.extent.width && extent.height == other.extent.height;
+        }
+    };
+
+    enum class RenderGraphQueue {
+        kGraphics,   // dynamic rendering around the attachments the pass writes
+        kCompute,
+    };
+
+    // Graphics owns the device memory so it shows up in the memory tracker and retires with the frames
+    struct RenderGraphAllocator {
+        std::function<VkDeviceMemory(const VkMemoryRequirements&, std::string_view owner)> allocate;
+        std::function<void(VkDeviceMemory)> free;
+        std::function<void(std::function<void()>)> defer_destruction;
+    };
+
+    struct RenderGraphStats {
+        std::uint32_t pass_count = 0;
+        std::uint32_t culled_pass_count = 0;
+        std::uint32_t transient_image_count = 0;
+        VkDeviceSize transient_bytes = 0;
+        // What the transients would take without aliasing
+        VkDeviceSize unaliased_bytes = 0;
+    };
+
+    class RenderGraph;
+
+    class RenderGraphPassBuilder {
+        public:
+        RenderGraphPassBuilder(RenderGraph& graph, std::uint32_t pass_index) : graph_(graph), pass_index_(pass_index) {}
+
+        // Without a clear value the previous contents are loaded, which counts as a read
+        RenderGraphPassBuilder& WriteColor(RenderGraphImage image, std::optional<VkClearColorValue> clear = std::nullopt);
+        RenderGraphPassBuilder& WriteDepth(
+            RenderGraphImage image, std::optional<VkClearDepthStencilValue> clear = std::nullopt);
+
+        RenderGraphPassBuilder& Read(RenderGraphImage image, ResourceUsage usage);
+        RenderGraphPassBuilder& Write(RenderGraphImage image, ResourceUsage usage);
+        RenderGraphPassBuilder& Read(RenderGraphBuffer buffer, ResourceUsage usage);
+        RenderGraphPassBuilder& Write(RenderGraphBuffer buffer, ResourceUsage usage);
+
+        // Defaults to the extent of the first attachment
+        RenderGraphPassBuilder& SetRenderArea(VkExtent2D extent);
+        // Kept even when nothing reads its output, e.g. readbacks
+        RenderGraphPassBuilder& SetSideEffect();
+        RenderGraphPassBuilder& SetExecute(std::function<void(VkCommandBuffer)> execute);
+
+        private:
+        RenderGraph& graph_;
+        std::uint32_t pass_index_;
+    };
+
+    // Passes and their resource accesses are declared every frame. Compile culls passes that
+    // don't contribute to an output and places transient images in aliased memory, Execute
+    // records the passes with synchronization2 barriers derived from the declared accesses.
+    class RenderGraph {
+        public:
+        void Initialize(VkDevice device, RenderGraphAllocator allocator);
+        void Destroy();
+
+        void Reset();
+
+        RenderGraphImage CreateImage(std::string_view name, const TransientImageDesc& desc);
+        // initial is the state the image is in when the frame starts, final where Execute leaves it
+        RenderGraphImage ImportImage(std::string_view name, VkImage image, VkImageView view, VkFormat format,
+                                     VkExtent2D extent, ResourceState initial, std::optional<ResourceUsage> final);
+        RenderGraphBuffer ImportBuffer(std::string_view name, VkBuffer buffer, ResourceState initial);
+
+        RenderGraphPassBuilder AddPass(std::string_view name, RenderGraphQueue queue = RenderGraphQueue::kGraphics);
+        void MarkOutput(RenderGraphImage image);
+
+        // Transients are only recreated when the declared structure changes
+        void Compile();
+        void Execute(VkCommandBuffer command_buffer);
+
+        VkImage GetImage(RenderGraphImage image) const;
+        VkImageView GetImageView(RenderGraphImage image) const;
+        const RenderGraphStats& GetStats() const { return stats_; }
+
+        private:
+        friend class RenderGraphPassBuilder;
+
+        struct Access {
+            std::uint32_t resource;
+            bool is_buffer;
+            ResourceUsage usage;
+            bool read;
+            bool write;
+        };
+
+        struct Attachment {
+            std::uint32_t image;
+            VkAttachmentLoadOp load_op;
+            VkClearValue clear_value;
+        };
+
+        struct Pass {
+            std::string name;
+            RenderGraphQueue queue;
+            std::vector<Access> accesses;
+            std::vector<Attachment> color_attachments;
+            std::optional<Attachment> depth_attachment = std::nullopt;
+            std::optional<VkExtent2D> render_area = std::nullopt;
+            bool side_effect = false;
+            std::function<void(VkCommandBuffer)> execute;
+        };
+
+        struct Image {
+            std::string name;
+            bool transient;
+            TransientImageDesc desc;
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            ResourceState initial;
+            std::optional<ResourceUsage> final = std::nullopt;
+            bool output = false;
+        };
+
+        struct Buffer {
+            std::string name;
+            VkBuffer buffer;
+            ResourceState initial;
+        };
+
+        // Where Execute tracks every resource, reads since the last write accumulate
+        struct TrackedState {
+            VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+            VkPipelineStageFlags2 write_stage = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+            VkPipelineStageFlags2 read_stage = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 read_access = VK_ACCESS_2_NONE;
+        };
+
+        // The part of a declaration that decides the physical transients
+        struct TransientKey {
+            TransientImageDesc desc;
+            VkImageUsageFlags usage = 0;
+            std::uint32_t first_pass = 0;
+            std::uint32_t last_pass = 0;
+            // Union of every access, the next user of the memory has to wait for these
+            VkPipelineStageFlags2 stages = VK_PIPELINE_STAGE_2_NONE;
+            VkAccessFlags2 write_access = VK_ACCESS_2_NONE;
+
+            bool operator==(const TransientKey& other) const = default;
+        };
+
+        struct PhysicalImage {
+            VkImage image = VK_NULL_HANDLE;
+            VkImageView view = VK_NULL_HANDLE;
+            // Union of the last accesses of everything that shares its memory, including itself
+            ResourceState alias_source;
+        };
+
+        void CullPasses();
+        void AllocateTransients(const std::vector<TransientKey>& keys);
+        void ReleaseTransients();
+        void RecordBarriers(VkCommandBuffer command_buffer, const Pass& pass);
+        void BeginRendering(VkCommandBuffer command_buffer, const Pass& pass, std::uint32_t live_index);
+        bool IsAccessedAfter(std::uint32_t image, std::uint32_t live_index) const;
+
+        VkDevice device_ = VK_NULL_HANDLE;
+        RenderGraphAllocator allocator_;
+
+        std::vector<Pass> passes_;
+        std::vector<Image> images_;
+        std::vector<Buffer> buffers_;
+        std::vector<std::uint32_t> live_passes_;
+
+        // Transient index in declaration order -> physical image
+        std::vector<std::uint32_t> transient_physical_;
+        std::vector<TransientKey> compiled_keys_;
+        std::vector<PhysicalImage> physical_images_;
+        std::vector<VkDeviceMemory> transient_memory_;
+
+        std::vector<TrackedState> image_states_;
+        std::vector<TrackedState> buffer_states_;
+        RenderGraphStats stats_;
+    };
+}
@@ -0,0 +1,202 @@
+#include <precomp.h>
+#include <resource_cache.h>
+#include <asset_baker.h>
+#include <mapped_file.h>
+#include <spdlog/spdlog.h>
+
+namespace veng {
+
+    namespace {
+
+        std::string MakeKey(std::string_view kind, std::string_view name, std::uint64_t hash) {
+            return fmt::format("{}:{}:{:016x}", kind, name, hash);
+        }
+
+        VkDeviceMemory GetMemory(const std::variant<TextureHandle, MeshHandle>& resource) {
+            if (const TextureHandle* texture = std::get_if<TextureHandle>(&resource)) {
+                return texture->memory;
+            }
+            return std::get<MeshHandle>(resource).vertices.memory;
+        }
+    }
+
+    ResourceCache::ResourceCache(Graphics& graphics, VkDeviceSize budget) : graphics_(graphics), budget_(budget) {}
+
+    ResourceCache::~ResourceCache() {
+        for (const auto& entry : entries_) {
+            Destroy(entry.second.resource);
+        }
+    }
+
+    TextureHandle ResourceCache::AcquireTexture(gsl::czstring path) {
+        MappedFile file(path);
+        std::string key = MakeKey("texture", path, HashContent(file.GetData()));
+        if (const Resource* resource = Find(key)) {
+            return std::get<TextureHandle>(*resource);
+        }
+
+        TextureHandle texture = graphics_.CreateTexture(file.GetData(), path);
+        Insert(std::move(key), texture);
+        return texture;
+    }
+
+    TextureHandle ResourceCache::AcquireTexture(const AssetArchive& archive, std::string_view name) {
+        std::optional<AssetView> asset = archive.Find(name);
+        if (!asset.has_value() || asset->type != AssetType::kTexture) {
+            throw std::runtime_error("Texture is missing from the asset archive!");
+        }
+
+        // The same pixels in another format or layout are another texture
+        std::uint64_t layout = HashAssetName(
+            fmt::format("{}x{} {} {}", asset->width, asset->height, static_cast<std::int32_t>(asset->format),
+                        asset->mip_count));
+        std::string key = MakeKey("texture", name, HashContent(asset->data, layout));
+        if (const Resource* resource = Find(key)) {
+            return std::get<TextureHandle>(*resource);
+        }
+
+        TextureHandle texture = graphics_.CreateTexture(archive, name);
+        Insert(std::move(key), texture);
+        return texture;
+    }
+
+    MeshHandle ResourceCache::AcquireMesh(gsl::czstring path) {
+        MappedFile file(path);
+        gsl::span<const std::uint8_t> data = file.GetData();
+        std::string key = MakeKey("mesh", path, HashContent(data));
+        if (const Resource* resource = Find(key)) {
+            return std::get<MeshHandle>(*resource);
+        }
+
+        std::vector<Vertex> vertices;
+        std::vector<std::uint32_t> indices;
+        std::string_view text(reinterpret_cast<const char*>(data.data()), data.size());
+        if (!ParseObj(text, vertices, indices)) {
+            throw std::runtime_error("Failed to load a mesh!");
+        }
+
+        MeshHandle mesh = CreateMesh(vertices, indices, path);
+        Insert(std::move(key), mesh);
+        return mesh;
+    }
+
+    MeshHandle ResourceCache::AcquireMesh(const AssetArchive& archive, std::string_view name) {
+        std::optional<AssetView> asset = archive.Find(name);
+        if (!asset.has_value() || asset->type != AssetType::kMesh) {
+            throw std::runtime_error("Mesh is missing from the asset archive!");
+        }
+
+        std::string key = MakeKey("mesh", name, HashContent(asset->data, asset->index_count));
+        if (const Resource* resource = Find(key)) {
+            return std::get<MeshHandle>(*resource);
+        }
+
+        MeshHandle mesh = CreateMesh(GetMeshVertices(*asset), GetMeshIndices(*asset), name);
+        Insert(std::move(key), mesh);
+        return mesh;
+    }
+
+    void ResourceCache::SetBudget(VkDeviceSize budget) {
+        budget_ = budget;
+        Evict();
+    }
+
+    ResourceCacheStats ResourceCache::GetStats() const {
+        ResourceCacheStats stats;
+        stats.hits = hits_;
+        stats.misses = misses_;
+        stats.evictions = evictions_;
+        stats.resource_count = static_cast<std::uint32_t>(entries_.size());
+        stats.resident_bytes = resident_bytes_;
+        stats.unused_bytes = unused_bytes_;
+        return stats;
+    }
+
+    const ResourceCache::Resource* ResourceCache::Find(const std::string& key) {
+        auto entry = entries_.find(key);
+        if (entry == entries_.end()) {
+            misses_++;
+            return nullptr;
+        }
+
+        hits_++;
+        if (entry->second.references++ == 0) {
+            unused_.erase(entry->second.unused_position);
+            unused_bytes_ -= entry->second.size;
+        }
+        return &entry->second.resource;
+    }
+
+    void ResourceCache::Insert(std::string key, Resource resource) {
+        Entry entry;
+        entry.resource = resource;
+        entry.references = 1;
+        // The tracker knows what the driver actually allocated, alignment and mip tail included
+        entry.size = graphics_.GetAllocationSize(GetMemory(resource));
+        if (const MeshHandle* mesh = std::get_if<MeshHandle>(&resource)) {
+            entry.size += graphics_.GetAllocationSize(mesh->indices.memory);
+        }
+
+        resident_bytes_ += entry.size;
+        keys_.emplace(GetMemory(resource), key);
+        entries_.emplace(std::move(key), std::move(entry));
+        Evict();
+    }
+
+    void ResourceCache::Release(VkDeviceMemory memory) {
+        auto key = keys_.find(memory);
+        if (key == keys_.end()) {
+            throw std::runtime_error("Released a resource the cache doesn't own!");
+        }
+
+        Entry& entry = entries_.at(key->second);
+        if (entry.references == 0) {
+            throw std::runtime_error("Released a resource more often than it was acquired!");
+        }
+        if (--entry.references == 0) {
+            entry.unused_position = unused_.insert(unused_.end(), key->second);
+            unused_bytes_ += entry.size;
+            Evict();
+        }
+    }
+
+    void ResourceCache::Evict() {
+        while (resident_bytes_ > budget_ && !unused_.empty()) {
+            auto entry = entries_.find(unused_.front());
+            unused_.pop_front();
+
+            // Deferred, the memory only comes back once the frames that may still draw it have finished
+            Destroy(entry->second.resource);
+            resident_bytes_ -= entry->second.size;
+            unused_bytes_ -= entry->second.size;
+            keys_.erase(GetMemory(entry->second.resource));
+            entries_.erase(entry);
+            evictions_++;
+        }
+    }
+
+    MeshHandle ResourceCache::CreateMesh(gsl::span<const Vertex> vertices, gsl::span<const std::uint32_t> indices,
+                                         std::string_view owner) {
+        MeshHandle mesh;
+        mesh.vertices = graphics_.CreateVertexBuffer(vertices, owner);
+        // Nothing owns the vertex buffer until Insert
+        try {
+            mesh.indices = graphics_.CreateIndexBuffer(indices, owner);
+        } catch (...) {
+            graphics_.DestroyBuffer(mesh.vertices);
+            throw;
+        }
+        mesh.index_count = static_cast<std::uint32_t>(indices.size());
+        return mesh;
+    }
+
+    void ResourceCache::Destroy(const Resource& resource) {
+        if (const TextureHandle* texture = std::get_if<TextureHandle>(&resource)) {
+            graphics_.DestroyTexture(*texture);
+            return;
+        }
+        const MeshHandle& mesh = std::get<MeshHandle>(resource);
+        graphics_.DestroyBuffer(mesh.vertices);
+        graphics_.DestroyBuffer(mesh.indices);
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <list>
+#include <unordered_map>
+#include <variant>
+#include <graphics.h>
+#include <mesh_handle.h>
+
+namespace veng {
+
+    struct ResourceCacheStats {
+        std::uint32_t hits = 0;
+        std::uint32_t misses = 0;
+        std::uint32_t evictions = 0;
+        std::uint32_t resource_count = 0;
+        // Device memory of every cached resource, referenced or not
+        VkDeviceSize resident_bytes = 0;
+        // The part of it nothing references, which eviction can give back
+        VkDeviceSize unused_bytes = 0;
+    };
+
+    // Shares textures and meshes between everything that loads the same asset. Resources are keyed by
+    // name and content hash, so a file that changed on disk loads again instead of returning the stale
+    // copy. Every Acquire takes a reference and needs a matching Release. Unreferenced resources stay
+    // cached for the next Acquire until the cache goes over budget, then the least recently released go
+    // first through the renderer's deferred destruction, so frames still drawing them are safe.
+    // Not thread safe, like the CreateTexture calls it makes.
+    class ResourceCache {
+        public:
+        static constexpr VkDeviceSize kDefaultBudget = 256ull << 20;
+
+        explicit ResourceCache(Graphics& graphics, VkDeviceSize budget = kDefaultBudget);
+        // Destroys every resource, referenced or not
+        ~ResourceCache();
+        ResourceCache(const ResourceCache&) = delete;
+        ResourceCache& operator=(const ResourceCache&) = delete;
+
+        // Anything Graphics::CreateTexture loads, the file is read once to hash it either way
+        TextureHandle AcquireTexture(gsl::czstring path);
+        TextureHandle AcquireTexture(const AssetArchive& archive, std::string_view name);
+        // Wavefront .obj
+        MeshHandle AcquireMesh(gsl::czstring path);
+        MeshHandle AcquireMesh(const AssetArchive& archive, std::string_view name);
+        void Release(const TextureHandle& texture) { Release(texture.memory); }
+        void Release(const MeshHandle& mesh) { Release(mesh.vertices.memory); }
+
+        // Soft, referenced resources are never evicted to meet it
+        void SetBudget(VkDeviceSize budget);
+        VkDeviceSize GetBudget() const { return budget_; }
+        ResourceCacheStats GetStats() const;
+
+        private:
+        using Resource = std::variant<TextureHandle, MeshHandle>;
+
+        struct Entry {
+            Resource resource;
+            VkDeviceSize size = 0;
+            std::uint32_t references = 0;
+            // Valid while references is 0
+            std::list<std::string>::iterator unused_position;
+        };
+
+        // Takes a reference, nullptr on a miss
+        const Resource* Find(const std::string& key);
+        void Insert(std::string key, Resource resource);
+        // Both buffers or neither
+        MeshHandle CreateMesh(gsl::span<const Vertex> vertices, gsl::span<const std::uint32_t> indices,
+                              std::string_view owner);
+        void Release(VkDeviceMemory memory);
+        void Evict();
+        void Destroy(const Resource& resource);
+
+        Graphics& graphics_;
+        VkDeviceSize budget_;
+        std::unordered_map<std::string, Entry> entries_;
+        // Texture memory or mesh vertex memory, identifies the entry a handle came from
+        std::unordered_map<VkDeviceMemory, std::string> keys_;
+        // Least recently released first
+        std::list<std::string> unused_;
+        VkDeviceSize resident_bytes_ = 0;
+        VkDeviceSize unused_bytes_ = 0;
+        std::uint32_t hits_ = 0;
+        std::uint32_t misses_ = 0;
+        std::uint32_t evictions_ = 0;
+    };
+}
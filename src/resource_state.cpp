@@ -0,0 +1,216 @@
+#include <precomp.h>
+#include <resource_state.h>
+
+namespace veng {
+
+    ResourceState GetResourceState(ResourceUsage usage) {
+        switch (usage) {
+        case ResourceUsage::kUndefined:
+            return {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED};
+        case ResourceUsage::kColorAttachment:
+            return {VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+                    VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL};
+        case ResourceUsage::kDepthAttachment:
+            return {VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT,
+                    VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL};
+        case ResourceUsage::kFragmentSampled:
+            return {VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        case ResourceUsage::kComputeSampled:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                    VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL};
+        case ResourceUsage::kComputeSampledGeneral:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL};
+        case ResourceUsage::kComputeStorageRead:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL};
+        case ResourceUsage::kComputeStorageWrite:
+            return {VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+                    VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL};
+        case ResourceUsage::kVertexStorageRead:
+            return {VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+                    VK_IMAGE_LAYOUT_GENERAL};
+        case ResourceUsage::kVertexBuffer:
+            return {VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED};
+        case ResourceUsage::kIndexBuffer:
+            return {VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT, VK_IMAGE_LAYOUT_UNDEFINED};
+        case ResourceUsage::kIndirectBuffer:
+            return {VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT,
+                    VK_IMAGE_LAYOUT_UNDEFINED};
+        case ResourceUsage::kTransferSrc:
+            return {VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_READ_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL};
+        case ResourceUsage::kTransferDst:
+            return {VK_PIPELINE_STAGE_2_COPY_BIT | VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL};
+        case ResourceUsage::kPresent:
+            // The present semaphore does the actual waiting
+            return {VK_PIPELINE_STAGE_2_NONE, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR};
+        }
+        return {};
+    }
+
+    bool IsWriteUsage(ResourceUsage usage) {
+        switch (usage) {
+        case ResourceUsage::kColorAttachment:
+        case ResourceUsage::kDepthAttachment:
+        case ResourceUsage::kComputeStorageWrite:
+        case ResourceUsage::kTransferDst:
+            return true;
+        default:
+            return false;
+        }
+    }
+
+    VkImageUsageFlags GetImageUsageFlags(ResourceUsage usage) {
+        switch (usage) {
+        case ResourceUsage::kColorAttachment:
+            return VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
+        case ResourceUsage::kDepthAttachment:
+            return VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT;
+        case ResourceUsage::kFragmentSampled:
+        case ResourceUsage::kComputeSampled:
+        case ResourceUsage::kComputeSampledGeneral:
+            return VK_IMAGE_USAGE_SAMPLED_BIT;
+        case ResourceUsage::kComputeStorageRead:
+        case ResourceUsage::kComputeStorageWrite:
+        case ResourceUsage::kVertexStorageRead:
+            return VK_IMAGE_USAGE_STORAGE_BIT;
+        case ResourceUsage::kTransferSrc:
+            return VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+        case ResourceUsage::kTransferDst:
+            return VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+        default:
+            return 0;
+        }
+    }
+
+    VkImageAspectFlags GetImageAspect(VkFormat format) {
+        switch (format) {
+        case VK_FORMAT_D16_UNORM:
+        case VK_FORMAT_D32_SFLOAT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT;
+        case VK_FORMAT_D24_UNORM_S8_UINT:
+        case VK_FORMAT_D32_SFLOAT_S8_UINT:
+            return VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT;
+        default:
+            return VK_IMAGE_ASPECT_COLOR_BIT;
+        }
+    }
+
+    VkImageMemoryBarrier2 MakeImageBarrier(
+        VkImage image, VkImageAspectFlags aspect, const ResourceState& from, const ResourceState& to) {
+        VkImageMemoryBarrier2 barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2;
+        barrier.srcStageMask = from.stage;
+        barrier.srcAccessMask = from.access;
+        barrier.dstStageMask = to.stage;
+        barrier.dstAccessMask = to.access;
+        barrier.oldLayout = from.layout;
+        barrier.newLayout = to.layout;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image = image;
+        barrier.subresourceRange.aspectMask = aspect;
+        barrier.subresourceRange.baseMipLevel = 0;
+        barrier.subresourceRange.levelCount = VK_REMAINING_MIP_LEVELS;
+        barrier.subresourceRange.baseArrayLayer = 0;
+        barrier.subresourceRange.layerCount = VK_REMAINING_ARRAY_LAYERS;
+        return barrier;
+    }
+
+    VkBufferMemoryBarrier2 MakeBufferBarrier(VkBuffer buffer, const ResourceState& from, const ResourceState& to) {
+        VkBufferMemoryBarrier2 barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2;
+        barrier.srcStageMask = from.stage;
+        barrier.srcAccessMask = from.access;
+        barrier.dstStageMask = to.stage;
+        barrier.dstAccessMask = to.access;
+        barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer = buffer;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        return barrier;
+    }
+
+    VkBufferMemoryBarrier2 MakeBufferRelease(
+        VkBuffer buffer, ResourceUsage from, std::uint32_t src_family, std::uint32_t dst_family) {
+        VkBufferMemoryBarrier2 barrier = MakeBufferBarrier(buffer, GetResourceState(from), ResourceState());
+        barrier.srcQueueFamilyIndex = src_family;
+        barrier.dstQueueFamilyIndex = dst_family;
+        return barrier;
+    }
+
+    VkBufferMemoryBarrier2 MakeBufferAcquire(
+        VkBuffer buffer, ResourceUsage to, std::uint32_t src_family, std::uint32_t dst_family) {
+        VkBufferMemoryBarrier2 barrier = MakeBufferBarrier(buffer, ResourceState(), GetResourceState(to));
+        barrier.srcQueueFamilyIndex = src_family;
+        barrier.dstQueueFamilyIndex = dst_family;
+        return barrier;
+    }
+
+    VkImageMemoryBarrier2 MakeImageRelease(VkImage image, VkFormat format, ResourceUsage from, ResourceUsage to,
+                                           std::uint32_t src_family, std::uint32_t dst_family) {
+        ResourceState release_to;
+        release_to.layout = GetResourceState(to).layout;
+        VkImageMemoryBarrier2 barrier =
+            MakeImageBarrier(image, GetImageAspect(format), GetResourceState(from), release_to);
+        barrier.srcQueueFamilyIndex = src_family;
+        barrier.dstQueueFamilyIndex = dst_family;
+        return barrier;
+    }
+
+    VkImageMemoryBarrier2 MakeImageAcquire(VkImage image, VkFormat format, ResourceUsage from, ResourceUsage to,
+                                           std::uint32_t src_family, std::uint32_t dst_family) {
+        ResourceState acquire_from;
+        acquire_from.layout = GetResourceState(from).layout;
+        VkImageMemoryBarrier2 barrier =
+            MakeImageBarrier(image, GetImageAspect(format), acquire_from, GetResourceState(to));
+        barrier.srcQueueFamilyIndex = src_family;
+        barrier.dstQueueFamilyIndex = dst_family;
+        return barrier;
+    }
+
+    void RecordImageTransition(
+        VkCommandBuffer command_buffer, VkImage image, VkFormat format, ResourceUsage from, ResourceUsage to) {
+        VkImageMemoryBarrier2 barrier =
+            MakeImageBarrier(image, GetImageAspect(format), GetResourceState(from), GetResourceState(to));
+
+        VkDependencyInfo dependency_info = {};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.imageMemoryBarrierCount = 1;
+        dependency_info.pImageMemoryBarriers = &barrier;
+        vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+    }
+
+    void RecordBufferBarrier(VkCommandBuffer command_buffer, VkBuffer buffer, ResourceUsage from, ResourceUsage to) {
+        VkBufferMemoryBarrier2 barrier = MakeBufferBarrier(buffer, GetResourceState(from), GetResourceState(to));
+
+        VkDependencyInfo dependency_info = {};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.bufferMemoryBarrierCount = 1;
+        dependency_info.pBufferMemoryBarriers = &barrier;
+        vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+    }
+
+    void RecordBarriers(VkCommandBuffer command_buffer, gsl::span<const VkBufferMemoryBarrier2> buffer_barriers,
+                        gsl::span<const VkImageMemoryBarrier2> image_barriers) {
+        if (buffer_barriers.empty() && image_barriers.empty()) {
+            return;
+        }
+
+        VkDependencyInfo dependency_info = {};
+        dependency_info.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO;
+        dependency_info.bufferMemoryBarrierCount = buffer_barriers.size();
+        dependency_info.pBufferMemoryBarriers = buffer_barriers.data();
+        dependency_info.imageMemoryBarrierCount = image_barriers.size();
+        dependency_info.pImageMemoryBarriers = image_barriers.data();
+        vkCmdPipelineBarrier2(command_buffer, &dependency_info);
+    }
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+namespace veng {
+
+    // How a pass touches a resource, each maps to one synchronization2 stage / access / layout
+    enum class ResourceUsage {
+        kUndefined,
+        kColorAttachment,
+        kDepthAttachment,
+        kFragmentSampled,
+        kComputeSampled,
+        // Sampled without leaving the GENERAL layout, e.g. a pyramid that compute also writes
+        kComputeSampledGeneral,
+        kComputeStorageRead,
+        kComputeStorageWrite,
+        kVertexStorageRead,
+        kVertexBuffer,
+        kIndexBuffer,
+        kIndirectBuffer,
+        kTransferSrc,
+        kTransferDst,
+        kPresent,
+    };
+
+    struct ResourceState {
+        VkPipelineStageFlags2 stage = VK_PIPELINE_STAGE_2_NONE;
+        VkAccessFlags2 access = VK_ACCESS_2_NONE;
+        VkImageLayout layout = VK_IMAGE_LAYOUT_UNDEFINED;
+    };
+
+    ResourceState GetResourceState(ResourceUsage usage);
+    bool IsWriteUsage(ResourceUsage usage);
+    VkImageUsageFlags GetImageUsageFlags(ResourceUsage usage);
+    VkImageAspectFlags GetImageAspect(VkFormat format);
+
+    VkImageMemoryBarrier2 MakeImageBarrier(
+        VkImage image, VkImageAspectFlags aspect, const ResourceState& from, const ResourceState& to);
+    VkBufferMemoryBarrier2 MakeBufferBarrier(VkBuffer buffer, const ResourceState& from, const ResourceState& to);
+
+    // Queue family ownership transfers are recorded twice, the release on the source queue carries
+    // only the source half of the barrier and the acquire on the destination queue only the other
+    VkBufferMemoryBarrier2 MakeBufferRelease(
+        VkBuffer buffer, ResourceUsage from, std::uint32_t src_family, std::uint32_t dst_family);
+    VkBufferMemoryBarrier2 MakeBufferAcquire(
+        VkBuffer buffer, ResourceUsage to, std::uint32_t src_family, std::uint32_t dst_family);
+    // Both halves carry the same layout transition
+    VkImageMemoryBarrier2 MakeImageRelease(VkImage image, VkFormat format, ResourceUsage from, ResourceUsage to,
+                                           std::uint32_t src_family, std::uint32_t dst_family);
+    VkImageMemoryBarrier2 MakeImageAcquire(VkImage image, VkFormat format, ResourceUsage from, ResourceUsage to,
+                                           std::uint32_t src_family, std::uint32_t dst_family);
+
+    // One off transitions outside the render graph, e.g. for uploads
+    void RecordImageTransition(
+        VkCommandBuffer command_buffer, VkImage image, VkFormat format, ResourceUsage from, ResourceUsage to);
+    void RecordBufferBarrier(VkCommandBuffer command_buffer, VkBuffer buffer, ResourceUsage from, ResourceUsage to);
+    // One vkCmdPipelineBarrier2 for the whole batch, nothing when both are empty
+    void RecordBarriers(VkCommandBuffer command_buffer, gsl::span<const VkBufferMemoryBarrier2> buffer_barriers,
+                        gsl::span<const VkImageMemoryBarrier2> image_barriers = {});
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+// SSE2 is the x86-64 baseline, AVX is only there when VENG_ENABLE_AVX2 is on
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VENG_SIMD_SSE
+#define VENG_SIMD_AVX
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VENG_SIMD_SSE
+#endif
+
+namespace veng::simd {
+
+    // One float per object, as wide as the build allows
+#if defined(VENG_SIMD_AVX)
+    using Lanes = __m256;
+    constexpr std::uint32_t kLaneCount = 8;
+    inline Lanes Load(const float* source) { return _mm256_loadu_ps(source); }
+    // destination is aligned to 32 bytes
+    inline void Store(float* destination, Lanes value) { _mm256_store_ps(destination, value); }
+    inline Lanes Splat(float value) { return _mm256_set1_ps(value); }
+    inline Lanes Add(Lanes left, Lanes right) { return _mm256_add_ps(left, right); }
+    inline Lanes Sub(Lanes left, Lanes right) { return _mm256_sub_ps(left, right); }
+    inline Lanes Mul(Lanes left, Lanes right) { return _mm256_mul_ps(left, right); }
+    inline Lanes Or(Lanes left, Lanes right) { return _mm256_or_ps(left, right); }
+    inline Lanes Abs(Lanes value) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), value); }
+    inline Lanes Less(Lanes left, Lanes right) { return _mm256_cmp_ps(left, right, _CMP_LT_OQ); }
+    inline Lanes Min(Lanes left, Lanes right) { return _mm256_min_ps(left, right); }
+    // Per lane mask ? if_true : if_false, mask comes from a comparison
+    inline Lanes Select(Lanes mask, Lanes if_true, Lanes if_false) { return _mm256_blendv_ps(if_false, if_true, mask); }
+    // Bit i is set when lane i of a comparison result is
+    inline std::uint32_t MoveMask(Lanes mask) { return _mm256_movemask_ps(mask); }
+#elif defined(VENG_SIMD_SSE)
+    using Lanes = __m128;
+    constexpr std::uint32_t kLaneCount = 4;
+    inline Lanes Load(const float* source) { return _mm_loadu_ps(source); }
+    // destination is aligned to 16 bytes
+    inline void Store(float* destination, Lanes value) { _mm_store_ps(destination, value); }
+    inline Lanes Splat(float value) { return _mm_set1_ps(value); }
+    inline Lanes Add(Lanes left, Lanes right) { return _mm_add_ps(left, right); }
+    inline Lanes Sub(Lanes left, Lanes right) { return _mm_sub_ps(left, right); }
+    inline Lanes Mul(Lanes left, Lanes right) { return _mm_mul_ps(left, right); }
+    inline Lanes Or(Lanes left, Lanes right) { return _mm_or_ps(left, right); }
+    inline Lanes Abs(Lanes value) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), value); }
+    inline Lanes Less(Lanes left, Lanes right) { return _mm_cmplt_ps(left, right); }
+    inline Lanes Min(Lanes left, Lanes right) { return _mm_min_ps(left, right); }
+    // Per lane mask ? if_true : if_false, mask comes from a comparison
+    inline Lanes Select(Lanes mask, Lanes if_true, Lanes if_false) {
+        return _mm_or_ps(_mm_and_ps(mask, if_true), _mm_andnot_ps(mask, if_false));
+    }
+    // Bit i is set when lane i of a comparison result is
+    inline std::uint32_t MoveMask(Lanes mask) { return _mm_movemask_ps(mask); }
+#endif
+}
@@ -0,0 +1,78 @@
+#include <precomp.h>
+#include <staging_ring.h>
+#include <algorithm>
+
+namespace veng {
+
+    void StagingRing::Initialize(std::uint8_t* data, VkDeviceSize capacity) {
+        data_ = data;
+        capacity_ = capacity;
+    }
+
+    std::optional<VkDeviceSize> StagingRing::Allocate(VkDeviceSize size) {
+        // Never empty, so every live allocation has its own offset
+        VkDeviceSize aligned_size = (std::max<VkDeviceSize>(size, 1) + kAlignment - 1) / kAlignment * kAlignment;
+        if (aligned_size > capacity_) {
+            return std::nullopt;
+        }
+
+        std::lock_guard lock(mutex_);
+        VkDeviceSize begin = 0;
+        if (!allocations_.empty()) {
+            VkDeviceSize head = allocations_.front().begin;
+            VkDeviceSize tail = allocations_.back().end;
+            bool wrapped = allocations_.back().begin < head;
+            if (wrapped) {
+                if (tail + aligned_size > head) {
+                    return std::nullopt;
+                }
+                begin = tail;
+            } else if (tail + aligned_size <= capacity_) {
+                begin = tail;
+            } else if (aligned_size <= head) {
+                begin = 0;
+            } else {
+                return std::nullopt;
+            }
+        }
+
+        allocations_.push_back({begin, begin + aligned_size, 0});
+        return begin;
+    }
+
+    void StagingRing::Submit(VkDeviceSize offset, std::uint64_t value) {
+        std::lock_guard lock(mutex_);
+        auto allocation = std::find_if(allocations_.begin(), allocations_.end(),
+                                       [offset](const Allocation& allocation) { return allocation.begin == offset; });
+        if (allocation != allocations_.end()) {
+            allocation->retire_value = value;
+        }
+    }
+
+    void StagingRing::Abandon(VkDeviceSize offset) {
+        std::lock_guard lock(mutex_);
+        auto allocation = std::find_if(allocations_.begin(), allocations_.end(),
+                                       [offset](const Allocation& allocation) { return allocation.begin == offset; });
+        if (allocation == allocations_.end()) {
+            return;
+        }
+        // The newest can go right away, anything older has to wait its turn or it would block the ring for good
+        if (std::next(allocation) == allocations_.end()) {
+            allocations_.pop_back();
+        } else {
+            allocation->abandoned = true;
+        }
+    }
+
+    void StagingRing::Release(std::uint64_t completed_value) {
+        std::lock_guard lock(mutex_);
+        while (!allocations_.empty()) {
+            const Allocation& oldest = allocations_.front();
+            bool retired = oldest.retire_value != 0 && oldest.retire_value <= completed_value;
+            if (!oldest.abandoned && !retired) {
+                break;
+            }
+            allocations_.pop_front();
+        }
+    }
+}
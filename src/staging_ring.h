@@ -0,0 +1,48 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <vulkan/vulkan.h>
+
+namespace veng {
+
+    // Suballocates one persistently mapped staging buffer front to back and wraps around. Space is
+    // handed back in allocation order once the upload that read it has finished, so a slow upload
+    // holds back the ones behind it, which for a loader's stream of similar uploads costs little.
+    // Only does the bookkeeping, the buffer belongs to the caller. Thread safe.
+    class StagingRing {
+        public:
+        // Copy offsets have to be multiples of 4 and of the texel block size
+        static constexpr VkDeviceSize kAlignment = 16;
+
+        void Initialize(std::uint8_t* data, VkDeviceSize capacity);
+
+        // The offset of size free bytes, nullopt when they won't fit until earlier uploads finish
+        std::optional<VkDeviceSize> Allocate(VkDeviceSize size);
+        // The allocation at offset can go once the upload timeline reaches value
+        void Submit(VkDeviceSize offset, std::uint64_t value);
+        // For an allocation that will never be submitted, e.g. when creating the upload's destination threw
+        void Abandon(VkDeviceSize offset);
+        // Frees the submitted allocations up to the first one still in flight
+        void Release(std::uint64_t completed_value);
+
+        std::uint8_t* GetData(VkDeviceSize offset) const { return data_ + offset; }
+        VkDeviceSize GetCapacity() const { return capacity_; }
+
+        private:
+        struct Allocation {
+            VkDeviceSize begin = 0;
+            VkDeviceSize end = 0;
+            // 0 until submitted
+            std::uint64_t retire_value = 0;
+            // Free as soon as everything before it is
+            bool abandoned = false;
+        };
+
+        std::uint8_t* data_ = nullptr;
+        VkDeviceSize capacity_ = 0;
+        std::mutex mutex_;
+        // Oldest first, so the live range runs from the front's begin to the back's end
+        std::deque<Allocation> allocations_;
+    };
+}
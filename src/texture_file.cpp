@@ -0,0 +1,304 @@
+#include <precomp.h>
+#include <texture_file.h>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC compiles any intrinsic without an /arch flag
+#define VENG_TARGET_SSSE3
+#else
+#define VENG_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#define VENG_RUNTIME_SSSE3
+#endif
+
+namespace veng {
+
+    namespace {
+
+        constexpr std::array<std::uint8_t, 12> kKtx2Identifier = {0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32,
+                                                                  0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A};
+        constexpr std::array<std::uint8_t, 4> kDdsMagic = {'D', 'D', 'S', ' '};
+
+        constexpr std::uint64_t kKtx2HeaderSize = 80;
+        constexpr std::uint64_t kKtx2LevelSize = 24;
+        // Magic, DDS_HEADER and DDS_HEADER_DXT10
+        constexpr std::uint64_t kDdsHeaderSize = 4 + 124;
+        constexpr std::uint64_t kDdsDx10HeaderSize = 20;
+        constexpr std::uint32_t kDdsMipMapCountFlag = 0x20000;
+        constexpr std::uint32_t kDdsCubemapFlag = 0x200;
+        constexpr std::uint32_t kDdsVolumeFlag = 0x200000;
+        constexpr std::uint32_t kDdsRgbFlag = 0x40;
+        constexpr std::uint32_t kDdsDimensionTexture2D = 3;
+        constexpr std::uint32_t kDdsMiscTextureCube = 0x4;
+
+        // Callers check the bounds first
+        template <typename T>
+        T ReadValue(gsl::span<const std::uint8_t> data, std::uint64_t offset) {
+            T value;
+            std::memcpy(&value, data.data() + offset, sizeof(T));
+            return value;
+        }
+
+        constexpr std::uint32_t MakeFourCC(std::string_view code) {
+            return std::uint32_t(std::uint8_t(code[0])) | std::uint32_t(std::uint8_t(code[1])) << 8 |
+                   std::uint32_t(std::uint8_t(code[2])) << 16 | std::uint32_t(std::uint8_t(code[3])) << 24;
+        }
+
+        VkFormat FromFourCC(std::uint32_t four_cc) {
+            switch (four_cc) {
+                case MakeFourCC("DXT1"):
+                    return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+                case MakeFourCC("DXT3"):
+                    return VK_FORMAT_BC2_UNORM_BLOCK;
+                case MakeFourCC("DXT5"):
+                    return VK_FORMAT_BC3_UNORM_BLOCK;
+                case MakeFourCC("ATI1"):
+                case MakeFourCC("BC4U"):
+                    return VK_FORMAT_BC4_UNORM_BLOCK;
+                case MakeFourCC("ATI2"):
+                case MakeFourCC("BC5U"):
+                    return VK_FORMAT_BC5_UNORM_BLOCK;
+                default:
+                    return VK_FORMAT_UNDEFINED;
+            }
+        }
+
+        VkFormat FromDxgiFormat(std::uint32_t dxgi_format) {
+            switch (dxgi_format) {
+                case 28:
+                    return VK_FORMAT_R8G8B8A8_UNORM;
+                case 29:
+                    return VK_FORMAT_R8G8B8A8_SRGB;
+                case 71:
+                    return VK_FORMAT_BC1_RGBA_UNORM_BLOCK;
+                case 72:
+                    return VK_FORMAT_BC1_RGBA_SRGB_BLOCK;
+                case 74:
+                    return VK_FORMAT_BC2_UNORM_BLOCK;
+                case 75:
+                    return VK_FORMAT_BC2_SRGB_BLOCK;
+                case 77:
+                    return VK_FORMAT_BC3_UNORM_BLOCK;
+                case 78:
+                    return VK_FORMAT_BC3_SRGB_BLOCK;
+                case 80:
+                    return VK_FORMAT_BC4_UNORM_BLOCK;
+                case 81:
+                    return VK_FORMAT_BC4_SNORM_BLOCK;
+                case 83:
+                    return VK_FORMAT_BC5_UNORM_BLOCK;
+                case 84:
+                    return VK_FORMAT_BC5_SNORM_BLOCK;
+                case 95:
+                    return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+                case 96:
+                    return VK_FORMAT_BC6H_SFLOAT_BLOCK;
+                case 98:
+                    return VK_FORMAT_BC7_UNORM_BLOCK;
+                case 99:
+                    return VK_FORMAT_BC7_SRGB_BLOCK;
+                default:
+                    return VK_FORMAT_UNDEFINED;
+            }
+        }
+
+#if defined(VENG_RUNTIME_SSSE3)
+        // The baseline build is SSE2 only, but every x86-64 CPU of the last fifteen years has the byte shuffle
+        bool HasSsse3() {
+#if defined(_MSC_VER) && !defined(__clang__)
+            std::array<int, 4> registers;
+            __cpuid(registers.data(), 1);
+            return (registers[2] >> 9) & 1;
+#else
+            return __builtin_cpu_supports("ssse3");
+#endif
+        }
+
+        // Four pixels per shuffle, returns how many were expanded. Each load reads 16 bytes for the 12 it
+        // uses, so it stops while 4 more are there.
+        VENG_TARGET_SSSE3 std::size_t ExpandRgbToRgbaSsse3(const std::uint8_t* rgb, std::uint8_t* rgba,
+                                                           std::size_t pixel_count) {
+            const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+            const __m128i alpha = _mm_set1_epi32(static_cast<std::int32_t>(0xFF000000));
+            std::size_t pixel = 0;
+            for (; pixel + 6 <= pixel_count; pixel += 4) {
+                __m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + pixel * 3));
+                __m128i expanded = _mm_or_si128(_mm_shuffle_epi8(source, shuffle), alpha);
+                _mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + pixel * 4), expanded);
+            }
+            return pixel;
+        }
+#endif
+    }
+
+    std::uint64_t GetTextureLevelSize(VkFormat format, std::uint32_t width, std::uint32_t height) {
+        std::uint64_t blocks = std::uint64_t((width + 3) / 4) * ((height + 3) / 4);
+        switch (format) {
+            case VK_FORMAT_R8G8B8A8_SRGB:
+            case VK_FORMAT_R8G8B8A8_UNORM:
+                return std::uint64_t(width) * height * 4;
+            case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+            case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+            case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+            case VK_FORMAT_BC4_UNORM_BLOCK:
+            case VK_FORMAT_BC4_SNORM_BLOCK:
+                return blocks * 8;
+            case VK_FORMAT_BC2_UNORM_BLOCK:
+            case VK_FORMAT_BC2_SRGB_BLOCK:
+            case VK_FORMAT_BC3_UNORM_BLOCK:
+            case VK_FORMAT_BC3_SRGB_BLOCK:
+            case VK_FORMAT_BC5_UNORM_BLOCK:
+            case VK_FORMAT_BC5_SNORM_BLOCK:
+            case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+            case VK_FORMAT_BC6H_SFLOAT_BLOCK:
+            case VK_FORMAT_BC7_UNORM_BLOCK:
+            case VK_FORMAT_BC7_SRGB_BLOCK:
+                return blocks * 16;
+            default:
+                return 0;
+        }
+    }
+
+    bool IsBlockCompressed(VkFormat format) {
+        return format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_BC7_SRGB_BLOCK;
+    }
+
+    void ExpandRgbToRgba(const std::uint8_t* rgb, std::uint8_t* rgba, std::size_t pixel_count) {
+        std::size_t pixel = 0;
+#if defined(VENG_RUNTIME_SSSE3)
+        static const bool has_ssse3 = HasSsse3();
+        if (has_ssse3) {
+            pixel = ExpandRgbToRgbaSsse3(rgb, rgba, pixel_count);
+        }
+#endif
+        // Without a byte shuffle, four pixels are three words shifted into four
+        for (; pixel + 4 <= pixel_count; pixel += 4) {
+            std::array<std::uint32_t, 3> words;
+            std::memcpy(words.data(), rgb + pixel * 3, sizeof(words));
+            std::array<std::uint32_t, 4> expanded = {
+                words[0] | 0xFF000000u,
+                (words[0] >> 24 | words[1] << 8) | 0xFF000000u,
+                (words[1] >> 16 | words[2] << 16) | 0xFF000000u,
+                words[2] >> 8 | 0xFF000000u,
+            };
+            std::memcpy(rgba + pixel * 4, expanded.data(), sizeof(expanded));
+        }
+        for (; pixel < pixel_count; pixel++) {
+            rgba[pixel * 4 + 0] = rgb[pixel * 3 + 0];
+            rgba[pixel * 4 + 1] = rgb[pixel * 3 + 1];
+            rgba[pixel * 4 + 2] = rgb[pixel * 3 + 2];
+            rgba[pixel * 4 + 3] = 255;
+        }
+    }
+
+    std::optional<TextureFileView> ParseKtx2(gsl::span<const std::uint8_t> data) {
+        if (data.size() < kKtx2HeaderSize ||
+            !std::equal(kKtx2Identifier.begin(), kKtx2Identifier.end(), data.begin())) {
+            return std::nullopt;
+        }
+
+        TextureFileView view;
+        view.format = static_cast<VkFormat>(ReadValue<std::uint32_t>(data, 12));
+        view.width = ReadValue<std::uint32_t>(data, 20);
+        view.height = ReadValue<std::uint32_t>(data, 24);
+        std::uint32_t depth = ReadValue<std::uint32_t>(data, 28);
+        std::uint32_t layer_count = ReadValue<std::uint32_t>(data, 32);
+        std::uint32_t face_count = ReadValue<std::uint32_t>(data, 36);
+        // 0 asks the loader to generate the mips, there's only the base level in the file then
+        std::uint32_t level_count = std::max(ReadValue<std::uint32_t>(data, 40), 1u);
+        std::uint32_t supercompression = ReadValue<std::uint32_t>(data, 44);
+        if (view.width == 0 || view.height == 0 || depth > 1 || layer_count > 1 || face_count != 1 ||
+            supercompression != 0 || level_count > 32 || GetTextureLevelSize(view.format, 1, 1) == 0) {
+            return std::nullopt;
+        }
+        if (data.size() < kKtx2HeaderSize + level_count * kKtx2LevelSize) {
+            return std::nullopt;
+        }
+
+        for (std::uint32_t level = 0; level < level_count; level++) {
+            std::uint64_t index = kKtx2HeaderSize + level * kKtx2LevelSize;
+            std::uint64_t offset = ReadValue<std::uint64_t>(data, index);
+            std::uint64_t size = ReadValue<std::uint64_t>(data, index + 8);
+            std::uint32_t width = std::max(view.width >> level, 1u);
+            std::uint32_t height = std::max(view.height >> level, 1u);
+            if (size != GetTextureLevelSize(view.format, width, height) || offset > data.size() ||
+                size > data.size() - offset) {
+                return std::nullopt;
+            }
+            view.levels.push_back(data.subspan(offset, size));
+        }
+        return view;
+    }
+
+    std::optional<TextureFileView> ParseDds(gsl::span<const std::uint8_t> data) {
+        if (data.size() < kDdsHeaderSize || !std::equal(kDdsMagic.begin(), kDdsMagic.end(), data.begin()) ||
+            ReadValue<std::uint32_t>(data, 4) != 124) {
+            return std::nullopt;
+        }
+
+        TextureFileView view;
+        std::uint32_t flags = ReadValue<std::uint32_t>(data, 8);
+        view.height = ReadValue<std::uint32_t>(data, 12);
+        view.width = ReadValue<std::uint32_t>(data, 16);
+        std::uint32_t level_count = flags & kDdsMipMapCountFlag ? std::max(ReadValue<std::uint32_t>(data, 28), 1u) : 1;
+        std::uint32_t pixel_flags = ReadValue<std::uint32_t>(data, 80);
+        std::uint32_t four_cc = ReadValue<std::uint32_t>(data, 84);
+        std::uint32_t caps2 = ReadValue<std::uint32_t>(data, 112);
+        if (caps2 & (kDdsCubemapFlag | kDdsVolumeFlag)) {
+            return std::nullopt;
+        }
+
+        std::uint64_t offset = kDdsHeaderSize;
+        if (four_cc == MakeFourCC("DX10")) {
+            if (data.size() < kDdsHeaderSize + kDdsDx10HeaderSize) {
+                return std::nullopt;
+            }
+            view.format = FromDxgiFormat(ReadValue<std::uint32_t>(data, offset));
+            std::uint32_t dimension = ReadValue<std::uint32_t>(data, offset + 4);
+            std::uint32_t misc_flags = ReadValue<std::uint32_t>(data, offset + 8);
+            std::uint32_t array_size = ReadValue<std::uint32_t>(data, offset + 12);
+            if (dimension != kDdsDimensionTexture2D || (misc_flags & kDdsMiscTextureCube) || array_size > 1) {
+                return std::nullopt;
+            }
+            offset += kDdsDx10HeaderSize;
+        } else if (pixel_flags & kDdsRgbFlag) {
+            // Only the common 32 bit RGBA layout, everything else needs swizzling
+            std::uint32_t bit_count = ReadValue<std::uint32_t>(data, 88);
+            std::uint32_t red_mask = ReadValue<std::uint32_t>(data, 92);
+            std::uint32_t alpha_mask = ReadValue<std::uint32_t>(data, 104);
+            if (bit_count == 32 && red_mask == 0x000000FF && alpha_mask == 0xFF000000) {
+                view.format = VK_FORMAT_R8G8B8A8_UNORM;
+            }
+        } else {
+            view.format = FromFourCC(four_cc);
+        }
+        if (view.width == 0 || view.height == 0 || level_count > 32 || view.format == VK_FORMAT_UNDEFINED) {
+            return std::nullopt;
+        }
+
+        // Levels follow the header back to back, largest first
+        for (std::uint32_t level = 0; level < level_count; level++) {
+            std::uint64_t size = GetTextureLevelSize(view.format, std::max(view.width >> level, 1u),
+                                                     std::max(view.height >> level, 1u));
+            if (size > data.size() - offset) {
+                return std::nullopt;
+            }
+            view.levels.push_back(data.subspan(offset, size));
+            offset += size;
+        }
+        return view;
+    }
+
+    std::optional<TextureFileView> ParseTextureFile(gsl::span<const std::uint8_t> data) {
+        if (data.size() >= kKtx2Identifier.size() &&
+            std::equal(kKtx2Identifier.begin(), kKtx2Identifier.end(), data.begin())) {
+            return ParseKtx2(data);
+        }
+        return ParseDds(data);
+    }
+}
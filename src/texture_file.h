@@ -0,0 +1,28 @@
+#pragma once
+
+#include <vector>
+#include <vulkan/vulkan.h>
+
+namespace veng {
+
+    // Bytes of one tightly packed mip level, block compressed formats round up to whole 4x4 blocks.
+    // 0 for formats textures can't be loaded in.
+    std::uint64_t GetTextureLevelSize(VkFormat format, std::uint32_t width, std::uint32_t height);
+    bool IsBlockCompressed(VkFormat format);
+    // Packed RGB8 to RGBA8 with opaque alpha, e.g. straight into staging memory
+    void ExpandRgbToRgba(const std::uint8_t* rgb, std::uint8_t* rgba, std::size_t pixel_count);
+
+    // A 2D texture inside a KTX2 or DDS file, levels point into the file's data and start with the largest
+    struct TextureFileView {
+        VkFormat format = VK_FORMAT_UNDEFINED;
+        std::uint32_t width = 0;
+        std::uint32_t height = 0;
+        std::vector<gsl::span<const std::uint8_t>> levels;
+    };
+
+    // Empty for anything but a single 2D image without supercompression in a format GetTextureLevelSize knows
+    std::optional<TextureFileView> ParseKtx2(gsl::span<const std::uint8_t> data);
+    std::optional<TextureFileView> ParseDds(gsl::span<const std::uint8_t> data);
+    // Picks the parser by the file's identifier
+    std::optional<TextureFileView> ParseTextureFile(gsl::span<const std::uint8_t> data);
+}
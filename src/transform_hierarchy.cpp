@@ -0,0 +1,304 @@
+#include <precomp.h>
+#include <transform_hierarchy.h>
+#include <algorithm>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/type_ptr.hpp>
+#include <simd.h>
+
+namespace veng {
+
+    namespace {
+
+        // Small levels aren't worth waking the workers for
+        constexpr std::uint32_t kUpdateBatchSize = 4096;
+
+        // The upper 3x3 of a local matrix plus its translation, one row of lanes per component,
+        // in column order: x axis, y axis, z axis, translation
+        constexpr std::uint32_t kLocalComponents = 12;
+
+        template <typename T>
+        void Permute(std::vector<T>& values, const std::vector<std::uint32_t>& new_slots) {
+            std::vector<T> permuted(values.size());
+            for (std::uint32_t slot = 0; slot < values.size(); slot++) {
+                permuted[new_slots[slot]] = values[slot];
+            }
+            values = std::move(permuted);
+        }
+    }
+
+    TransformHandle TransformHierarchy::Create(TransformHandle parent) {
+        std::uint32_t slot = parent_slots_.size();
+        std::uint32_t parent_slot = parent.IsValid() ? GetSlot(parent) : UINT32_MAX;
+        std::uint32_t depth = parent.IsValid() ? depths_[parent_slot] + 1 : 0;
+
+        // Appending keeps the depth order only when nothing deeper is already there
+        if (!level_ends_.empty() && depth + 1 < level_ends_.size()) {
+            sorted_ = false;
+        }
+        if (sorted_) {
+            level_ends_.resize(std::max<std::size_t>(level_ends_.size(), depth + 1), slot);
+            level_ends_[depth] = slot + 1;
+        }
+
+        TransformHandle handle = {static_cast<std::uint32_t>(handle_slots_.size())};
+        handle_slots_.push_back(slot);
+        slot_handles_.push_back(handle.index);
+        parent_slots_.push_back(parent_slot);
+        depths_.push_back(depth);
+
+        for (std::vector<float>& component : translation_) {
+            component.push_back(0.0f);
+        }
+        for (std::vector<float>& component : rotation_) {
+            component.push_back(0.0f);
+        }
+        rotation_[3].back() = 1.0f;
+        for (std::vector<float>& component : scale_) {
+            component.push_back(1.0f);
+        }
+
+        dirty_.push_back(1);
+        changed_.push_back(0);
+        world_.emplace_back(1.0f);
+        return handle;
+    }
+
+    void TransformHierarchy::Reserve(std::uint32_t count) {
+        handle_slots_.reserve(count);
+        slot_handles_.reserve(count);
+        parent_slots_.reserve(count);
+        depths_.reserve(count);
+        for (std::vector<float>& component : translation_) {
+            component.reserve(count);
+        }
+        for (std::vector<float>& component : rotation_) {
+            component.reserve(count);
+        }
+        for (std::vector<float>& component : scale_) {
+            component.reserve(count);
+        }
+        dirty_.reserve(count);
+        changed_.reserve(count);
+        world_.reserve(count);
+    }
+
+    void TransformHierarchy::SetTranslation(TransformHandle handle, glm::vec3 translation) {
+        std::uint32_t slot = GetSlot(handle);
+        for (std::uint32_t i = 0; i < 3; i++) {
+            translation_[i][slot] = translation[i];
+        }
+        dirty_[slot] = 1;
+    }
+
+    void TransformHierarchy::SetRotation(TransformHandle handle, glm::quat rotation) {
+        std::uint32_t slot = GetSlot(handle);
+        rotation_[0][slot] = rotation.x;
+        rotation_[1][slot] = rotation.y;
+        rotation_[2][slot] = rotation.z;
+        rotation_[3][slot] = rotation.w;
+        dirty_[slot] = 1;
+    }
+
+    void TransformHierarchy::SetScale(TransformHandle handle, glm::vec3 scale) {
+        std::uint32_t slot = GetSlot(handle);
+        for (std::uint32_t i = 0; i < 3; i++) {
+            scale_[i][slot] = scale[i];
+        }
+        dirty_[slot] = 1;
+    }
+
+    glm::vec3 TransformHierarchy::GetTranslation(TransformHandle handle) const {
+        std::uint32_t slot = GetSlot(handle);
+        return {translation_[0][slot], translation_[1][slot], translation_[2][slot]};
+    }
+
+    glm::quat TransformHierarchy::GetRotation(TransformHandle handle) const {
+        std::uint32_t slot = GetSlot(handle);
+        return glm::quat(rotation_[3][slot], rotation_[0][slot], rotation_[1][slot], rotation_[2][slot]);
+    }
+
+    glm::vec3 TransformHierarchy::GetScale(TransformHandle handle) const {
+        std::uint32_t slot = GetSlot(handle);
+        return {scale_[0][slot], scale_[1][slot], scale_[2][slot]};
+    }
+
+    const glm::mat4& TransformHierarchy::GetWorldMatrix(TransformHandle handle) const {
+        return world_[GetSlot(handle)];
+    }
+
+    void TransformHierarchy::SortByDepth() {
+        // Counting sort, stable so siblings keep their creation order
+        level_ends_.assign(*std::max_element(depths_.begin(), depths_.end()) + 1, 0);
+        for (std::uint32_t depth : depths_) {
+            level_ends_[depth]++;
+        }
+        std::vector<std::uint32_t> level_starts(level_ends_.size(), 0);
+        for (std::uint32_t depth = 1; depth < level_ends_.size(); depth++) {
+            level_starts[depth] = level_starts[depth - 1] + level_ends_[depth - 1];
+        }
+        for (std::uint32_t depth = 0; depth < level_ends_.size(); depth++) {
+            level_ends_[depth] += level_starts[depth];
+        }
+
+        std::vector<std::uint32_t> new_slots(depths_.size());
+        for (std::uint32_t slot = 0; slot < depths_.size(); slot++) {
+            new_slots[slot] = level_starts[depths_[slot]]++;
+        }
+
+        for (std::uint32_t& parent_slot : parent_slots_) {
+            if (parent_slot != UINT32_MAX) {
+                parent_slot = new_slots[parent_slot];
+            }
+        }
+        Permute(parent_slots_, new_slots);
+        Permute(slot_handles_, new_slots);
+        Permute(depths_, new_slots);
+        for (std::vector<float>& component : translation_) {
+            Permute(component, new_slots);
+        }
+        for (std::vector<float>& component : rotation_) {
+            Permute(component, new_slots);
+        }
+        for (std::vector<float>& component : scale_) {
+            Permute(component, new_slots);
+        }
+        Permute(dirty_, new_slots);
+        Permute(world_, new_slots);
+
+        for (std::uint32_t slot = 0; slot < slot_handles_.size(); slot++) {
+            handle_slots_[slot_handles_[slot]] = slot;
+        }
+        sorted_ = true;
+    }
+
+    void TransformHierarchy::Update(JobSystem* job_system) {
+        if (!sorted_) {
+            SortByDepth();
+        }
+
+        // Each level only reads the one above it, which is finished by the time it starts
+        std::uint32_t level_begin = 0;
+        for (std::uint32_t level_end : level_ends_) {
+            auto update_batch = [this, level_begin](std::uint32_t begin, std::uint32_t end) {
+                UpdateRange(level_begin + begin, level_begin + end);
+            };
+            if (job_system != nullptr) {
+                job_system->ParallelFor(level_end - level_begin, kUpdateBatchSize, update_batch);
+            } else {
+                update_batch(0, level_end - level_begin);
+            }
+            level_begin = level_end;
+        }
+    }
+
+    void TransformHierarchy::UpdateRange(std::uint32_t begin, std::uint32_t end) {
+        std::uint32_t slot = begin;
+#if defined(VENG_SIMD_SSE)
+        for (; slot + simd::kLaneCount <= end; slot += simd::kLaneCount) {
+            UpdateLanes(slot);
+        }
+#endif
+        for (; slot < end; slot++) {
+            UpdateSingle(slot);
+        }
+    }
+
+    bool TransformHierarchy::PropagateDirty(std::uint32_t slot) {
+        std::uint32_t parent_slot = parent_slots_[slot];
+        bool changed = dirty_[slot] != 0 || (parent_slot != UINT32_MAX && changed_[parent_slot] != 0);
+        changed_[slot] = changed ? 1 : 0;
+        dirty_[slot] = 0;
+        return changed;
+    }
+
+    void TransformHierarchy::UpdateSingle(std::uint32_t slot) {
+        if (!PropagateDirty(slot)) {
+            return;
+        }
+
+        glm::mat4 local = glm::translate(glm::mat4(1.0f), GetTranslation({slot_handles_[slot]})) *
+                          glm::mat4_cast(GetRotation({slot_handles_[slot]})) *
+                          glm::scale(glm::mat4(1.0f), GetScale({slot_handles_[slot]}));
+        std::uint32_t parent_slot = parent_slots_[slot];
+        world_[slot] = parent_slot != UINT32_MAX ? world_[parent_slot] * local : local;
+    }
+
+    void TransformHierarchy::UpdateLanes(std::uint32_t first_slot) {
+#if defined(VENG_SIMD_SSE)
+        bool any_changed = false;
+        for (std::uint32_t lane = 0; lane < simd::kLaneCount; lane++) {
+            any_changed |= PropagateDirty(first_slot + lane);
+        }
+        if (!any_changed) {
+            return;
+        }
+
+        simd::Lanes x = simd::Load(&rotation_[0][first_slot]);
+        simd::Lanes y = simd::Load(&rotation_[1][first_slot]);
+        simd::Lanes z = simd::Load(&rotation_[2][first_slot]);
+        simd::Lanes w = simd::Load(&rotation_[3][first_slot]);
+        simd::Lanes scale_x = simd::Load(&scale_[0][first_slot]);
+        simd::Lanes scale_y = simd::Load(&scale_[1][first_slot]);
+        simd::Lanes scale_z = simd::Load(&scale_[2][first_slot]);
+
+        // Same expansion as glm::mat4_cast, then each axis is scaled
+        simd::Lanes one = simd::Splat(1.0f);
+        simd::Lanes two = simd::Splat(2.0f);
+        simd::Lanes xx = simd::Mul(x, x);
+        simd::Lanes yy = simd::Mul(y, y);
+        simd::Lanes zz = simd::Mul(z, z);
+        simd::Lanes xy = simd::Mul(x, y);
+        simd::Lanes xz = simd::Mul(x, z);
+        simd::Lanes yz = simd::Mul(y, z);
+        simd::Lanes wx = simd::Mul(w, x);
+        simd::Lanes wy = simd::Mul(w, y);
+        simd::Lanes wz = simd::Mul(w, z);
+
+        alignas(32) std::array<std::array<float, simd::kLaneCount>, kLocalComponents> local;
+        simd::Store(local[0].data(), simd::Mul(scale_x, simd::Sub(one, simd::Mul(two, simd::Add(yy, zz)))));
+        simd::Store(local[1].data(), simd::Mul(scale_x, simd::Mul(two, simd::Add(xy, wz))));
+        simd::Store(local[2].data(), simd::Mul(scale_x, simd::Mul(two, simd::Sub(xz, wy))));
+        simd::Store(local[3].data(), simd::Mul(scale_y, simd::Mul(two, simd::Sub(xy, wz))));
+        simd::Store(local[4].data(), simd::Mul(scale_y, simd::Sub(one, simd::Mul(two, simd::Add(xx, zz)))));
+        simd::Store(local[5].data(), simd::Mul(scale_y, simd::Mul(two, simd::Add(yz, wx))));
+        simd::Store(local[6].data(), simd::Mul(scale_z, simd::Mul(two, simd::Add(xz, wy))));
+        simd::Store(local[7].data(), simd::Mul(scale_z, simd::Mul(two, simd::Sub(yz, wx))));
+        simd::Store(local[8].data(), simd::Mul(scale_z, simd::Sub(one, simd::Mul(two, simd::Add(xx, yy)))));
+        simd::Store(local[9].data(), simd::Load(&translation_[0][first_slot]));
+        simd::Store(local[10].data(), simd::Load(&translation_[1][first_slot]));
+        simd::Store(local[11].data(), simd::Load(&translation_[2][first_slot]));
+
+        for (std::uint32_t lane = 0; lane < simd::kLaneCount; lane++) {
+            std::uint32_t slot = first_slot + lane;
+            if (changed_[slot] == 0) {
+                continue;
+            }
+
+            std::uint32_t parent_slot = parent_slots_[slot];
+            float* world = glm::value_ptr(world_[slot]);
+            if (parent_slot == UINT32_MAX) {
+                for (std::uint32_t column = 0; column < 3; column++) {
+                    _mm_storeu_ps(world + column * 4, _mm_setr_ps(local[column * 3][lane], local[column * 3 + 1][lane],
+                                                                  local[column * 3 + 2][lane], 0.0f));
+                }
+                _mm_storeu_ps(world + 12, _mm_setr_ps(local[9][lane], local[10][lane], local[11][lane], 1.0f));
+                continue;
+            }
+
+            // world = parent * local, one parent column per local row
+            const float* parent = glm::value_ptr(world_[parent_slot]);
+            __m128 parent_columns[4] = {
+                _mm_loadu_ps(parent), _mm_loadu_ps(parent + 4), _mm_loadu_ps(parent + 8), _mm_loadu_ps(parent + 12)};
+            for (std::uint32_t column = 0; column < 4; column++) {
+                __m128 result = _mm_mul_ps(parent_columns[0], _mm_set1_ps(local[column * 3][lane]));
+                result = _mm_add_ps(result, _mm_mul_ps(parent_columns[1], _mm_set1_ps(local[column * 3 + 1][lane])));
+                result = _mm_add_ps(result, _mm_mul_ps(parent_columns[2], _mm_set1_ps(local[column * 3 + 2][lane])));
+                if (column == 3) {
+                    result = _mm_add_ps(result, parent_columns[3]);
+                }
+                _mm_storeu_ps(world + column * 4, result);
+            }
+        }
+#endif
+    }
+}
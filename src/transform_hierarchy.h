@@ -0,0 +1,70 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <glm/gtc/quaternion.hpp>
+#include <job_system.h>
+
+namespace veng {
+
+    struct TransformHandle {
+        std::uint32_t index = UINT32_MAX;
+        bool IsValid() const { return index != UINT32_MAX; }
+    };
+
+    // Local translation / rotation / scale live in one float stream per component, so world matrices are
+    // built several nodes at a time with SSE, or AVX when VENG_ENABLE_AVX2 is on. Nodes are kept sorted
+    // by depth: parents come before their children and every depth level can be split across cores.
+    class TransformHierarchy {
+        public:
+        // Parents have to exist before their children
+        TransformHandle Create(TransformHandle parent = {});
+        void Reserve(std::uint32_t count);
+
+        void SetTranslation(TransformHandle handle, glm::vec3 translation);
+        void SetRotation(TransformHandle handle, glm::quat rotation);
+        void SetScale(TransformHandle handle, glm::vec3 scale);
+        glm::vec3 GetTranslation(TransformHandle handle) const;
+        glm::quat GetRotation(TransformHandle handle) const;
+        glm::vec3 GetScale(TransformHandle handle) const;
+
+        // Recomputes the world matrices of every changed node and its descendants, without a job system
+        // on the calling thread only
+        void Update(JobSystem* job_system = nullptr);
+
+        const glm::mat4& GetWorldMatrix(TransformHandle handle) const;
+        // Indexed by slot, parents before children. Contiguous, so it can be copied straight into an
+        // instance or culling buffer. Slots are only stable between two calls to Create.
+        gsl::span<const glm::mat4> GetWorldMatrices() const { return world_; }
+        // Nonzero for the slots the last Update recomputed
+        gsl::span<const std::uint8_t> GetChangedFlags() const { return changed_; }
+        std::uint32_t GetSlot(TransformHandle handle) const { return handle_slots_[handle.index]; }
+        std::uint32_t GetCount() const { return parent_slots_.size(); }
+
+        private:
+        void SortByDepth();
+        void UpdateRange(std::uint32_t begin, std::uint32_t end);
+        // Also clears the node's dirty flag, false when neither it nor its parent changed
+        bool PropagateDirty(std::uint32_t slot);
+        void UpdateSingle(std::uint32_t slot);
+        void UpdateLanes(std::uint32_t first_slot);
+
+        std::vector<std::uint32_t> handle_slots_;
+        std::vector<std::uint32_t> slot_handles_;
+        // UINT32_MAX for roots
+        std::vector<std::uint32_t> parent_slots_;
+        std::vector<std::uint32_t> depths_;
+        // Slot past the last node of each depth
+        std::vector<std::uint32_t> level_ends_;
+        bool sorted_ = true;
+
+        std::array<std::vector<float>, 3> translation_;
+        std::array<std::vector<float>, 4> rotation_;
+        std::array<std::vector<float>, 3> scale_;
+
+        // Set by the setters, changed_ also covers nodes whose parent changed
+        std::vector<std::uint8_t> dirty_;
+        std::vector<std::uint8_t> changed_;
+        std::vector<glm::mat4> world_;
+    };
+}
@@ -0,0 +1,87 @@
+#include <precomp.h>
+#include <upload_queue.h>
+
+namespace veng {
+
+    void UploadQueue::Initialize(VkDevice device, GpuTimeline& timeline, std::uint32_t queue_family) {
+        device_ = device;
+        timeline_ = &timeline;
+        queue_family_ = queue_family;
+    }
+
+    void UploadQueue::Destroy() {
+        std::lock_guard lock(pools_mutex_);
+        for (auto& [thread, pool] : pools_) {
+            vkDestroyCommandPool(device_, pool.pool, nullptr);
+        }
+        pools_.clear();
+    }
+
+    UploadQueue::ThreadPool& UploadQueue::GetThreadPool() {
+        std::lock_guard lock(pools_mutex_);
+
+        // Map nodes don't move, the calling thread keeps its reference without holding the lock
+        ThreadPool& pool = pools_[std::this_thread::get_id()];
+        if (pool.pool != VK_NULL_HANDLE) {
+            return pool;
+        }
+
+        VkCommandPoolCreateInfo pool_info = {};
+        pool_info.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        pool_info.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        pool_info.queueFamilyIndex = queue_family_;
+
+        if (vkCreateCommandPool(device_, &pool_info, nullptr, &pool.pool) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create upload command pool!");
+        }
+        return pool;
+    }
+
+    VkCommandBuffer UploadQueue::Begin() {
+        ThreadPool& pool = GetThreadPool();
+
+        while (!pool.in_flight.empty() && timeline_->IsComplete(pool.in_flight.front().first)) {
+            pool.available.push_back(pool.in_flight.front().second);
+            pool.in_flight.pop_front();
+        }
+
+        VkCommandBuffer command_buffer = VK_NULL_HANDLE;
+        if (!pool.available.empty()) {
+            command_buffer = pool.available.back();
+            pool.available.pop_back();
+        } else {
+            VkCommandBufferAllocateInfo allocation_info = {};
+            allocation_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocation_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocation_info.commandPool = pool.pool;
+            allocation_info.commandBufferCount = 1;
+
+            if (vkAllocateCommandBuffers(device_, &allocation_info, &command_buffer) != VK_SUCCESS) {
+                throw std::runtime_error("Failed to allocate upload command buffer!");
+            }
+        }
+
+        // Begin resets buffers coming back from in_flight
+        VkCommandBufferBeginInfo begin_info = {};
+        begin_info.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        if (vkBeginCommandBuffer(command_buffer, &begin_info) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to begin upload command buffer!");
+        }
+
+        return command_buffer;
+    }
+
+    std::uint64_t UploadQueue::Submit(VkCommandBuffer command_buffer) {
+        if (vkEndCommandBuffer(command_buffer) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to record upload command buffer!");
+        }
+
+        QueueSubmission submission;
+        submission.command_buffers.push_back(command_buffer);
+        std::uint64_t value = timeline_->Submit(submission);
+
+        GetThreadPool().in_flight.emplace_back(value, command_buffer);
+        return value;
+    }
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include <gpu_timeline.h>
+
+namespace veng {
+
+    // Records uploads for the queue behind a timeline. Every thread gets its own command pool, so
+    // loader threads record in parallel and only the submission itself is serialized.
+    class UploadQueue {
+        public:
+        void Initialize(VkDevice device, GpuTimeline& timeline, std::uint32_t queue_family);
+        // Pools of threads that have exited stay around until here
+        void Destroy();
+
+        GpuTimeline& GetTimeline() { return *timeline_; }
+        std::uint32_t GetQueueFamily() const { return queue_family_; }
+
+        VkCommandBuffer Begin();
+        // Has to be called on the thread that began the command buffer, returns the timeline value
+        // signaled once the upload has finished
+        std::uint64_t Submit(VkCommandBuffer command_buffer);
+
+        private:
+        struct ThreadPool {
+            VkCommandPool pool = VK_NULL_HANDLE;
+            // Submission order, so the oldest retire first
+            std::deque<std::pair<std::uint64_t, VkCommandBuffer>> in_flight;
+            std::vector<VkCommandBuffer> available;
+        };
+
+        ThreadPool& GetThreadPool();
+
+        VkDevice device_ = VK_NULL_HANDLE;
+        GpuTimeline* timeline_ = nullptr;
+        std::uint32_t queue_family_ = 0;
+
+        std::mutex pools_mutex_;
+        std::unordered_map<std::thread::id, ThreadPool> pools_;
+    };
+}
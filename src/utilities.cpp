@@ -1,6 +1,7 @@
 #include <precomp.h>
 #include <utilities.h>
 #include <fstream>
+#include <limits>
 
 namespace veng {
     
@@ -8,23 +9,30 @@ namespace veng {
         return std::strcmp(left, right) == 0;
     }
 
-    std::vector<std::uint8_t> ReadFile(std::filesystem::path shader_path) {
-        if (!std::filesystem::exists(shader_path)) {
+    std::vector<std::uint8_t> ReadFile(std::filesystem::path path) {
+        if (!std::filesystem::exists(path)) {
             return {};
         }
 
-        if (!std::filesystem::is_regular_file(shader_path)) {
+        if (!std::filesystem::is_regular_file(path)) {
             return {};
         }
 
-        std::ifstream file(shader_path, std::ios::binary);
+        std::ifstream file(path, std::ios::binary);
         if (!file.is_open()) {
             return {};
         }
 
-        const std::uint32_t size = std::filesystem::file_size(shader_path);
+        const std::uintmax_t size = std::filesystem::file_size(path);
+        if (size > std::numeric_limits<std::size_t>::max()) {
+            return {};
+        }
+
         std::vector<std::uint8_t> buffer(size);
-        file.read(reinterpret_cast<char*>(buffer.data()), size);
+        file.read(reinterpret_cast<char*>(buffer.data()), static_cast<std::streamsize>(size));
+        if (static_cast<std::uintmax_t>(file.gcount()) != size) {
+            return {};
+        }
         return buffer;
     }
 }
\ No newline at end of file
@@ -5,5 +5,6 @@
 namespace veng {
     
     bool streq(gsl::czstring left, gsl::czstring right);
-    std::vector<std::uint8_t> ReadFile(std::filesystem::path shader_path);
+    // Copies the whole file, MappedFile reads it in place. Empty when the file can't be read.
+    std::vector<std::uint8_t> ReadFile(std::filesystem::path path);
 }
\ No newline at end of file
@@ -0,0 +1,206 @@
+#include <precomp.h>
+#include <bc_encoder.h>
+#include <algorithm>
+#include <array>
+#include <vector>
+#include <spdlog/spdlog.h>
+
+// VulkanEngineBcEncoderTest
+// Throughput alone would look just as good with the bits in the wrong order, so every format has to get
+// a few fixed blocks back within its bound. CPU only, registered with ctest.
+namespace veng {
+
+    namespace {
+
+        // Reference decoders written from the format specs rather than the encoder, so a field in the
+        // wrong place shows up as a large error instead of cancelling out
+        std::array<std::uint8_t, 3> ExpandBc1Color(std::uint16_t color) {
+            std::uint32_t red = color >> 11;
+            std::uint32_t green = (color >> 5) & 63;
+            std::uint32_t blue = color & 31;
+            return {static_cast<std::uint8_t>(red << 3 | red >> 2), static_cast<std::uint8_t>(green << 2 | green >> 4),
+                    static_cast<std::uint8_t>(blue << 3 | blue >> 2)};
+        }
+
+        void DecodeBc1Block(const std::uint8_t* block, std::uint8_t* rgba) {
+            std::uint16_t color0 = block[0] | block[1] << 8;
+            std::uint16_t color1 = block[2] | block[3] << 8;
+            std::array<std::array<std::uint8_t, 4>, 4> palette = {};
+            std::array<std::uint8_t, 3> endpoint0 = ExpandBc1Color(color0);
+            std::array<std::uint8_t, 3> endpoint1 = ExpandBc1Color(color1);
+            for (std::uint32_t channel = 0; channel < 3; channel++) {
+                std::uint32_t low = endpoint0[channel];
+                std::uint32_t high = endpoint1[channel];
+                palette[0][channel] = low;
+                palette[1][channel] = high;
+                palette[2][channel] = color0 > color1 ? (2 * low + high) / 3 : (low + high) / 2;
+                palette[3][channel] = color0 > color1 ? (low + 2 * high) / 3 : 0;
+            }
+            palette[0][3] = palette[1][3] = palette[2][3] = 255;
+            palette[3][3] = color0 > color1 ? 255 : 0;
+
+            std::uint32_t indices = block[4] | block[5] << 8 | block[6] << 16 | std::uint32_t(block[7]) << 24;
+            for (std::uint32_t texel = 0; texel < 16; texel++) {
+                std::copy_n(palette[(indices >> (texel * 2)) & 3].begin(), 4, rgba + texel * 4);
+            }
+        }
+
+        // Writes one channel of the texels, stride apart
+        void DecodeBc4Block(const std::uint8_t* block, std::uint8_t* values, std::uint32_t stride) {
+            std::uint32_t low = block[0];
+            std::uint32_t high = block[1];
+            std::array<std::uint8_t, 8> palette = {static_cast<std::uint8_t>(low), static_cast<std::uint8_t>(high)};
+            for (std::uint32_t entry = 2; entry < 8; entry++) {
+                if (low > high) {
+                    palette[entry] = ((8 - entry) * low + (entry - 1) * high) / 7;
+                } else if (entry < 6) {
+                    palette[entry] = ((6 - entry) * low + (entry - 1) * high) / 5;
+                } else {
+                    palette[entry] = entry == 6 ? 0 : 255;
+                }
+            }
+
+            std::uint64_t indices = 0;
+            for (std::uint32_t byte = 0; byte < 6; byte++) {
+                indices |= std::uint64_t(block[2 + byte]) << (byte * 8);
+            }
+            for (std::uint32_t texel = 0; texel < 16; texel++) {
+                values[texel * stride] = palette[(indices >> (texel * 3)) & 7];
+            }
+        }
+
+        // Mode 6 only, the one mode the encoder writes. False for any other.
+        bool DecodeBc7Block(const std::uint8_t* block, std::uint8_t* rgba) {
+            std::uint32_t position = 0;
+            auto read = [&](std::uint32_t count) {
+                std::uint32_t value = 0;
+                for (std::uint32_t bit = 0; bit < count; bit++, position++) {
+                    value |= ((block[position / 8] >> (position % 8)) & 1u) << bit;
+                }
+                return value;
+            };
+            if (read(7) != 1u << 6) {
+                return false;
+            }
+
+            std::array<std::array<std::uint32_t, 4>, 2> endpoints = {};
+            for (std::uint32_t channel = 0; channel < 4; channel++) {
+                endpoints[0][channel] = read(7);
+                endpoints[1][channel] = read(7);
+            }
+            for (std::array<std::uint32_t, 4>& endpoint : endpoints) {
+                std::uint32_t p_bit = read(1);
+                for (std::uint32_t& value : endpoint) {
+                    value = value << 1 | p_bit;
+                }
+            }
+
+            constexpr std::array<std::uint32_t, 16> kWeights = {0, 4, 9, 13, 17, 21, 26, 30,
+                                                                34, 38, 43, 47, 51, 55, 60, 64};
+            for (std::uint32_t texel = 0; texel < 16; texel++) {
+                std::uint32_t weight = kWeights[read(texel == 0 ? 3 : 4)];
+                for (std::uint32_t channel = 0; channel < 4; channel++) {
+                    rgba[texel * 4 + channel] =
+                        ((64 - weight) * endpoints[0][channel] + weight * endpoints[1][channel] + 32) >> 6;
+                }
+            }
+            return true;
+        }
+
+        // Largest difference over the channels the format keeps, or 255 for a block that doesn't decode
+        std::int32_t GetBcRoundTripError(gsl::span<const std::uint8_t> rgba, BcFormat format, EncodeQuality quality) {
+            std::vector<std::uint8_t> block = EncodeBc(rgba, glm::ivec2(4, 4), format, quality);
+            std::array<std::uint8_t, 64> decoded = {};
+            std::uint32_t channel_count = 0;
+            switch (format) {
+                case BcFormat::kBc1:
+                    DecodeBc1Block(block.data(), decoded.data());
+                    channel_count = 3;
+                    break;
+                case BcFormat::kBc4:
+                    DecodeBc4Block(block.data(), decoded.data(), 4);
+                    channel_count = 1;
+                    break;
+                case BcFormat::kBc5:
+                    DecodeBc4Block(block.data(), decoded.data(), 4);
+                    DecodeBc4Block(block.data() + 8, decoded.data() + 1, 4);
+                    channel_count = 2;
+                    break;
+                case BcFormat::kBc7:
+                    if (!DecodeBc7Block(block.data(), decoded.data())) {
+                        return 255;
+                    }
+                    channel_count = 4;
+                    break;
+            }
+
+            std::int32_t error = 0;
+            for (std::uint32_t texel = 0; texel < 16; texel++) {
+                for (std::uint32_t channel = 0; channel < channel_count; channel++) {
+                    std::int32_t difference = decoded[texel * 4 + channel] - rgba[texel * 4 + channel];
+                    error = std::max(error, std::abs(difference));
+                }
+            }
+            return error;
+        }
+
+        // False when any format gets a block back outside its bound
+        bool CheckBcRoundTrips() {
+            std::array<std::pair<std::string_view, std::array<std::uint8_t, 64>>, 4> blocks;
+            blocks[0].first = "solid";
+            blocks[1].first = "two_color";
+            blocks[2].first = "gradient";
+            blocks[3].first = "alpha";
+            for (std::uint32_t texel = 0; texel < 16; texel++) {
+                std::uint32_t x = texel % 4;
+                std::uint32_t y = texel / 4;
+                std::array<std::array<std::uint8_t, 4>, 4> colors = {{
+                    {200, 96, 40, 255},
+                    (x + y) % 2 == 0 ? std::array<std::uint8_t, 4>{16, 200, 64, 255}
+                                     : std::array<std::uint8_t, 4>{232, 48, 160, 255},
+                    {static_cast<std::uint8_t>(20 + texel * 13), static_cast<std::uint8_t>(40 + texel * 9),
+                     static_cast<std::uint8_t>(220 - texel * 12), 255},
+                    {64, 128, 192, static_cast<std::uint8_t>(texel * 17)},
+                }};
+                for (std::uint32_t block = 0; block < blocks.size(); block++) {
+                    std::copy_n(colors[block].begin(), 4, blocks[block].second.begin() + texel * 4);
+                }
+            }
+
+            // Quantization error of each format on the blocks above plus a little, a misplaced field costs far more.
+            // The gradient has more levels than BC1 and BC4 have palette entries.
+            struct FormatBounds {
+                std::string_view name;
+                BcFormat format;
+                std::array<std::int32_t, 4> max_errors;
+            };
+            constexpr std::array<FormatBounds, 4> kBounds = {{
+                {"bc1", BcFormat::kBc1, {4, 6, 34, 6}},
+                {"bc4", BcFormat::kBc4, {1, 1, 16, 1}},
+                {"bc5", BcFormat::kBc5, {1, 1, 16, 1}},
+                {"bc7", BcFormat::kBc7, {2, 2, 4, 4}},
+            }};
+            for (const FormatBounds& bounds : kBounds) {
+                for (EncodeQuality quality : {EncodeQuality::kFast, EncodeQuality::kQuality}) {
+                    for (std::uint32_t block = 0; block < blocks.size(); block++) {
+                        std::int32_t error = GetBcRoundTripError(blocks[block].second, bounds.format, quality);
+                        if (error > bounds.max_errors[block]) {
+                            spdlog::error("{} {} block is off by {} after a round trip", bounds.name,
+                                          blocks[block].first, error);
+                            return false;
+                        }
+                    }
+                }
+            }
+            return true;
+        }
+    }
+}
+
+std::int32_t main() {
+    if (!veng::CheckBcRoundTrips()) {
+        return EXIT_FAILURE;
+    }
+    spdlog::info("Every BC format round trips within its bound");
+    return EXIT_SUCCESS;
+}
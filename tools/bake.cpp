@@ -0,0 +1,49 @@
+#include <precomp.h>
+#include <asset_baker.h>
+#include <spdlog/spdlog.h>
+
+// VulkanEngineBake [--cache=<directory>] [--compress=bc1|bc4|bc5|bc7] [--fast] <archive.vpak> <file>...
+// Assets are named after their file name like the packer does. The cache defaults to bake_cache next to
+// the archive, sources whose contents haven't changed since the last bake are copied from there.
+// --compress block compresses the textures, --fast trades some of their quality for encoding speed.
+std::int32_t main(std::int32_t argc, gsl::zstring* argv) {
+    std::optional<std::filesystem::path> cache_directory;
+    std::optional<veng::BcFormat> compression;
+    veng::EncodeQuality quality = veng::EncodeQuality::kQuality;
+    std::vector<std::filesystem::path> paths;
+    for (gsl::czstring argument : gsl::span<gsl::zstring>(argv, argc).subspan(1)) {
+        std::string_view value(argument);
+        if (value.starts_with("--cache=")) {
+            cache_directory = value.substr(std::string_view("--cache=").size());
+        } else if (value.starts_with("--compress=")) {
+            compression = veng::ParseBcFormat(value.substr(std::string_view("--compress=").size()));
+            if (!compression.has_value()) {
+                spdlog::error("Unknown texture compression {}", value);
+                return EXIT_FAILURE;
+            }
+        } else if (value == "--fast") {
+            quality = veng::EncodeQuality::kFast;
+        } else {
+            paths.emplace_back(value);
+        }
+    }
+    if (paths.size() < 2) {
+        spdlog::error("Usage: VulkanEngineBake [--cache=<directory>] [--compress=bc1|bc4|bc5|bc7] [--fast] "
+                      "<archive.vpak> <file>...");
+        return EXIT_FAILURE;
+    }
+
+    std::filesystem::path output = paths.front();
+    veng::AssetBaker baker(cache_directory.value_or(output.parent_path() / "bake_cache"));
+    baker.SetCompression(compression, quality);
+    for (const std::filesystem::path& path : gsl::span(paths).subspan(1)) {
+        baker.Add(path, path.filename().string());
+    }
+
+    veng::JobSystem jobs;
+    if (!baker.Bake(output, jobs)) {
+        return EXIT_FAILURE;
+    }
+    spdlog::info("Baked {} assets into {}, {} unchanged", paths.size() - 1, output.string(), baker.GetCachedCount());
+    return EXIT_SUCCESS;
+}
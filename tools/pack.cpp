@@ -0,0 +1,28 @@
+#include <precomp.h>
+#include <asset_archive.h>
+#include <spdlog/spdlog.h>
+
+// VulkanEnginePack <archive.vpak> <file>...
+// Assets are named after their file name, e.g. paving-stones.jpg or basic.vert.spv
+std::int32_t main(std::int32_t argc, gsl::zstring* argv) {
+    gsl::span<gsl::zstring> arguments(argv, argc);
+    if (arguments.size() < 2) {
+        spdlog::error("Usage: VulkanEnginePack <archive.vpak> <file>...");
+        return EXIT_FAILURE;
+    }
+
+    veng::AssetArchiveWriter writer;
+    for (gsl::czstring argument : arguments.subspan(2)) {
+        std::filesystem::path path(argument);
+        if (!writer.AddFile(path, path.filename().string())) {
+            return EXIT_FAILURE;
+        }
+    }
+
+    std::filesystem::path output(arguments[1]);
+    if (!writer.Write(output)) {
+        return EXIT_FAILURE;
+    }
+    spdlog::info("Packed {} assets into {}", arguments.size() - 2, output.string());
+    return EXIT_SUCCESS;
+}